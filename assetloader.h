@@ -0,0 +1,210 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Loads bitmaps in the background.  A pool of worker threads takes the
+// files one at a time and decodes each into an ordinary memory surface
+// (from the asset pack if it has the file), so however many there are
+// they take about as long as the biggest one instead of all of them end to
+// end.  The thread that owns the device collects each bitmap as it finishes
+// and puts it in a real surface, and can keep drawing frames meanwhile.
+//
+// Nothing here touches Direct3D, so the whole thing runs in the headless
+// tools too.  Only the thread that started the loader may collect from it.
+
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <atomic>
+#include <thread>
+#include "platform.h"
+#include "hrclock.h"
+#include "surface.h"
+#include "bmp.h"
+#include "assetpack.h"
+#include "resources.h"
+#include "trace.h"
+
+#define ASSETLOADER_MAXASSETS	32
+#define ASSETLOADER_MAXTHREADS	8
+
+enum
+{
+	ASSET_QUEUED,
+	ASSET_DECODING,
+	ASSET_DECODED,
+	ASSET_FAILED,
+};
+
+struct ASSETLOAD
+{
+	char PathName[ RESOURCE_MAXPATH ];
+	CMemorySurface32 Pixels;		// Written by one worker, then only read
+
+	std::atomic<int> State;
+	BOOL bCollected;				// Handed out by CollectAsset()
+
+	// HrClockNow() counts, for the load timings
+	int Thread;						// Which worker decoded it
+	INT64 Started;
+	INT64 Decoded;
+};
+
+struct ASSETLOADER
+{
+	ASSETLOAD Loads[ ASSETLOADER_MAXASSETS ];
+	int Count;
+	int Collected;
+
+	const ASSETPACK* pPack;			// May be 0.  Has to stay open until StopAssetLoader().
+	INT64 StartTime;
+
+	std::thread Workers[ ASSETLOADER_MAXTHREADS ];
+	int Threads;
+
+	alignas( 64 ) std::atomic<int> NextLoad;
+};
+
+// Decodes one file into memory, from the pack if it has it
+BOOL DecodeAsset( const ASSETPACK* pPack, const char* PathName, CMemorySurface32* pPixels )
+{
+	const ASSETPACKIMAGE* pImage = pPack ? FindAssetPackImage( pPack, PathName ) : 0;
+	if( !pImage )
+		return LoadBmpFile( PathName, pPixels );
+
+	if( !pPixels->Create( pImage->Width, pImage->Height ) )
+		return FALSE;
+
+	CopyAssetPackImage( pPack, pImage, pPixels->GetBits(), pPixels->GetPitch() );
+	return TRUE;
+}
+
+void AssetLoaderWorker( ASSETLOADER* pLoader, int Thread )
+{
+	char Name[ 32 ];
+	snprintf( Name, sizeof( Name ), "Asset Loader %d", Thread );
+	TraceNameThread( Name );
+
+	for( ;; )
+	{
+		int i = pLoader->NextLoad.fetch_add( 1, std::memory_order_relaxed );
+		if( i >= pLoader->Count )
+			break;
+
+		ASSETLOAD* pLoad = &pLoader->Loads[ i ];
+		pLoad->Thread = Thread;
+		pLoad->Started = HrClockNow();
+		pLoad->State.store( ASSET_DECODING, std::memory_order_relaxed );
+
+		BOOL bOk;
+		{
+			TRACE_SCOPE( "DecodeAsset" );
+			bOk = DecodeAsset( pLoader->pPack, pLoad->PathName, &pLoad->Pixels );
+		}
+
+		pLoad->Decoded = HrClockNow();
+
+		// Release, so the pixels are all there before the collecting thread sees the state
+		pLoad->State.store( bOk ? ASSET_DECODED : ASSET_FAILED, std::memory_order_release );
+	}
+}
+
+// Starts decoding Count files on Threads workers (0 for one per core, up to the number of
+// files).  Returns at once.  Files are started in the order given, so put the one wanted
+// first, first.
+BOOL StartAssetLoader( ASSETLOADER* pLoader, const char** PathNames, int Count, int Threads = 0, const ASSETPACK* pPack = 0 )
+{
+	if( Count > ASSETLOADER_MAXASSETS )
+		return FALSE;
+
+	for( int i = 0 ; i < Count ; i++ )
+		if( strlen( PathNames[ i ] ) >= RESOURCE_MAXPATH )
+			return FALSE;
+
+	if( Threads <= 0 )
+		Threads = (int)std::thread::hardware_concurrency();
+	if( Threads > Count )
+		Threads = Count;
+	if( Threads > ASSETLOADER_MAXTHREADS )
+		Threads = ASSETLOADER_MAXTHREADS;
+	if( Threads < 1 )
+		Threads = 1;
+
+	pLoader->Count = Count;
+	pLoader->Collected = 0;
+	pLoader->pPack = pPack;
+	pLoader->StartTime = HrClockNow();
+	pLoader->NextLoad.store( 0, std::memory_order_relaxed );
+
+	for( int i = 0 ; i < Count ; i++ )
+	{
+		ASSETLOAD* pLoad = &pLoader->Loads[ i ];
+		strcpy( pLoad->PathName, PathNames[ i ] );
+		pLoad->Pixels.Release();
+		pLoad->State.store( ASSET_QUEUED, std::memory_order_relaxed );
+		pLoad->bCollected = FALSE;
+		pLoad->Thread = 0;
+		pLoad->Started = pLoad->Decoded = 0;
+	}
+
+	pLoader->Threads = Threads;
+	for( int t = 0 ; t < Threads ; t++ )
+		pLoader->Workers[ t ] = std::thread( AssetLoaderWorker, pLoader, t );
+
+	return TRUE;
+}
+
+// Hands out the next file that has finished (or failed), in the order they finish.  Returns its
+// index in the list given to StartAssetLoader(), or -1 if none has finished since last time.
+int CollectAsset( ASSETLOADER* pLoader )
+{
+	for( int i = 0 ; i < pLoader->Count ; i++ )
+	{
+		ASSETLOAD* pLoad = &pLoader->Loads[ i ];
+		if( pLoad->bCollected || pLoad->State.load( std::memory_order_acquire ) < ASSET_DECODED )
+			continue;
+
+		pLoad->bCollected = TRUE;
+		pLoader->Collected++;
+		return i;
+	}
+
+	return -1;
+}
+
+inline BOOL IsAssetLoaderDone( const ASSETLOADER* pLoader )
+{
+	return pLoader->Collected == pLoader->Count;
+}
+
+// The decoded pixels of a file that has been collected, or 0.  This is how the resource cache's
+// loader finds them (see LoadD3DResource()).
+CMemorySurface32* FindCollectedAsset( ASSETLOADER* pLoader, const char* PathName )
+{
+	for( int i = 0 ; i < pLoader->Count ; i++ )
+	{
+		ASSETLOAD* pLoad = &pLoader->Loads[ i ];
+		if( pLoad->bCollected && pLoad->State.load( std::memory_order_relaxed ) == ASSET_DECODED &&
+			ResourcePathsMatch( pLoad->PathName, PathName ) )
+			return &pLoad->Pixels;
+	}
+
+	return 0;
+}
+
+// Waits for the workers and frees the decoded pixels.  Anything not collected is thrown away.
+void StopAssetLoader( ASSETLOADER* pLoader )
+{
+	for( int t = 0 ; t < pLoader->Threads ; t++ )
+		pLoader->Workers[ t ].join();
+
+	for( int i = 0 ; i < pLoader->Count ; i++ )
+		pLoader->Loads[ i ].Pixels.Release();
+
+	pLoader->Threads = 0;
+	pLoader->Count = pLoader->Collected = 0;
+}
+
+#endif	// ASSETLOADER_H
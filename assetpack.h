@@ -0,0 +1,229 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Asset packs: all of the game's bitmaps baked into one file, already in
+// X8R8G8B8 with every row padded out the way a surface's would be.  The
+// pack is memory mapped in one go and each image is used where it lies, so
+// loading is a lookup and a copy into the surface, with no decoding and one
+// file to open instead of one per bitmap.  Build one with "headless pack".
+//
+// File layout (little endian, as the structures are in memory on x86):
+//		ASSETPACKHEADER
+//		ASSETPACKIMAGE table
+//		the pixels of each image, starting on an ASSETPACK_ALIGN boundary
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+#include "surface.h"
+
+#define ASSETPACK_MAGIC		0x4B415055	// 'UPAK'
+#define ASSETPACK_VERSION	1
+#define ASSETPACK_ALIGN		64			// Images start on a cache line
+#define ASSETPACK_PITCHALIGN	16		// Rows start 16 byte aligned for the SSE2 blitters
+#define ASSETPACK_MAXNAME	40
+
+struct ASSETPACKHEADER
+{
+	DWORD Magic;
+	DWORD Version;
+	DWORD ImageCount;
+	DWORD Reserved;
+};
+
+struct ASSETPACKIMAGE
+{
+	char Name[ ASSETPACK_MAXNAME ];		// The bitmap's file name, without its folder
+	DWORD Width;
+	DWORD Height;
+	DWORD Pitch;						// In bytes
+	DWORD Reserved;
+	INT64 Offset;						// File offset of the top row
+};
+
+// The layout is the file format, so it must not change with the compiler
+static_assert( sizeof( ASSETPACKHEADER ) == 16, "ASSETPACKHEADER is part of the file format" );
+static_assert( sizeof( ASSETPACKIMAGE ) == 64, "ASSETPACKIMAGE is part of the file format" );
+
+// The part of a path a pack knows an image by, so "graphics\\ball.bmp" finds "ball.bmp"
+inline const char* AssetPackName( const char* PathName )
+{
+	const char* pName = PathName;
+	for( const char* p = PathName ; *p ; p++ )
+		if( *p == '\\' || *p == '/' )
+			pName = p + 1;
+
+	return pName;
+}
+
+//====================================================
+// Writing
+//====================================================
+
+// Writes Count surfaces to a new pack.  Names are used as they are given (see AssetPackName()).
+BOOL WriteAssetPack( const char* FileName, const char** Names, ISurface32** ppSurfaces, int Count )
+{
+	ASSETPACKIMAGE* pImages = new ASSETPACKIMAGE[ Count ? Count : 1 ];
+	memset( pImages, 0, sizeof( ASSETPACKIMAGE ) * ( Count ? Count : 1 ) );
+
+	// Lay the pixels out after the table
+	INT64 Pos = sizeof( ASSETPACKHEADER ) + (INT64)Count * sizeof( ASSETPACKIMAGE );
+	BOOL bOk = TRUE;
+
+	for( int i = 0 ; i < Count && bOk ; i++ )
+	{
+		ASSETPACKIMAGE* pImage = &pImages[ i ];
+		const char* pName = AssetPackName( Names[ i ] );
+
+		bOk = strlen( pName ) < ASSETPACK_MAXNAME;
+		strncpy( pImage->Name, pName, ASSETPACK_MAXNAME - 1 );
+
+		pImage->Width = ppSurfaces[ i ]->GetWidth();
+		pImage->Height = ppSurfaces[ i ]->GetHeight();
+		pImage->Pitch = ( pImage->Width * 4 + ASSETPACK_PITCHALIGN - 1 ) & ~( ASSETPACK_PITCHALIGN - 1 );
+
+		Pos = ( Pos + ASSETPACK_ALIGN - 1 ) & ~(INT64)( ASSETPACK_ALIGN - 1 );
+		pImage->Offset = Pos;
+		Pos += (INT64)pImage->Pitch * pImage->Height;
+	}
+
+	FILE* pFile = bOk ? fopen( FileName, "wb" ) : 0;
+	if( !pFile )
+	{
+		delete [] pImages;
+		return FALSE;
+	}
+
+	ASSETPACKHEADER Header;
+	memset( &Header, 0, sizeof( Header ) );
+	Header.Magic = ASSETPACK_MAGIC;
+	Header.Version = ASSETPACK_VERSION;
+	Header.ImageCount = Count;
+
+	bOk = fwrite( &Header, sizeof( Header ), 1, pFile ) == 1;
+	if( bOk && Count )
+		bOk = fwrite( pImages, sizeof( ASSETPACKIMAGE ), Count, pFile ) == (size_t)Count;
+
+	INT64 Written = sizeof( ASSETPACKHEADER ) + (INT64)Count * sizeof( ASSETPACKIMAGE );
+	static const BYTE Zero[ ASSETPACK_ALIGN ] = { 0 };
+
+	for( int i = 0 ; i < Count && bOk ; i++ )
+	{
+		ASSETPACKIMAGE* pImage = &pImages[ i ];
+
+		LOCKEDSURFACE32 Locked;
+		if( !ppSurfaces[ i ]->Lock( &Locked, TRUE ) )
+		{
+			bOk = FALSE;
+			break;
+		}
+
+		// Padding up to the image, then each row with its padding
+		DWORD Gap = (DWORD)( pImage->Offset - Written );
+		bOk = !Gap || fwrite( Zero, Gap, 1, pFile ) == 1;
+
+		DWORD RowPad = pImage->Pitch - pImage->Width * 4;
+		for( DWORD y = 0 ; y < pImage->Height && bOk ; y++ )
+		{
+			bOk = fwrite( (BYTE*)Locked.pBits + (INT64)y * Locked.Pitch, pImage->Width * 4, 1, pFile ) == 1;
+			if( bOk && RowPad )
+				bOk = fwrite( Zero, RowPad, 1, pFile ) == 1;
+		}
+
+		ppSurfaces[ i ]->Unlock();
+		Written = pImage->Offset + (INT64)pImage->Pitch * pImage->Height;
+	}
+
+	bOk = ( fclose( pFile ) == 0 ) && bOk;
+	delete [] pImages;
+	return bOk;
+}
+
+//====================================================
+// Reading
+//====================================================
+
+// A pack in memory.  Only points into the data it was opened on.
+struct ASSETPACK
+{
+	const BYTE* pBase;
+	INT64 Size;
+	const ASSETPACKIMAGE* pImages;
+	int ImageCount;
+};
+
+// Checks the header and the image table of a pack at pData (normally a mapped file, which is
+// page aligned).  Nothing is copied; pData has to stay around while the pack is used.
+BOOL OpenAssetPack( ASSETPACK* pPack, const BYTE* pData, INT64 Size )
+{
+	memset( pPack, 0, sizeof( ASSETPACK ) );
+
+	if( !pData || ( (size_t)pData & ( ASSETPACK_ALIGN - 1 ) ) || Size < (INT64)sizeof( ASSETPACKHEADER ) )
+		return FALSE;
+
+	const ASSETPACKHEADER* pHeader = (const ASSETPACKHEADER*)pData;
+	if( pHeader->Magic != ASSETPACK_MAGIC || pHeader->Version != ASSETPACK_VERSION ||
+		(INT64)sizeof( ASSETPACKHEADER ) + (INT64)pHeader->ImageCount * (INT64)sizeof( ASSETPACKIMAGE ) > Size )
+		return FALSE;
+
+	const ASSETPACKIMAGE* pImages = (const ASSETPACKIMAGE*)( pData + sizeof( ASSETPACKHEADER ) );
+
+	// Check every image once here so lookups do not have to
+	for( DWORD i = 0 ; i < pHeader->ImageCount ; i++ )
+	{
+		const ASSETPACKIMAGE* pImage = &pImages[ i ];
+		if( pImage->Name[ ASSETPACK_MAXNAME - 1 ] || pImage->Width == 0 || pImage->Height == 0 ||
+			pImage->Width > 0x10000 || pImage->Height > 0x10000 || pImage->Pitch < pImage->Width * 4 ||
+			( pImage->Pitch & 3 ) || pImage->Offset < 0 || ( pImage->Offset & ( ASSETPACK_ALIGN - 1 ) ) ||
+			(INT64)pImage->Pitch * pImage->Height > Size || pImage->Offset > Size - (INT64)pImage->Pitch * pImage->Height )
+			return FALSE;
+	}
+
+	pPack->pBase = pData;
+	pPack->Size = Size;
+	pPack->pImages = pImages;
+	pPack->ImageCount = (int)pHeader->ImageCount;
+	return TRUE;
+}
+
+// Finds an image by its file name (any folder in PathName is ignored).  Returns 0 if the pack
+// does not have it, or no pack is open.
+const ASSETPACKIMAGE* FindAssetPackImage( const ASSETPACK* pPack, const char* PathName )
+{
+	const char* pName = AssetPackName( PathName );
+
+	for( int i = 0 ; i < pPack->ImageCount ; i++ )
+		if( !strcmp( pPack->pImages[ i ].Name, pName ) )
+			return &pPack->pImages[ i ];
+
+	return 0;
+}
+
+inline const DWORD* GetAssetPackPixels( const ASSETPACK* pPack, const ASSETPACKIMAGE* pImage )
+{
+	return (const DWORD*)( pPack->pBase + pImage->Offset );
+}
+
+// Copies an image into pDest, which must be at least as big.  DestPitch is in bytes.  When the
+// pitches match, as they normally do, the whole image is one copy.
+void CopyAssetPackImage( const ASSETPACK* pPack, const ASSETPACKIMAGE* pImage, DWORD* pDest, int DestPitch )
+{
+	const BYTE* pSrc = (const BYTE*)GetAssetPackPixels( pPack, pImage );
+
+	if( (DWORD)DestPitch == pImage->Pitch )
+	{
+		memcpy( pDest, pSrc, (size_t)pImage->Pitch * ( pImage->Height - 1 ) + pImage->Width * 4 );
+		return;
+	}
+
+	for( DWORD y = 0 ; y < pImage->Height ; y++ )
+		memcpy( (BYTE*)pDest + (INT64)y * DestPitch, pSrc + (INT64)y * pImage->Pitch, pImage->Width * 4 );
+}
+
+#endif	// ASSETPACK_H
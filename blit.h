@@ -0,0 +1,339 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// 32-bit blitters that work on raw DWORD buffers with a pitch.  There is a
+// scalar, an SSE2 and an AVX2 version of each; InitBlitters() picks the
+// best one the CPU supports.  Nothing in here needs Direct3D.
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <string.h>
+#include "platform.h"
+#include "cpu.h"
+
+// Pitches are in bytes, the same as D3DLOCKED_RECT::Pitch
+typedef void (*BLITOPAQUE32)( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height );
+typedef void (*BLITCOLORKEY32)( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height, DWORD ColorKey );
+
+//====================================================
+// Scalar Blitters
+//====================================================
+
+// Copies a block of pixels
+void BlitOpaque32_Scalar( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height )
+{
+	// Convert the pitches from bytes to DWORDS
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	// Copy each row in one go
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		memcpy( pDest, pSrc, Width * 4 );
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+// Copies a block of pixels, skipping the ones that match the color key
+void BlitColorKey32_Scalar( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height, DWORD ColorKey )
+{
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		for( int x = 0 ; x < Width ; x++ )
+		{
+			// Only copy the pixel if it is not transparent
+			if( pSrc[ x ] != ColorKey )
+				pDest[ x ] = pSrc[ x ];
+		}
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+//====================================================
+// SSE2 Blitters (4 pixels at a time)
+//====================================================
+
+#ifdef PLATFORM_X86
+
+CPU_TARGET_SSE2 void BlitOpaque32_SSE2( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height )
+{
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		int x = 0;
+
+		// Move 4 pixels per step
+		for( ; x + 4 <= Width ; x += 4 )
+			_mm_storeu_si128( (__m128i*)( pDest + x ), _mm_loadu_si128( (const __m128i*)( pSrc + x ) ) );
+
+		// Finish off the end of the row
+		for( ; x < Width ; x++ )
+			pDest[ x ] = pSrc[ x ];
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+CPU_TARGET_SSE2 void BlitColorKey32_SSE2( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height, DWORD ColorKey )
+{
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	const __m128i Key = _mm_set1_epi32( (int)ColorKey );
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		int x = 0;
+
+		for( ; x + 4 <= Width ; x += 4 )
+		{
+			__m128i Src = _mm_loadu_si128( (const __m128i*)( pSrc + x ) );
+
+			// All ones in each lane that matches the color key
+			__m128i Mask = _mm_cmpeq_epi32( Src, Key );
+			int Bits = _mm_movemask_epi8( Mask );
+
+			// Nothing to draw
+			if( Bits == 0xFFFF )
+				continue;
+
+			// Nothing transparent, so no need to read the destination
+			if( Bits == 0 )
+			{
+				_mm_storeu_si128( (__m128i*)( pDest + x ), Src );
+				continue;
+			}
+
+			// Keep the destination where the key matched and the source everywhere else
+			__m128i Dest = _mm_loadu_si128( (const __m128i*)( pDest + x ) );
+			Dest = _mm_or_si128( _mm_and_si128( Mask, Dest ), _mm_andnot_si128( Mask, Src ) );
+			_mm_storeu_si128( (__m128i*)( pDest + x ), Dest );
+		}
+
+		for( ; x < Width ; x++ )
+		{
+			if( pSrc[ x ] != ColorKey )
+				pDest[ x ] = pSrc[ x ];
+		}
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+#endif	// PLATFORM_X86
+
+//====================================================
+// AVX2 Blitters (8 pixels at a time)
+//====================================================
+
+#ifndef CPU_NO_AVX2
+
+// Returns a mask with the first Count lanes switched on
+CPU_TARGET_AVX2 inline __m256i BlitTailMask( int Count )
+{
+	return _mm256_cmpgt_epi32( _mm256_set1_epi32( Count ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) );
+}
+
+CPU_TARGET_AVX2 void BlitOpaque32_AVX2( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height )
+{
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	// The mask for the partial block at the end of every row
+	int Tail = Width & 7;
+	__m256i TailMask = BlitTailMask( Tail );
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		int x = 0;
+
+		for( ; x + 8 <= Width ; x += 8 )
+			_mm256_storeu_si256( (__m256i*)( pDest + x ), _mm256_loadu_si256( (const __m256i*)( pSrc + x ) ) );
+
+		// Masked load and store so we never touch pixels past the end of the row
+		if( Tail )
+		{
+			__m256i Src = _mm256_maskload_epi32( (const int*)( pSrc + x ), TailMask );
+			_mm256_maskstore_epi32( (int*)( pDest + x ), TailMask, Src );
+		}
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+CPU_TARGET_AVX2 void BlitColorKey32_AVX2( const DWORD* pSrc, int SrcPitch, DWORD* pDest, int DestPitch, int Width, int Height, DWORD ColorKey )
+{
+	int SrcPitch32 = SrcPitch / 4;
+	int DestPitch32 = DestPitch / 4;
+
+	const __m256i Key = _mm256_set1_epi32( (int)ColorKey );
+
+	int Tail = Width & 7;
+	__m256i TailMask = BlitTailMask( Tail );
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		int x = 0;
+
+		for( ; x + 8 <= Width ; x += 8 )
+		{
+			__m256i Src = _mm256_loadu_si256( (const __m256i*)( pSrc + x ) );
+			__m256i Mask = _mm256_cmpeq_epi32( Src, Key );
+			int Bits = _mm256_movemask_epi8( Mask );
+
+			// Nothing to draw
+			if( Bits == -1 )
+				continue;
+
+			if( Bits == 0 )
+			{
+				_mm256_storeu_si256( (__m256i*)( pDest + x ), Src );
+				continue;
+			}
+
+			// Pick the destination where the key matched
+			__m256i Dest = _mm256_loadu_si256( (const __m256i*)( pDest + x ) );
+			_mm256_storeu_si256( (__m256i*)( pDest + x ), _mm256_blendv_epi8( Src, Dest, Mask ) );
+		}
+
+		// Only store the lanes that are inside the row and not transparent
+		if( Tail )
+		{
+			__m256i Src = _mm256_maskload_epi32( (const int*)( pSrc + x ), TailMask );
+			__m256i Opaque = _mm256_andnot_si256( _mm256_cmpeq_epi32( Src, Key ), TailMask );
+			_mm256_maskstore_epi32( (int*)( pDest + x ), Opaque, Src );
+		}
+
+		pSrc += SrcPitch32;
+		pDest += DestPitch32;
+	}
+}
+
+#endif	// CPU_NO_AVX2
+
+//====================================================
+// Dispatch
+//====================================================
+
+// The blitters in use.  These work before InitBlitters() is called.
+BLITOPAQUE32 g_pfnBlitOpaque32 = BlitOpaque32_Scalar;
+BLITCOLORKEY32 g_pfnBlitColorKey32 = BlitColorKey32_Scalar;
+
+// Name of the blitters in use
+const char* g_BlitterName = "Scalar";
+
+// Picks the fastest blitters for this CPU.  Pass FALSE to force the scalar ones.
+void InitBlitters( BOOL bAllowSIMD = TRUE )
+{
+	g_pfnBlitOpaque32 = BlitOpaque32_Scalar;
+	g_pfnBlitColorKey32 = BlitColorKey32_Scalar;
+	g_BlitterName = "Scalar";
+
+	if( !bAllowSIMD )
+		return;
+
+#ifdef PLATFORM_X86
+#ifndef CPU_NO_AVX2
+	if( CpuHasAVX2() )
+	{
+		g_pfnBlitOpaque32 = BlitOpaque32_AVX2;
+		g_pfnBlitColorKey32 = BlitColorKey32_AVX2;
+		g_BlitterName = "AVX2";
+		return;
+	}
+#endif
+
+	if( CpuHasSSE2() )
+	{
+		g_pfnBlitOpaque32 = BlitOpaque32_SSE2;
+		g_pfnBlitColorKey32 = BlitColorKey32_SSE2;
+		g_BlitterName = "SSE2";
+	}
+#endif
+}
+
+//====================================================
+// Fills
+//====================================================
+
+// Fills a rectangle with one color.  The caller has already clipped it.
+void FillRect32( DWORD* pDestData, int DestPitch, RECT Rect, DWORD Color )
+{
+	int Pitch32 = DestPitch / 4;
+
+	for( int y = Rect.top ; y < Rect.bottom ; y++ )
+	{
+		DWORD* pRow = pDestData + y * Pitch32;
+
+		// Simple enough for the compiler to vectorize
+		for( int x = Rect.left ; x < Rect.right ; x++ )
+			pRow[ x ] = Color;
+	}
+}
+
+//====================================================
+// Clipped Blit
+//====================================================
+
+// Clips a source rectangle and destination point against a DestWidth x DestHeight target.
+// Returns FALSE if there is nothing left to draw.
+BOOL ClipBlit( RECT* pSourceRect, POINT* pDestPoint, int DestWidth, int DestHeight )
+{
+	// Off the left or top edge
+	if( pDestPoint->x < 0 )
+	{
+		pSourceRect->left -= pDestPoint->x;
+		pDestPoint->x = 0;
+	}
+	if( pDestPoint->y < 0 )
+	{
+		pSourceRect->top -= pDestPoint->y;
+		pDestPoint->y = 0;
+	}
+
+	// Off the right or bottom edge
+	if( pDestPoint->x + ( pSourceRect->right - pSourceRect->left ) > DestWidth )
+		pSourceRect->right = pSourceRect->left + ( DestWidth - pDestPoint->x );
+	if( pDestPoint->y + ( pSourceRect->bottom - pSourceRect->top ) > DestHeight )
+		pSourceRect->bottom = pSourceRect->top + ( DestHeight - pDestPoint->y );
+
+	return ( pSourceRect->right > pSourceRect->left ) && ( pSourceRect->bottom > pSourceRect->top );
+}
+
+// Blits part of one DWORD buffer to another, clipped to the destination
+void Blit32( const DWORD* pSrcData, int SrcPitch, RECT SourceRect, DWORD* pDestData, int DestPitch,
+			 int DestWidth, int DestHeight, POINT DestPoint, BOOL bTransparent, DWORD ColorKey )
+{
+	if( !ClipBlit( &SourceRect, &DestPoint, DestWidth, DestHeight ) )
+		return;
+
+	// Get pointers to the first pixel of each rectangle
+	const DWORD* pSrc = pSrcData + SourceRect.top * ( SrcPitch / 4 ) + SourceRect.left;
+	DWORD* pDest = pDestData + DestPoint.y * ( DestPitch / 4 ) + DestPoint.x;
+
+	int Width = SourceRect.right - SourceRect.left;
+	int Height = SourceRect.bottom - SourceRect.top;
+
+	if( bTransparent )
+		g_pfnBlitColorKey32( pSrc, SrcPitch, pDest, DestPitch, Width, Height, ColorKey );
+	else
+		g_pfnBlitOpaque32( pSrc, SrcPitch, pDest, DestPitch, Width, Height );
+}
+
+#endif	// BLIT_H
@@ -0,0 +1,171 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Windows bitmap (.bmp) reader.  The header is read once and the pixels are
+// converted straight into 32 bit X8R8G8B8 memory, such as a locked surface,
+// so a file is only decoded one time and never goes through GDI.
+//
+// Reads uncompressed 1, 4, 8, 24 and 32 bit files, bottom up or top down,
+// which is everything the game's art is saved as.  Pixels come out with the
+// top byte 0, the same as D3DX gave us, so colour keys still match.
+
+#ifndef BMP_H
+#define BMP_H
+
+#include <string.h>
+#include "platform.h"
+#include "mapfile.h"
+#include "surface.h"
+
+#define BMP_MAXSIZE		16384		// Widest or tallest bitmap we will take
+
+struct BMPINFO
+{
+	int Width;
+	int Height;
+	int BitCount;
+	BOOL bTopDown;				// Rows are stored top row first
+	DWORD PixelOffset;			// Where the first stored row starts
+	int RowBytes;				// Stored row size, padded to 4 bytes
+	DWORD Palette[ 256 ];		// Already X8R8G8B8, for 8 bits and under
+};
+
+inline DWORD BmpWord( const BYTE* p ) { return p[ 0 ] | ( p[ 1 ] << 8 ); }
+inline DWORD BmpDword( const BYTE* p ) { return p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 ) | ( (DWORD)p[ 3 ] << 24 ); }
+
+// Reads the file and info headers of a bitmap held in memory.  Returns FALSE if it is not a
+// bitmap we can read, or the file is too short for the pixels it says it has.
+BOOL ReadBmpHeader( const BYTE* pData, INT64 Size, BMPINFO* pInfo )
+{
+	memset( pInfo, 0, sizeof( BMPINFO ) );
+
+	// BITMAPFILEHEADER (14 bytes) then at least a BITMAPINFOHEADER (40 bytes)
+	if( !pData || Size < 54 || pData[ 0 ] != 'B' || pData[ 1 ] != 'M' )
+		return FALSE;
+
+	DWORD HeaderSize = BmpDword( pData + 14 );
+	int Width = (int)BmpDword( pData + 18 );
+	int Height = (int)BmpDword( pData + 22 );
+	DWORD Planes = BmpWord( pData + 26 );
+	int BitCount = (int)BmpWord( pData + 28 );
+	DWORD Compression = BmpDword( pData + 30 );
+	DWORD ColorsUsed = BmpDword( pData + 46 );
+
+	// Older OS/2 headers are 12 bytes and nothing we ship uses them
+	if( HeaderSize < 40 || Planes != 1 )
+		return FALSE;
+
+	if( BitCount != 1 && BitCount != 4 && BitCount != 8 && BitCount != 24 && BitCount != 32 )
+		return FALSE;
+
+	if( Compression == 3 )
+	{
+		// BI_BITFIELDS is fine as long as the masks are the normal ones.  They sit straight
+		// after the 40 byte header whether they are part of a bigger header or not.
+		if( BitCount != 32 || Size < 66 || BmpDword( pData + 54 ) != 0x00FF0000 ||
+			BmpDword( pData + 58 ) != 0x0000FF00 || BmpDword( pData + 62 ) != 0x000000FF )
+			return FALSE;
+	}
+	else if( Compression != 0 )
+		return FALSE;
+
+	pInfo->bTopDown = Height < 0;
+	if( Height < 0 )
+		Height = -Height;
+
+	if( Width <= 0 || Height <= 0 || Width > BMP_MAXSIZE || Height > BMP_MAXSIZE )
+		return FALSE;
+
+	pInfo->Width = Width;
+	pInfo->Height = Height;
+	pInfo->BitCount = BitCount;
+	pInfo->PixelOffset = BmpDword( pData + 10 );
+	pInfo->RowBytes = ( ( Width * BitCount + 31 ) / 32 ) * 4;
+
+	if( pInfo->PixelOffset + (INT64)pInfo->RowBytes * Height > Size )
+		return FALSE;
+
+	if( BitCount <= 8 )
+	{
+		DWORD Colors = ColorsUsed ? ColorsUsed : 1 << BitCount;
+		DWORD PaletteOffset = 14 + HeaderSize;
+
+		if( Colors > ( 1u << BitCount ) || PaletteOffset + (INT64)Colors * 4 > pInfo->PixelOffset )
+			return FALSE;
+
+		// Stored as blue, green, red, unused, which is X8R8G8B8 once the top byte is cleared
+		for( DWORD i = 0 ; i < Colors ; i++ )
+			pInfo->Palette[ i ] = BmpDword( pData + PaletteOffset + i * 4 ) & 0x00FFFFFF;
+	}
+
+	return TRUE;
+}
+
+// Converts the pixels of a bitmap whose header was read by ReadBmpHeader() into pDest, which
+// must hold Width x Height pixels.  DestPitch is in bytes.
+void DecodeBmp( const BYTE* pData, const BMPINFO* pInfo, DWORD* pDest, int DestPitch )
+{
+	const int Width = pInfo->Width;
+
+	for( int y = 0 ; y < pInfo->Height ; y++ )
+	{
+		int Row = pInfo->bTopDown ? y : pInfo->Height - 1 - y;
+		const BYTE* pSrc = pData + pInfo->PixelOffset + (INT64)Row * pInfo->RowBytes;
+		DWORD* pOut = (DWORD*)( (BYTE*)pDest + (INT64)y * DestPitch );
+
+		switch( pInfo->BitCount )
+		{
+		case 32:
+			for( int x = 0 ; x < Width ; x++ )
+				pOut[ x ] = BmpDword( pSrc + x * 4 ) & 0x00FFFFFF;
+			break;
+
+		case 24:
+			for( int x = 0 ; x < Width ; x++, pSrc += 3 )
+				pOut[ x ] = pSrc[ 0 ] | ( pSrc[ 1 ] << 8 ) | ( pSrc[ 2 ] << 16 );
+			break;
+
+		case 8:
+			for( int x = 0 ; x < Width ; x++ )
+				pOut[ x ] = pInfo->Palette[ pSrc[ x ] ];
+			break;
+
+		default:
+			{
+				// 1 and 4 bits, packed high bits first
+				const int Bits = pInfo->BitCount;
+				const int Mask = ( 1 << Bits ) - 1;
+
+				for( int x = 0 ; x < Width ; x++ )
+				{
+					int Bit = x * Bits;
+					int Index = ( pSrc[ Bit >> 3 ] >> ( 8 - Bits - ( Bit & 7 ) ) ) & Mask;
+					pOut[ x ] = pInfo->Palette[ Index ];
+				}
+			}
+			break;
+		}
+	}
+}
+
+// Loads a bitmap file into a memory surface.  The file is mapped rather than read, so the
+// only copy made is the conversion itself.
+BOOL LoadBmpFile( const char* FileName, CMemorySurface32* pSurface )
+{
+	MAPPEDFILE File;
+	if( !OpenMappedFile( &File, FileName ) )
+		return FALSE;
+
+	BMPINFO Info;
+	BOOL bOk = ReadBmpHeader( File.pData, File.Size, &Info ) && pSurface->Create( Info.Width, Info.Height );
+	if( bOk )
+		DecodeBmp( File.pData, &Info, pSurface->GetBits(), pSurface->GetPitch() );
+
+	CloseMappedFile( &File );
+	return bOk;
+}
+
+#endif	// BMP_H
@@ -0,0 +1,368 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Draws one game frame to any ISurface32.  Render() fills in a COMPOSEFRAME
+// with the background, the sprites and where they go, the HUD and the text,
+// and ComposeFrame() does the dirty rectangle tracking and turns it into a
+// draw list.
+// Nothing in here needs Direct3D, so the headless tools draw the very same
+// frames into memory.
+
+#ifndef COMPOSE_H
+#define COMPOSE_H
+
+#include <stdio.h>
+#include "platform.h"
+#include "surface.h"
+#include "drawlist.h"
+#include "hud.h"
+#include "pongsim.h"
+#include "profile.h"
+#include "trace.h"
+
+#define COMPOSE_MAXSPRITES	8
+
+struct COMPOSESPRITE
+{
+	const SPANSPRITE* pSprite;
+	POINT Position;
+};
+
+struct COMPOSEFRAME
+{
+	ISurface32* pBackground;		// Copied under everything
+	DWORD ClearColor;				// Shows where the background does not reach
+
+	int SpriteCount;				// Drawn in order, after the background
+	COMPOSESPRITE Sprites[ COMPOSE_MAXSPRITES ];
+
+	HUDLAYER* pHud;					// Drawn over the sprites, may be NULL
+
+	const TEXTBATCH* pText;			// Drawn last, may be NULL
+	const FONTATLAS* pAtlas;
+	ISurface32* pFont;
+	DWORD ColorKey;					// Transparent color in the font
+};
+
+// Empties a frame
+void BeginComposeFrame( COMPOSEFRAME* pFrame, ISurface32* pBackground, DWORD ClearColor )
+{
+	memset( pFrame, 0, sizeof( COMPOSEFRAME ) );
+
+	pFrame->pBackground = pBackground;
+	pFrame->ClearColor = ClearColor;
+}
+
+void AddComposeSprite( COMPOSEFRAME* pFrame, const SPANSPRITE* pSprite, POINT Position )
+{
+	if( pFrame->SpriteCount >= COMPOSE_MAXSPRITES )
+		return;
+
+	pFrame->Sprites[ pFrame->SpriteCount ].pSprite = pSprite;
+	pFrame->Sprites[ pFrame->SpriteCount ].Position = Position;
+	pFrame->SpriteCount++;
+}
+
+void SetComposeHud( COMPOSEFRAME* pFrame, HUDLAYER* pHud )
+{
+	pFrame->pHud = pHud;
+}
+
+void SetComposeText( COMPOSEFRAME* pFrame, const TEXTBATCH* pText, const FONTATLAS* pAtlas, ISurface32* pFont, DWORD ColorKey )
+{
+	pFrame->pText = pText;
+	pFrame->pAtlas = pAtlas;
+	pFrame->pFont = pFont;
+	pFrame->ColorKey = ColorKey;
+}
+
+// Records where everything in the frame will be drawn and works out what has to be restored.
+// Returns TRUE if the whole target has to be redrawn.
+BOOL TrackComposeFrame( const COMPOSEFRAME* pFrame, DIRTYTRACKER* pTracker, BOOL bDirtyRects )
+{
+	BeginDirtyFrame( pTracker );
+	for( int i = 0 ; i < pFrame->SpriteCount ; i++ )
+	{
+		const COMPOSESPRITE* pSprite = &pFrame->Sprites[ i ];
+		TrackDirtyRect( pTracker, pSprite->Position.x, pSprite->Position.y, pSprite->pSprite->Width, pSprite->pSprite->Height );
+	}
+	if( pFrame->pHud )
+	{
+		// Only the letters that changed, everything else in the overlay is already on the screen
+		const HUDLAYER* pHud = pFrame->pHud;
+		for( int i = 0 ; i < pHud->ChangedCount ; i++ )
+			TrackDirtyRect( pTracker, pHud->Changed[ i ].left, pHud->Changed[ i ].top,
+							pHud->Changed[ i ].right - pHud->Changed[ i ].left, pHud->Changed[ i ].bottom - pHud->Changed[ i ].top );
+	}
+	if( pFrame->pText )
+		TrackTextBatch( pTracker, pFrame->pText, pFrame->pAtlas->LetterWidth, pFrame->pAtlas->LetterHeight );
+
+	if( !bDirtyRects )
+		InvalidateDirtyTracker( pTracker );
+
+	return EndDirtyFrame( pTracker );
+}
+
+// Lays the HUD overlay over the parts of the fields inside Rect
+void DrawListHud( DRAWLIST* pList, HUDLAYER* pHud, const RECT* pRect )
+{
+	for( int i = 0 ; i < pHud->FieldCount ; i++ )
+	{
+		RECT Field;
+		GetHudFieldRect( pHud, i, &Field );
+
+		if( pRect )
+		{
+			if( Field.left < pRect->left ) Field.left = pRect->left;
+			if( Field.top < pRect->top ) Field.top = pRect->top;
+			if( Field.right > pRect->right ) Field.right = pRect->right;
+			if( Field.bottom > pRect->bottom ) Field.bottom = pRect->bottom;
+			if( Field.left >= Field.right || Field.top >= Field.bottom )
+				continue;
+		}
+
+		POINT DestPoint = { Field.left, Field.top };
+		DrawListBlit( pList, &pHud->Overlay, &Field, DestPoint, TRUE, pHud->ColorKey );
+	}
+}
+
+// Records the drawing for a frame that TrackComposeFrame() has been run on.  The background
+// goes in layer 0, the sprites in layer 1 and the HUD and the text in layer 2.
+void BuildComposeDrawList( const COMPOSEFRAME* pFrame, const DIRTYTRACKER* pTracker, BOOL bFull, DRAWLIST* pList, ISurface32* pDest )
+{
+	BeginDrawList( pList, pDest );
+	SetDrawLayer( pList, 0, PROFILE_BACKGROUND );
+
+	if( bFull )
+	{
+		// Only clear what the background does not cover
+		if( pFrame->pBackground->GetWidth() < pDest->GetWidth() || pFrame->pBackground->GetHeight() < pDest->GetHeight() )
+		{
+			RECT All = { 0, 0, pDest->GetWidth(), pDest->GetHeight() };
+			DrawListFill( pList, All, pFrame->ClearColor );
+		}
+
+		POINT Origin = { 0, 0 };
+		DrawListBlit( pList, pFrame->pBackground, NULL, Origin, FALSE, 0 );
+	}
+	else
+	{
+		// Only put back the background where things were or will be drawn, and clear what it does not cover
+		for( int i = 0 ; i < pTracker->DirtyCount ; i++ )
+		{
+			RECT Outside[ 2 ];
+			int OutsideCount = DirtyRectOutside( pTracker->Dirty[ i ], pFrame->pBackground->GetWidth(), pFrame->pBackground->GetHeight(), Outside );
+			for( int o = 0 ; o < OutsideCount ; o++ )
+				DrawListFill( pList, Outside[ o ], pFrame->ClearColor );
+
+			POINT DestPoint = { pTracker->Dirty[ i ].left, pTracker->Dirty[ i ].top };
+			DrawListBlit( pList, pFrame->pBackground, &pTracker->Dirty[ i ], DestPoint, FALSE, 0 );
+		}
+	}
+
+	SetDrawLayer( pList, 1, PROFILE_SPRITES );
+	for( int i = 0 ; i < pFrame->SpriteCount ; i++ )
+		DrawListSprite( pList, pFrame->Sprites[ i ].pSprite, pFrame->Sprites[ i ].Position );
+
+	SetDrawLayer( pList, 2, PROFILE_TEXT );
+	if( pFrame->pHud )
+	{
+		// The HUD only has to go back where the background was put back
+		if( bFull )
+			DrawListHud( pList, pFrame->pHud, NULL );
+		else
+			for( int i = 0 ; i < pTracker->DirtyCount ; i++ )
+				DrawListHud( pList, pFrame->pHud, &pTracker->Dirty[ i ] );
+	}
+
+	if( pFrame->pText )
+	{
+		DrawListText( pList, pFrame->pText, pFrame->pAtlas, pFrame->pFont, TRUE, pFrame->ColorKey );
+	}
+}
+
+// Draws the frame to pDest.  With bDirtyRects only the parts that changed since the last frame
+// drawn with the same tracker are redrawn.  pStats gets the command and lock counts, if wanted.
+// Returns FALSE if a surface could not be locked.
+BOOL ComposeFrame( const COMPOSEFRAME* pFrame, DIRTYTRACKER* pTracker, ISurface32* pDest, BOOL bDirtyRects, DRAWSTATS* pStats = 0 )
+{
+	TRACE_SCOPE( "ComposeFrame" );
+
+	static DRAWLIST List;
+
+	BOOL bFull = TrackComposeFrame( pFrame, pTracker, bDirtyRects );
+	BuildComposeDrawList( pFrame, pTracker, bFull, &List, pDest );
+
+	BOOL bOk = ExecuteDrawList( &List );
+
+	if( pStats )
+		*pStats = List.Stats;
+
+	return bOk;
+}
+
+//====================================================
+// The Game Screen
+//====================================================
+
+// What the HUD shows besides the match itself
+struct HUDINFO
+{
+	int FrameRate;
+	int PixelsTouched;		// Pixels redrawn last frame, shown with the frame timings
+	BOOL bCanQuit;			// Show the quit prompt on the win screen
+	BOOL bProfileOverlay;	// Show the frame timings
+	const DRAWSTATS* pDrawStats;	// Shown with the frame timings, may be NULL
+};
+
+// The HUD's labels, which never change
+struct HUDLABEL
+{
+	int x, y;
+	const char* Text;
+};
+
+static const HUDLABEL g_HudLabels[] =
+{
+	{ 10, 10, "Player 1: " },
+	{ ( RES_WIDTH - 106 ), 10, "Player 2: " },
+	{ ( ( RES_WIDTH / 2 ) - 104 ), 10, "UBER-PONG by Sean Gilleran" },		// Program Heading
+	{ ( RES_WIDTH - 92 ), ( RES_HEIGHT - 26 ), "FPS: " },
+	{ 10, ( RES_HEIGHT - 26 ), "Ball Speed: " },
+	{ ( ( RES_WIDTH / 2 ) - 64 ), ( RES_HEIGHT - 26 ), "Bounce Count: " },
+};
+
+// The numbers, in the order GetHudValues() gives them
+enum
+{
+	HUDVALUE_SCORE1,
+	HUDVALUE_SCORE2,
+	HUDVALUE_FPS,
+	HUDVALUE_SPEED,
+	HUDVALUE_BOUNCES,
+	HUDVALUE_COUNT
+};
+
+struct HUDVALUEFIELD
+{
+	int x, y;
+	int Cells;			// Room for the widest number it shows
+};
+
+static const HUDVALUEFIELD g_HudValues[ HUDVALUE_COUNT ] =
+{
+	{ 90, 10, 3 },
+	{ ( RES_WIDTH - 26 ), 10, 3 },
+	{ ( RES_WIDTH - 42 ), ( RES_HEIGHT - 26 ), 6 },
+	{ 106, ( RES_HEIGHT - 26 ), 6 },
+	{ ( ( RES_WIDTH / 2 ) + 48 ), ( RES_HEIGHT - 26 ), 8 },
+};
+
+#define HUD_LABELCOUNT	(int)( sizeof( g_HudLabels ) / sizeof( g_HudLabels[ 0 ] ) )
+
+inline void GetHudValues( const PONGSIM* pSim, const HUDINFO* pHud, int* pValues )
+{
+	pValues[ HUDVALUE_SCORE1 ] = pSim->p1Score;
+	pValues[ HUDVALUE_SCORE2 ] = pSim->p2Score;
+	pValues[ HUDVALUE_FPS ] = pHud->FrameRate;
+	pValues[ HUDVALUE_SPEED ] = pSim->BallSpeed;
+	pValues[ HUDVALUE_BOUNCES ] = pSim->BounceCount;
+}
+
+// Puts the labels and the number fields in a HUD layer the size of the screen.  The labels
+// are drawn now and never again.  Returns FALSE if the font cannot be locked.
+BOOL InitGameHud( HUDLAYER* pLayer, const FONTATLAS* pAtlas, ISurface32* pFont, DWORD ColorKey )
+{
+	if( !InitHudLayer( pLayer, RES_WIDTH, RES_HEIGHT, pAtlas, pFont, ColorKey ) )
+		return FALSE;
+
+	for( int i = 0 ; i < HUD_LABELCOUNT ; i++ )
+		AddHudField( pLayer, g_HudLabels[ i ].x, g_HudLabels[ i ].y, (int)strlen( g_HudLabels[ i ].Text ), g_HudLabels[ i ].Text );
+
+	for( int i = 0 ; i < HUDVALUE_COUNT ; i++ )
+		AddHudField( pLayer, g_HudValues[ i ].x, g_HudValues[ i ].y, g_HudValues[ i ].Cells, "" );
+
+	return TRUE;
+}
+
+// Brings the numbers in the HUD up to date.  Call once a frame, before the frame is composed.
+void UpdateGameHud( HUDLAYER* pLayer, const PONGSIM* pSim, const HUDINFO* pHud )
+{
+	int Values[ HUDVALUE_COUNT ];
+	GetHudValues( pSim, pHud, Values );
+
+	BeginHudFrame( pLayer );
+	for( int i = 0 ; i < HUDVALUE_COUNT ; i++ )
+		SetHudNumber( pLayer, HUD_LABELCOUNT + i, Values[ i ] );
+}
+
+// Queues the strings on the game screen.  With bFields FALSE the labels and numbers are left
+// out, for when a HUD layer from InitGameHud() draws them.
+void QueueHudText( TEXTBATCH* pBatch, const PONGSIM* pSim, const HUDINFO* pHud, BOOL bFields = TRUE )
+{
+	char Line[64];
+
+	BeginTextBatch( pBatch );
+
+	if( bFields )
+	{
+		for( int i = 0 ; i < HUD_LABELCOUNT ; i++ )
+			AddText( pBatch, g_HudLabels[ i ].x, g_HudLabels[ i ].y, g_HudLabels[ i ].Text );
+
+		int Values[ HUDVALUE_COUNT ];
+		GetHudValues( pSim, pHud, Values );
+		for( int i = 0 ; i < HUDVALUE_COUNT ; i++ )
+		{
+			snprintf( Line, sizeof( Line ), "%d", Values[ i ] );
+			AddText( pBatch, g_HudValues[ i ].x, g_HudValues[ i ].y, Line );
+		}
+	}
+
+	// The win screen
+	if( pSim->p1Score >= MAX_SCORE || pSim->p2Score >= MAX_SCORE )
+	{
+		AddText( pBatch, ( ( RES_WIDTH / 2 ) - 72 ), ( ( RES_HEIGHT / 2 ) - 18 ),
+				 pSim->p1Score >= MAX_SCORE ? "PLAYER ONE WINS!!!" : "PLAYER TWO WINS!!!" );
+
+		if( pHud->bCanQuit )
+			AddText( pBatch, ( ( RES_WIDTH / 2 ) - 88 ), ( ( RES_HEIGHT / 2 ) + 18 ), "Press Start to Quit..." );
+	}
+
+	// Frame timings
+	if( pHud->bProfileOverlay )
+	{
+		AddText( pBatch, 10, 42, "Stage (us)     p50     p99   p99.9     max" );
+		for( int i = 0 ; i < PROFILE_STAGES ; i++ )
+		{
+			FormatProfileStage( i, Line, sizeof( Line ) );
+			AddText( pBatch, 10, 58 + 16 * i, Line );
+		}
+
+		if( pHud->pDrawStats )
+		{
+			const DRAWSTATS* pStats = pHud->pDrawStats;
+			snprintf( Line, sizeof( Line ), "Draws %d (%d blits %d sprites)  Locks %d, was %d", pStats->Commands,
+					  pStats->Blits, pStats->Sprites, pStats->Locks, pStats->ImmediateLocks );
+			AddText( pBatch, 10, 58 + 16 * PROFILE_STAGES, Line );
+		}
+
+		snprintf( Line, sizeof( Line ), "Pixels redrawn %d", pHud->PixelsTouched );
+		AddText( pBatch, 10, 74 + 16 * PROFILE_STAGES, Line );
+	}
+}
+
+// Where the paddles and ball are drawn, Alpha (0 - 65535) of the way from the last tick to this one
+void GetSpritePositions( const PONGSIM* pPrev, const PONGSIM* pSim, int Alpha, POINT* pPaddle1, POINT* pPaddle2, POINT* pBall )
+{
+	pPaddle1->x = PongSimPixels( pSim->Paddle1X );
+	pPaddle1->y = PongSimPixels( PongSimLerp( pPrev->Paddle1Y, pSim->Paddle1Y, Alpha ) );
+	pPaddle2->x = PongSimPixels( pSim->Paddle2X );
+	pPaddle2->y = PongSimPixels( PongSimLerp( pPrev->Paddle2Y, pSim->Paddle2Y, Alpha ) );
+	pBall->x = PongSimPixels( PongSimLerp( pPrev->BallX, pSim->BallX, Alpha ) );
+	pBall->y = PongSimPixels( PongSimLerp( pPrev->BallY, pSim->BallY, Alpha ) );
+}
+
+#endif	// COMPOSE_H
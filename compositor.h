@@ -0,0 +1,190 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Multithreaded frame composition.  The target is cut into bands of rows
+// and a pool of worker threads, started once, draws the frame's whole draw
+// list into one band at a time.  Each band only ever touches its own rows,
+// so the drawing needs no locks; the threads just take the next band
+// number from an atomic counter.  The thread calling ComposeFrameBands()
+// draws bands too, and returns once every band is done.
+
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "platform.h"
+#include "compose.h"
+#include "trace.h"
+
+#define COMPOSITOR_MAXTHREADS	64
+#define COMPOSITOR_BANDHEIGHT	32		// Rows per band.  Enough bands to keep every thread busy at 1080p.
+#define COMPOSITOR_MINPIXELS	65536	// Smaller dirty frames are drawn on the calling thread
+
+struct BANDCOMPOSITOR
+{
+	int Threads;						// Including the calling thread
+	int BandHeight;
+	std::thread Workers[ COMPOSITOR_MAXTHREADS ];
+
+	// Waking the workers up for a frame, and waiting for them to finish it
+	std::mutex Lock;
+	std::condition_variable Wake;
+	std::condition_variable Finished;
+	DWORD Generation;					// Goes up once per frame
+	int Busy;							// Workers still drawing this frame
+	BOOL bQuit;
+
+	// The frame being drawn
+	DRAWLIST List;
+	int BandCount;
+
+	alignas( 64 ) std::atomic<int> NextBand;
+
+	// Bands drawn by each thread, for checking the work is spread out
+	DWORD BandsDrawn[ COMPOSITOR_MAXTHREADS ];
+};
+
+// Draws bands until there are none left
+void ComposeBands( BANDCOMPOSITOR* pCompositor, int Thread )
+{
+	int Height = pCompositor->List.Heights[ 0 ];
+
+	for( ;; )
+	{
+		int Band = pCompositor->NextBand.fetch_add( 1, std::memory_order_relaxed );
+		if( Band >= pCompositor->BandCount )
+			break;
+
+		TRACE_SCOPE( "ComposeBand" );
+
+		int Top = Band * pCompositor->BandHeight;
+		int Bottom = Top + pCompositor->BandHeight < Height ? Top + pCompositor->BandHeight : Height;
+
+		DrawListRows( &pCompositor->List, Top, Bottom, FALSE );
+		pCompositor->BandsDrawn[ Thread ]++;
+	}
+}
+
+void CompositorWorker( BANDCOMPOSITOR* pCompositor, int Thread )
+{
+	char Name[ 32 ];
+	snprintf( Name, sizeof( Name ), "Compositor %d", Thread );
+	TraceNameThread( Name );
+
+	DWORD Seen = 0;
+
+	for( ;; )
+	{
+		{
+			std::unique_lock<std::mutex> Lock( pCompositor->Lock );
+			while( pCompositor->Generation == Seen && !pCompositor->bQuit )
+				pCompositor->Wake.wait( Lock );
+
+			if( pCompositor->bQuit )
+				return;
+
+			Seen = pCompositor->Generation;
+		}
+
+		ComposeBands( pCompositor, Thread );
+
+		std::lock_guard<std::mutex> Lock( pCompositor->Lock );
+		if( --pCompositor->Busy == 0 )
+			pCompositor->Finished.notify_one();
+	}
+}
+
+// Starts the worker threads.  0 threads uses one per core.
+void InitBandCompositor( BANDCOMPOSITOR* pCompositor, int Threads, int BandHeight = COMPOSITOR_BANDHEIGHT )
+{
+	if( Threads <= 0 )
+		Threads = (int)std::thread::hardware_concurrency();
+	if( Threads < 1 )
+		Threads = 1;
+	if( Threads > COMPOSITOR_MAXTHREADS )
+		Threads = COMPOSITOR_MAXTHREADS;
+
+	pCompositor->Threads = Threads;
+	pCompositor->BandHeight = BandHeight > 0 ? BandHeight : COMPOSITOR_BANDHEIGHT;
+	pCompositor->Generation = 0;
+	pCompositor->Busy = 0;
+	pCompositor->bQuit = FALSE;
+	pCompositor->BandCount = 0;
+	pCompositor->NextBand.store( 0 );
+	memset( pCompositor->BandsDrawn, 0, sizeof( pCompositor->BandsDrawn ) );
+
+	// Thread 0 is whoever calls ComposeFrameBands()
+	for( int t = 1 ; t < Threads ; t++ )
+		pCompositor->Workers[ t ] = std::thread( CompositorWorker, pCompositor, t );
+}
+
+// Stops the worker threads
+void ShutdownBandCompositor( BANDCOMPOSITOR* pCompositor )
+{
+	{
+		std::lock_guard<std::mutex> Lock( pCompositor->Lock );
+		pCompositor->bQuit = TRUE;
+	}
+	pCompositor->Wake.notify_all();
+
+	for( int t = 1 ; t < pCompositor->Threads ; t++ )
+		pCompositor->Workers[ t ].join();
+
+	pCompositor->Threads = 1;
+}
+
+// Same as ComposeFrame(), but the drawing is shared between the compositor's threads.  Each
+// surface is locked once for the whole frame.  Returns FALSE if a surface could not be locked.
+BOOL ComposeFrameBands( BANDCOMPOSITOR* pCompositor, const COMPOSEFRAME* pFrame, DIRTYTRACKER* pTracker, ISurface32* pDest, BOOL bDirtyRects, DRAWSTATS* pStats = 0 )
+{
+	TRACE_SCOPE( "ComposeFrameBands" );
+
+	DRAWLIST* pList = &pCompositor->List;
+
+	BOOL bFull = TrackComposeFrame( pFrame, pTracker, bDirtyRects );
+	BuildComposeDrawList( pFrame, pTracker, bFull, pList, pDest );
+
+	if( !LockDrawList( pList ) )
+		return FALSE;
+
+	// Waking the workers costs more than drawing a few small rectangles
+	if( pCompositor->Threads == 1 || ( !bFull && pTracker->PixelsTouched < COMPOSITOR_MINPIXELS ) )
+	{
+		DrawListRows( pList, 0, pList->Heights[ 0 ], TRUE );
+		pCompositor->BandsDrawn[ 0 ]++;
+	}
+	else
+	{
+		pCompositor->BandCount = ( pList->Heights[ 0 ] + pCompositor->BandHeight - 1 ) / pCompositor->BandHeight;
+		pCompositor->NextBand.store( 0, std::memory_order_relaxed );
+
+		// The mutex also makes everything written above visible to the workers
+		{
+			std::lock_guard<std::mutex> Lock( pCompositor->Lock );
+			pCompositor->Busy = pCompositor->Threads - 1;
+			pCompositor->Generation++;
+		}
+		pCompositor->Wake.notify_all();
+
+		ComposeBands( pCompositor, 0 );
+
+		std::unique_lock<std::mutex> Lock( pCompositor->Lock );
+		while( pCompositor->Busy > 0 )
+			pCompositor->Finished.wait( Lock );
+	}
+
+	UnlockDrawList( pList );
+
+	if( pStats )
+		*pStats = pList->Stats;
+
+	return TRUE;
+}
+
+#endif	// COMPOSITOR_H
@@ -0,0 +1,98 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// CPU feature detection and the macros needed to build SSE2/AVX2 code paths
+// that are only used when the CPU supports them.
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "platform.h"
+
+#ifdef PLATFORM_X86
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// Compilers before VC11 have no AVX2 intrinsics
+#if !defined( PLATFORM_X86 ) || ( defined( _MSC_VER ) && _MSC_VER < 1700 )
+#define CPU_NO_AVX2
+#endif
+
+// GCC and Clang only emit vector instructions for functions that ask for them
+#if defined( __GNUC__ )
+#define CPU_TARGET_SSE2	__attribute__(( target( "sse2" ) ))
+#define CPU_TARGET_AVX2	__attribute__(( target( "avx2" ) ))
+#else
+#define CPU_TARGET_SSE2
+#define CPU_TARGET_AVX2
+#endif
+
+#ifdef PLATFORM_X86
+
+// Runs CPUID for the given leaf (and subleaf)
+void CpuId( int Leaf, int SubLeaf, unsigned int Regs[4] )
+{
+#ifdef _MSC_VER
+	int Info[4];
+	__cpuidex( Info, Leaf, SubLeaf );
+	Regs[0] = Info[0]; Regs[1] = Info[1]; Regs[2] = Info[2]; Regs[3] = Info[3];
+#else
+	__cpuid_count( Leaf, SubLeaf, Regs[0], Regs[1], Regs[2], Regs[3] );
+#endif
+}
+
+BOOL CpuHasSSE2()
+{
+	unsigned int Regs[4];
+	CpuId( 1, 0, Regs );
+
+	// EDX bit 26
+	return ( Regs[3] & ( 1 << 26 ) ) != 0;
+}
+
+BOOL CpuHasAVX2()
+{
+#ifdef CPU_NO_AVX2
+	return FALSE;
+#else
+	unsigned int Regs[4];
+
+	// Make sure leaf 7 exists
+	CpuId( 0, 0, Regs );
+	if( Regs[0] < 7 )
+		return FALSE;
+
+	// The CPU has to support AVX and the OS has to save the YMM registers (OSXSAVE)
+	CpuId( 1, 0, Regs );
+	if( ( Regs[2] & ( 1 << 27 ) ) == 0 || ( Regs[2] & ( 1 << 28 ) ) == 0 )
+		return FALSE;
+
+	// XCR0 bits 1 and 2 say the OS saves the XMM and YMM state
+#ifdef _MSC_VER
+	unsigned __int64 XCR0 = _xgetbv( 0 );
+#else
+	unsigned int XCR0Lo, XCR0Hi;
+	__asm__ __volatile__( "xgetbv" : "=a"( XCR0Lo ), "=d"( XCR0Hi ) : "c"( 0 ) );
+	unsigned int XCR0 = XCR0Lo;
+#endif
+	if( ( XCR0 & 6 ) != 6 )
+		return FALSE;
+
+	// EBX bit 5 of leaf 7
+	CpuId( 7, 0, Regs );
+	return ( Regs[1] & ( 1 << 5 ) ) != 0;
+#endif
+}
+
+#endif	// PLATFORM_X86
+
+#endif	// CPU_H
@@ -0,0 +1,220 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Dirty rectangle tracking.  Every frame the bounds of each sprite and
+// string are recorded; only the areas covered this frame or last frame are
+// restored from the background, instead of the whole screen.
+
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include <string.h>
+#include "platform.h"
+#include "blit.h"
+#include "text.h"
+
+#define DIRTY_MAXRECTS	64		// Most rectangles tracked per frame
+
+struct DIRTYTRACKER
+{
+	int Width;					// Size of the target
+	int Height;
+
+	BOOL bFullRedraw;			// Set when the whole target has to be redrawn
+
+	int PrevCount;				// Bounds of everything drawn last frame
+	RECT Prev[ DIRTY_MAXRECTS ];
+
+	int CurCount;				// Bounds of everything drawn this frame
+	RECT Cur[ DIRTY_MAXRECTS ];
+
+	int DirtyCount;				// The merged areas to restore this frame
+	RECT Dirty[ DIRTY_MAXRECTS * 2 ];
+
+	int PixelsTouched;			// Pixels restored and drawn last frame
+};
+
+// Sets up a tracker for a Width x Height target.  The first frame is always a full redraw.
+void InitDirtyTracker( DIRTYTRACKER* pTracker, int Width, int Height )
+{
+	memset( pTracker, 0, sizeof( DIRTYTRACKER ) );
+
+	pTracker->Width = Width;
+	pTracker->Height = Height;
+	pTracker->bFullRedraw = TRUE;
+}
+
+// Forces a full redraw next frame, e.g. after the device was reset
+void InvalidateDirtyTracker( DIRTYTRACKER* pTracker )
+{
+	pTracker->bFullRedraw = TRUE;
+}
+
+// Starts recording the bounds for a new frame
+void BeginDirtyFrame( DIRTYTRACKER* pTracker )
+{
+	pTracker->CurCount = 0;
+}
+
+// Clips a rectangle to the target.  Returns FALSE if nothing is left.
+BOOL ClipDirtyRect( DIRTYTRACKER* pTracker, RECT* pRect )
+{
+	if( pRect->left < 0 )
+		pRect->left = 0;
+	if( pRect->top < 0 )
+		pRect->top = 0;
+	if( pRect->right > pTracker->Width )
+		pRect->right = pTracker->Width;
+	if( pRect->bottom > pTracker->Height )
+		pRect->bottom = pTracker->Height;
+
+	return ( pRect->right > pRect->left ) && ( pRect->bottom > pRect->top );
+}
+
+// Records the bounds of something drawn this frame
+void TrackDirtyRect( DIRTYTRACKER* pTracker, int x, int y, int Width, int Height )
+{
+	RECT Rect = { x, y, x + Width, y + Height };
+
+	if( !ClipDirtyRect( pTracker, &Rect ) )
+		return;
+
+	// Out of room, so grow the last rectangle to cover this one as well.  Dropping it would
+	// leave it on the back buffer, since nothing would restore its area next frame.
+	if( pTracker->CurCount == DIRTY_MAXRECTS )
+	{
+		RECT* pLast = &pTracker->Cur[ DIRTY_MAXRECTS - 1 ];
+		if( Rect.left < pLast->left )
+			pLast->left = Rect.left;
+		if( Rect.top < pLast->top )
+			pLast->top = Rect.top;
+		if( Rect.right > pLast->right )
+			pLast->right = Rect.right;
+		if( Rect.bottom > pLast->bottom )
+			pLast->bottom = Rect.bottom;
+		return;
+	}
+
+	pTracker->Cur[ pTracker->CurCount++ ] = Rect;
+}
+
+// Records the bounds of every string in a text batch
+void TrackTextBatch( DIRTYTRACKER* pTracker, const TEXTBATCH* pBatch, int LetterWidth, int LetterHeight )
+{
+	for( int i = 0 ; i < pBatch->Count ; i++ )
+	{
+		const TEXTITEM* pItem = &pBatch->Items[ i ];
+		TrackDirtyRect( pTracker, pItem->x, pItem->y, pItem->Length * LetterWidth, LetterHeight );
+	}
+}
+
+// Adds a rectangle to the dirty list, merging it with any rectangles it overlaps
+void AddDirtyRect( DIRTYTRACKER* pTracker, RECT Rect )
+{
+	int i = 0;
+	while( i < pTracker->DirtyCount )
+	{
+		RECT* pOther = &pTracker->Dirty[ i ];
+
+		// No overlap, so move on
+		if( Rect.left >= pOther->right || pOther->left >= Rect.right ||
+			Rect.top >= pOther->bottom || pOther->top >= Rect.bottom )
+		{
+			i++;
+			continue;
+		}
+
+		// Grow to cover both, remove the old one and start again since the
+		// bigger rectangle may now overlap ones that were already checked
+		if( pOther->left < Rect.left )
+			Rect.left = pOther->left;
+		if( pOther->top < Rect.top )
+			Rect.top = pOther->top;
+		if( pOther->right > Rect.right )
+			Rect.right = pOther->right;
+		if( pOther->bottom > Rect.bottom )
+			Rect.bottom = pOther->bottom;
+
+		*pOther = pTracker->Dirty[ --pTracker->DirtyCount ];
+		i = 0;
+	}
+
+	pTracker->Dirty[ pTracker->DirtyCount++ ] = Rect;
+}
+
+// Works out what needs restoring this frame: everything drawn last frame plus everything
+// drawn this frame.  Returns TRUE if the whole target has to be redrawn instead.
+BOOL EndDirtyFrame( DIRTYTRACKER* pTracker )
+{
+	BOOL bFull = pTracker->bFullRedraw;
+	int Pixels = 0;
+
+	pTracker->DirtyCount = 0;
+
+	if( !bFull )
+	{
+		int i;
+		for( i = 0 ; i < pTracker->PrevCount ; i++ )
+			AddDirtyRect( pTracker, pTracker->Prev[ i ] );
+		for( i = 0 ; i < pTracker->CurCount ; i++ )
+			AddDirtyRect( pTracker, pTracker->Cur[ i ] );
+
+		for( i = 0 ; i < pTracker->DirtyCount ; i++ )
+		{
+			RECT* pRect = &pTracker->Dirty[ i ];
+			Pixels += ( pRect->right - pRect->left ) * ( pRect->bottom - pRect->top );
+		}
+	}
+	else
+		Pixels = pTracker->Width * pTracker->Height;
+
+	// Count the pixels drawn on top as well
+	for( int i = 0 ; i < pTracker->CurCount ; i++ )
+	{
+		RECT* pRect = &pTracker->Cur[ i ];
+		Pixels += ( pRect->right - pRect->left ) * ( pRect->bottom - pRect->top );
+	}
+	pTracker->PixelsTouched = Pixels;
+
+	// This frame's bounds are what has to be cleaned up next frame
+	memcpy( pTracker->Prev, pTracker->Cur, pTracker->CurCount * sizeof( RECT ) );
+	pTracker->PrevCount = pTracker->CurCount;
+	pTracker->bFullRedraw = FALSE;
+
+	return bFull;
+}
+
+// Finds the parts of Rect that a Width x Height background does not reach, so they can be
+// cleared instead.  Fills in at most two rectangles and returns how many.
+int DirtyRectOutside( RECT Rect, int Width, int Height, RECT* pOutside )
+{
+	int Count = 0;
+
+	// The strip to the right, the full height of Rect
+	if( Rect.right > Width )
+	{
+		SetRect( &pOutside[ Count++ ], Rect.left > Width ? Rect.left : Width, Rect.top, Rect.right, Rect.bottom );
+		Rect.right = Width;
+	}
+
+	// The strip below, up to where the right one starts
+	if( Rect.bottom > Height && Rect.left < Rect.right )
+		SetRect( &pOutside[ Count++ ], Rect.left, Rect.top > Height ? Rect.top : Height, Rect.right, Rect.bottom );
+
+	return Count;
+}
+
+// Copies the dirty areas from a background of the same size as the target.  Pitches are in bytes.
+void RestoreDirtyRectsToBuffer( const DIRTYTRACKER* pTracker, const DWORD* pBgData, int BgPitch, DWORD* pDestData, int DestPitch )
+{
+	for( int i = 0 ; i < pTracker->DirtyCount ; i++ )
+	{
+		POINT DestPoint = { pTracker->Dirty[ i ].left, pTracker->Dirty[ i ].top };
+		Blit32( pBgData, BgPitch, pTracker->Dirty[ i ], pDestData, DestPitch, pTracker->Width, pTracker->Height, DestPoint, FALSE, 0 );
+	}
+}
+
+#endif	// DIRTY_H
@@ -0,0 +1,411 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Retained drawing.  Fills, blits, sprites and text are recorded into a
+// DRAWLIST during the frame instead of being drawn straight away.  When
+// the list is run every surface it uses is locked exactly once, the
+// commands are grouped by what they draw from, and the whole list is drawn
+// in one pass.  The list can also be drawn a range of rows at a time, which
+// is how the band compositor shares a frame between threads.
+//
+// Commands go in layers.  Layers are drawn in order; inside a layer the
+// commands that draw from the same source are pulled together, in the
+// order each source was first used.  So anything that has to end up on top
+// of something else with a different source goes in a later layer.
+
+#ifndef DRAWLIST_H
+#define DRAWLIST_H
+
+#include <string.h>
+#include "platform.h"
+#include "blit.h"
+#include "sprite.h"
+#include "text.h"
+#include "surface.h"
+#include "profile.h"
+
+#define DRAWLIST_MAXCOMMANDS	256
+#define DRAWLIST_MAXSURFACES	16		// Including the target
+#define DRAWLIST_MAXLAYERS		8
+
+enum DRAWCOMMANDTYPE
+{
+	DRAW_FILL,			// Fill Rect with Color
+	DRAW_BLIT,			// Copy SourceRect of a surface to DestPoint
+	DRAW_SPRITE,		// Draw a span sprite at DestPoint
+	DRAW_TEXT			// Draw a text batch with a font surface
+};
+
+struct DRAWCOMMAND
+{
+	int Type;
+	int Layer;
+	int Surface;				// Index into DRAWLIST::pSurfaces of the source, -1 for none
+	const void* pSource;		// What the command draws from, for grouping
+
+	RECT Rect;					// Fill area, or the source rectangle of a blit
+	POINT DestPoint;
+	DWORD Color;				// Fill color, or the color key
+	BOOL bTransparent;
+
+	const SPANSPRITE* pSprite;
+	const TEXTBATCH* pText;
+	const FONTATLAS* pAtlas;
+
+	DWORD SortKey;
+};
+
+// How much work a list was and how many locks it took
+struct DRAWSTATS
+{
+	int Commands;
+	int Fills;
+	int Blits;
+	int Sprites;
+	int Texts;
+	int Dropped;				// Commands that did not fit
+
+	int Locks;					// Surfaces locked to draw the list
+	int ImmediateLocks;			// Locks the same drawing took one call at a time
+};
+
+struct DRAWLIST
+{
+	int Count;
+	DRAWCOMMAND Commands[ DRAWLIST_MAXCOMMANDS ];
+	int Order[ DRAWLIST_MAXCOMMANDS ];			// Commands in the order they are drawn
+
+	int Layer;									// Layer new commands go in
+	int LayerStages[ DRAWLIST_MAXLAYERS ];		// Profile stage each layer is timed into, -1 for none
+
+	// Every surface the list touches.  0 is the target.
+	int SurfaceCount;
+	ISurface32* pSurfaces[ DRAWLIST_MAXSURFACES ];
+	LOCKEDSURFACE32 Locked[ DRAWLIST_MAXSURFACES ];
+	int Widths[ DRAWLIST_MAXSURFACES ];
+	int Heights[ DRAWLIST_MAXSURFACES ];
+
+	DRAWSTATS Stats;
+};
+
+// Empties a list that will be drawn to pDest
+void BeginDrawList( DRAWLIST* pList, ISurface32* pDest )
+{
+	pList->Count = 0;
+	pList->Layer = 0;
+	for( int i = 0 ; i < DRAWLIST_MAXLAYERS ; i++ )
+		pList->LayerStages[ i ] = -1;
+
+	pList->SurfaceCount = 1;
+	pList->pSurfaces[ 0 ] = pDest;
+
+	memset( &pList->Stats, 0, sizeof( DRAWSTATS ) );
+}
+
+// Puts the commands that follow in Layer, and times that layer into a profile stage if asked
+void SetDrawLayer( DRAWLIST* pList, int Layer, int ProfileStage = -1 )
+{
+	if( Layer < 0 )
+		Layer = 0;
+	if( Layer >= DRAWLIST_MAXLAYERS )
+		Layer = DRAWLIST_MAXLAYERS - 1;
+
+	pList->Layer = Layer;
+	pList->LayerStages[ Layer ] = ProfileStage;
+}
+
+// Returns the index of a surface in the list, adding it if it is new.  -1 if there is no room.
+int DrawListSurface( DRAWLIST* pList, ISurface32* pSurface )
+{
+	for( int i = 0 ; i < pList->SurfaceCount ; i++ )
+	{
+		if( pList->pSurfaces[ i ] == pSurface )
+			return i;
+	}
+
+	if( pList->SurfaceCount == DRAWLIST_MAXSURFACES )
+		return -1;
+
+	pList->pSurfaces[ pList->SurfaceCount ] = pSurface;
+	return pList->SurfaceCount++;
+}
+
+// Adds a blank command of a type.  NULL if the list is full.
+DRAWCOMMAND* NewDrawCommand( DRAWLIST* pList, int Type )
+{
+	if( pList->Count == DRAWLIST_MAXCOMMANDS )
+	{
+		pList->Stats.Dropped++;
+		return 0;
+	}
+
+	DRAWCOMMAND* pCommand = &pList->Commands[ pList->Count++ ];
+	memset( pCommand, 0, sizeof( DRAWCOMMAND ) );
+	pCommand->Type = Type;
+	pCommand->Layer = pList->Layer;
+	pCommand->Surface = -1;
+
+	pList->Stats.Commands++;
+	return pCommand;
+}
+
+//====================================================
+// Recording
+//====================================================
+
+void DrawListFill( DRAWLIST* pList, RECT Rect, DWORD Color )
+{
+	DRAWCOMMAND* pCommand = NewDrawCommand( pList, DRAW_FILL );
+	if( !pCommand )
+		return;
+
+	pCommand->Rect = Rect;
+	pCommand->Color = Color;
+
+	pList->Stats.Fills++;
+	pList->Stats.ImmediateLocks += 1;
+}
+
+// A NULL rectangle copies the whole source
+void DrawListBlit( DRAWLIST* pList, ISurface32* pSource, const RECT* pSourceRect, POINT DestPoint, BOOL bTransparent, DWORD ColorKey )
+{
+	int Surface = DrawListSurface( pList, pSource );
+	if( Surface < 0 )
+	{
+		pList->Stats.Dropped++;
+		return;
+	}
+
+	DRAWCOMMAND* pCommand = NewDrawCommand( pList, DRAW_BLIT );
+	if( !pCommand )
+		return;
+
+	RECT Rect;
+	if( pSourceRect )
+		Rect = *pSourceRect;
+	else
+		SetRect( &Rect, 0, 0, pSource->GetWidth(), pSource->GetHeight() );
+
+	// Keep within the source, e.g. a background smaller than the screen
+	if( Rect.left < 0 )
+	{
+		DestPoint.x -= Rect.left;
+		Rect.left = 0;
+	}
+	if( Rect.top < 0 )
+	{
+		DestPoint.y -= Rect.top;
+		Rect.top = 0;
+	}
+	if( Rect.right > pSource->GetWidth() )
+		Rect.right = pSource->GetWidth();
+	if( Rect.bottom > pSource->GetHeight() )
+		Rect.bottom = pSource->GetHeight();
+
+	pCommand->Rect = Rect;
+	pCommand->Surface = Surface;
+	pCommand->pSource = pSource;
+	pCommand->DestPoint = DestPoint;
+	pCommand->bTransparent = bTransparent;
+	pCommand->Color = ColorKey;
+
+	pList->Stats.Blits++;
+	pList->Stats.ImmediateLocks += 2;
+}
+
+void DrawListSprite( DRAWLIST* pList, const SPANSPRITE* pSprite, POINT DestPoint )
+{
+	DRAWCOMMAND* pCommand = NewDrawCommand( pList, DRAW_SPRITE );
+	if( !pCommand )
+		return;
+
+	pCommand->pSprite = pSprite;
+	pCommand->pSource = pSprite;
+	pCommand->DestPoint = DestPoint;
+
+	pList->Stats.Sprites++;
+	pList->Stats.ImmediateLocks += 1;
+}
+
+void DrawListText( DRAWLIST* pList, const TEXTBATCH* pText, const FONTATLAS* pAtlas, ISurface32* pFont, BOOL bTransparent, DWORD ColorKey )
+{
+	int Surface = DrawListSurface( pList, pFont );
+	if( Surface < 0 )
+	{
+		pList->Stats.Dropped++;
+		return;
+	}
+
+	DRAWCOMMAND* pCommand = NewDrawCommand( pList, DRAW_TEXT );
+	if( !pCommand )
+		return;
+
+	pCommand->Surface = Surface;
+	pCommand->pSource = pFont;
+	pCommand->pText = pText;
+	pCommand->pAtlas = pAtlas;
+	pCommand->bTransparent = bTransparent;
+	pCommand->Color = ColorKey;
+
+	pList->Stats.Texts++;
+	pList->Stats.ImmediateLocks += 2;
+}
+
+//====================================================
+// Drawing
+//====================================================
+
+// Works out the drawing order and locks every surface once.  Returns FALSE, with nothing
+// locked, if a surface cannot be locked.
+BOOL LockDrawList( DRAWLIST* pList )
+{
+	// Group each command with the first one in its layer that used the same source
+	for( int i = 0 ; i < pList->Count ; i++ )
+	{
+		DRAWCOMMAND* pCommand = &pList->Commands[ i ];
+		int Group = i;
+
+		if( pCommand->pSource )
+		{
+			for( int j = 0 ; j < i ; j++ )
+			{
+				if( pList->Commands[ j ].Layer == pCommand->Layer && pList->Commands[ j ].pSource == pCommand->pSource )
+				{
+					Group = j;
+					break;
+				}
+			}
+		}
+
+		pCommand->SortKey = ( (DWORD)pCommand->Layer << 16 ) | ( Group << 8 ) | i;
+	}
+
+	// Insertion sort, since the list is short and mostly in order already
+	for( int i = 0 ; i < pList->Count ; i++ )
+	{
+		int j = i;
+		while( j > 0 && pList->Commands[ pList->Order[ j - 1 ] ].SortKey > pList->Commands[ i ].SortKey )
+		{
+			pList->Order[ j ] = pList->Order[ j - 1 ];
+			j--;
+		}
+		pList->Order[ j ] = i;
+	}
+
+	// The target is written, everything else is only read
+	for( int i = 0 ; i < pList->SurfaceCount ; i++ )
+	{
+		if( !pList->pSurfaces[ i ]->Lock( &pList->Locked[ i ], i != 0 ) )
+		{
+			while( --i >= 0 )
+				pList->pSurfaces[ i ]->Unlock();
+			return FALSE;
+		}
+
+		pList->Widths[ i ] = pList->pSurfaces[ i ]->GetWidth();
+		pList->Heights[ i ] = pList->pSurfaces[ i ]->GetHeight();
+	}
+
+	pList->Stats.Locks = pList->SurfaceCount;
+	return TRUE;
+}
+
+void UnlockDrawList( DRAWLIST* pList )
+{
+	for( int i = pList->SurfaceCount - 1 ; i >= 0 ; i-- )
+		pList->pSurfaces[ i ]->Unlock();
+}
+
+// Draws one command, clipped to the target rows from Top up to (not including) Bottom
+void DrawCommandRows( const DRAWLIST* pList, const DRAWCOMMAND* pCommand, int Top, int Bottom )
+{
+	// Treat the rows as a target of their own, with everything moved up by Top
+	const LOCKEDSURFACE32* pDest = &pList->Locked[ 0 ];
+	DWORD* pRows = pDest->pBits + Top * ( pDest->Pitch / 4 );
+	int Width = pList->Widths[ 0 ];
+	int Height = Bottom - Top;
+
+	switch( pCommand->Type )
+	{
+		case DRAW_FILL:
+		{
+			RECT Rect = pCommand->Rect;
+			Rect.top -= Top;
+			Rect.bottom -= Top;
+
+			if( Rect.left < 0 )
+				Rect.left = 0;
+			if( Rect.top < 0 )
+				Rect.top = 0;
+			if( Rect.right > Width )
+				Rect.right = Width;
+			if( Rect.bottom > Height )
+				Rect.bottom = Height;
+
+			if( Rect.right > Rect.left && Rect.bottom > Rect.top )
+				FillRect32( pRows, pDest->Pitch, Rect, pCommand->Color );
+			break;
+		}
+
+		case DRAW_BLIT:
+		{
+			const LOCKEDSURFACE32* pSource = &pList->Locked[ pCommand->Surface ];
+			POINT DestPoint = { pCommand->DestPoint.x, pCommand->DestPoint.y - Top };
+
+			Blit32( pSource->pBits, pSource->Pitch, pCommand->Rect, pRows, pDest->Pitch, Width, Height,
+					DestPoint, pCommand->bTransparent, pCommand->Color );
+			break;
+		}
+
+		case DRAW_SPRITE:
+			DrawSpanSprite( pCommand->pSprite, pCommand->DestPoint.x, pCommand->DestPoint.y - Top, pRows, pDest->Pitch, Width, Height );
+			break;
+
+		case DRAW_TEXT:
+		{
+			const LOCKEDSURFACE32* pFont = &pList->Locked[ pCommand->Surface ];
+
+			DrawTextBatchToBuffer( pCommand->pText, pCommand->pAtlas, pFont->pBits, pFont->Pitch, pCommand->bTransparent, pCommand->Color,
+								   pRows, pDest->Pitch, Width, Height, 0, Top );
+			break;
+		}
+	}
+}
+
+// Draws a locked list, clipped to the rows from Top up to (not including) Bottom.  Nothing outside
+// those rows is touched, so different threads can draw different rows of the same list at once.
+// With bProfile each layer is timed into its profile stage.
+void DrawListRows( const DRAWLIST* pList, int Top, int Bottom, BOOL bProfile )
+{
+	int i = 0;
+
+	while( i < pList->Count )
+	{
+		// Run every command in this layer
+		int Layer = pList->Commands[ pList->Order[ i ] ].Layer;
+		INT64 Start = bProfile ? HrClockNow() : 0;
+
+		for( ; i < pList->Count && pList->Commands[ pList->Order[ i ] ].Layer == Layer ; i++ )
+			DrawCommandRows( pList, &pList->Commands[ pList->Order[ i ] ], Top, Bottom );
+
+		if( bProfile && pList->LayerStages[ Layer ] >= 0 )
+			RecordHistogram( &g_ProfileHistograms[ pList->LayerStages[ Layer ] ], HrClockToNs( HrClockNow() - Start ) );
+	}
+}
+
+// Draws the whole list in one pass.  Returns FALSE if a surface could not be locked.
+BOOL ExecuteDrawList( DRAWLIST* pList )
+{
+	if( !LockDrawList( pList ) )
+		return FALSE;
+
+	DrawListRows( pList, 0, pList->Heights[ 0 ], TRUE );
+
+	UnlockDrawList( pList );
+	return TRUE;
+}
+
+#endif	// DRAWLIST_H
@@ -4,10 +4,27 @@
 // All rights reserved
 //*********************************
 
+#include "blit.h"
+#include "sprite.h"
+#include "text.h"
+#include "dirty.h"
+#include "surface.h"
+#include "profile.h"
+#include "trace.h"
+#include "mapfile.h"
+#include "bmp.h"
+#include "assetpack.h"
+#include "resources.h"
+#include "assetloader.h"
+#include "input.h"
+
 HRESULT RestoreGraphics();
 
 LPDIRECT3DSURFACE8 g_pBackSurface = 0;
 
+// Tracks which parts of the back buffer changed
+DIRTYTRACKER g_DirtyTracker;
+
 int g_DeviceWidth = 0;
 int g_DeviceHeight = 0;
 
@@ -104,6 +121,9 @@ int InitDirect3DDevice( HWND hWndTarget, int Width, int Height, BOOL bWindowed,
 	g_DeviceHeight = Height;
 	g_DeviceWidth = Width;
 
+	// Nothing has been drawn yet, so the first frame is a full redraw
+	InitDirtyTracker( &g_DirtyTracker, Width, Height );
+
 	// Save a copy of the pres params for use in device validation later
 	g_SavedPresParams = d3dpp;
 
@@ -164,161 +184,288 @@ void Rectangle32Fast( D3DRECT* pRect, DWORD Color, LPDIRECT3DDEVICE8 pDevice )
 	pDevice->Clear( 1, pRect, D3DCLEAR_TARGET, Color, 0.0f, 0 );
 }
 
-// Loads a bitmap to a surface
+// The baked bitmaps, while GameInit() is loading them
+MAPPEDFILE g_AssetPackFile;
+ASSETPACK g_AssetPack;
+
+// Maps the asset pack so LoadBitmapToSurface() takes bitmaps from it.  Without one, or for
+// anything not in it, the .bmp files are loaded instead.
+BOOL OpenGameAssetPack( char* PathName )
+{
+	if( !OpenMappedFile( &g_AssetPackFile, PathName ) )
+		return FALSE;
+
+	if( !OpenAssetPack( &g_AssetPack, g_AssetPackFile.pData, g_AssetPackFile.Size ) )
+	{
+		Debug( "The asset pack is damaged or out of date, loading the bitmaps instead" );
+		CloseMappedFile( &g_AssetPackFile );
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CloseGameAssetPack()
+{
+	memset( &g_AssetPack, 0, sizeof( ASSETPACK ) );
+	CloseMappedFile( &g_AssetPackFile );
+}
+
+// Loads a bitmap to a surface.  The image comes from the asset pack if it has it, otherwise
+// the file is mapped, its header read once, and the pixels decoded straight into the surface.
 int LoadBitmapToSurface( char* PathName, LPDIRECT3DSURFACE8* ppSurface, LPDIRECT3DDEVICE8 pDevice )
 {
 	HRESULT r;
-	HBITMAP hBitmap;
-	BITMAP Bitmap;
-	
-	// Load the bitmap first using the GDI to get info about it
-	hBitmap = (HBITMAP)LoadImage( NULL, PathName, IMAGE_BITMAP, 0, 0, 
-									LR_LOADFROMFILE | LR_CREATEDIBSECTION );
-	if( hBitmap == NULL )
+	MAPPEDFILE File;
+	BMPINFO Info;
+	int Width, Height;
+
+	const ASSETPACKIMAGE* pImage = FindAssetPackImage( &g_AssetPack, PathName );
+	if( pImage )
 	{
-		// The file probably does not exist
-		Debug( "Unable to load bitmap" );
-		return E_FAIL;
+		Width = pImage->Width;
+		Height = pImage->Height;
 	}
+	else
+	{
+		if( !OpenMappedFile( &File, PathName ) )
+		{
+			// The file probably does not exist
+			Debug( "Unable to load bitmap" );
+			return E_FAIL;
+		}
 
-	// Get information about the object
-	GetObject( hBitmap, sizeof( BITMAP ), &Bitmap );
-	// Unload the bitmap from memory
-	DeleteObject( hBitmap );
+		if( !ReadBmpHeader( File.pData, File.Size, &Info ) )
+		{
+			Debug( "Unable to read bitmap, it must be an uncompressed .bmp" );
+			CloseMappedFile( &File );
+			return E_FAIL;
+		}
 
-	// Create a surface using the information gained from the previous load
-	r = pDevice->CreateImageSurface( Bitmap.bmWidth, Bitmap.bmHeight, D3DFMT_X8R8G8B8, ppSurface );
-	if( FAILED( r ) )
+		Width = Info.Width;
+		Height = Info.Height;
+	}
+
+	// Create a surface the size of the bitmap
+	r = pDevice->CreateImageSurface( Width, Height, D3DFMT_X8R8G8B8, ppSurface );
+	if( SUCCEEDED( r ) )
 	{
-		Debug( "Unable to create surface for bitmap load" );
-		return E_FAIL;
+		D3DLOCKED_RECT LockedRect;
+		r = (*ppSurface)->LockRect( &LockedRect, 0, 0 );
+		if( SUCCEEDED( r ) )
+		{
+			if( pImage )
+				CopyAssetPackImage( &g_AssetPack, pImage, (DWORD*)LockedRect.pBits, LockedRect.Pitch );
+			else
+				DecodeBmp( File.pData, &Info, (DWORD*)LockedRect.pBits, LockedRect.Pitch );
+
+			(*ppSurface)->UnlockRect( );
+		}
+		else
+		{
+			(*ppSurface)->Release( );
+			*ppSurface = 0;
+		}
 	}
 
-	// Load the image again, this time using Direct3D to load it directly to the new surface
-	r = D3DXLoadSurfaceFromFile( *ppSurface, NULL, NULL, PathName, 
-									NULL, D3DX_FILTER_NONE, 0, NULL );
+	if( !pImage )
+		CloseMappedFile( &File );
+
 	if( FAILED( r ) )
 	{
-		Debug( "Unable to load file to surface" );
+		Debug( "Unable to create surface for bitmap load" );
 		return E_FAIL;
 	}
 
 	return S_OK;
 }
 
-// Copy a surface to another surface (with transparency!)
-HRESULT CopySurfaceToSurface( RECT* pSourceRect, LPDIRECT3DSURFACE8 pSourceSurf, POINT* pDestPoint, LPDIRECT3DSURFACE8 pDestSurf, BOOL bTransparent, D3DCOLOR ColorKey )
+// A Direct3D surface as an ISurface32, so the portable drawing code can use it.  Pass the
+// device for the back buffer and Clear() will use the hardware.  An owned surface is
+// released along with this.
+class CD3DSurface32 : public ISurface32
 {
-	// Holds error return values
-	HRESULT r = 0;	
-	
-	// Holds information about the surfaces when they are locked
-	D3DLOCKED_RECT LockedSource;
-	D3DLOCKED_RECT LockedDest;
-
-	// Make sure the source surface is valid
-	if( !pSourceSurf )
-		return E_FAIL;
+public:
+	CD3DSurface32( LPDIRECT3DSURFACE8 pSurface, LPDIRECT3DDEVICE8 pDevice = 0, BOOL bOwned = FALSE ) : m_pSurface( pSurface ), m_pDevice( pDevice ), m_Width( 0 ), m_Height( 0 ), m_bOwned( bOwned )
+	{
+		if( m_pSurface )
+		{
+			D3DSURFACE_DESC d3dsd;
+			m_pSurface->GetDesc( &d3dsd );
 
-	// Make sure the destination surface is valid
-	if( !pDestSurf )
-		return E_FAIL;
+			m_Width = d3dsd.Width;
+			m_Height = d3dsd.Height;
+		}
+	}
 
-	// The source rectangle
-	RECT SourceRect;
-	// The destination point
-	POINT DestPoint;
+	~CD3DSurface32()
+	{
+		if( m_bOwned && m_pSurface )
+			m_pSurface->Release();
+	}
 
-	// Holds information about the source surface
-	D3DSURFACE_DESC d3dsdSource;
-	// Get information about the source surface
-	pSourceSurf->GetDesc( &d3dsdSource );
+	LPDIRECT3DSURFACE8 GetD3DSurface() { return m_pSurface; }
 
-	// Holds information about the destination surface
-	D3DSURFACE_DESC d3dsdDest;
-	// Get information about the destination surface
-	pDestSurf->GetDesc( &d3dsdDest );
+	int GetWidth() { return m_Width; }
+	int GetHeight() { return m_Height; }
 
-	// If a source rectangle was specified then copy it into the local RECT structure
-	if( pSourceRect )
-		SourceRect = *pSourceRect;
-	else
-		// Otherwise set the rectangle to encompas the entire source surface
-		SetRect( &SourceRect, 0, 0, d3dsdSource.Width, d3dsdSource.Height );
-	
-	// If a destination point was specified then copy it to the local POINT structure
-	if( pDestPoint )
-		DestPoint = *pDestPoint;
-	else
+	BOOL Lock( LOCKEDSURFACE32* pLocked, BOOL bReadOnly )
 	{
-		// Otherwise set the point to (0,0)
-		DestPoint.x = DestPoint.y = 0;
+		if( !m_pSurface )
+			return FALSE;
+
+		D3DLOCKED_RECT Locked;
+		if( FAILED( m_pSurface->LockRect( &Locked, 0, bReadOnly ? D3DLOCK_READONLY : 0 ) ) )
+			return FALSE;
+
+		pLocked->pBits = (DWORD*)Locked.pBits;
+		pLocked->Pitch = Locked.Pitch;
+		return TRUE;
 	}
 
-	// Lock the source surface.
-	r = pSourceSurf->LockRect( &LockedSource, 0, D3DLOCK_READONLY  );
-	if( FAILED( r ) )
-		// Fatal Error
-		return E_FAIL;
+	void Unlock()
+	{
+		m_pSurface->UnlockRect();
+	}
 
-	// Lock the destination surface
-	r = pDestSurf->LockRect( &LockedDest, 0, 0 );
-	if( FAILED( r ) )
+	BOOL Clear( DWORD Color )
 	{
-		pSourceSurf->UnlockRect();
-		return E_FAIL;
+		if( !m_pDevice )
+			return ISurface32::Clear( Color );
+
+		return SUCCEEDED( m_pDevice->Clear( 0, 0, D3DCLEAR_TARGET, Color, 1.0f, 0 ) );
 	}
 
-	// Modify the pitch to be DWORD compatible
-	LockedSource.Pitch /= 4;
-	LockedDest.Pitch /= 4;
+private:
+	LPDIRECT3DSURFACE8 m_pSurface;
+	LPDIRECT3DDEVICE8 m_pDevice;
+	int m_Width;
+	int m_Height;
+	BOOL m_bOwned;
 
-	// Get 32bit pointers to the surface data
-	DWORD* pSourceData = (DWORD*)LockedSource.pBits;
-	DWORD* pDestData = (DWORD*)LockedDest.pBits;
+	// Copying would release the surface twice
+	CD3DSurface32( const CD3DSurface32& );
+	CD3DSurface32& operator=( const CD3DSurface32& );
+};
 
-	// Get the offset into the source surface
-	int SourceOffset = SourceRect.top * LockedSource.Pitch + SourceRect.left;
-	// Get the offset into the destination surface
-	int DestOffset = DestPoint.y * LockedDest.Pitch + DestPoint.x;
+//====================================================
+// Resources
+//====================================================
+
+// Every bitmap the game loads, shared by path (see resources.h)
+RESOURCECACHE g_Resources;
+
+// Bitmaps being decoded in the background while the game starts up
+ASSETLOADER g_AssetLoader;
 
-	// Loop for each row of the source image
-	for( int y = 0 ; y < SourceRect.bottom ; y++ )
+// The resource cache's loader: a bitmap in a Direct3D surface.  pContext is the device.  If
+// g_AssetLoader has already decoded the file, its pixels are just copied in.
+ISurface32* LoadD3DResource( const char* PathName, void* pContext )
+{
+	LPDIRECT3DSURFACE8 pSurface = 0;
+	LPDIRECT3DDEVICE8 pDevice = (LPDIRECT3DDEVICE8)pContext;
+
+	CMemorySurface32* pDecoded = FindCollectedAsset( &g_AssetLoader, PathName );
+	if( !pDecoded )
 	{
-		// Loop for each column of the source image
-		for( int x = 0 ; x < SourceRect.right ; x++ )
-		{
-			// If transparency was requested
-			if( bTransparent )
-			{
-				if( pSourceData[ SourceOffset ] != ColorKey )
-				{
-					pDestData[ DestOffset ] = pSourceData[ SourceOffset ];
-				}
-			}
-			else // Transparency was not requested
-			{
-				pDestData[ DestOffset ] = pSourceData[ SourceOffset ];
-			}
+		if( FAILED( LoadBitmapToSurface( (char*)PathName, &pSurface, pDevice ) ) )
+			return 0;
 
-			// Increment to the next pixel in the destination
-			DestOffset++;
-			// Increment to the next pixel in the source
-			SourceOffset++;
-		}
-		
-		SourceOffset += LockedSource.Pitch - SourceRect.right;
-		DestOffset += LockedDest.Pitch - SourceRect.right;
+		return new CD3DSurface32( pSurface, 0, TRUE );
+	}
+
+	if( FAILED( pDevice->CreateImageSurface( pDecoded->GetWidth(), pDecoded->GetHeight(), D3DFMT_X8R8G8B8, &pSurface ) ) )
+	{
+		Debug( "Unable to create surface for bitmap load" );
+		return 0;
+	}
+
+	CD3DSurface32* pResult = new CD3DSurface32( pSurface, 0, TRUE );
+
+	LOCKEDSURFACE32 Locked;
+	if( !pResult->Lock( &Locked, FALSE ) )
+	{
+		delete pResult;
+		return 0;
+	}
+
+	for( int y = 0 ; y < pDecoded->GetHeight() ; y++ )
+		memcpy( (BYTE*)Locked.pBits + y * Locked.Pitch, (BYTE*)pDecoded->GetBits() + y * pDecoded->GetPitch(), pDecoded->GetWidth() * 4 );
+
+	pResult->Unlock();
+	return pResult;
+}
+
+// The Direct3D surface behind a resource from g_Resources, or 0 if it did not load
+LPDIRECT3DSURFACE8 GetResourceD3DSurface( const RESOURCE* pResource )
+{
+	return pResource ? ( (CD3DSurface32*)pResource->pSurface )->GetD3DSurface() : 0;
+}
+
+// Copy a surface to another surface (with transparency!)
+HRESULT CopySurfaceToSurface( RECT* pSourceRect, LPDIRECT3DSURFACE8 pSourceSurf, POINT* pDestPoint, LPDIRECT3DSURFACE8 pDestSurf, BOOL bTransparent, D3DCOLOR ColorKey )
+{
+	TRACE_SCOPE( "CopySurfaceToSurface" );
+
+	// Make sure the surfaces are valid
+	if( !pSourceSurf || !pDestSurf )
+		return E_FAIL;
+
+	CD3DSurface32 Source( pSourceSurf );
+	CD3DSurface32 Dest( pDestSurf );
+
+	// Let the fastest blitter for this CPU do the copy, clipped to the destination
+	return SurfaceCopy( pSourceRect, &Source, pDestPoint, &Dest, bTransparent, ColorKey ) ? S_OK : E_FAIL;
+}
+
+// Copies the dirty rectangles from the background to the destination, locking each surface once.
+// Wherever the background does not reach is filled with ClearColor.
+HRESULT RestoreDirtyRects( DIRTYTRACKER* pTracker, LPDIRECT3DSURFACE8 pBgSurf, LPDIRECT3DSURFACE8 pDestSurf, D3DCOLOR ClearColor )
+{
+	// Make sure the surfaces are valid
+	if( !pBgSurf || !pDestSurf )
+		return E_FAIL;
+
+	CD3DSurface32 Background( pBgSurf );
+	CD3DSurface32 Dest( pDestSurf );
+
+	return SurfaceRestoreDirtyRects( pTracker, &Background, &Dest, ClearColor ) ? S_OK : E_FAIL;
+}
+
+// Builds a span sprite from a color keyed surface
+HRESULT CreateSpanSpriteFromSurface( LPDIRECT3DSURFACE8 pSourceSurf, D3DCOLOR ColorKey, SPANSPRITE* pSprite )
+{
+	// Make sure the source surface is valid
+	if( !pSourceSurf )
+		return E_FAIL;
+
+	CD3DSurface32 Source( pSourceSurf );
+
+	if( !SurfaceBuildSpanSprite( &Source, ColorKey, pSprite ) )
+	{
+		Debug( "Unable to build span sprite from surface" );
+		return E_FAIL;
 	}
 
-	// Copying is complete so unlock the surfaces
-	pSourceSurf->UnlockRect();
-	pDestSurf->UnlockRect();
-	
-	// Return success
 	return S_OK;
 }
 
+// Draws a span sprite to a surface.  Same result as CopySurfaceToSurface() with transparency on.
+HRESULT CopySpanSpriteToSurface( SPANSPRITE* pSprite, POINT* pDestPoint, LPDIRECT3DSURFACE8 pDestSurf )
+{
+	// Make sure the destination surface is valid
+	if( !pDestSurf )
+		return E_FAIL;
+
+	POINT DestPoint = { 0, 0 };
+	if( pDestPoint )
+		DestPoint = *pDestPoint;
+
+	CD3DSurface32 Dest( pDestSurf );
+
+	return SurfaceDrawSpanSprite( pSprite, DestPoint, &Dest ) ? S_OK : E_FAIL;
+}
+
 //====================================================
 // DC to Surface code
 //====================================================
@@ -501,6 +648,8 @@ LPDIRECT3DDEVICE8 g_pDevice = 0;
 // Call every frame to check if the device is valid.  If it is not then the it is reaquired if possible
 HRESULT ValidateDevice()
 {
+	TRACE_SCOPE( "ValidateDevice" );
+
 	HRESULT r = 0;
 	
 	// Test the current state of the device
@@ -547,7 +696,9 @@ HRESULT ValidateDevice()
 // Use this function to reinit any surfaces that were lost when the device was lost.
 HRESULT RestoreGraphics()
 {
-	
+	// The back buffer was cleared, so everything has to be drawn again
+	InvalidateDirtyTracker( &g_DirtyTracker );
+
 	return S_OK;
 }
 
@@ -561,9 +712,13 @@ int g_AlphabetLetterWidth = 0;		// The width of a letter
 int g_AlphabetLetterHeight = 0;		// The height of a letter
 int g_AlphabetLettersPerRow = 0;	// The number of letters per row
 
-// The surface holding the alphabet bitmap
+// The alphabet bitmap, from g_Resources, and the surface holding it
+const RESOURCE* g_pAlphabet = 0;
 LPDIRECT3DSURFACE8 g_pAlphabetSurface = 0;
 
+// Where each letter lives in the alphabet bitmap
+FONTATLAS g_FontAtlas;
+
 // Has the alphabet bitmap been loaded yet?
 BOOL g_bAlphabetLoaded = FALSE;
 
@@ -578,11 +733,10 @@ HRESULT LoadAlphabet( char* strPathName, int LetterWidth, int LetterHeight )
 	if( !LetterWidth || !LetterHeight )
 		return E_FAIL;
 
-	HRESULT r = 0;
-	
 	// Load the bitmap into memory
-	r = LoadBitmapToSurface( strPathName, &g_pAlphabetSurface, g_pDevice );
-	if( FAILED( r ) )
+	g_pAlphabet = AcquireResource( &g_Resources, strPathName );
+	g_pAlphabetSurface = GetResourceD3DSurface( g_pAlphabet );
+	if( !g_pAlphabetSurface )
 	{
 		Debug( "Unable to load alphabet bitmap" );
 		return E_FAIL;
@@ -603,6 +757,9 @@ HRESULT LoadAlphabet( char* strPathName, int LetterWidth, int LetterHeight )
 	// Compute the number of letters in a row
 	g_AlphabetLettersPerRow = g_AlphabetWidth / g_AlphabetLetterWidth;
 
+	// Work out where every letter is once, instead of every time one is printed
+	InitFontAtlas( &g_FontAtlas, g_AlphabetWidth, g_AlphabetHeight, LetterWidth, LetterHeight );
+
 	// Set the loaded flag to TRUE
 	g_bAlphabetLoaded = TRUE;
 
@@ -613,11 +770,12 @@ HRESULT LoadAlphabet( char* strPathName, int LetterWidth, int LetterHeight )
 HRESULT UnloadAlphabet()
 {
 	// Check if the alphabet exists
-	if( g_pAlphabetSurface )
+	if( g_pAlphabet )
 	{
-		// Release the surface
-		g_pAlphabetSurface->Release();
-		// NULL the pointer
+		// Hand the bitmap back to the cache
+		ReleaseResource( &g_Resources, g_pAlphabet );
+		// NULL the pointers
+		g_pAlphabet = 0;
 		g_pAlphabetSurface = 0;
 		// Set the loaded flag to FALSE
 		g_bAlphabetLoaded = FALSE;
@@ -626,113 +784,57 @@ HRESULT UnloadAlphabet()
 	return S_OK;
 }
 
-// Print a character to a surface using the loaded alphabet
-void PrintChar( int x, int y, char Character, BOOL bTransparent, D3DCOLOR ColorKey, DWORD* pDestData, int DestPitch )
+// Draws every string queued in a text batch.  The alphabet is locked once for the whole batch.
+void DrawTextBatch( TEXTBATCH* pBatch, BOOL bTransparent, D3DCOLOR ColorKey, DWORD* pDestData, int DestPitch )
 {
-	HRESULT r = 0;
-	
-	div_t Result;	// Holds the result of divisions
-
-	// The offset into the alphabet image
-	int OffsetX = 0, OffsetY = 0;
+	TRACE_SCOPE( "DrawTextBatch" );
 
-	POINT LetterDestPoint = { 0, 0 };	// The destination point for the letter
-	RECT LetterRect = { 0, 0, 0, 0 };	// The source rectangle for the letter
+	HRESULT r = 0;
 
 	// If the alphabet has not been loaded yet then exit
 	if( !g_bAlphabetLoaded )
 		return;
 
-	// The characters are specified in ASCII code, which begins at 32 so we want to decrement this value by 32 to make it zero based
-	Character -= 32;
-
-	// Avoid divide by 0 errors
-	if( Character == 0 )
+	// Nothing to draw
+	if( pBatch->Count == 0 )
 		return;
 
-	// Divide the character code by the number of letters per row.
-	// The quotient will help get the vertical offset and the remainder will help get the horizontal offset
-	Result = div( Character, g_AlphabetLettersPerRow );
-
-	// Get the horizontal offset by multiplying the remainder by the width of the Letter
-	OffsetX = Result.rem * g_AlphabetLetterWidth;
-	// Get the vertical offset by multiplying the quotient by the height of the letter
-	OffsetY = Result.quot * g_AlphabetLetterHeight;
-
-	// Fill in the source rectangle with the computed offsets
-	SetRect( &LetterRect, OffsetX, OffsetY, 
-	OffsetX + g_AlphabetLetterWidth, OffsetY + g_AlphabetLetterHeight );
-	
-	// Fill in the destination point
-	LetterDestPoint.x = x;
-	LetterDestPoint.y = y;
-	
 	D3DLOCKED_RECT LockedAlphabet;	// Holds info about the alphabet surface
 
 	// Lock the source surface
 	r = g_pAlphabetSurface->LockRect( &LockedAlphabet, 0, D3DLOCK_READONLY  );
 	if( FAILED( r ) )
 	{
-		Debug( "Couldnt lock alphabet surface for PrintChar()" );
+		Debug( "Couldnt lock alphabet surface for DrawTextBatch()" );
 		return;
 	}
-	
-	// Get a DWORD pointer to each surface
-	DWORD* pAlphaData = (DWORD*)LockedAlphabet.pBits;
-
-	// Convert the BYTE pitch pointer to a DWORD ptr
-	LockedAlphabet.Pitch /=4;
-	DestPitch /= 4;
 
-	// Compute the offset into the alphabet
-	int AlphaOffset = OffsetY * LockedAlphabet.Pitch + OffsetX;
-	// Compute the offset into the destination surface
-	int DestOffset = y * DestPitch + x;
-
-	// Loop for each row in the letter
-	for( int cy = 0 ; cy < g_AlphabetLetterHeight ; cy++ )
-	{
-		// Loop for each column in the letter
-		for( int cx = 0 ; cx < g_AlphabetLetterWidth ; cx++ )
-		{
-			if( bTransparent )
-			{
-				// If this alphabet pixel is not transparent
-				if( pAlphaData[ AlphaOffset ] != ColorKey )
-				{
-					// Then copy the pixel to the destination
-					pDestData[ DestOffset ] = pAlphaData[ AlphaOffset ];
-				}
+	DrawTextBatchToBuffer( pBatch, &g_FontAtlas, (DWORD*)LockedAlphabet.pBits, LockedAlphabet.Pitch,
+						   bTransparent, ColorKey, pDestData, DestPitch, g_DeviceWidth, g_DeviceHeight );
 
-				// Increment the offsets to the next pixel
-				AlphaOffset++;
-				DestOffset++;
-			}
-			else
-				pDestData[ DestOffset ] = pAlphaData[ AlphaOffset ];
-		}
-
-		// Move the offsets to the start of the next row
-		DestOffset += DestPitch - g_AlphabetLetterWidth;
-		AlphaOffset += LockedAlphabet.Pitch - g_AlphabetLetterWidth;
-	}
-	
 	// Unlock the surface
 	g_pAlphabetSurface->UnlockRect();
-	
 }
 
+// Print a string to a surface using the loaded alphabet
+void PrintString( int x, int y, char* String, BOOL bTransparent, D3DCOLOR ColorKey, DWORD* pDestData, int DestPitch )
+{
+	TRACE_SCOPE( "PrintString" );
 
+	// A batch of one, so the alphabet is only locked once per string
+	static TEXTBATCH Batch;
 
-void PrintString( int x, int y, char* String, BOOL bTransparent, D3DCOLOR ColorKey, DWORD* pDestData, int DestPitch )
+	BeginTextBatch( &Batch );
+	AddText( &Batch, x, y, String );
+	DrawTextBatch( &Batch, bTransparent, ColorKey, pDestData, DestPitch );
+}
+
+// Print a character to a surface using the loaded alphabet
+void PrintChar( int x, int y, char Character, BOOL bTransparent, D3DCOLOR ColorKey, DWORD* pDestData, int DestPitch )
 {
-	// Loop for each character in the string
-	for( UINT i = 0 ; i < strlen( String ) ; i++ )
-	{
-		// Print the current character
-		PrintChar( x + (g_AlphabetLetterWidth * i), y, String[i], 
-							bTransparent, ColorKey, pDestData, DestPitch );
-	}	
+	char String[2] = { Character, 0 };
+
+	PrintString( x, y, String, bTransparent, ColorKey, pDestData, DestPitch );
 }
 
 //====================================================
@@ -761,6 +863,7 @@ HRESULT InitTiming()
 	return S_OK;
 }
 	
+// Counts frames for the FPS display, and records each frame's length in the profile
 void FrameCount()
 {
 	INT64 NewCount = 0;			// The current count
@@ -776,6 +879,7 @@ void FrameCount()
 
 	// Increase the frame count
 	g_FrameCount++;
+	ProfileFrame( );
 	
 	// Compute the difference since the last count
 	Difference = NewCount - LastCount;
@@ -797,7 +901,7 @@ void FrameCount()
 // Prints the frame rate to the screen
 void PrintFrameRate( int x, int y, DWORD* pDestData, int DestPitch )
 {
-	char string[4];	// String to hold the frame rate
+	char string[12];	// String to hold the frame rate (big enough for any int)
 	
 	// Zero out the string
 	ZeroMemory( &string, sizeof( string ) );
@@ -807,4 +911,93 @@ void PrintFrameRate( int x, int y, DWORD* pDestData, int DestPitch )
 
 	// Output the string to the back surface
 	PrintString( x, y, string, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), pDestData, DestPitch );
-}
\ No newline at end of file
+}
+
+//====================================================
+// Keyboard Input
+//====================================================
+
+// A key the game uses, and the PONGINPUT_ flags it gives
+struct KEYBINDING
+{
+	int VirtualKey;
+	unsigned int Buttons;
+};
+
+// The keyboard as an input source.  The window procedure hands it every WM_KEYDOWN and WM_KEYUP
+// and the bound keys go straight into the ring, stamped with when Windows got them, so a tap
+// between two frames is never missed.
+class CKeyboardInput : public IInputSource
+{
+public:
+	CKeyboardInput( const KEYBINDING* pBindings, int Count ) : m_pBindings( pBindings ), m_Count( Count ), m_Down( 0 ), m_LastTime( 0 ), m_Dropped( 0 ) {}
+
+	// Returns TRUE if the message was for a bound key
+	BOOL OnKeyMessage( INPUTRING* pRing, UINT uMessage, WPARAM wParam, LPARAM lParam )
+	{
+		int Key = (int)wParam;
+
+		// Windows only says which control key it was in the extended key bit
+		if( Key == VK_CONTROL )
+			Key = ( lParam & ( 1 << 24 ) ) ? VK_RCONTROL : VK_LCONTROL;
+
+		unsigned int Buttons = 0;
+		for( int i = 0 ; i < m_Count ; i++ )
+			if( m_pBindings[ i ].VirtualKey == Key )
+				Buttons |= m_pBindings[ i ].Buttons;
+
+		if( !Buttons )
+			return FALSE;
+
+		BOOL bDown = ( uMessage == WM_KEYDOWN );
+
+		// Holding a key down repeats WM_KEYDOWN, but it is still only one press
+		if( bDown ? ( m_Down & Buttons ) == Buttons : !( m_Down & Buttons ) )
+			return TRUE;
+
+		Push( pRing, Buttons, bDown );
+		return TRUE;
+	}
+
+	// Lets go of everything, e.g. when the window loses the focus and will not see the key ups
+	void ReleaseAll( INPUTRING* pRing )
+	{
+		if( m_Down )
+			Push( pRing, m_Down, FALSE );
+	}
+
+	// Everything is pushed as the messages arrive
+	void Poll( INPUTRING* pRing, INT64 Now ) {}
+
+	DWORD GetDropped() const { return m_Dropped; }
+
+private:
+	void Push( INPUTRING* pRing, unsigned int Buttons, BOOL bDown )
+	{
+		// The message may have waited in the queue while a frame was drawn, so go back by its
+		// age.  GetMessageTime() is only good to a few milliseconds, so never go back past the
+		// last key, which would put them out of order.
+		INT64 Now = HrClockNow();
+		DWORD Age = GetTickCount() - (DWORD)GetMessageTime();
+		INT64 Time = Now - (INT64)Age * HrClockFrequency() / 1000;
+		if( Time < m_LastTime )
+			Time = m_LastTime;
+		if( Time > Now )
+			Time = Now;
+
+		if( !PushInputEvent( pRing, Time, Buttons, bDown ) )
+		{
+			m_Dropped++;
+			return;
+		}
+
+		m_LastTime = Time;
+		m_Down = bDown ? ( m_Down | Buttons ) : ( m_Down & ~Buttons );
+	}
+
+	const KEYBINDING* m_pBindings;
+	int m_Count;
+	unsigned int m_Down;		// Buttons pushed as held
+	INT64 m_LastTime;
+	DWORD m_Dropped;			// Keys lost because the ring was full
+};
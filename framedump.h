@@ -0,0 +1,449 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Frame capture.  SubmitFrameDump() copies a finished frame into one of a
+// few slots and hands it to a writer thread through a single producer,
+// single consumer ring, so drawing never waits on the disk; if the writer
+// falls behind the frame is dropped and counted instead.  The writer codes
+// each frame against the one before it: runs of unchanged pixels are
+// skipped and the changed ones stored as 24 bit BGR, which suits a screen
+// that is mostly the same from frame to frame.
+//
+// The file is a series of chunks, each a four character code, a byte count
+// and the bytes (all little endian):
+//		'UFDH'	width, height, version
+//		'FRAM'	frame number, flags, time (ns since capture began), then the
+//				pixels as ( unchanged count, changed count, changed BGR ... )
+//				repeated, each count stored 7 bits a byte
+//		'UFDE'	frames written, frames dropped
+// Every FRAMEDUMP_KEYINTERVAL frames is a key frame coded on its own, so a
+// reader can start there.
+
+#ifndef FRAMEDUMP_H
+#define FRAMEDUMP_H
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "platform.h"
+#include "surface.h"
+#include "hrclock.h"
+#include "trace.h"
+
+#define FRAMEDUMP_VERSION		1
+#define FRAMEDUMP_SLOTS			4			// Frames that can wait for the writer
+#define FRAMEDUMP_KEYINTERVAL	300			// Frames between key frames
+#define FRAMEDUMP_FILEBUFFER	( 1 << 20 )	// Bytes collected before each write to the file
+#define FRAMEDUMP_MAXSIZE		16384		// Widest or tallest frame a reader will take
+
+#define FRAMEDUMP_KEYFRAME		1			// FRAM flags
+
+#define FRAMEDUMP_HEADER		0x48444655	// 'UFDH'
+#define FRAMEDUMP_FRAME			0x4D415246	// 'FRAM'
+#define FRAMEDUMP_END			0x45444655	// 'UFDE'
+
+struct FRAMEDUMP
+{
+	int Width;
+	int Height;
+
+	// Frames waiting for the writer.  Frame n goes in slot n % FRAMEDUMP_SLOTS.
+	DWORD* pSlots[ FRAMEDUMP_SLOTS ];
+	DWORD SlotNumber[ FRAMEDUMP_SLOTS ];
+	INT64 SlotTime[ FRAMEDUMP_SLOTS ];
+
+	alignas( 64 ) std::atomic<DWORD> Head;	// Frames handed over (only the drawing thread writes it)
+	alignas( 64 ) std::atomic<DWORD> Tail;	// Frames written (only the writer writes it)
+	std::atomic<BOOL> bStop;
+
+	// The drawing thread's side
+	alignas( 64 ) DWORD Submitted;
+	DWORD Dropped;
+	INT64 StartTime;
+
+	// The writer's side
+	std::thread Writer;
+	FILE* pFile;
+	char* pFileBuffer;
+	DWORD* pPrevious;			// Last frame written
+	BYTE* pCoded;
+	DWORD Written;
+	INT64 BytesWritten;
+	BOOL bFailed;
+};
+
+//====================================================
+// Coding
+//====================================================
+
+inline BYTE* FrameDumpPutVarint( BYTE* pOut, DWORD Value )
+{
+	while( Value >= 0x80 )
+	{
+		*pOut++ = (BYTE)( Value | 0x80 );
+		Value >>= 7;
+	}
+	*pOut++ = (BYTE)Value;
+	return pOut;
+}
+
+inline BOOL FrameDumpGetVarint( const BYTE** ppIn, const BYTE* pEnd, DWORD* pValue )
+{
+	DWORD Value = 0;
+	for( int Shift = 0 ; Shift < 35 ; Shift += 7 )
+	{
+		if( *ppIn >= pEnd )
+			return FALSE;
+
+		BYTE b = *( *ppIn )++;
+		Value |= (DWORD)( b & 0x7F ) << Shift;
+		if( !( b & 0x80 ) )
+		{
+			*pValue = Value;
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+// Most bytes a frame of Pixels pixels can code to
+inline DWORD FrameDumpMaxCoded( DWORD Pixels )
+{
+	return Pixels * 3 + ( Pixels / 2 + 1 ) * 10;
+}
+
+// Codes a frame against the previous one (NULL for a key frame).  Only the color is kept,
+// the top byte of each pixel is ignored.  Returns the bytes written to pOut.
+DWORD FrameDumpEncode( const DWORD* pFrame, const DWORD* pPrevious, DWORD Pixels, BYTE* pOut )
+{
+	BYTE* pStart = pOut;
+	DWORD i = 0;
+
+	while( i < Pixels )
+	{
+		// Pixels the same as last frame
+		DWORD Same = i;
+		if( pPrevious )
+		{
+			while( i < Pixels && ( ( pFrame[ i ] ^ pPrevious[ i ] ) & 0x00FFFFFF ) == 0 )
+				i++;
+		}
+
+		// Then pixels that changed.  A short gap of unchanged pixels costs less to store than
+		// to start a new run for, so runs carry on over gaps of one.
+		DWORD Changed = i;
+		while( i < Pixels )
+		{
+			if( pPrevious && ( ( pFrame[ i ] ^ pPrevious[ i ] ) & 0x00FFFFFF ) == 0 &&
+				( i + 1 >= Pixels || ( ( pFrame[ i + 1 ] ^ pPrevious[ i + 1 ] ) & 0x00FFFFFF ) == 0 ) )
+				break;
+			i++;
+		}
+
+		pOut = FrameDumpPutVarint( pOut, Changed - Same );
+		pOut = FrameDumpPutVarint( pOut, i - Changed );
+
+		for( DWORD p = Changed ; p < i ; p++ )
+		{
+			pOut[ 0 ] = (BYTE)pFrame[ p ];
+			pOut[ 1 ] = (BYTE)( pFrame[ p ] >> 8 );
+			pOut[ 2 ] = (BYTE)( pFrame[ p ] >> 16 );
+			pOut += 3;
+		}
+	}
+
+	return (DWORD)( pOut - pStart );
+}
+
+// Applies a coded frame to pFrame, which holds the previous frame (anything, for a key frame).
+// Returns FALSE if the data is damaged.
+BOOL FrameDumpDecode( const BYTE* pIn, DWORD Bytes, DWORD* pFrame, DWORD Pixels )
+{
+	const BYTE* pEnd = pIn + Bytes;
+	DWORD i = 0;
+
+	while( pIn < pEnd )
+	{
+		DWORD Same, Changed;
+		if( !FrameDumpGetVarint( &pIn, pEnd, &Same ) || !FrameDumpGetVarint( &pIn, pEnd, &Changed ) )
+			return FALSE;
+
+		if( Same > Pixels - i || Changed > Pixels - i - Same || (DWORD)( pEnd - pIn ) < Changed * 3 )
+			return FALSE;
+
+		i += Same;
+		for( DWORD p = 0 ; p < Changed ; p++ )
+		{
+			pFrame[ i++ ] = pIn[ 0 ] | ( pIn[ 1 ] << 8 ) | ( pIn[ 2 ] << 16 );
+			pIn += 3;
+		}
+	}
+
+	return i == Pixels;
+}
+
+//====================================================
+// Writing
+//====================================================
+
+BOOL FrameDumpWriteChunk( FRAMEDUMP* pDump, DWORD Code, const void* pHeader, DWORD HeaderBytes, const void* pData, DWORD DataBytes )
+{
+	DWORD Chunk[ 2 ] = { Code, HeaderBytes + DataBytes };
+
+	BOOL bOk = fwrite( Chunk, sizeof( Chunk ), 1, pDump->pFile ) == 1;
+	bOk = bOk && ( !HeaderBytes || fwrite( pHeader, HeaderBytes, 1, pDump->pFile ) == 1 );
+	bOk = bOk && ( !DataBytes || fwrite( pData, DataBytes, 1, pDump->pFile ) == 1 );
+
+	pDump->BytesWritten += sizeof( Chunk ) + HeaderBytes + DataBytes;
+	return bOk;
+}
+
+// Codes and writes the frames as they arrive
+void FrameDumpWriter( FRAMEDUMP* pDump )
+{
+	TraceNameThread( "Frame Dump" );
+
+	DWORD Pixels = pDump->Width * pDump->Height;
+
+	for( ;; )
+	{
+		// Look at the stop flag first, so every frame handed over before it was set is written
+		BOOL bStop = pDump->bStop.load( std::memory_order_acquire );
+		DWORD Tail = pDump->Tail.load( std::memory_order_relaxed );
+		DWORD Head = pDump->Head.load( std::memory_order_acquire );
+
+		if( Tail == Head )
+		{
+			if( bStop )
+				break;
+
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+			continue;
+		}
+
+		TRACE_SCOPE( "FrameDumpWrite" );
+
+		int Slot = Tail % FRAMEDUMP_SLOTS;
+		BOOL bKey = pDump->Written % FRAMEDUMP_KEYINTERVAL == 0;
+
+		DWORD Coded = FrameDumpEncode( pDump->pSlots[ Slot ], bKey ? 0 : pDump->pPrevious, Pixels, pDump->pCoded );
+
+		struct { DWORD Number; DWORD Flags; INT64 Time; } Header =
+			{ pDump->SlotNumber[ Slot ], bKey ? FRAMEDUMP_KEYFRAME : 0u, pDump->SlotTime[ Slot ] };
+
+		if( !FrameDumpWriteChunk( pDump, FRAMEDUMP_FRAME, &Header, sizeof( Header ), pDump->pCoded, Coded ) )
+			pDump->bFailed = TRUE;
+
+		// Keep the frame to code the next one against, which frees the slot
+		memcpy( pDump->pPrevious, pDump->pSlots[ Slot ], Pixels * 4 );
+		pDump->Written++;
+
+		pDump->Tail.store( Tail + 1, std::memory_order_release );
+	}
+}
+
+// Opens the file and starts the writer thread
+BOOL StartFrameDump( FRAMEDUMP* pDump, const char* FileName, int Width, int Height )
+{
+	pDump->pFile = fopen( FileName, "wb" );
+	if( !pDump->pFile )
+		return FALSE;
+
+	// Big writes, rather than one per chunk
+	pDump->pFileBuffer = new char[ FRAMEDUMP_FILEBUFFER ];
+	setvbuf( pDump->pFile, pDump->pFileBuffer, _IOFBF, FRAMEDUMP_FILEBUFFER );
+
+	DWORD Pixels = Width * Height;
+	pDump->Width = Width;
+	pDump->Height = Height;
+
+	for( int i = 0 ; i < FRAMEDUMP_SLOTS ; i++ )
+		pDump->pSlots[ i ] = new DWORD[ Pixels ];
+	pDump->pPrevious = new DWORD[ Pixels ];
+	pDump->pCoded = new BYTE[ FrameDumpMaxCoded( Pixels ) ];
+
+	pDump->Head.store( 0 );
+	pDump->Tail.store( 0 );
+	pDump->bStop.store( FALSE );
+	pDump->Submitted = 0;
+	pDump->Dropped = 0;
+	pDump->Written = 0;
+	pDump->BytesWritten = 0;
+	pDump->bFailed = FALSE;
+	pDump->StartTime = HrClockNow();
+
+	DWORD Header[ 3 ] = { (DWORD)Width, (DWORD)Height, FRAMEDUMP_VERSION };
+	if( !FrameDumpWriteChunk( pDump, FRAMEDUMP_HEADER, Header, sizeof( Header ), 0, 0 ) )
+		pDump->bFailed = TRUE;
+
+	pDump->Writer = std::thread( FrameDumpWriter, pDump );
+	return TRUE;
+}
+
+// Hands a finished frame to the writer.  Costs one copy of the frame.  Returns FALSE if the
+// writer is behind and the frame was dropped, or the surface could not be read.
+BOOL SubmitFrameDump( FRAMEDUMP* pDump, ISurface32* pSource )
+{
+	TRACE_SCOPE( "SubmitFrameDump" );
+
+	DWORD Number = pDump->Submitted++;
+
+	DWORD Head = pDump->Head.load( std::memory_order_relaxed );
+	if( Head - pDump->Tail.load( std::memory_order_acquire ) >= FRAMEDUMP_SLOTS )
+	{
+		pDump->Dropped++;
+		return FALSE;
+	}
+
+	LOCKEDSURFACE32 Locked;
+	if( !pSource->Lock( &Locked, TRUE ) )
+	{
+		pDump->Dropped++;
+		return FALSE;
+	}
+
+	int Slot = Head % FRAMEDUMP_SLOTS;
+	int Width = pDump->Width < pSource->GetWidth() ? pDump->Width : pSource->GetWidth();
+	int Height = pDump->Height < pSource->GetHeight() ? pDump->Height : pSource->GetHeight();
+
+	// A smaller source leaves the rest of the slot as it was
+	for( int y = 0 ; y < Height ; y++ )
+		memcpy( pDump->pSlots[ Slot ] + y * pDump->Width, (BYTE*)Locked.pBits + y * Locked.Pitch, Width * 4 );
+
+	pSource->Unlock();
+
+	pDump->SlotNumber[ Slot ] = Number;
+	pDump->SlotTime[ Slot ] = HrClockToNs( HrClockNow() - pDump->StartTime );
+
+	pDump->Head.store( Head + 1, std::memory_order_release );
+	return TRUE;
+}
+
+// Writes the frames still waiting, stops the writer and closes the file.  Returns FALSE if
+// anything could not be written.
+BOOL StopFrameDump( FRAMEDUMP* pDump )
+{
+	pDump->bStop.store( TRUE, std::memory_order_release );
+	pDump->Writer.join();
+
+	DWORD Footer[ 2 ] = { pDump->Written, pDump->Dropped };
+	if( !FrameDumpWriteChunk( pDump, FRAMEDUMP_END, Footer, sizeof( Footer ), 0, 0 ) )
+		pDump->bFailed = TRUE;
+
+	if( fclose( pDump->pFile ) != 0 )
+		pDump->bFailed = TRUE;
+	pDump->pFile = 0;
+
+	for( int i = 0 ; i < FRAMEDUMP_SLOTS ; i++ )
+	{
+		delete [] pDump->pSlots[ i ];
+		pDump->pSlots[ i ] = 0;
+	}
+	delete [] pDump->pPrevious;
+	delete [] pDump->pCoded;
+	delete [] pDump->pFileBuffer;
+	pDump->pPrevious = 0;
+	pDump->pCoded = 0;
+	pDump->pFileBuffer = 0;
+
+	return !pDump->bFailed;
+}
+
+//====================================================
+// Reading
+//====================================================
+
+struct FRAMEDUMPREADER
+{
+	FILE* pFile;
+	int Width;
+	int Height;
+	DWORD* pFrame;				// The last frame read
+	BYTE* pCoded;
+	DWORD CodedSize;
+
+	DWORD Number;				// Of the last frame read
+	INT64 Time;
+	BOOL bKey;
+};
+
+void CloseFrameDump( FRAMEDUMPREADER* pReader )
+{
+	if( pReader->pFile )
+		fclose( pReader->pFile );
+
+	delete [] pReader->pFrame;
+	delete [] pReader->pCoded;
+	memset( pReader, 0, sizeof( FRAMEDUMPREADER ) );
+}
+
+BOOL OpenFrameDump( FRAMEDUMPREADER* pReader, const char* FileName )
+{
+	memset( pReader, 0, sizeof( FRAMEDUMPREADER ) );
+
+	pReader->pFile = fopen( FileName, "rb" );
+	if( !pReader->pFile )
+		return FALSE;
+
+	DWORD Header[ 5 ];
+	if( fread( Header, sizeof( Header ), 1, pReader->pFile ) != 1 || Header[ 0 ] != FRAMEDUMP_HEADER ||
+		Header[ 1 ] != 12 || Header[ 4 ] != FRAMEDUMP_VERSION || Header[ 2 ] == 0 || Header[ 3 ] == 0 ||
+		Header[ 2 ] > FRAMEDUMP_MAXSIZE || Header[ 3 ] > FRAMEDUMP_MAXSIZE )
+	{
+		CloseFrameDump( pReader );
+		return FALSE;
+	}
+
+	pReader->Width = (int)Header[ 2 ];
+	pReader->Height = (int)Header[ 3 ];
+	pReader->pFrame = new DWORD[ pReader->Width * pReader->Height ];
+	memset( pReader->pFrame, 0, pReader->Width * pReader->Height * 4 );
+	return TRUE;
+}
+
+// Reads the next frame into pReader->pFrame.  Returns FALSE at the end of the file, or if it is damaged.
+BOOL ReadFrameDump( FRAMEDUMPREADER* pReader )
+{
+	DWORD Chunk[ 2 ];
+
+	for( ;; )
+	{
+		if( fread( Chunk, sizeof( Chunk ), 1, pReader->pFile ) != 1 || Chunk[ 0 ] == FRAMEDUMP_END )
+			return FALSE;
+
+		if( Chunk[ 0 ] == FRAMEDUMP_FRAME )
+			break;
+
+		// Skip chunks this version does not know
+		if( fseek( pReader->pFile, Chunk[ 1 ], SEEK_CUR ) != 0 )
+			return FALSE;
+	}
+
+	struct { DWORD Number; DWORD Flags; INT64 Time; } Header;
+	if( Chunk[ 1 ] < sizeof( Header ) || fread( &Header, sizeof( Header ), 1, pReader->pFile ) != 1 )
+		return FALSE;
+
+	DWORD Bytes = Chunk[ 1 ] - sizeof( Header );
+	if( Bytes > pReader->CodedSize )
+	{
+		delete [] pReader->pCoded;
+		pReader->pCoded = new BYTE[ Bytes ];
+		pReader->CodedSize = Bytes;
+	}
+
+	if( Bytes && fread( pReader->pCoded, Bytes, 1, pReader->pFile ) != 1 )
+		return FALSE;
+
+	pReader->Number = Header.Number;
+	pReader->Time = Header.Time;
+	pReader->bKey = ( Header.Flags & FRAMEDUMP_KEYFRAME ) ? TRUE : FALSE;
+
+	return FrameDumpDecode( pReader->pCoded, Bytes, pReader->pFrame, pReader->Width * pReader->Height );
+}
+
+#endif	// FRAMEDUMP_H
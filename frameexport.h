@@ -0,0 +1,371 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Frame export.  With -export the game copies every frame it draws into a
+// ring of slots in named shared memory, where other programs (streaming,
+// bot vision) can map them and read the pixels in place.  Each slot has a
+// sequence number that is odd while the slot is being written, so a reader
+// takes the number, reads the pixels, and checks the number has not changed
+// (a seqlock).  Neither side takes a lock or makes a system call per frame.
+//
+// This header is all a reader needs: OpenFrameExport(), then
+// BeginExportFrame() / EndExportFrame() around each look at a frame.
+//
+// Layout of the shared memory:
+//		FRAMEEXPORTHEADER, padded to FRAMEEXPORT_PAGE
+//		Slots x ( FRAMEEXPORTSLOT, then the pixels ), each SlotBytes long
+// Frame n (counting from 1) goes in slot n % Slots.
+
+#ifndef FRAMEEXPORT_H
+#define FRAMEEXPORT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "platform.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define FRAMEEXPORT_NAME		"UberPongFrames"
+#define FRAMEEXPORT_MAGIC		0x58465055	// 'UPFX'
+#define FRAMEEXPORT_VERSION		1
+#define FRAMEEXPORT_SLOTS		4
+#define FRAMEEXPORT_PAGE		4096
+
+struct FRAMEEXPORTHEADER
+{
+	DWORD Magic;
+	DWORD Version;
+	DWORD Slots;
+	DWORD SlotBytes;
+	DWORD MaxWidth;
+	DWORD MaxHeight;
+	std::atomic<DWORD> Latest;		// Newest frame finished, 0 before the first
+	std::atomic<DWORD> bLive;		// Cleared when the game stops exporting
+};
+
+struct FRAMEEXPORTSLOT
+{
+	std::atomic<DWORD> Sequence;	// Odd while the slot is being written
+	DWORD Frame;
+	DWORD Width;
+	DWORD Height;
+	DWORD Pitch;					// Bytes
+	DWORD Reserved;
+	INT64 Time;						// When it was published, as given to PublishExportFrame()
+	BYTE Padding[ 32 ];				// The pixels start on a cache line
+};
+
+// What BeginExportFrame() hands back.  The pixels are in the shared memory, not a copy.
+struct FRAMEEXPORTVIEW
+{
+	const DWORD* pPixels;
+	int Width;
+	int Height;
+	int Pitch;
+	DWORD Frame;
+	INT64 Time;
+
+	const FRAMEEXPORTSLOT* pSlot;
+	DWORD Sequence;
+};
+
+// Where a mapping of the shared memory is, for both sides
+struct FRAMEEXPORTMAPPING
+{
+	BYTE* pBase;
+	INT64 Size;
+	FRAMEEXPORTHEADER* pHeader;
+
+#ifdef _WIN32
+	HANDLE hMapping;
+#endif
+};
+
+inline FRAMEEXPORTSLOT* GetExportSlot( const FRAMEEXPORTMAPPING* pMapping, DWORD Frame )
+{
+	return (FRAMEEXPORTSLOT*)( pMapping->pBase + FRAMEEXPORT_PAGE + (INT64)( Frame % pMapping->pHeader->Slots ) * pMapping->pHeader->SlotBytes );
+}
+
+void UnmapFrameExport( FRAMEEXPORTMAPPING* pMapping )
+{
+#ifdef _WIN32
+	if( pMapping->pBase )
+		UnmapViewOfFile( pMapping->pBase );
+	if( pMapping->hMapping )
+		CloseHandle( pMapping->hMapping );
+	pMapping->hMapping = 0;
+#else
+	if( pMapping->pBase )
+		munmap( pMapping->pBase, (size_t)pMapping->Size );
+#endif
+
+	pMapping->pBase = 0;
+	pMapping->pHeader = 0;
+	pMapping->Size = 0;
+}
+
+//====================================================
+// Publishing (the game)
+//====================================================
+
+struct FRAMEEXPORT
+{
+	FRAMEEXPORTMAPPING Mapping;
+	char Name[ 64 ];
+	DWORD Frame;				// Frames published
+};
+
+// Makes the shared memory for frames up to Width x Height and clears it.  Returns FALSE if the
+// shared memory cannot be made.
+BOOL StartFrameExport( FRAMEEXPORT* pExport, int Width, int Height, const char* Name = FRAMEEXPORT_NAME )
+{
+	memset( pExport, 0, sizeof( FRAMEEXPORT ) );
+
+	DWORD SlotBytes = ( sizeof( FRAMEEXPORTSLOT ) + Width * Height * 4 + FRAMEEXPORT_PAGE - 1 ) & ~( FRAMEEXPORT_PAGE - 1 );
+	INT64 Size = FRAMEEXPORT_PAGE + (INT64)SlotBytes * FRAMEEXPORT_SLOTS;
+	BYTE* pBase = 0;
+
+#ifdef _WIN32
+	snprintf( pExport->Name, sizeof( pExport->Name ), "Local\\%s", Name );
+
+	// Backed by the paging file, and gone once every process has closed it
+	HANDLE hMapping = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)( Size >> 32 ), (DWORD)Size, pExport->Name );
+	if( !hMapping )
+		return FALSE;
+
+	pBase = (BYTE*)MapViewOfFile( hMapping, FILE_MAP_ALL_ACCESS, 0, 0, 0 );
+	if( !pBase )
+	{
+		CloseHandle( hMapping );
+		return FALSE;
+	}
+
+	pExport->Mapping.hMapping = hMapping;
+#else
+	snprintf( pExport->Name, sizeof( pExport->Name ), "/%s", Name );
+
+	int File = shm_open( pExport->Name, O_CREAT | O_RDWR, 0600 );
+	if( File < 0 )
+		return FALSE;
+
+	if( ftruncate( File, (off_t)Size ) != 0 )
+	{
+		close( File );
+		shm_unlink( pExport->Name );
+		return FALSE;
+	}
+
+	void* pData = mmap( 0, (size_t)Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0 );
+	close( File );
+
+	if( pData == MAP_FAILED )
+	{
+		shm_unlink( pExport->Name );
+		return FALSE;
+	}
+
+	pBase = (BYTE*)pData;
+#endif
+
+	pExport->Mapping.pBase = pBase;
+	pExport->Mapping.Size = Size;
+	pExport->Mapping.pHeader = (FRAMEEXPORTHEADER*)pBase;
+
+	// Readers check the magic number last
+	FRAMEEXPORTHEADER* pHeader = pExport->Mapping.pHeader;
+	memset( pBase, 0, FRAMEEXPORT_PAGE );
+	pHeader->Version = FRAMEEXPORT_VERSION;
+	pHeader->Slots = FRAMEEXPORT_SLOTS;
+	pHeader->SlotBytes = SlotBytes;
+	pHeader->MaxWidth = Width;
+	pHeader->MaxHeight = Height;
+	pHeader->Latest.store( 0 );
+	pHeader->bLive.store( TRUE );
+
+	for( DWORD i = 0 ; i < FRAMEEXPORT_SLOTS ; i++ )
+		memset( (void*)GetExportSlot( &pExport->Mapping, i ), 0, sizeof( FRAMEEXPORTSLOT ) );
+
+	std::atomic_thread_fence( std::memory_order_release );
+	pHeader->Magic = FRAMEEXPORT_MAGIC;
+	return TRUE;
+}
+
+// Copies a frame into the next slot and makes it the latest.  Time is passed on to the readers
+// (the game gives microseconds from HrClockNow(), which every process on the machine shares).
+void PublishExportFrame( FRAMEEXPORT* pExport, const DWORD* pBits, int Pitch, int Width, int Height, INT64 Time )
+{
+	FRAMEEXPORTHEADER* pHeader = pExport->Mapping.pHeader;
+	if( !pHeader )
+		return;
+
+	if( Width > (int)pHeader->MaxWidth )
+		Width = pHeader->MaxWidth;
+	if( Height > (int)pHeader->MaxHeight )
+		Height = pHeader->MaxHeight;
+
+	DWORD Frame = ++pExport->Frame;
+	FRAMEEXPORTSLOT* pSlot = GetExportSlot( &pExport->Mapping, Frame );
+
+	// Odd while the pixels change, so a reader in the middle of them knows to throw them away
+	DWORD Sequence = pSlot->Sequence.load( std::memory_order_relaxed );
+	pSlot->Sequence.store( Sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+
+	pSlot->Frame = Frame;
+	pSlot->Width = Width;
+	pSlot->Height = Height;
+	pSlot->Pitch = Width * 4;
+	pSlot->Time = Time;
+
+	DWORD* pPixels = (DWORD*)( pSlot + 1 );
+	for( int y = 0 ; y < Height ; y++ )
+		memcpy( pPixels + y * Width, (const BYTE*)pBits + y * Pitch, Width * 4 );
+
+	pSlot->Sequence.store( Sequence + 2, std::memory_order_release );
+	pHeader->Latest.store( Frame, std::memory_order_release );
+}
+
+// Tells the readers no more frames are coming and removes the shared memory's name
+void StopFrameExport( FRAMEEXPORT* pExport )
+{
+	if( !pExport->Mapping.pHeader )
+		return;
+
+	pExport->Mapping.pHeader->bLive.store( FALSE, std::memory_order_release );
+	UnmapFrameExport( &pExport->Mapping );
+
+#ifndef _WIN32
+	shm_unlink( pExport->Name );
+#endif
+}
+
+//====================================================
+// Reading (anyone else)
+//====================================================
+
+// Maps the game's frames.  Returns FALSE if the game is not exporting.
+BOOL OpenFrameExport( FRAMEEXPORTMAPPING* pMapping, const char* Name = FRAMEEXPORT_NAME )
+{
+	memset( pMapping, 0, sizeof( FRAMEEXPORTMAPPING ) );
+
+	char FullName[ 64 ];
+	BYTE* pBase = 0;
+	INT64 Size = 0;
+
+#ifdef _WIN32
+	snprintf( FullName, sizeof( FullName ), "Local\\%s", Name );
+
+	HANDLE hMapping = OpenFileMappingA( FILE_MAP_READ, FALSE, FullName );
+	if( !hMapping )
+		return FALSE;
+
+	pBase = (BYTE*)MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !pBase )
+	{
+		CloseHandle( hMapping );
+		return FALSE;
+	}
+
+	// The view is the whole section, which is as big as the header says
+	const FRAMEEXPORTHEADER* pShared = (const FRAMEEXPORTHEADER*)pBase;
+	Size = FRAMEEXPORT_PAGE + (INT64)pShared->Slots * pShared->SlotBytes;
+	pMapping->hMapping = hMapping;
+#else
+	snprintf( FullName, sizeof( FullName ), "/%s", Name );
+
+	int File = shm_open( FullName, O_RDONLY, 0 );
+	if( File < 0 )
+		return FALSE;
+
+	struct stat Stat;
+	if( fstat( File, &Stat ) != 0 || Stat.st_size < FRAMEEXPORT_PAGE )
+	{
+		close( File );
+		return FALSE;
+	}
+
+	void* pData = mmap( 0, (size_t)Stat.st_size, PROT_READ, MAP_SHARED, File, 0 );
+	close( File );
+
+	if( pData == MAP_FAILED )
+		return FALSE;
+
+	pBase = (BYTE*)pData;
+	Size = Stat.st_size;
+#endif
+
+	pMapping->pBase = pBase;
+	pMapping->Size = Size;
+	pMapping->pHeader = (FRAMEEXPORTHEADER*)pBase;
+
+	const FRAMEEXPORTHEADER* pHeader = pMapping->pHeader;
+	BOOL bOk = pHeader->Magic == FRAMEEXPORT_MAGIC;
+	std::atomic_thread_fence( std::memory_order_acquire );
+
+	bOk = bOk && pHeader->Version == FRAMEEXPORT_VERSION && pHeader->Slots > 0 &&
+		  FRAMEEXPORT_PAGE + (INT64)pHeader->Slots * pHeader->SlotBytes <= Size &&
+		  sizeof( FRAMEEXPORTSLOT ) + (INT64)pHeader->MaxWidth * pHeader->MaxHeight * 4 <= pHeader->SlotBytes;
+
+	if( !bOk )
+		UnmapFrameExport( pMapping );
+
+	return bOk;
+}
+
+void CloseFrameExport( FRAMEEXPORTMAPPING* pMapping )
+{
+	UnmapFrameExport( pMapping );
+}
+
+// TRUE while the game is still publishing frames
+inline BOOL IsFrameExportLive( const FRAMEEXPORTMAPPING* pMapping )
+{
+	return pMapping->pHeader->bLive.load( std::memory_order_acquire );
+}
+
+// Looks at the newest frame, if it is newer than frame After.  Returns FALSE if there is no new
+// frame yet.  The view points straight at the shared pixels; check EndExportFrame() once done
+// with them.
+inline BOOL BeginExportFrame( const FRAMEEXPORTMAPPING* pMapping, DWORD After, FRAMEEXPORTVIEW* pView )
+{
+	DWORD Latest = pMapping->pHeader->Latest.load( std::memory_order_acquire );
+	if( Latest == 0 || Latest == After )
+		return FALSE;
+
+	const FRAMEEXPORTSLOT* pSlot = GetExportSlot( pMapping, Latest );
+
+	// Odd means the game has already gone all the way round the ring and is writing it again
+	DWORD Sequence = pSlot->Sequence.load( std::memory_order_acquire );
+	if( Sequence & 1 )
+		return FALSE;
+
+	pView->pPixels = (const DWORD*)( pSlot + 1 );
+	pView->Width = pSlot->Width;
+	pView->Height = pSlot->Height;
+	pView->Pitch = pSlot->Pitch;
+	pView->Frame = pSlot->Frame;
+	pView->Time = pSlot->Time;
+	pView->pSlot = pSlot;
+	pView->Sequence = Sequence;
+
+	return pView->Frame == Latest;
+}
+
+// Returns TRUE if the frame was not touched while it was being read, so whatever was read
+// from it can be trusted
+inline BOOL EndExportFrame( const FRAMEEXPORTVIEW* pView )
+{
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return pView->pSlot->Sequence.load( std::memory_order_relaxed ) == pView->Sequence;
+}
+
+#endif	// FRAMEEXPORT_H
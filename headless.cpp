@@ -0,0 +1,3506 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Headless driver for the parts of the engine that do not need Windows or
+// Direct3D.  Used for benchmarks on the build servers.
+//
+// Build (Linux):
+//		g++ -O2 -pthread -o headless headless.cpp
+//
+// Usage:
+//		headless blit [iterations]		Benchmark the blitters
+//		headless sprite [iterations]	Benchmark span sprites against color keyed blits
+//		headless text [frames]			Benchmark the batched text renderer
+//		headless dirty [frames]			Compare dirty rectangle frames against full redraws
+//		headless compose [frames]		Draw real game frames into memory, dirty rectangles against full redraws
+//		headless hud [frames]			Check the HUD layer draws the same frames as the text batch, and how much less it draws
+//		headless bands [threads] [frames]	Draw 1080p and 4K frames on the band compositor (0 threads tries 1, 2, 4 ... cores)
+//		headless sim [ticks] [rate]		Run bot-vs-bot matches as fast as possible
+//		headless batch [matches] [ticks]	Run many matches at once with the AVX2 kernel
+//		headless collide				Check the ball never tunnels through a paddle, at any tick rate
+//		headless timestep [rate]			Check the fixed timestep gives the same match at any frame rate
+//		headless timers [events]			Check the timer wheel fires every event once, on time
+//		headless histogram [values]		Check the profile histograms against exact percentiles
+//		headless trace [spans]			Time trace spans on and off, and write trace.json from several threads
+//		headless tourney [threads] [games]	Round robin between the bots (0 threads tries 1, 2, 4 ... cores)
+//		headless replay [seconds]		Record a bot match, save it and play it back at full speed
+//		headless play file				Play back a recording made with the game's -record option
+//		headless archive [matches]		Put bot matches in a replay archive, then seek around it and scan it on every core
+//		headless capture [frames]		Capture game frames to capture.ufd on the writer thread, then read them back
+//		headless export [frames] [readers]	Publish game frames to shared memory at 1000 fps and check what the readers see
+//		headless assets [rounds]		Check the bitmap reader, then time loading the game's bitmaps with and without an asset pack
+//		headless pack out.pak files...	Bake bitmaps into an asset pack (the game looks for graphics\assets.pak)
+//		headless resources [rounds]		Check the resource cache shares and frees bitmaps the way the game uses it
+//		headless loader [threads] [extra]	Load the game's bitmaps (and extra full HD ones) in turn, then on background threads
+//		headless input [taps]			Check key presses reach the tick they happened in at any frame rate, from another thread too
+//		headless simthread [seconds]	Run the match on its own thread under a hitching 144 fps renderer, and time key press to present
+
+
+//====================================================
+// Preprocessor Directives
+//====================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "platform.h"
+#include "blit.h"
+#include "sprite.h"
+#include "text.h"
+#include "dirty.h"
+#include "pongsim.h"
+#include "pongbatch.h"
+#include "timestep.h"
+#include "timerwheel.h"
+#include "profile.h"
+#include "pongbot.h"
+#include "tourney.h"
+#include "trace.h"
+#include "surface.h"
+#include "compose.h"
+#include "compositor.h"
+#include "replay.h"
+#include "replayarchive.h"
+#include "mapfile.h"
+#include "framedump.h"
+#include "frameexport.h"
+#include "bmp.h"
+#include "assetpack.h"
+#include "resources.h"
+#include "assetloader.h"
+#include "input.h"
+#include "simthread.h"
+#include <sys/stat.h>
+
+#define MATCH(a, b) (!strcmp( a, b ))
+
+#define COLOR_KEY	0x00FF00FF	// Magenta, same as D3DCOLOR_ARGB( 0, 255, 0, 255 )
+
+// Same layout as graphics\font.bmp
+#define FONT_LETTERW	8
+#define FONT_LETTERH	16
+#define FONT_WIDTH		80
+#define FONT_HEIGHT		160
+
+
+//====================================================
+// Helpers
+//====================================================
+
+// Seconds since the first call
+double Seconds()
+{
+	static std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>( std::chrono::steady_clock::now() - Start ).count();
+}
+
+// Fills a buffer with a round sprite on a color keyed background
+void MakeSprite( DWORD* pData, int Width, int Height, DWORD Color )
+{
+	int cx = Width / 2, cy = Height / 2, r = ( Width < Height ? Width : Height ) / 2;
+
+	for( int y = 0 ; y < Height ; y++ )
+		for( int x = 0 ; x < Width ; x++ )
+			pData[ y * Width + x ] = ( ( x - cx ) * ( x - cx ) + ( y - cy ) * ( y - cy ) <= r * r ) ? Color + x : COLOR_KEY;
+}
+
+
+// Fills a buffer with a stand-in font: a checker pattern on a color keyed background
+void MakeFont( DWORD* pData )
+{
+	for( int y = 0 ; y < FONT_HEIGHT ; y++ )
+		for( int x = 0 ; x < FONT_WIDTH ; x++ )
+			pData[ y * FONT_WIDTH + x ] = ( ( x ^ y ) & 1 ) ? 0x00FFFFFF : COLOR_KEY;
+}
+
+
+//====================================================
+// Blitter Benchmark
+//====================================================
+
+int BenchBlit( int Iterations )
+{
+	const int Width = 640, Height = 480;
+
+	DWORD* pBg = new DWORD[ Width * Height ];
+	DWORD* pDest = new DWORD[ Width * Height ];
+	DWORD* pCheck = new DWORD[ Width * Height ];
+	DWORD* pBall = new DWORD[ 30 * 30 ];
+
+	for( int i = 0 ; i < Width * Height ; i++ )
+		pBg[ i ] = i * 2654435761u;
+	MakeSprite( pBall, 30, 30, 0x00C0C0C0 );
+
+	RECT BgRect = { 0, 0, Width, Height };
+	RECT BallRect = { 0, 0, 30, 30 };
+
+	int Pass = 0;
+	for( int Simd = 0 ; Simd < 2 ; Simd++ )
+	{
+		InitBlitters( Simd != 0 );
+
+		// Full screen copy, the same as the background in Render()
+		double Start = Seconds();
+		for( int i = 0 ; i < Iterations ; i++ )
+		{
+			POINT Origin = { 0, 0 };
+			Blit32( pBg, Width * 4, BgRect, pDest, Width * 4, Width, Height, Origin, FALSE, COLOR_KEY );
+		}
+		double Opaque = Seconds() - Start;
+
+		// Color keyed sprites all over the screen
+		Start = Seconds();
+		for( int i = 0 ; i < Iterations ; i++ )
+		{
+			for( int s = 0 ; s < 64 ; s++ )
+			{
+				POINT Pos = { ( s * 37 + i ) % ( Width - 20 ), ( s * 53 ) % ( Height - 20 ) };
+				Blit32( pBall, 30 * 4, BallRect, pDest, Width * 4, Width, Height, Pos, TRUE, COLOR_KEY );
+			}
+		}
+		double Keyed = Seconds() - Start;
+
+		double Pixels = (double)Iterations * Width * Height;
+		printf( "%-6s opaque: %8.1f Mpix/s   keyed: %8.1f Mpix/s\n", g_BlitterName,
+				Pixels / Opaque / 1e6, Pixels * ( 64.0 * 30 * 30 ) / ( Width * Height ) / Keyed / 1e6 );
+
+		// Every blitter has to produce the same image as the scalar one
+		if( Pass++ == 0 )
+			memcpy( pCheck, pDest, Width * Height * 4 );
+		else if( memcmp( pCheck, pDest, Width * Height * 4 ) )
+			printf( "%s output does not match the scalar blitter!\n", g_BlitterName );
+	}
+
+	delete [] pBg;
+	delete [] pDest;
+	delete [] pCheck;
+	delete [] pBall;
+
+	return 0;
+}
+
+
+//====================================================
+// Span Sprite Benchmark
+//====================================================
+
+int BenchSprite( int Iterations )
+{
+	const int Width = 640, Height = 480;
+
+	DWORD* pKeyed = new DWORD[ Width * Height ];
+	DWORD* pSpans = new DWORD[ Width * Height ];
+	DWORD* pBall = new DWORD[ 30 * 30 ];
+
+	memset( pKeyed, 0, Width * Height * 4 );
+	memset( pSpans, 0, Width * Height * 4 );
+	MakeSprite( pBall, 30, 30, 0x00C0C0C0 );
+
+	InitBlitters( );
+
+	SPANSPRITE Ball;
+	BuildSpanSprite( &Ball, pBall, 30 * 4, 30, 30, COLOR_KEY );
+	printf( "Ball: %d spans, %d of %d pixels opaque\n", Ball.SpanCount, Ball.PixelCount, 30 * 30 );
+
+	RECT BallRect = { 0, 0, 30, 30 };
+
+	// Includes positions hanging off every edge to exercise the clipping
+	double Start = Seconds();
+	for( int i = 0 ; i < Iterations ; i++ )
+	{
+		for( int s = 0 ; s < 64 ; s++ )
+		{
+			POINT Pos = { ( s * 37 + i ) % ( Width + 40 ) - 20, ( s * 53 + i ) % ( Height + 40 ) - 20 };
+			Blit32( pBall, 30 * 4, BallRect, pKeyed, Width * 4, Width, Height, Pos, TRUE, COLOR_KEY );
+		}
+	}
+	double Keyed = Seconds() - Start;
+
+	Start = Seconds();
+	for( int i = 0 ; i < Iterations ; i++ )
+	{
+		for( int s = 0 ; s < 64 ; s++ )
+		{
+			POINT Pos = { ( s * 37 + i ) % ( Width + 40 ) - 20, ( s * 53 + i ) % ( Height + 40 ) - 20 };
+			DrawSpanSprite( &Ball, Pos.x, Pos.y, pSpans, Width * 4, Width, Height );
+		}
+	}
+	double Spans = Seconds() - Start;
+
+	double Sprites = (double)Iterations * 64;
+	printf( "%-6s keyed: %8.2f Msprites/s\n", g_BlitterName, Sprites / Keyed / 1e6 );
+	printf( "Spans  draw:  %8.2f Msprites/s\n", Sprites / Spans / 1e6 );
+
+	if( memcmp( pKeyed, pSpans, Width * Height * 4 ) )
+		printf( "Span sprite output does not match the color keyed blit!\n" );
+
+	FreeSpanSprite( &Ball );
+	delete [] pKeyed;
+	delete [] pSpans;
+	delete [] pBall;
+
+	return 0;
+}
+
+
+//====================================================
+// Text Benchmark
+//====================================================
+
+int BenchText( int Frames )
+{
+	const int Width = 640, Height = 480;
+
+	DWORD* pDest = new DWORD[ Width * Height ];
+	DWORD* pFont = new DWORD[ FONT_WIDTH * FONT_HEIGHT ];
+
+	memset( pDest, 0, Width * Height * 4 );
+	MakeFont( pFont );
+
+	InitBlitters( );
+
+	FONTATLAS Atlas;
+	InitFontAtlas( &Atlas, FONT_WIDTH, FONT_HEIGHT, FONT_LETTERW, FONT_LETTERH );
+
+	static TEXTBATCH Batch;
+
+	// The same strings Render() draws every frame
+	double Start = Seconds();
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		BeginTextBatch( &Batch );
+		AddText( &Batch, 10, 10, "Player 1: 3" );
+		AddText( &Batch, Width - 106, 10, "Player 2: 7" );
+		AddText( &Batch, Width / 2 - 104, 10, "UBER-PONG by Sean Gilleran" );
+		AddText( &Batch, Width - 92, Height - 26, "FPS: " );
+		AddText( &Batch, Width - 42, Height - 26, "999" );
+		AddText( &Batch, 10, Height - 26, "Ball Speed: " );
+		AddText( &Batch, 106, Height - 26, "3" );
+		AddText( &Batch, Width / 2 - 64, Height - 26, "Bounce Count: " );
+		AddText( &Batch, Width / 2 + 48, Height - 26, "42" );
+		AddText( &Batch, Width / 2 - 72, Height / 2 - 18, "PLAYER ONE WINS!!!" );
+		AddText( &Batch, Width / 2 - 88, Height / 2 + 18, "Press Start to Quit..." );
+
+		DrawTextBatchToBuffer( &Batch, &Atlas, pFont, FONT_WIDTH * 4, TRUE, COLOR_KEY, pDest, Width * 4, Width, Height );
+	}
+	double Elapsed = Seconds() - Start;
+
+	printf( "%d strings, %d glyphs per frame\n", Batch.Count, Batch.CharCount );
+	printf( "%.0f text passes/s (%.2f us each)\n", Frames / Elapsed, Elapsed / Frames * 1e6 );
+
+	delete [] pDest;
+	delete [] pFont;
+
+	return 0;
+}
+
+
+//====================================================
+// Dirty Rectangle Check
+//====================================================
+
+int BenchDirty( int Frames )
+{
+	const int Width = 640, Height = 480;
+
+	DWORD* pBg = new DWORD[ Width * Height ];
+	DWORD* pFull = new DWORD[ Width * Height ];
+	DWORD* pDirty = new DWORD[ Width * Height ];
+	DWORD* pBall = new DWORD[ 30 * 30 ];
+	DWORD* pPaddle = new DWORD[ 19 * 79 ];
+	DWORD* pFont = new DWORD[ FONT_WIDTH * FONT_HEIGHT ];
+
+	for( int i = 0 ; i < Width * Height ; i++ )
+		pBg[ i ] = i * 2654435761u;
+	memset( pDirty, 0xCD, Width * Height * 4 );
+	MakeSprite( pBall, 30, 30, 0x00C0C0C0 );
+	MakeSprite( pPaddle, 19, 79, 0x00808080 );
+	MakeFont( pFont );
+
+	InitBlitters( );
+
+	SPANSPRITE Ball, Paddle;
+	BuildSpanSprite( &Ball, pBall, 30 * 4, 30, 30, COLOR_KEY );
+	BuildSpanSprite( &Paddle, pPaddle, 19 * 4, 19, 79, COLOR_KEY );
+
+	FONTATLAS Atlas;
+	InitFontAtlas( &Atlas, FONT_WIDTH, FONT_HEIGHT, FONT_LETTERW, FONT_LETTERH );
+
+	static TEXTBATCH Batch;
+	static DIRTYTRACKER Tracker;
+	InitDirtyTracker( &Tracker, Width, Height );
+
+	RECT BgRect = { 0, 0, Width, Height };
+	POINT Origin = { 0, 0 };
+
+	double Touched = 0;
+	int Mismatches = 0;
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		// Something that moves like a game
+		int BallX = ( i * 3 ) % ( Width - 30 ), BallY = ( i * 2 ) % ( Height - 30 );
+		int Paddle1Y = 100 + ( i % 200 ), Paddle2Y = 300 - ( i % 200 );
+
+		// Now and then more sprites than the tracker has room for, gone again the frame after
+		int Extra = ( i % 50 == 7 ) ? DIRTY_MAXRECTS + 16 : 0;
+
+		char Count[12];
+		sprintf( Count, "%d", i );
+
+		BeginTextBatch( &Batch );
+		AddText( &Batch, 10, 10, "Player 1: 3" );
+		AddText( &Batch, Width / 2 - 104, 10, "UBER-PONG by Sean Gilleran" );
+		AddText( &Batch, Width / 2 + 48, Height - 26, Count );
+
+		// Full redraw
+		Blit32( pBg, Width * 4, BgRect, pFull, Width * 4, Width, Height, Origin, FALSE, 0 );
+		DrawSpanSprite( &Paddle, 15, Paddle1Y, pFull, Width * 4, Width, Height );
+		DrawSpanSprite( &Paddle, Width - 34, Paddle2Y, pFull, Width * 4, Width, Height );
+		DrawSpanSprite( &Ball, BallX, BallY, pFull, Width * 4, Width, Height );
+		for( int e = 0 ; e < Extra ; e++ )
+			DrawSpanSprite( &Ball, ( e * 97 ) % ( Width - 30 ), ( e * 61 ) % ( Height - 30 ), pFull, Width * 4, Width, Height );
+		DrawTextBatchToBuffer( &Batch, &Atlas, pFont, FONT_WIDTH * 4, TRUE, COLOR_KEY, pFull, Width * 4, Width, Height );
+
+		// Dirty rectangles
+		BeginDirtyFrame( &Tracker );
+		TrackDirtyRect( &Tracker, 15, Paddle1Y, Paddle.Width, Paddle.Height );
+		TrackDirtyRect( &Tracker, Width - 34, Paddle2Y, Paddle.Width, Paddle.Height );
+		TrackDirtyRect( &Tracker, BallX, BallY, Ball.Width, Ball.Height );
+		for( int e = 0 ; e < Extra ; e++ )
+			TrackDirtyRect( &Tracker, ( e * 97 ) % ( Width - 30 ), ( e * 61 ) % ( Height - 30 ), Ball.Width, Ball.Height );
+		TrackTextBatch( &Tracker, &Batch, FONT_LETTERW, FONT_LETTERH );
+
+		if( EndDirtyFrame( &Tracker ) )
+			Blit32( pBg, Width * 4, BgRect, pDirty, Width * 4, Width, Height, Origin, FALSE, 0 );
+		else
+			RestoreDirtyRectsToBuffer( &Tracker, pBg, Width * 4, pDirty, Width * 4 );
+
+		DrawSpanSprite( &Paddle, 15, Paddle1Y, pDirty, Width * 4, Width, Height );
+		DrawSpanSprite( &Paddle, Width - 34, Paddle2Y, pDirty, Width * 4, Width, Height );
+		DrawSpanSprite( &Ball, BallX, BallY, pDirty, Width * 4, Width, Height );
+		for( int e = 0 ; e < Extra ; e++ )
+			DrawSpanSprite( &Ball, ( e * 97 ) % ( Width - 30 ), ( e * 61 ) % ( Height - 30 ), pDirty, Width * 4, Width, Height );
+		DrawTextBatchToBuffer( &Batch, &Atlas, pFont, FONT_WIDTH * 4, TRUE, COLOR_KEY, pDirty, Width * 4, Width, Height );
+
+		Touched += Tracker.PixelsTouched;
+
+		if( memcmp( pFull, pDirty, Width * Height * 4 ) )
+			Mismatches++;
+	}
+
+	printf( "Average pixels touched: %.0f of %d (%.1f%%)\n", Touched / Frames, Width * Height, 100.0 * Touched / Frames / ( Width * Height ) );
+	printf( "%d of %d frames differ from a full redraw\n", Mismatches, Frames );
+
+	FreeSpanSprite( &Ball );
+	FreeSpanSprite( &Paddle );
+	delete [] pBg;
+	delete [] pFull;
+	delete [] pDirty;
+	delete [] pBall;
+	delete [] pPaddle;
+	delete [] pFont;
+
+	return Mismatches ? 1 : 0;
+}
+
+
+//====================================================
+// Frame Composition Check
+//====================================================
+
+// Stand-ins for the game's bitmaps, in memory surfaces
+struct GAMEART
+{
+	CMemorySurface32 Background;
+	CMemorySurface32 Font;
+	FONTATLAS Atlas;
+	SPANSPRITE Paddle;
+	SPANSPRITE Ball;
+	HUDLAYER Hud;
+};
+
+void LoadGameArt( GAMEART* pArt, int BgWidth = RES_WIDTH, int BgHeight = RES_HEIGHT )
+{
+	CMemorySurface32 Paddle, Ball;
+
+	pArt->Background.Create( BgWidth, BgHeight );
+	for( int i = 0 ; i < BgWidth * BgHeight ; i++ )
+		pArt->Background.GetBits()[ i ] = i * 2654435761u;
+
+	pArt->Font.Create( FONT_WIDTH, FONT_HEIGHT );
+	MakeFont( pArt->Font.GetBits() );
+	InitFontAtlas( &pArt->Atlas, FONT_WIDTH, FONT_HEIGHT, FONT_LETTERW, FONT_LETTERH );
+
+	Paddle.Create( PADDLE_WIDTH, PADDLE_HEIGHT );
+	MakeSprite( Paddle.GetBits(), PADDLE_WIDTH, PADDLE_HEIGHT, 0x00808080 );
+	SurfaceBuildSpanSprite( &Paddle, COLOR_KEY, &pArt->Paddle );
+
+	Ball.Create( BALL_WIDTH, BALL_HEIGHT );
+	MakeSprite( Ball.GetBits(), BALL_WIDTH, BALL_HEIGHT, 0x00C0C0C0 );
+	SurfaceBuildSpanSprite( &Ball, COLOR_KEY, &pArt->Ball );
+
+	InitGameHud( &pArt->Hud, &pArt->Atlas, &pArt->Font, COLOR_KEY );
+}
+
+void FreeGameArt( GAMEART* pArt )
+{
+	FreeSpanSprite( &pArt->Paddle );
+	FreeSpanSprite( &pArt->Ball );
+	FreeHudLayer( &pArt->Hud );
+}
+
+// Fills in a frame the way Render() does
+void BuildGameFrame( COMPOSEFRAME* pFrame, GAMEART* pArt, TEXTBATCH* pText, const PONGSIM* pPrev, const PONGSIM* pSim, int Alpha, const HUDINFO* pHud )
+{
+	POINT Paddle1, Paddle2, Ball;
+	GetSpritePositions( pPrev, pSim, Alpha, &Paddle1, &Paddle2, &Ball );
+	UpdateGameHud( &pArt->Hud, pSim, pHud );
+	QueueHudText( pText, pSim, pHud, FALSE );
+
+	BeginComposeFrame( pFrame, &pArt->Background, 0x00000019 );
+	AddComposeSprite( pFrame, &pArt->Paddle, Paddle1 );
+	AddComposeSprite( pFrame, &pArt->Paddle, Paddle2 );
+	AddComposeSprite( pFrame, &pArt->Ball, Ball );
+	SetComposeHud( pFrame, &pArt->Hud );
+	SetComposeText( pFrame, pText, &pArt->Atlas, &pArt->Font, COLOR_KEY );
+}
+
+// Draws a frame in full one call at a time, the way Render() used to, with every call locking
+// the surfaces it uses
+void ComposeImmediate( const COMPOSEFRAME* pFrame, ISurface32* pDest )
+{
+	pDest->Clear( pFrame->ClearColor );
+	SurfaceCopy( NULL, pFrame->pBackground, NULL, pDest, FALSE, 0 );
+
+	for( int i = 0 ; i < pFrame->SpriteCount ; i++ )
+		SurfaceDrawSpanSprite( pFrame->Sprites[ i ].pSprite, pFrame->Sprites[ i ].Position, pDest );
+
+	for( int i = 0 ; pFrame->pHud && i < pFrame->pHud->FieldCount ; i++ )
+	{
+		RECT Field;
+		GetHudFieldRect( pFrame->pHud, i, &Field );
+		POINT DestPoint = { Field.left, Field.top };
+		SurfaceCopy( &Field, &pFrame->pHud->Overlay, &DestPoint, pDest, TRUE, pFrame->pHud->ColorKey );
+	}
+
+	SurfaceDrawTextBatch( pFrame->pText, pFrame->pAtlas, pFrame->pFont, TRUE, pFrame->ColorKey, pDest );
+}
+
+// Draws frames over a background that does not reach the edges of the screen, with dirty
+// rectangles and in full.  Returns how many differ.  Anything the ball leaves behind outside
+// the background has to be cleared, not copied.
+int CheckSmallBackground( int Frames )
+{
+	static GAMEART Art;
+	static TEXTBATCH Text;
+	static DIRTYTRACKER DirtyTracker, FullTracker;
+	CMemorySurface32 DirtyBack, FullBack;
+	COMPOSEFRAME Frame;
+
+	LoadGameArt( &Art, RES_WIDTH * 3 / 4, RES_HEIGHT * 3 / 4 );
+	DirtyBack.Create( RES_WIDTH, RES_HEIGHT );
+	FullBack.Create( RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &DirtyTracker, RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &FullTracker, RES_WIDTH, RES_HEIGHT );
+
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	PongSimInit( &Sim, 2 );
+	PongRngSeed( &Rng, 2 );
+
+	int Mismatches = 0;
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		for( int t = 0 ; t < 10 ; t++ )
+		{
+			PrevSim = Sim;
+			PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+			if( Sim.bGameOver )
+				PongSimInit( &Sim, i );
+		}
+
+		HUDINFO Hud = { i, DirtyTracker.PixelsTouched, FALSE, FALSE, 0 };
+		BuildGameFrame( &Frame, &Art, &Text, &PrevSim, &Sim, 32768, &Hud );
+		ComposeFrame( &Frame, &DirtyTracker, &DirtyBack, TRUE );
+		ComposeFrame( &Frame, &FullTracker, &FullBack, FALSE );
+
+		if( memcmp( DirtyBack.GetBits(), FullBack.GetBits(), RES_WIDTH * RES_HEIGHT * 4 ) )
+			Mismatches++;
+	}
+
+	FreeGameArt( &Art );
+	return Mismatches;
+}
+
+// Plays a bot match and draws every frame with the game's own drawing code, with dirty
+// rectangles, in full, and one call at a time, and checks they all come out the same
+int BenchCompose( int Frames )
+{
+	static GAMEART Art;
+	static TEXTBATCH Text;
+	static DIRTYTRACKER DirtyTracker, FullTracker;
+	CMemorySurface32 DirtyBack, FullBack, ImmediateBack;
+	COMPOSEFRAME Frame;
+	DRAWSTATS Stats;
+
+	InitBlitters( );
+	LoadGameArt( &Art );
+	DirtyBack.Create( RES_WIDTH, RES_HEIGHT );
+	FullBack.Create( RES_WIDTH, RES_HEIGHT );
+	ImmediateBack.Create( RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &DirtyTracker, RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &FullTracker, RES_WIDTH, RES_HEIGHT );
+
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	PongSimInit( &Sim, 1 );
+	PongRngSeed( &Rng, 1 );
+
+	double DirtyTime = 0, FullTime = 0, ImmediateTime = 0, Touched = 0;
+	double Commands = 0, Locks = 0, ImmediateLocks = 0;
+	int Mismatches = 0;
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		// Ten ticks a frame, drawn half way through the last one
+		for( int t = 0 ; t < 10 ; t++ )
+		{
+			PrevSim = Sim;
+			PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+			if( Sim.bGameOver )
+				PongSimInit( &Sim, i );
+		}
+
+		HUDINFO Hud = { i, DirtyTracker.PixelsTouched, FALSE, FALSE, 0 };
+		BuildGameFrame( &Frame, &Art, &Text, &PrevSim, &Sim, 32768, &Hud );
+
+		double Start = Seconds();
+		ComposeFrame( &Frame, &DirtyTracker, &DirtyBack, TRUE, &Stats );
+		DirtyTime += Seconds() - Start;
+
+		Touched += DirtyTracker.PixelsTouched;
+		Commands += Stats.Commands;
+		Locks += Stats.Locks;
+		ImmediateLocks += Stats.ImmediateLocks;
+
+		Start = Seconds();
+		ComposeFrame( &Frame, &FullTracker, &FullBack, FALSE );
+		FullTime += Seconds() - Start;
+
+		Start = Seconds();
+		ComposeImmediate( &Frame, &ImmediateBack );
+		ImmediateTime += Seconds() - Start;
+
+		if( memcmp( DirtyBack.GetBits(), FullBack.GetBits(), RES_WIDTH * RES_HEIGHT * 4 ) ||
+			memcmp( ImmediateBack.GetBits(), FullBack.GetBits(), RES_WIDTH * RES_HEIGHT * 4 ) )
+			Mismatches++;
+	}
+
+	printf( "One call at a time: %7.1f us per frame\n", ImmediateTime / Frames * 1e6 );
+	printf( "Full redraw:        %7.1f us per frame\n", FullTime / Frames * 1e6 );
+	printf( "Dirty rectangles:   %7.1f us per frame, %.1f%% of the pixels\n", DirtyTime / Frames * 1e6,
+			100.0 * Touched / Frames / ( RES_WIDTH * RES_HEIGHT ) );
+	printf( "Draw list:          %.1f commands and %.1f locks per frame (%.1f drawn one call at a time)\n",
+			Commands / Frames, Locks / Frames, ImmediateLocks / Frames );
+	printf( "%d of %d frames differ\n", Mismatches, Frames );
+
+	if( SaveSurfaceBMP( &DirtyBack, "compose.bmp" ) )
+		printf( "Last frame saved to compose.bmp\n" );
+
+	FreeGameArt( &Art );
+
+	int SmallMismatches = CheckSmallBackground( Frames / 10 + 1 );
+	printf( "Background smaller than the screen: %d of %d frames differ\n", SmallMismatches, Frames / 10 + 1 );
+
+	return Mismatches || SmallMismatches ? 1 : 0;
+}
+
+
+//====================================================
+// HUD Layer Check
+//====================================================
+
+// Letters in a batch that are actually drawn
+int CountBatchGlyphs( const TEXTBATCH* pBatch, const FONTATLAS* pAtlas )
+{
+	int Glyphs = 0;
+	for( int i = 0 ; i < pBatch->CharCount ; i++ )
+		if( pAtlas->bHasGlyph[ (unsigned char)pBatch->Chars[ i ] ] )
+			Glyphs++;
+
+	return Glyphs;
+}
+
+// Plays a bot match and draws every frame twice with dirty rectangles: once with all of the
+// HUD in the text batch, and once with the HUD layer.  Checks they come out the same and
+// shows how much text each one draws.
+int BenchHud( int Frames )
+{
+	static GAMEART Art;
+	static TEXTBATCH BatchText, LayerText;
+	static DIRTYTRACKER BatchTracker, LayerTracker;
+	CMemorySurface32 BatchBack, LayerBack;
+	COMPOSEFRAME Frame;
+
+	InitBlitters( );
+	LoadGameArt( &Art );
+	BatchBack.Create( RES_WIDTH, RES_HEIGHT );
+	LayerBack.Create( RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &BatchTracker, RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &LayerTracker, RES_WIDTH, RES_HEIGHT );
+
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	PongSimInit( &Sim, 1 );
+	PongRngSeed( &Rng, 1 );
+
+	double BatchTime = 0, LayerTime = 0, BatchTouched = 0, LayerTouched = 0;
+	double BatchGlyphs = 0, LayerCells = 0;
+	int Mismatches = 0;
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		for( int t = 0 ; t < 10 ; t++ )
+		{
+			PrevSim = Sim;
+			PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+			if( Sim.bGameOver )
+				PongSimInit( &Sim, i );
+		}
+
+		// The frame rate goes up by one every frame, so there is always a number to redraw
+		POINT Paddle1, Paddle2, Ball;
+		GetSpritePositions( &PrevSim, &Sim, 32768, &Paddle1, &Paddle2, &Ball );
+		HUDINFO Hud = { i, BatchTracker.PixelsTouched, FALSE, FALSE, 0 };
+
+		// Every string in the batch, the way it was
+		double Start = Seconds();
+		QueueHudText( &BatchText, &Sim, &Hud );
+		BeginComposeFrame( &Frame, &Art.Background, 0x00000019 );
+		AddComposeSprite( &Frame, &Art.Paddle, Paddle1 );
+		AddComposeSprite( &Frame, &Art.Paddle, Paddle2 );
+		AddComposeSprite( &Frame, &Art.Ball, Ball );
+		SetComposeText( &Frame, &BatchText, &Art.Atlas, &Art.Font, COLOR_KEY );
+		ComposeFrame( &Frame, &BatchTracker, &BatchBack, TRUE );
+		BatchTime += Seconds() - Start;
+
+		BatchTouched += BatchTracker.PixelsTouched;
+		BatchGlyphs += CountBatchGlyphs( &BatchText, &Art.Atlas );
+
+		// The labels and numbers from the HUD layer
+		Start = Seconds();
+		UpdateGameHud( &Art.Hud, &Sim, &Hud );
+		QueueHudText( &LayerText, &Sim, &Hud, FALSE );
+		BeginComposeFrame( &Frame, &Art.Background, 0x00000019 );
+		AddComposeSprite( &Frame, &Art.Paddle, Paddle1 );
+		AddComposeSprite( &Frame, &Art.Paddle, Paddle2 );
+		AddComposeSprite( &Frame, &Art.Ball, Ball );
+		SetComposeHud( &Frame, &Art.Hud );
+		SetComposeText( &Frame, &LayerText, &Art.Atlas, &Art.Font, COLOR_KEY );
+		ComposeFrame( &Frame, &LayerTracker, &LayerBack, TRUE );
+		LayerTime += Seconds() - Start;
+
+		LayerTouched += LayerTracker.PixelsTouched;
+		LayerCells += Art.Hud.CellsDrawn;
+
+		if( memcmp( BatchBack.GetBits(), LayerBack.GetBits(), RES_WIDTH * RES_HEIGHT * 4 ) )
+			Mismatches++;
+	}
+
+	printf( "Text batch: %5.1f letters drawn, %6.1f us and %4.1f%% of the pixels per frame\n", BatchGlyphs / Frames,
+			BatchTime / Frames * 1e6, 100.0 * BatchTouched / Frames / ( RES_WIDTH * RES_HEIGHT ) );
+	printf( "HUD layer:  %5.1f letters drawn, %6.1f us and %4.1f%% of the pixels per frame\n", LayerCells / Frames,
+			LayerTime / Frames * 1e6, 100.0 * LayerTouched / Frames / ( RES_WIDTH * RES_HEIGHT ) );
+	printf( "%d of %d frames differ\n", Mismatches, Frames );
+
+	FreeGameArt( &Art );
+	return Mismatches ? 1 : 0;
+}
+
+
+//====================================================
+// Band Compositor Benchmark
+//====================================================
+
+// Draws Frames full redraws of a Width x Height frame with the compositor and checks each
+// against ComposeFrame() on one thread.  Returns the seconds per frame, or 0 if any differ.
+double RunBands( BANDCOMPOSITOR* pCompositor, GAMEART* pArt, int Width, int Height, int Frames )
+{
+	static TEXTBATCH Text;
+	static DIRTYTRACKER Tracker, CheckTracker;
+	CMemorySurface32 Back, Check;
+	COMPOSEFRAME Frame;
+
+	Back.Create( Width, Height );
+	Check.Create( Width, Height );
+	InitDirtyTracker( &Tracker, Width, Height );
+	InitDirtyTracker( &CheckTracker, Width, Height );
+
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	PongSimInit( &Sim, 1 );
+	PongRngSeed( &Rng, 1 );
+
+	double Elapsed = 0;
+	BOOL bSame = TRUE;
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		PrevSim = Sim;
+		PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+
+		HUDINFO Hud = { i, Tracker.PixelsTouched, FALSE, TRUE, 0 };
+		BuildGameFrame( &Frame, pArt, &Text, &PrevSim, &Sim, 32768, &Hud );
+
+		double Start = Seconds();
+		ComposeFrameBands( pCompositor, &Frame, &Tracker, &Back, FALSE );
+		Elapsed += Seconds() - Start;
+
+		// Only check some of the frames, the single threaded version is the slow part
+		if( ( i & 7 ) == 0 )
+		{
+			ComposeFrame( &Frame, &CheckTracker, &Check, FALSE );
+			if( memcmp( Back.GetBits(), Check.GetBits(), Width * Height * 4 ) )
+				bSame = FALSE;
+		}
+	}
+
+	return bSame ? Elapsed / Frames : 0;
+}
+
+int BenchBands( int Threads, int Frames )
+{
+	static GAMEART Art;
+	static BANDCOMPOSITOR Compositor;
+	int Sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+
+	InitBlitters( );
+
+	int Cores = (int)std::thread::hardware_concurrency();
+	if( Cores < 1 )
+		Cores = 1;
+
+	for( int s = 0 ; s < 2 ; s++ )
+	{
+		int Width = Sizes[ s ][ 0 ], Height = Sizes[ s ][ 1 ];
+		LoadGameArt( &Art, Width, Height );
+
+		// One run with the threads asked for, or a sweep up to the core count
+		int First = Threads > 0 ? Threads : 1;
+		int Last = Threads > 0 ? Threads : Cores;
+
+		double Single = 0;
+		for( int t = First ; t < Last * 2 ; t *= 2 )
+		{
+			if( t > Last )
+				t = Last;
+
+			InitBandCompositor( &Compositor, t );
+			double Time = RunBands( &Compositor, &Art, Width, Height, Frames );
+			ShutdownBandCompositor( &Compositor );
+
+			if( Time == 0 )
+			{
+				printf( "%dx%d with %d threads differs from ComposeFrame()!\n", Width, Height, t );
+				return 1;
+			}
+
+			if( Single == 0 )
+				Single = Time;
+
+			printf( "%dx%d %3d threads: %7.2f ms per frame, %.2fx one thread\n", Width, Height, t, Time * 1000, Single / Time );
+		}
+
+		FreeGameArt( &Art );
+	}
+
+	return 0;
+}
+
+
+//====================================================
+// Simulation Benchmark
+//====================================================
+
+// A simple bot: keep the middle of the paddle level with the middle of the ball
+unsigned int TrackBall( const PONGSIM* pSim, int PaddleY, unsigned int Up, unsigned int Down )
+{
+	int Ball = pSim->BallY + ( ( BALL_HEIGHT / 2 ) << PONGSIM_SHIFT );
+	int Paddle = PaddleY + ( ( PADDLE_HEIGHT / 2 ) << PONGSIM_SHIFT );
+
+	if( Ball < Paddle - pSim->PaddleStep )
+		return Up;
+	if( Ball > Paddle + pSim->PaddleStep )
+		return Down;
+
+	return 0;
+}
+
+int BenchSim( int Ticks, int TickRate )
+{
+	PONGSIM Sim;
+	DWORD Seed = 1;
+	int Matches = 0;
+	DWORD Hash = 0;
+
+	PongSimInit( &Sim, Seed, TickRate );
+
+	double Start = Seconds();
+	for( int i = 0 ; i < Ticks ; i++ )
+	{
+		// Player two is lazy so somebody eventually wins
+		unsigned int Input = TrackBall( &Sim, Sim.Paddle1Y, PONGINPUT_P1_UP, PONGINPUT_P1_DOWN );
+		if( ( i & 3 ) == 0 )
+			Input |= TrackBall( &Sim, Sim.Paddle2Y, PONGINPUT_P2_UP, PONGINPUT_P2_DOWN );
+
+		// Play at top speed
+		Input |= PONGINPUT_SPEED5;
+
+		if( PongSimStep( &Sim, Input ) & PONGEVENT_GAMEOVER )
+		{
+			Hash ^= PongSimHash( &Sim );
+			Matches++;
+			PongSimInit( &Sim, ++Seed, TickRate );
+		}
+	}
+	double Elapsed = Seconds() - Start;
+
+	Hash ^= PongSimHash( &Sim );
+
+	printf( "%d ticks at %d Hz, %d matches finished\n", Ticks, Sim.TickRate, Matches );
+	printf( "%.1f million ticks/s, state hash %08X\n", Ticks / Elapsed / 1e6, Hash );
+
+	return 0;
+}
+
+
+//====================================================
+// Batch Simulation Benchmark
+//====================================================
+
+// The TrackBall() bots for every match in a batch, written so the compiler can vectorize it
+void TrackBallBatch( const PONGBATCH* pBatch, unsigned int* pInputs, int Tick )
+{
+	const int Step = pBatch->PaddleStep;
+	const int BallMid = ( BALL_HEIGHT / 2 ) << PONGSIM_SHIFT;
+	const int PaddleMid = ( PADDLE_HEIGHT / 2 ) << PONGSIM_SHIFT;
+
+	for( int i = 0 ; i < pBatch->Padded ; i++ )
+	{
+		int Ball = pBatch->pBallY[ i ] + BallMid;
+		int Paddle1 = pBatch->pPaddle1Y[ i ] + PaddleMid;
+		int Paddle2 = pBatch->pPaddle2Y[ i ] + PaddleMid;
+
+		unsigned int Input = PONGINPUT_SPEED5;
+		Input |= ( Ball < Paddle1 - Step ) ? PONGINPUT_P1_UP : 0;
+		Input |= ( Ball > Paddle1 + Step ) ? PONGINPUT_P1_DOWN : 0;
+
+		// Player two is lazy, differently in each match
+		if( ( ( Tick + i ) & 3 ) == 0 )
+		{
+			Input |= ( Ball < Paddle2 - Step ) ? PONGINPUT_P2_UP : 0;
+			Input |= ( Ball > Paddle2 + Step ) ? PONGINPUT_P2_DOWN : 0;
+		}
+
+		pInputs[ i ] = Input;
+	}
+}
+
+// Plays the batch for a number of ticks, starting a new match in any slot whose match ends
+DWORD RunBatch( PONGBATCH* pBatch, int Ticks, int* pFinished )
+{
+	unsigned int* pInputs = new unsigned int[ pBatch->Padded ];
+	int* pEvents = new int[ pBatch->Padded ];
+	DWORD Hash = 0;
+	DWORD Seed = 1000000;
+
+	for( int t = 0 ; t < Ticks ; t++ )
+	{
+		TrackBallBatch( pBatch, pInputs, t );
+		PongBatchStep( pBatch, pInputs, pEvents );
+
+		for( int i = 0 ; i < pBatch->Count ; i++ )
+		{
+			if( pEvents[ i ] & PONGEVENT_GAMEOVER )
+			{
+				PONGSIM Sim;
+				PongBatchGet( pBatch, i, &Sim );
+				Hash = Hash * 31 + PongSimHash( &Sim );
+				PongBatchResetMatch( pBatch, i, Seed++ );
+				( *pFinished )++;
+			}
+		}
+	}
+
+	delete [] pInputs;
+	delete [] pEvents;
+
+	return Hash;
+}
+
+int BenchBatch( int Matches, int Ticks )
+{
+	PONGBATCH Batch;
+	DWORD Hash[2];
+	double Elapsed[2];
+	int Finished[2] = { 0, 0 };
+
+	// Scalar first, then AVX2, from the same starting point
+	for( int Simd = 0 ; Simd < 2 ; Simd++ )
+	{
+		InitPongBatch( Simd != 0 );
+		PongBatchInit( &Batch, Matches, 1 );
+
+		double Start = Seconds();
+		Hash[ Simd ] = RunBatch( &Batch, Ticks, &Finished[ Simd ] );
+		Elapsed[ Simd ] = Seconds() - Start;
+
+		for( int i = 0 ; i < Batch.Count ; i++ )
+		{
+			PONGSIM Sim;
+			PongBatchGet( &Batch, i, &Sim );
+			Hash[ Simd ] = Hash[ Simd ] * 31 + PongSimHash( &Sim );
+		}
+
+		PongBatchFree( &Batch );
+
+		printf( "%-6s %d matches x %d ticks: %.1f million match-ticks/s, %d finished, hash %08X\n",
+				Simd ? "AVX2" : "Scalar", Matches, Ticks, (double)Matches * Ticks / Elapsed[ Simd ] / 1e6, Finished[ Simd ], Hash[ Simd ] );
+
+		if( Simd && !CpuHasAVX2() )
+			printf( "(no AVX2 on this CPU, both runs were scalar)\n" );
+	}
+
+	if( Hash[0] != Hash[1] )
+	{
+		printf( "AVX2 results do not match PongSimStep()!\n" );
+		return 1;
+	}
+
+	return 0;
+}
+
+
+//====================================================
+// Collision Check
+//====================================================
+
+// Plays Seconds of game time at top speed.  With bPerfect the paddles are put in line with the
+// ball before every tick, so nothing should ever get past them.  Returns the goals scored and
+// the number of ticks that left the ball outside the court.
+int RunCollide( int TickRate, int Seconds, BOOL bPerfect, PONGSIM* pSim, int* pOutside )
+{
+	PongSimInit( pSim, 7, TickRate );
+	*pOutside = 0;
+
+	int Goals = 0;
+	int Ticks = Seconds * TickRate;
+
+	for( int i = 0 ; i < Ticks ; i++ )
+	{
+		if( bPerfect )
+		{
+			int y = pSim->BallY + ( BALL_HEIGHT - PADDLE_HEIGHT ) * PONGSIM_ONE / 2;
+			pSim->Paddle1Y = pSim->Paddle2Y = y;
+			PongSimMovePaddle( pSim, &pSim->Paddle1Y, FALSE, FALSE );
+			PongSimMovePaddle( pSim, &pSim->Paddle2Y, FALSE, FALSE );
+		}
+
+		if( PongSimStep( pSim, PONGINPUT_SPEED5 ) & PONGEVENT_SCORED )
+			Goals++;
+
+		// Keep scoring forever
+		pSim->p1Score = pSim->p2Score = 0;
+
+		if( pSim->BallX < 0 || pSim->BallX > ( ( RES_WIDTH - BALL_WIDTH ) << PONGSIM_SHIFT ) ||
+			pSim->BallY < 0 || pSim->BallY > ( ( RES_HEIGHT - BALL_HEIGHT ) << PONGSIM_SHIFT ) )
+			( *pOutside )++;
+	}
+
+	return Goals;
+}
+
+int BenchCollide()
+{
+	// At 10 Hz the ball moves 50 pixels a tick, more than a paddle and a ball put together.
+	// The first rate is the reference path, so it must divide PONGSIM_BASE_RATE exactly.
+	int Rates[] = { 100, 50, 20, 10, 5, 1000 };
+	int Failed = 0;
+	int FirstX = 0, FirstY = 0;
+
+	for( int r = 0 ; r < (int)( sizeof( Rates ) / sizeof( Rates[0] ) ) ; r++ )
+	{
+		PONGSIM Sim;
+		int Outside[2];
+
+		int Missed = RunCollide( Rates[ r ], 600, TRUE, &Sim, &Outside[0] );
+		int Bounces = Sim.BounceCount;
+
+		// Paddles lined up at the start of a tick can only promise a return if the ball cannot
+		// move further than half a paddle and ball vertically in one tick
+		int Travel = BALL_MAXSPEED * BALL_SPEED * PONGSIM_BASE_RATE / Rates[ r ];
+		BOOL bMustReturn = Travel <= ( PADDLE_HEIGHT + BALL_HEIGHT ) / 2;
+
+		// With the paddles still the path is pure reflection, so it should not depend on the tick rate
+		int Goals = RunCollide( Rates[ r ], 600, FALSE, &Sim, &Outside[1] );
+		if( r == 0 )
+		{
+			FirstX = Sim.BallX;
+			FirstY = Sim.BallY;
+		}
+
+		BOOL bSamePath = ( PONGSIM_BASE_RATE % Rates[ r ] ) != 0 || ( Sim.BallX == FirstX && Sim.BallY == FirstY );
+		BOOL bOk = ( Missed == 0 || !bMustReturn ) && Outside[0] == 0 && Outside[1] == 0 && bSamePath;
+
+		printf( "%4d Hz: perfect paddles %d hits %d missed%s, still paddles %d goals, ball ends at (%d, %d) %s\n",
+				Rates[ r ], Bounces, Missed, bMustReturn ? "" : " (ball outruns them)", Goals, PongSimPixels( Sim.BallX ), PongSimPixels( Sim.BallY ), bOk ? "" : "FAILED" );
+		if( !bOk )
+			Failed++;
+	}
+
+	return Failed ? 1 : 0;
+}
+
+
+//====================================================
+// Fixed Timestep Check
+//====================================================
+
+// Plays Seconds worth of ticks through the fixed timestep scheduler, with frames that take
+// FrameTime clock counts each (plus up to Jitter more).  A Stall of that many counts happens
+// half way through.  Returns the hash of the final state and how long it took in *pTime.
+DWORD RunTimestep( int TickRate, INT64 Frequency, int Seconds, INT64 FrameTime, INT64 Jitter, INT64 Stall,
+				   FIXEDSTEP* pStep, INT64* pTime )
+{
+	PONGSIM Sim;
+	PongSimInit( &Sim, 1, TickRate );
+	FixedStepInit( pStep, Frequency, TickRate );
+
+	PONGRNG Rng;
+	PongRngSeed( &Rng, 1 );
+
+	const DWORD Total = (DWORD)Seconds * TickRate;
+	INT64 Now = 1;
+	FixedStepReset( pStep, Now );
+
+	while( Sim.Tick < Total )
+	{
+		Now += FrameTime + ( Jitter ? PongRngNext( &Rng ) % Jitter : 0 );
+		if( Stall && Sim.Tick >= Total / 2 )
+		{
+			Now += Stall;
+			Stall = 0;
+		}
+
+		int Ticks = FixedStepAdvance( pStep, Now );
+		for( int i = 0 ; i < Ticks && Sim.Tick < Total ; i++ )
+		{
+			unsigned int Input = PongBotTracker( &Sim, 1, 0 ) | PongBotPredictor( &Sim, 2, 0 ) | PONGINPUT_SPEED3;
+			PongSimStep( &Sim, Input );
+		}
+
+		FixedStepRenderDue( pStep, Now );
+	}
+
+	*pTime = Now - 1;
+	return PongSimHash( &Sim );
+}
+
+int BenchTimestep( int TickRate )
+{
+	const INT64 Frequency = 10000000;	// A typical QueryPerformanceFrequency()
+	const int Seconds = 60;
+	int Failed = 0;
+
+	struct
+	{
+		const char* Name;
+		INT64 FrameTime;
+		INT64 Jitter;
+	} Tests[] =
+	{
+		{ "30 fps",				Frequency / 30,		0 },
+		{ "60 fps",				Frequency / 60,		0 },
+		{ "144 fps",			Frequency / 144,	0 },
+		{ "1000 fps",			Frequency / 1000,	0 },
+		{ "uncapped (jitter)",	1000,				20000 },
+		{ "12 fps (jitter)",	Frequency / 15,		Frequency / 30 },
+	};
+
+	DWORD Expected = 0;
+	FIXEDSTEP Step;
+	INT64 Time;
+
+	for( int t = 0 ; t < (int)( sizeof( Tests ) / sizeof( Tests[0] ) ) ; t++ )
+	{
+		DWORD Hash = RunTimestep( TickRate, Frequency, Seconds, Tests[ t ].FrameTime, Tests[ t ].Jitter, 0, &Step, &Time );
+		if( t == 0 )
+			Expected = Hash;
+
+		// Same match, and it took the same game time give or take a frame
+		INT64 Late = Time - Seconds * Frequency;
+		BOOL bOk = ( Hash == Expected ) && Step.DroppedTicks == 0 && Late >= 0 && Late <= Tests[ t ].FrameTime + Tests[ t ].Jitter;
+
+		printf( "%-18s %u frames, %.2fs, hash %08X %s\n", Tests[ t ].Name, Step.Frames,
+				(double)Time / Frequency, Hash, bOk ? "" : "MISMATCH" );
+		if( !bOk )
+			Failed++;
+	}
+
+	// After a two second stall only the clamped amount is caught up on
+	RunTimestep( TickRate, Frequency, Seconds, Frequency / 60, 0, 2 * Frequency, &Step, &Time );
+	printf( "2s stall           %.2fs, %u ticks dropped\n", (double)Time / Frequency, Step.DroppedTicks );
+	if( Step.DroppedTicks == 0 )
+		Failed++;
+
+	return Failed ? 1 : 0;
+}
+
+
+//====================================================
+// Timer Wheel Check
+//====================================================
+
+// Posts events with random delays (some many turns of the wheel away), polls at random
+// intervals, and checks every event fires exactly once, never early, and at the first
+// poll after it was due.  The clock starts just before it wraps round.
+int BenchTimers( int Events )
+{
+	TIMERWHEEL Wheel;
+	TIMEREVENT Fired[ TIMERWHEEL_MAXEVENTS ];
+	PONGRNG Rng;
+
+	DWORD Now = 0xFFFFFFFF - 5000;
+	InitTimerWheel( &Wheel, Now );
+	PongRngSeed( &Rng, 1 );
+
+	DWORD* pDue = new DWORD[ Events ];
+	BOOL* pDone = new BOOL[ Events ];
+	int Posted = 0, Done = 0, Errors = 0, Cancelled = 0;
+
+	double Start = Seconds();
+	while( Done + Cancelled < Events )
+	{
+		// Post a few
+		while( Posted < Events && Wheel.Count < TIMERWHEEL_MAXEVENTS && ( PongRngNext( &Rng ) & 1 ) )
+		{
+			DWORD r = PongRngNext( &Rng );
+			DWORD Delay = ( r & 7 ) == 0 ? r % 3000 : r % 40;
+			if( Delay == 0 )
+				Delay = 1;
+
+			PostTimerEvent( &Wheel, Delay, Posted, 0 );
+			pDue[ Posted ] = Now + Delay;
+			pDone[ Posted ] = FALSE;
+			Posted++;
+		}
+
+		// Now and then cancel the newest one
+		if( Posted > 0 && !pDone[ Posted - 1 ] && PongRngNext( &Rng ) % 50 == 0 )
+		{
+			if( CancelTimerEvents( &Wheel, Posted - 1 ) == 1 )
+			{
+				pDone[ Posted - 1 ] = TRUE;
+				Cancelled++;
+			}
+		}
+
+		// Check the wheel knows when the next one is due
+		DWORD NextDue = TimerWheelNextDue( &Wheel );
+
+		// Move the clock on, sometimes a long way
+		DWORD Last = Now;
+		DWORD r = PongRngNext( &Rng );
+		Now += ( r & 63 ) == 0 ? r % 1000 : r % 4;
+
+		// And how long there is to sleep from the new time
+		DWORD Wait = TimerWheelWaitTime( &Wheel, Now );
+
+		int Count = PollTimerWheel( &Wheel, Now, Fired );
+		if( NextDue != TIMERWHEEL_NONE && ( Count > 0 ) != ( Wait == 0 ) )
+			Errors++;
+		if( Count == 0 && Wait != ( NextDue == TIMERWHEEL_NONE ? TIMERWHEEL_NONE : NextDue - ( Now - Last ) ) )
+			Errors++;
+		for( int i = 0 ; i < Count ; i++ )
+		{
+			int e = Fired[ i ].Type;
+			BOOL bOnTime = (int)( Now - pDue[ e ] ) >= 0 && (int)( Last - pDue[ e ] ) < 0;
+			BOOL bInOrder = i == 0 || (int)( Fired[ i ].Due - Fired[ i - 1 ].Due ) >= 0;
+
+			if( pDone[ e ] || !bOnTime || !bInOrder )
+				Errors++;
+
+			if( i == 0 && NextDue != Fired[ 0 ].Due - Last )
+				Errors++;
+
+			pDone[ e ] = TRUE;
+			Done++;
+		}
+
+		// Anything due should have gone
+		for( int i = 0 ; i < TIMERWHEEL_MAXEVENTS ; i++ )
+		{
+			if( Wheel.Events[ i ].bActive && (int)( Now - Wheel.Events[ i ].Due ) >= 0 )
+				Errors++;
+		}
+	}
+	double Elapsed = Seconds() - Start;
+
+	printf( "%d events fired, %d cancelled, %d errors, clock ended at %u (%.1f million events/s)\n",
+			Done, Cancelled, Errors, Now, Events / Elapsed / 1e6 );
+
+	delete [] pDue;
+	delete [] pDone;
+
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Histogram Check
+//====================================================
+
+int CompareDWORD( const void* a, const void* b )
+{
+	DWORD x = *(const DWORD*)a, y = *(const DWORD*)b;
+	return x < y ? -1 : ( x > y ? 1 : 0 );
+}
+
+// Records frame-time-like values (mostly a few ms, with rare long spikes) and checks every
+// percentile is within one bucket (1/16) above the exact answer and never below it
+int BenchHistogram( int Values )
+{
+	static HISTOGRAM Histogram;
+	DWORD* pValues = new DWORD[ Values ];
+	PONGRNG Rng;
+	int Errors = 0;
+
+	ClearHistogram( &Histogram );
+	PongRngSeed( &Rng, 1 );
+
+	double Start = Seconds();
+	for( int i = 0 ; i < Values ; i++ )
+	{
+		DWORD r = PongRngNext( &Rng );
+		pValues[ i ] = ( r % 1000 ) == 0 ? 16000000 + r % 200000000 : 2000000 + r % 3000000;
+		if( ( r & 0xFFFF ) == 1 )
+			pValues[ i ] = r & 15;		// A few tiny ones for the exact buckets
+		RecordHistogram( &Histogram, pValues[ i ] );
+	}
+	double Elapsed = Seconds() - Start;
+
+	qsort( pValues, Values, sizeof( DWORD ), CompareDWORD );
+
+	double Fractions[] = { 0.0, 0.5, 0.9, 0.99, 0.999, 0.9999, 1.0 };
+	for( int f = 0 ; f < (int)( sizeof( Fractions ) / sizeof( Fractions[0] ) ) ; f++ )
+	{
+		int Rank = (int)( Fractions[ f ] * Values + 0.999999 );
+		if( Rank < 1 )
+			Rank = 1;
+		DWORD Exact = pValues[ Rank - 1 ];
+		DWORD Found = HistogramPercentile( &Histogram, Fractions[ f ] );
+
+		BOOL bOk = Found >= Exact && Found - Exact <= Exact / HISTOGRAM_SUBBUCKETS;
+		printf( "p%-7g exact %10.1f us, histogram %10.1f us %s\n", Fractions[ f ] * 100, Exact / 1000.0, Found / 1000.0, bOk ? "" : "WRONG" );
+		if( !bOk )
+			Errors++;
+	}
+
+	if( Histogram.Max.load() != pValues[ Values - 1 ] || Histogram.Count.load() != (DWORD)Values )
+		Errors++;
+
+	printf( "%.1f ns per value recorded\n", Elapsed / Values * 1e9 );
+
+	delete [] pValues;
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Trace Check
+//====================================================
+
+// Something cheap for the spans to wrap, so the compiler cannot throw the loop away
+volatile DWORD g_TraceWork = 0;
+
+void TraceSpans( int Spans )
+{
+	for( int i = 0 ; i < Spans ; i++ )
+	{
+		TRACE_SCOPE( "Span" );
+		g_TraceWork = g_TraceWork + 1;
+	}
+}
+
+// Plays bot matches on a worker thread with every tick traced, like the game loop does
+void TraceWorker( int Index, int Ticks )
+{
+	char Name[ 32 ];
+	snprintf( Name, sizeof( Name ), "Worker %d", Index );
+	TraceNameThread( Name );
+
+	PONGSIM Sim;
+	PONGRNG Rng;
+	DWORD Seed = PongRngDerive( 1, Index );
+	PongSimInit( &Sim, Seed );
+	PongRngSeed( &Rng, Seed );
+
+	for( int i = 0 ; i < Ticks ; i++ )
+	{
+		TRACE_SCOPE( "PongSimStep" );
+		PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+		if( Sim.bGameOver )
+			PongSimInit( &Sim, ++Seed );
+	}
+}
+
+// Counts the spans in a ring from the current trace, and checks that spans on one thread
+// finish in order and never end before they start
+int CheckTraceRing( const TRACERING* pRing, int* pErrors )
+{
+	DWORD Head = pRing->Head.load();
+	DWORD First = Head > TRACE_RINGSIZE ? Head - TRACE_RINGSIZE : 0;
+	const TRACEEVENT* pLast = 0;
+	int Kept = 0;
+
+	for( DWORD i = First ; i < Head ; i++ )
+	{
+		const TRACEEVENT* pEvent = &pRing->Events[ i & ( TRACE_RINGSIZE - 1 ) ];
+		if( pEvent->Start < g_TraceStart )
+			continue;
+
+		if( pEvent->End < pEvent->Start || ( pLast && pEvent->End < pLast->End ) )
+		{
+			(*pErrors)++;
+			break;
+		}
+
+		pLast = pEvent;
+		Kept++;
+	}
+
+	printf( "%-10s %8u spans, %6d kept\n", pRing->ThreadName, Head, Kept );
+	return Kept;
+}
+
+// Times a span with tracing off and on, then traces a few threads and checks every ring
+// holds the newest events in order.  A second batch of threads must reuse the first
+// batch's rings rather than make new ones.
+int BenchTrace( int Spans )
+{
+	int Errors = 0;
+
+	TraceNameThread( "Main" );
+
+	double Start = Seconds();
+	TraceSpans( Spans );
+	double Off = Seconds() - Start;
+
+	// Nothing is allocated until tracing starts
+	if( g_TraceRingCount.load() != 0 )
+		Errors++;
+
+	StartTrace();
+	Start = Seconds();
+	TraceSpans( Spans );
+	double On = Seconds() - Start;
+	StopTrace();
+
+	printf( "Tracing off: %.2f ns per span\n", Off / Spans * 1e9 );
+	printf( "Tracing on:  %.2f ns per span\n", On / Spans * 1e9 );
+
+	// The main ring went round many times, so only the last TRACE_RINGSIZE spans are left
+	TRACERING* pMain = TraceThreadRing();
+	if( pMain->Head.load() != (DWORD)Spans || strcmp( pMain->ThreadName, "Main" ) )
+		Errors++;
+
+	// Nested spans from several threads, one of which wraps, twice over
+	for( int Pass = 0 ; Pass < 2 ; Pass++ )
+	{
+		StartTrace();
+		{
+			TRACE_SCOPE( "BenchTrace" );
+
+			std::thread Workers[ 3 ];
+			for( int t = 0 ; t < 3 ; t++ )
+				Workers[ t ] = std::thread( TraceWorker, t, t == 0 ? TRACE_RINGSIZE * 2 : 20000 );
+			for( int t = 0 ; t < 3 ; t++ )
+				Workers[ t ].join();
+		}
+		StopTrace();
+
+		printf( "Pass %d:\n", Pass + 1 );
+		int Rings = g_TraceRingCount.load();
+		for( int t = 0 ; t < Rings ; t++ )
+		{
+			int Kept = CheckTraceRing( g_pTraceRings[ t ].load(), &Errors );
+
+			// Only the BenchTrace span is left on the main thread from this trace
+			if( t == 0 && Kept != 1 )
+				Errors++;
+		}
+
+		if( Rings != 4 )
+			Errors++;
+	}
+
+	Start = Seconds();
+	if( !WriteTraceJSON( "trace.json" ) )
+		Errors++;
+	printf( "Wrote trace.json in %.1f ms\n", ( Seconds() - Start ) * 1000 );
+
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Tournament
+//====================================================
+
+// Runs one tournament and prints how fast it went.  Returns the combined match hash.
+DWORD RunTourney( int Threads, int Games, BOOL bStandings, double* pElapsed )
+{
+	TOURNEYSETTINGS Settings;
+	TOURNEYSTANDING Standings[ sizeof( g_PongBots ) / sizeof( g_PongBots[0] ) ];
+	TOURNEYSTATS Stats;
+
+	DefaultTourneySettings( &Settings );
+	Settings.Threads = Threads;
+	Settings.GamesPerPairing = Games;
+
+	double Start = Seconds();
+	RunTournament( g_PongBots, g_PongBotCount, &Settings, Standings, &Stats );
+	*pElapsed = Seconds() - Start;
+
+	int Stolen = 0;
+	for( int t = 0 ; t < Stats.Threads ; t++ )
+		Stolen += Stats.Stolen[ t ];
+
+	printf( "%3d threads: %d matches in %.2fs, %.0f matches/s, %.1f million ticks/s, %d stolen, hash %08X\n",
+			Stats.Threads, Stats.Matches, *pElapsed, Stats.Matches / *pElapsed, Stats.TotalTicks / *pElapsed / 1e6, Stolen, Stats.Hash );
+
+	if( bStandings )
+	{
+		printf( "\n%-10s %6s %6s %6s %8s %8s\n", "Bot", "Won", "Lost", "Drawn", "For", "Against" );
+		for( int i = 0 ; i < g_PongBotCount ; i++ )
+		{
+			printf( "%-10s %6d %6d %6d %8d %8d\n", g_PongBots[ i ].Name, Standings[ i ].Wins, Standings[ i ].Losses,
+					Standings[ i ].Draws, Standings[ i ].PointsFor, Standings[ i ].PointsAgainst );
+		}
+		printf( "\n" );
+	}
+
+	return Stats.Hash;
+}
+
+int BenchTourney( int Threads, int Games )
+{
+	double Elapsed;
+
+	if( Threads > 0 )
+	{
+		RunTourney( Threads, Games, TRUE, &Elapsed );
+		return 0;
+	}
+
+	// Sweep the thread count to see how it scales.  Every run must give the same results.
+	int Cores = (int)std::thread::hardware_concurrency();
+	if( Cores < 1 )
+		Cores = 1;
+
+	double Single = 0;
+	DWORD Hash = RunTourney( 1, Games, TRUE, &Single );
+
+	for( int t = 2 ; t < Cores * 2 && t <= TOURNEY_MAXTHREADS ; t *= 2 )
+	{
+		if( t > Cores )
+			t = Cores;
+
+		if( RunTourney( t, Games, FALSE, &Elapsed ) != Hash )
+		{
+			printf( "Results changed with %d threads!\n", t );
+			return 1;
+		}
+
+		printf( "             %.2fx the speed of one thread (%.0f%% efficiency)\n", Single / Elapsed, Single / Elapsed / t * 100 );
+	}
+
+	return 0;
+}
+
+
+//====================================================
+// Match Recordings
+//====================================================
+
+// Plays a recording back and prints how long it took
+BOOL RunReplay( const REPLAY* pReplay )
+{
+	PONGSIM Sim;
+
+	double Start = Seconds();
+	BOOL bOk = PlayReplay( pReplay, &Sim );
+	double Elapsed = Seconds() - Start;
+
+	printf( "Played %u ticks (%.1f minutes of play) in %.2f ms, %.0fx real time, %.1f million ticks/s\n",
+			pReplay->TickCount, pReplay->TickCount / (double)pReplay->TickRate / 60, Elapsed * 1000,
+			pReplay->TickCount / (double)pReplay->TickRate / Elapsed, pReplay->TickCount / Elapsed / 1e6 );
+	printf( "Score %d - %d, state hash %08X, recorded %08X %s\n", Sim.p1Score, Sim.p2Score,
+			PongSimHash( &Sim ), pReplay->FinalHash, bOk ? "" : "MISMATCH" );
+
+	return bOk;
+}
+
+// Records a bot match the way the game loop does, saves it, loads it back and checks it
+// plays back to the same state.  Then checks a damaged recording is caught.
+int BenchReplay( int Seconds )
+{
+	const int TickRate = PONGSIM_BASE_RATE * 10;
+	const char FileName[] = "replay.rep";
+
+	PONGSIM Sim;
+	PONGRNG Rng;
+	REPLAY Replay;
+	memset( &Replay, 0, sizeof( Replay ) );
+
+	DWORD Seed = PongRngDerive( 1, 0 );
+	PongSimInit( &Sim, Seed, TickRate );
+	PongRngSeed( &Rng, Seed );
+	BeginReplayRecord( &Replay, Seed, Sim.TickRate );
+
+	int Ticks = Seconds * Sim.TickRate;
+	int GameOverTick = 0;
+
+	for( int i = 0 ; i < Ticks ; i++ )
+	{
+		unsigned int Input = PongBotPredictor( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng );
+
+		// Somebody changes the ball speed now and then, holding the key for a moment
+		int Second = i / Sim.TickRate;
+		if( Second % 50 == 10 && i % Sim.TickRate < Sim.TickRate / 5 )
+			Input |= PONGINPUT_SPEED1 << ( ( Second / 50 ) % BALL_MAXSPEED );
+
+		RecordReplayTick( &Replay, Input );
+		if( ( PongSimStep( &Sim, Input ) & PONGEVENT_GAMEOVER ) && !GameOverTick )
+			GameOverTick = i + 1;
+	}
+
+	EndReplayRecord( &Replay, &Sim );
+
+	if( !SaveReplay( &Replay, FileName ) )
+	{
+		printf( "Could not write %s\n", FileName );
+		return 1;
+	}
+
+	printf( "Recorded %d ticks at %d Hz, ", Ticks, Sim.TickRate );
+	if( GameOverTick )
+		printf( "match won at tick %d\n", GameOverTick );
+	else
+		printf( "match still going\n" );
+	printf( "%s is %u bytes, %.3f bits a tick (%d bytes as one WORD a tick)\n", FileName,
+			REPLAY_HEADERSIZE + Replay.DataSize, ( Replay.DataSize * 8.0 ) / Ticks, Ticks * 2 );
+
+	FreeReplay( &Replay );
+
+	if( !LoadReplay( &Replay, FileName ) )
+	{
+		printf( "Could not read %s back\n", FileName );
+		return 1;
+	}
+
+	int Errors = 0;
+	if( Replay.Seed != Seed || Replay.TickCount != (DWORD)Ticks || Replay.FinalHash != PongSimHash( &Sim ) )
+		Errors++;
+
+	if( !RunReplay( &Replay ) )
+		Errors++;
+
+	// Flip one button in the middle of the recording; the playback has to notice
+	DWORD Pos = 0, Run = 0, Change;
+	while( Pos < Replay.DataSize / 2 )
+	{
+		ReplayGetVarint( Replay.pData, Replay.DataSize, &Pos, &Run );
+		if( ( Run & 31 ) == REPLAY_MANY )
+			ReplayGetVarint( Replay.pData, Replay.DataSize, &Pos, &Change );
+	}
+	Replay.pData[ Pos - 1 ] ^= 1;
+
+	if( PlayReplay( &Replay, &Sim ) )
+	{
+		printf( "A damaged recording played back without a mismatch\n" );
+		Errors++;
+	}
+
+	FreeReplay( &Replay );
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+// Plays back a recording from the game
+int PlayReplayFile( const char* FileName )
+{
+	REPLAY Replay;
+	memset( &Replay, 0, sizeof( Replay ) );
+
+	if( !LoadReplay( &Replay, FileName ) )
+	{
+		printf( "Could not read %s\n", FileName );
+		return 1;
+	}
+
+	printf( "%s: seed %08X, %u ticks at %d Hz, %u bytes of input\n", FileName, Replay.Seed,
+			Replay.TickCount, Replay.TickRate, Replay.DataSize );
+
+	BOOL bOk = RunReplay( &Replay );
+	FreeReplay( &Replay );
+
+	return bOk ? 0 : 1;
+}
+
+
+//====================================================
+// Replay Archives
+//====================================================
+
+// The state hash before Tick, found the slow way: reading the recording from the start
+DWORD ReplayHashAt( const REPLAY* pReplay, DWORD Tick )
+{
+	PONGSIM Sim;
+	PongSimInit( &Sim, pReplay->Seed, pReplay->TickRate );
+
+	DWORD Pos = 0;
+	unsigned int Input = 0;
+	DWORD Length;
+
+	while( Sim.Tick < Tick && ReplayNextRun( pReplay->pData, pReplay->DataSize, &Pos, &Input, &Length ) )
+	{
+		for( DWORD i = 0 ; i < Length && Sim.Tick < Tick ; i++ )
+			PongSimStep( &Sim, Input );
+	}
+
+	return PongSimHash( &Sim );
+}
+
+// Checks matches until there are none left
+void ScanArchive( const REPLAYARCHIVE* pArchive, std::atomic<int>* pNext, std::atomic<int>* pBad )
+{
+	PONGSIM Sim;
+
+	for( ;; )
+	{
+		int Match = pNext->fetch_add( 1 );
+		if( Match >= pArchive->MatchCount )
+			break;
+
+		if( !CheckReplayArchiveMatch( pArchive, Match, &Sim ) )
+			pBad->fetch_add( 1 );
+	}
+}
+
+// Records a round robin of bot matches into an archive, maps it, and checks that seeking
+// lands on the same state as reading from the start, and that every match checks out
+int BenchArchive( int Matches )
+{
+	const int TickRate = PONGSIM_BASE_RATE * 10;
+	const DWORD MaxTicks = 300 * TickRate;
+	const char FileName[] = "replays.upra";
+
+	if( Matches < 1 )
+		Matches = 1;
+
+	REPLAY* pReplays = new REPLAY[ Matches ];
+	memset( pReplays, 0, Matches * sizeof( REPLAY ) );
+
+	REPLAYARCHIVEWRITER Writer;
+	if( !BeginReplayArchive( &Writer, FileName ) )
+	{
+		printf( "Could not write %s\n", FileName );
+		return 1;
+	}
+
+	INT64 Ticks = 0;
+	int Errors = 0;
+	double Start = Seconds();
+
+	for( int m = 0 ; m < Matches ; m++ )
+	{
+		const PONGBOTINFO* pBot1 = &g_PongBots[ m % g_PongBotCount ];
+		const PONGBOTINFO* pBot2 = &g_PongBots[ ( m / g_PongBotCount ) % g_PongBotCount ];
+
+		PONGSIM Sim;
+		PONGRNG Rng;
+		DWORD Seed = PongRngDerive( 2, m );
+		PongSimInit( &Sim, Seed, TickRate );
+		PongRngSeed( &Rng, Seed );
+		BeginReplayRecord( &pReplays[ m ], Seed, Sim.TickRate );
+
+		while( !Sim.bGameOver && Sim.Tick < MaxTicks )
+		{
+			unsigned int Input = pBot1->pfnPolicy( &Sim, 1, &Rng ) | pBot2->pfnPolicy( &Sim, 2, &Rng );
+			RecordReplayTick( &pReplays[ m ], Input );
+			PongSimStep( &Sim, Input );
+		}
+
+		EndReplayRecord( &pReplays[ m ], &Sim );
+		Ticks += Sim.Tick;
+
+		if( !AddReplayArchiveMatch( &Writer, &pReplays[ m ] ) )
+			Errors++;
+	}
+
+	if( !EndReplayArchive( &Writer ) )
+		Errors++;
+
+	printf( "Recorded and archived %d matches, %.1f hours of play at %d Hz, in %.2fs\n", Matches,
+			Ticks / (double)TickRate / 3600, TickRate, Seconds() - Start );
+
+	MAPPEDFILE File;
+	REPLAYARCHIVE Archive;
+
+	if( !OpenMappedFile( &File, FileName ) || !OpenReplayArchive( &Archive, File.pData, File.Size ) )
+	{
+		printf( "Could not open %s\n", FileName );
+		return 1;
+	}
+
+	printf( "%s is %.1f KB, %d matches, a keyframe every %u ticks\n", FileName, File.Size / 1024.0,
+			Archive.MatchCount, Archive.pHeader->KeyframeInterval );
+
+	// Seek to random ticks, against reading each recording from the start
+	PONGRNG Rng;
+	PongRngSeed( &Rng, 3 );
+
+	const int Seeks = 200;
+	double SeekTime = 0;
+	double ReadTime = 0;
+
+	for( int i = 0 ; i < Seeks ; i++ )
+	{
+		int Match = PongRngNext( &Rng ) % Archive.MatchCount;
+		DWORD Tick = PongRngNext( &Rng ) % ( Archive.pMatches[ Match ].TickCount + 1 );
+
+		PONGSIM Sim;
+		REPLAYCURSOR Cursor;
+
+		double Begin = Seconds();
+		BOOL bOk = SeekReplayArchive( &Archive, Match, Tick, &Sim, &Cursor );
+		SeekTime += Seconds() - Begin;
+
+		Begin = Seconds();
+		DWORD Hash = ReplayHashAt( &pReplays[ Match ], Tick );
+		ReadTime += Seconds() - Begin;
+
+		if( !bOk || Sim.Tick != Tick || PongSimHash( &Sim ) != Hash )
+		{
+			printf( "Seek to tick %u of match %d went wrong\n", Tick, Match );
+			Errors++;
+		}
+	}
+
+	printf( "Seek: %.1f us on average, reading from the start %.1f us (%.0fx faster)\n",
+			SeekTime / Seeks * 1e6, ReadTime / Seeks * 1e6, ReadTime / SeekTime );
+
+	// Check every match on every core at once, straight out of the one mapping
+	int Threads = (int)std::thread::hardware_concurrency();
+	if( Threads < 1 )
+		Threads = 1;
+
+	std::thread Workers[ COMPOSITOR_MAXTHREADS ];
+	if( Threads > COMPOSITOR_MAXTHREADS )
+		Threads = COMPOSITOR_MAXTHREADS;
+
+	std::atomic<int> Next( 0 );
+	std::atomic<int> Bad( 0 );
+
+	Start = Seconds();
+	for( int t = 1 ; t < Threads ; t++ )
+		Workers[ t ] = std::thread( ScanArchive, &Archive, &Next, &Bad );
+	ScanArchive( &Archive, &Next, &Bad );
+	for( int t = 1 ; t < Threads ; t++ )
+		Workers[ t ].join();
+	double Elapsed = Seconds() - Start;
+
+	printf( "Scan: %d matches checked on %d threads in %.1f ms, %.1f million ticks/s, %d bad\n", Archive.MatchCount,
+			Threads, Elapsed * 1000, Ticks / Elapsed / 1e6, Bad.load() );
+	Errors += Bad.load();
+
+	// A damaged keyframe has to be caught
+	std::atomic<int> One( Archive.MatchCount - 1 );
+	BYTE* pCopy = new BYTE[ File.Size ];
+	memcpy( pCopy, File.pData, File.Size );
+
+	REPLAYARCHIVE Damaged;
+	OpenReplayArchive( &Damaged, pCopy, File.Size );
+	const REPLAYMATCH* pLast = &Damaged.pMatches[ Damaged.MatchCount - 1 ];
+	if( pLast->KeyframeCount > 1 )
+	{
+		( (REPLAYKEYFRAME*)( pCopy + pLast->Keyframes ) )[ 1 ].Sim.BallX ^= 1;
+
+		Bad.store( 0 );
+		ScanArchive( &Damaged, &One, &Bad );
+		if( Bad.load() != 1 )
+		{
+			printf( "A damaged keyframe was not noticed\n" );
+			Errors++;
+		}
+	}
+
+	// Offsets so large that adding the table size wraps round have to be turned away, in the
+	// header and in a match entry
+	const INT64 Huge = 0x7FFFFFFFFFFFFFFFLL - 7;
+	for( int i = 0 ; i < 3 ; i++ )
+	{
+		memcpy( pCopy, File.pData, File.Size );
+		REPLAYARCHIVEHEADER* pHeader = (REPLAYARCHIVEHEADER*)pCopy;
+		REPLAYMATCH* pMatch = (REPLAYMATCH*)( pCopy + pHeader->MatchTable );
+
+		if( i == 0 )
+		{
+			pHeader->MatchTable = Huge;
+			pHeader->MatchCount = 1;
+		}
+		else if( i == 1 )
+			pMatch->Keyframes = Huge;
+		else
+			pMatch->Runs = Huge;
+
+		if( OpenReplayArchive( &Damaged, pCopy, File.Size ) )
+		{
+			printf( "A damaged archive was opened (%d)\n", i + 1 );
+			Errors++;
+		}
+	}
+	delete [] pCopy;
+
+	CloseMappedFile( &File );
+	for( int m = 0 ; m < Matches ; m++ )
+		FreeReplay( &pReplays[ m ] );
+	delete [] pReplays;
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Frame Capture
+//====================================================
+
+// Hashes the color of every pixel, which is all the capture keeps
+DWORD HashFrameColor( const DWORD* pPixels, int Count )
+{
+	DWORD Hash = 2166136261u;
+	for( int i = 0 ; i < Count ; i++ )
+		Hash = ( Hash ^ ( pPixels[ i ] & 0x00FFFFFF ) ) * 16777619u;
+	return Hash;
+}
+
+// Draws game frames as fast as possible and captures every one, timing what it costs the
+// drawing thread.  Then reads the file back and checks each frame that was kept.
+int BenchCapture( int Frames )
+{
+	static GAMEART Art;
+	static TEXTBATCH Text;
+	static DIRTYTRACKER Tracker;
+	static FRAMEDUMP Dump;
+	CMemorySurface32 Back;
+	COMPOSEFRAME Frame;
+
+	const char FileName[] = "capture.ufd";
+	const int Pixels = RES_WIDTH * RES_HEIGHT;
+
+	InitBlitters( );
+	LoadGameArt( &Art );
+	Back.Create( RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &Tracker, RES_WIDTH, RES_HEIGHT );
+
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	PongSimInit( &Sim, 1 );
+	PongRngSeed( &Rng, 1 );
+
+	DWORD* pHashes = new DWORD[ Frames ];
+
+	if( !StartFrameDump( &Dump, FileName, RES_WIDTH, RES_HEIGHT ) )
+	{
+		printf( "Could not write %s\n", FileName );
+		return 1;
+	}
+
+	double ComposeTime = 0, SubmitTime = 0, WorstSubmit = 0;
+	double Start = Seconds();
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		for( int t = 0 ; t < 10 ; t++ )
+		{
+			PrevSim = Sim;
+			PongSimStep( &Sim, PongBotTracker( &Sim, 1, &Rng ) | PongBotLazy( &Sim, 2, &Rng ) );
+			if( Sim.bGameOver )
+				PongSimInit( &Sim, i );
+		}
+
+		HUDINFO Hud = { i, Tracker.PixelsTouched, FALSE, FALSE, 0 };
+		BuildGameFrame( &Frame, &Art, &Text, &PrevSim, &Sim, 32768, &Hud );
+
+		double Begin = Seconds();
+		ComposeFrame( &Frame, &Tracker, &Back, TRUE );
+		double Composed = Seconds();
+		SubmitFrameDump( &Dump, &Back );
+		double Submitted = Seconds();
+
+		ComposeTime += Composed - Begin;
+		SubmitTime += Submitted - Composed;
+		if( Submitted - Composed > WorstSubmit )
+			WorstSubmit = Submitted - Composed;
+
+		pHashes[ i ] = HashFrameColor( Back.GetBits(), Pixels );
+	}
+
+	double DrawTime = Seconds() - Start;
+	DWORD Dropped = Dump.Dropped;
+
+	if( !StopFrameDump( &Dump ) )
+	{
+		printf( "Could not write all of %s\n", FileName );
+		return 1;
+	}
+	double Elapsed = Seconds() - Start;
+
+	printf( "%d frames drawn in %.2fs (%.0f fps), all written %.2fs after the first\n", Frames, DrawTime, Frames / DrawTime, Elapsed );
+	printf( "Compose %.1f us per frame, capture %.1f us (worst %.1f us)\n", ComposeTime / Frames * 1e6,
+			SubmitTime / Frames * 1e6, WorstSubmit * 1e6 );
+	printf( "%u frames written, %u dropped with the writer behind\n", Dump.Written, Dropped );
+	printf( "%s is %.1f MB, %.1f KB a frame (%.0f:1 against 32 bit frames)\n", FileName, Dump.BytesWritten / 1048576.0,
+			Dump.BytesWritten / 1024.0 / Dump.Written, (double)Dump.Written * Pixels * 4 / Dump.BytesWritten );
+
+	// Read it all back
+	FRAMEDUMPREADER Reader;
+	if( !OpenFrameDump( &Reader, FileName ) )
+	{
+		printf( "Could not read %s back\n", FileName );
+		return 1;
+	}
+
+	int Read = 0, Bad = 0, Keys = 0;
+	DWORD Last = 0;
+
+	Start = Seconds();
+	while( ReadFrameDump( &Reader ) )
+	{
+		if( Reader.Number >= (DWORD)Frames || ( Read && Reader.Number <= Last ) ||
+			HashFrameColor( Reader.pFrame, Pixels ) != pHashes[ Reader.Number ] )
+			Bad++;
+
+		Last = Reader.Number;
+		Keys += Reader.bKey;
+		Read++;
+	}
+	Elapsed = Seconds() - Start;
+
+	printf( "Read back %d frames (%d key frames) in %.2fs, %d bad\n", Read, Keys, Elapsed, Bad );
+	CloseFrameDump( &Reader );
+
+	// Headers with a frame too big to allocate have to be turned away
+	DWORD Sizes[][ 2 ] = { { FRAMEDUMP_MAXSIZE + 1, 16 }, { 16, 0xFFFFFFFF }, { 0x10000, 0x10000 } };
+	for( int i = 0 ; i < 3 ; i++ )
+	{
+		DWORD Header[ 5 ] = { FRAMEDUMP_HEADER, 12, Sizes[ i ][ 0 ], Sizes[ i ][ 1 ], FRAMEDUMP_VERSION };
+		FILE* pFile = fopen( "damaged.ufd", "wb" );
+		if( pFile )
+		{
+			fwrite( Header, sizeof( Header ), 1, pFile );
+			fclose( pFile );
+		}
+
+		if( OpenFrameDump( &Reader, "damaged.ufd" ) )
+		{
+			printf( "A damaged frame dump was opened (%d)\n", i + 1 );
+			CloseFrameDump( &Reader );
+			Bad++;
+		}
+	}
+	remove( "damaged.ufd" );
+
+	FreeGameArt( &Art );
+	delete [] pHashes;
+
+	BOOL bOk = Bad == 0 && Read == (int)Dump.Written && Dump.Written + Dropped == (DWORD)Frames;
+	printf( "%s\n", bOk ? "OK" : "FAILED" );
+	return bOk ? 0 : 1;
+}
+
+
+//====================================================
+// Shared Memory Export
+//====================================================
+
+#define EXPORT_FPS	1000
+
+// A quick position dependent checksum of the color, so reading a frame costs about what copying it would
+DWORD SumFrameColor( const DWORD* pPixels, int Count )
+{
+	DWORD Sum = 0;
+	for( int i = 0 ; i < Count ; i++ )
+		Sum += ( pPixels[ i ] & 0x00FFFFFF ) * (DWORD)( i * 2 + 1 );
+	return Sum;
+}
+
+struct EXPORTREADER
+{
+	int Index;
+	DWORD* pHashes;			// Checksum of each frame seen, by frame number (0 if missed)
+	int Seen;
+	int Torn;				// Frames overwritten while being read
+	double Latency;			// Total microseconds from publishing to finishing reading
+	double ReadTime;		// Total seconds spent reading frames
+};
+
+// Draws the frames the export test publishes, the same every time it is called
+struct EXPORTFRAMES
+{
+	GAMEART Art;
+	TEXTBATCH Text;
+	DIRTYTRACKER Tracker;
+	CMemorySurface32 Back;
+	PONGSIM Sim, PrevSim;
+	PONGRNG Rng;
+	int Frame;
+};
+
+void BeginExportFrames( EXPORTFRAMES* pFrames )
+{
+	InitDirtyTracker( &pFrames->Tracker, RES_WIDTH, RES_HEIGHT );
+	pFrames->Back.Create( RES_WIDTH, RES_HEIGHT );
+	PongSimInit( &pFrames->Sim, 1 );
+	PongRngSeed( &pFrames->Rng, 1 );
+	pFrames->Frame = 0;
+}
+
+void DrawExportFrame( EXPORTFRAMES* pFrames )
+{
+	for( int t = 0 ; t < 10 ; t++ )
+	{
+		pFrames->PrevSim = pFrames->Sim;
+		PongSimStep( &pFrames->Sim, PongBotTracker( &pFrames->Sim, 1, &pFrames->Rng ) | PongBotLazy( &pFrames->Sim, 2, &pFrames->Rng ) );
+		if( pFrames->Sim.bGameOver )
+			PongSimInit( &pFrames->Sim, pFrames->Frame );
+	}
+
+	COMPOSEFRAME Frame;
+	HUDINFO Hud = { pFrames->Frame++, 0, FALSE, FALSE, 0 };
+	BuildGameFrame( &Frame, &pFrames->Art, &pFrames->Text, &pFrames->PrevSim, &pFrames->Sim, 32768, &Hud );
+	ComposeFrame( &Frame, &pFrames->Tracker, &pFrames->Back, TRUE );
+}
+
+// Another program's view: maps the shared memory itself and reads every frame it can in place
+void ExportReader( EXPORTREADER* pReader, int Frames )
+{
+	FRAMEEXPORTMAPPING Mapping;
+	if( !OpenFrameExport( &Mapping ) )
+		return;
+
+	DWORD After = 0;
+	FRAMEEXPORTVIEW View;
+
+	while( IsFrameExportLive( &Mapping ) && After < (DWORD)Frames )
+	{
+		if( !BeginExportFrame( &Mapping, After, &View ) )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		double Begin = Seconds();
+		DWORD Hash = SumFrameColor( View.pPixels, View.Width * View.Height );
+		INT64 Now = HrClockToNs( HrClockNow() ) / 1000;
+		pReader->ReadTime += Seconds() - Begin;
+
+		if( !EndExportFrame( &View ) )
+		{
+			pReader->Torn++;
+			continue;
+		}
+
+		pReader->pHashes[ View.Frame ] = Hash;
+		pReader->Latency += (double)( Now - View.Time );
+		pReader->Seen++;
+		After = View.Frame;
+	}
+
+	CloseFrameExport( &Mapping );
+}
+
+// Publishes game frames at EXPORT_FPS while reader threads, each with their own mapping, read
+// them.  Then draws the frames again to check what the readers saw.
+int BenchExport( int Frames, int Readers )
+{
+	static EXPORTFRAMES Draw;
+	static FRAMEEXPORT Export;
+
+	if( Readers < 1 )
+		Readers = 1;
+	if( Readers > COMPOSITOR_MAXTHREADS )
+		Readers = COMPOSITOR_MAXTHREADS;
+
+	InitBlitters( );
+	LoadGameArt( &Draw.Art );
+	BeginExportFrames( &Draw );
+
+	if( !StartFrameExport( &Export, RES_WIDTH, RES_HEIGHT ) )
+	{
+		printf( "Could not make the shared memory\n" );
+		return 1;
+	}
+
+	EXPORTREADER Reader[ COMPOSITOR_MAXTHREADS ];
+	std::thread Threads[ COMPOSITOR_MAXTHREADS ];
+
+	for( int r = 0 ; r < Readers ; r++ )
+	{
+		memset( &Reader[ r ], 0, sizeof( EXPORTREADER ) );
+		Reader[ r ].Index = r;
+		Reader[ r ].pHashes = new DWORD[ Frames + 1 ];
+		memset( Reader[ r ].pHashes, 0, ( Frames + 1 ) * 4 );
+		Threads[ r ] = std::thread( ExportReader, &Reader[ r ], Frames );
+	}
+
+	double PublishTime = 0;
+	double Start = Seconds();
+
+	for( int i = 0 ; i < Frames ; i++ )
+	{
+		// Hold to the frame rate, letting the readers run in the meantime
+		while( Seconds() - Start < (double)i / EXPORT_FPS )
+			std::this_thread::yield();
+
+		DrawExportFrame( &Draw );
+
+		double Begin = Seconds();
+		PublishExportFrame( &Export, Draw.Back.GetBits(), Draw.Back.GetPitch(), RES_WIDTH, RES_HEIGHT, HrClockToNs( HrClockNow() ) / 1000 );
+		PublishTime += Seconds() - Begin;
+	}
+
+	double Elapsed = Seconds() - Start;
+
+	// Give the readers a moment to finish the last frame
+	while( Seconds() - Start < Elapsed + 0.1 )
+		std::this_thread::yield();
+	StopFrameExport( &Export );
+
+	for( int r = 0 ; r < Readers ; r++ )
+		Threads[ r ].join();
+
+	printf( "Published %d frames in %.2fs (%.0f fps), %.1f us each, %d readers on %d cores\n", Frames, Elapsed, Frames / Elapsed,
+			PublishTime / Frames * 1e6, Readers, (int)std::thread::hardware_concurrency() );
+
+	// Draw the same frames again to check the readers saw them right
+	BeginExportFrames( &Draw );
+	int Errors = 0;
+	int Wrong[ COMPOSITOR_MAXTHREADS ] = { 0 };
+
+	for( int i = 1 ; i <= Frames ; i++ )
+	{
+		DrawExportFrame( &Draw );
+		DWORD Hash = SumFrameColor( Draw.Back.GetBits(), RES_WIDTH * RES_HEIGHT );
+
+		for( int r = 0 ; r < Readers ; r++ )
+		{
+			if( Reader[ r ].pHashes[ i ] && Reader[ r ].pHashes[ i ] != Hash )
+				Wrong[ r ]++;
+		}
+	}
+
+	for( int r = 0 ; r < Readers ; r++ )
+	{
+		EXPORTREADER* pReader = &Reader[ r ];
+		double ReadRate = pReader->ReadTime > 0 ? pReader->Seen / pReader->ReadTime : 0;
+
+		printf( "Reader %d: saw %d frames (%.1f%%), %d torn and thrown away, %d wrong, %.0f us behind on average,\n"
+				"          %.1f us to read a frame (%.0f fps)\n", r, pReader->Seen, 100.0 * pReader->Seen / Frames,
+				pReader->Torn, Wrong[ r ], pReader->Seen ? pReader->Latency / pReader->Seen : 0.0,
+				pReader->Seen ? pReader->ReadTime / pReader->Seen * 1e6 : 0.0, ReadRate );
+
+		// Only a wrong frame or a reader that saw nothing fails.  How many frames a reader keeps
+		// up with depends on the machine and its load, so that is for information.
+		if( Wrong[ r ] || pReader->Seen == 0 )
+			Errors++;
+		else if( ReadRate < EXPORT_FPS )
+			printf( "          reads slower than the %d fps the frames come at\n", EXPORT_FPS );
+
+		delete [] pReader->pHashes;
+	}
+
+	FreeGameArt( &Draw.Art );
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Asset Loading
+//====================================================
+
+#define ASSETS_FOLDER	"bench_graphics"
+
+// Writes a bitmap the way a paint program would.  With 8 bits or under the pixels are
+// indices into pPalette.
+BOOL WriteTestBmp( const char* FileName, const DWORD* pPixels, const DWORD* pPalette, int Width, int Height, int BitCount, BOOL bTopDown )
+{
+	int RowBytes = ( ( Width * BitCount + 31 ) / 32 ) * 4;
+	int Colors = BitCount <= 8 ? 1 << BitCount : 0;
+	DWORD Offset = 14 + 40 + Colors * 4;
+	DWORD Size = Offset + RowBytes * Height;
+
+	BYTE* pFile = new BYTE[ Size ];
+	memset( pFile, 0, Size );
+
+	DWORD Fields[] = { Size, 0, Offset, 40, (DWORD)Width, (DWORD)( bTopDown ? -Height : Height ),
+					   (DWORD)( 1 | ( BitCount << 16 ) ), 0, (DWORD)( RowBytes * Height ), 2835, 2835, 0, 0 };
+
+	pFile[ 0 ] = 'B';
+	pFile[ 1 ] = 'M';
+	for( int i = 0 ; i < 13 * 4 ; i++ )
+		pFile[ 2 + i ] = (BYTE)( Fields[ i / 4 ] >> ( ( i % 4 ) * 8 ) );
+
+	for( int i = 0 ; i < Colors * 4 ; i++ )
+		pFile[ 54 + i ] = (BYTE)( pPalette[ i / 4 ] >> ( ( i % 4 ) * 8 ) );
+
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		BYTE* pRow = pFile + Offset + ( bTopDown ? y : Height - 1 - y ) * RowBytes;
+
+		for( int x = 0 ; x < Width ; x++ )
+		{
+			DWORD Pixel = pPixels[ y * Width + x ];
+			int Bit = x * BitCount;
+
+			if( BitCount <= 8 )
+				pRow[ Bit >> 3 ] |= (BYTE)( Pixel << ( 8 - BitCount - ( Bit & 7 ) ) );
+			else
+				for( int b = 0 ; b < BitCount / 8 ; b++ )
+					pRow[ Bit / 8 + b ] = (BYTE)( Pixel >> ( b * 8 ) );
+		}
+	}
+
+	FILE* pOut = fopen( FileName, "wb" );
+	BOOL bOk = pOut && fwrite( pFile, Size, 1, pOut ) == 1;
+	if( pOut )
+		bOk = ( fclose( pOut ) == 0 ) && bOk;
+
+	delete [] pFile;
+	return bOk;
+}
+
+// Drops a file from the OS file cache, so the next read comes off the disk as it would the
+// first time the game starts after a reboot
+void EvictFile( const char* FileName )
+{
+	int File = open( FileName, O_RDONLY );
+	if( File < 0 )
+		return;
+
+	fdatasync( File );
+	posix_fadvise( File, 0, 0, POSIX_FADV_DONTNEED );
+	close( File );
+}
+
+// What the game used to do for each bitmap: LoadImage() read and decoded the whole file to find
+// its size, then D3DXLoadSurfaceFromFile() read and decoded it again into the surface
+BOOL LoadBmpTwice( const char* FileName, CMemorySurface32* pSurface )
+{
+	CMemorySurface32 SizeOnly;
+	BOOL bOk = TRUE;
+
+	for( int Pass = 0 ; Pass < 2 && bOk ; Pass++ )
+	{
+		FILE* pFile = fopen( FileName, "rb" );
+		if( !pFile )
+			return FALSE;
+
+		fseek( pFile, 0, SEEK_END );
+		long Size = ftell( pFile );
+		fseek( pFile, 0, SEEK_SET );
+
+		BYTE* pData = new BYTE[ Size ];
+		BMPINFO Info;
+		bOk = fread( pData, Size, 1, pFile ) == 1 && ReadBmpHeader( pData, Size, &Info );
+		fclose( pFile );
+
+		CMemorySurface32* pDest = Pass ? pSurface : &SizeOnly;
+		if( bOk && pDest->Create( Info.Width, Info.Height ) )
+			DecodeBmp( pData, &Info, pDest->GetBits(), pDest->GetPitch() );
+
+		delete [] pData;
+	}
+
+	return bOk;
+}
+
+// TRUE if a surface holds exactly the colors in pExpected
+BOOL SurfaceMatches( CMemorySurface32* pSurface, const DWORD* pExpected, int Width, int Height )
+{
+	if( pSurface->GetWidth() != Width || pSurface->GetHeight() != Height )
+		return FALSE;
+
+	for( int y = 0 ; y < Height ; y++ )
+		for( int x = 0 ; x < Width ; x++ )
+			if( pSurface->GetBits()[ y * pSurface->GetPitch() / 4 + x ] != ( pExpected[ y * Width + x ] & 0x00FFFFFF ) )
+				return FALSE;
+
+	return TRUE;
+}
+
+// Checks the bitmap reader on every format it takes, then times loading the game's bitmaps the
+// old way, decoded once from the .bmp files, and from an asset pack, with the files both in and
+// out of the OS file cache
+int BenchAssets( int Rounds )
+{
+	int Errors = 0;
+	char FileName[ 256 ];
+	PONGRNG Rng;
+	PongRngSeed( &Rng, 20 );
+
+	mkdir( ASSETS_FOLDER, 0777 );
+
+	// Every bit depth, both ways up, with an odd width so the rows are padded
+	const int TestW = 37, TestH = 23;
+	DWORD Pixels[ TestW * TestH ], Expected[ TestW * TestH ], Palette[ 256 ];
+	const int Depths[] = { 1, 4, 8, 24, 32 };
+
+	for( int i = 0 ; i < 256 ; i++ )
+		Palette[ i ] = PongRngNext( &Rng ) & 0x00FFFFFF;
+
+	for( int d = 0 ; d < 5 ; d++ )
+	{
+		for( int bTopDown = 0 ; bTopDown < 2 ; bTopDown++ )
+		{
+			int Bits = Depths[ d ];
+			for( int i = 0 ; i < TestW * TestH ; i++ )
+			{
+				Pixels[ i ] = PongRngNext( &Rng );
+				if( Bits <= 8 )
+					Pixels[ i ] &= ( 1 << Bits ) - 1;
+				Expected[ i ] = Bits <= 8 ? Palette[ Pixels[ i ] ] : Pixels[ i ];
+			}
+
+			sprintf( FileName, ASSETS_FOLDER "/test%d%s.bmp", Bits, bTopDown ? "td" : "" );
+			CMemorySurface32 Surface;
+			BOOL bOk = WriteTestBmp( FileName, Pixels, Palette, TestW, TestH, Bits, bTopDown ) &&
+					   LoadBmpFile( FileName, &Surface ) && SurfaceMatches( &Surface, Expected, TestW, TestH );
+
+			printf( "%2d bit %s: %s\n", Bits, bTopDown ? "top down " : "bottom up", bOk ? "ok" : "WRONG" );
+			if( !bOk )
+				Errors++;
+		}
+	}
+
+	// The game's bitmaps, at their real sizes
+	const char* Names[] = { "space.bmp", "paddle.bmp", "ball.bmp", "font.bmp" };
+	const int Sizes[][ 2 ] = { { RES_WIDTH, RES_HEIGHT }, { PADDLE_WIDTH, PADDLE_HEIGHT }, { BALL_WIDTH, BALL_HEIGHT }, { FONT_WIDTH, FONT_HEIGHT } };
+	const int ArtCount = 4;
+
+	char Paths[ ArtCount ][ 64 ];
+	DWORD* pArt[ ArtCount ];
+	CMemorySurface32 Loaded[ ArtCount ];
+	ISurface32* pLoaded[ ArtCount ];
+
+	for( int a = 0 ; a < ArtCount ; a++ )
+	{
+		int Width = Sizes[ a ][ 0 ], Height = Sizes[ a ][ 1 ];
+		pArt[ a ] = new DWORD[ Width * Height ];
+
+		if( a == 0 )
+			for( int i = 0 ; i < Width * Height ; i++ )
+				pArt[ a ][ i ] = ( i * 2654435761u ) & 0x00FFFFFF;
+		else if( a == 3 )
+			MakeFont( pArt[ a ] );
+		else
+			MakeSprite( pArt[ a ], Width, Height, 0x00808080 );
+
+		sprintf( Paths[ a ], ASSETS_FOLDER "/%s", Names[ a ] );
+		if( !WriteTestBmp( Paths[ a ], pArt[ a ], 0, Width, Height, 24, FALSE ) || !LoadBmpFile( Paths[ a ], &Loaded[ a ] ) ||
+			!SurfaceMatches( &Loaded[ a ], pArt[ a ], Width, Height ) )
+		{
+			printf( "%s did not load\n", Paths[ a ] );
+			Errors++;
+		}
+		pLoaded[ a ] = &Loaded[ a ];
+	}
+
+	const char PackName[] = ASSETS_FOLDER "/assets.pak";
+	if( !WriteAssetPack( PackName, Names, pLoaded, ArtCount ) )
+	{
+		printf( "Could not write %s\n", PackName );
+		return 1;
+	}
+
+	// A cut short bitmap and a damaged pack have to be turned away
+	MAPPEDFILE File;
+	BMPINFO Info;
+	ASSETPACK Pack;
+
+	if( OpenMappedFile( &File, Paths[ 0 ] ) )
+	{
+		if( ReadBmpHeader( File.pData, File.Size - 1, &Info ) )
+		{
+			printf( "A cut short bitmap was read\n" );
+			Errors++;
+		}
+		CloseMappedFile( &File );
+	}
+
+	if( OpenMappedFile( &File, PackName ) )
+	{
+		BYTE* pCopy = new BYTE[ File.Size + ASSETPACK_ALIGN ];
+		BYTE* pAligned = pCopy + ( -(size_t)pCopy & ( ASSETPACK_ALIGN - 1 ) );
+		memcpy( pAligned, File.pData, File.Size );
+
+		// An image running off the end, and one so far out that the end wraps round
+		ASSETPACKIMAGE* pImage = &( (ASSETPACKIMAGE*)( pAligned + sizeof( ASSETPACKHEADER ) ) )[ 2 ];
+		INT64 Offset = pImage->Offset;
+		INT64 Damaged[] = { File.Size - ASSETPACK_ALIGN, 0x7FFFFFFFFFFFFFFFLL & ~(INT64)( ASSETPACK_ALIGN - 1 ) };
+
+		for( int i = 0 ; i < 2 ; i++ )
+		{
+			pImage->Offset = Damaged[ i ];
+			if( OpenAssetPack( &Pack, pAligned, File.Size ) )
+			{
+				printf( "A damaged pack was opened (%d)\n", i + 1 );
+				Errors++;
+			}
+		}
+
+		pImage->Offset = Offset;
+		if( !OpenAssetPack( &Pack, pAligned, File.Size ) )
+		{
+			printf( "The repaired pack was turned away\n" );
+			Errors++;
+		}
+
+		delete [] pCopy;
+		CloseMappedFile( &File );
+	}
+
+	// The game loads these, the paddle once for each player
+	const int Loads[] = { 0, 1, 1, 2, 3 };
+	const int LoadCount = 5;
+	const char* Ways[] = { "bitmaps, read and decoded twice (before)", "bitmaps, decoded once", "asset pack" };
+
+	printf( "\nLoading the game's %d bitmaps, average of %d:\n", LoadCount, Rounds );
+
+	for( int Way = 0 ; Way < 3 ; Way++ )
+	{
+		double Time[ 2 ] = { 0, 0 };
+
+		for( int bCold = 1 ; bCold >= 0 ; bCold-- )
+		{
+			for( int r = 0 ; r < Rounds ; r++ )
+			{
+				if( bCold )
+				{
+					for( int a = 0 ; a < ArtCount ; a++ )
+						EvictFile( Paths[ a ] );
+					EvictFile( PackName );
+				}
+
+				CMemorySurface32 Surfaces[ LoadCount ];
+				BOOL bOk = TRUE;
+				double Start = Seconds();
+
+				if( Way == 2 )
+				{
+					bOk = OpenMappedFile( &File, PackName ) && OpenAssetPack( &Pack, File.pData, File.Size );
+					for( int l = 0 ; l < LoadCount && bOk ; l++ )
+					{
+						const ASSETPACKIMAGE* pImage = FindAssetPackImage( &Pack, Paths[ Loads[ l ] ] );
+						bOk = pImage && Surfaces[ l ].Create( pImage->Width, pImage->Height );
+						if( bOk )
+							CopyAssetPackImage( &Pack, pImage, Surfaces[ l ].GetBits(), Surfaces[ l ].GetPitch() );
+					}
+					CloseMappedFile( &File );
+				}
+				else
+				{
+					for( int l = 0 ; l < LoadCount && bOk ; l++ )
+						bOk = Way ? LoadBmpFile( Paths[ Loads[ l ] ], &Surfaces[ l ] ) : LoadBmpTwice( Paths[ Loads[ l ] ], &Surfaces[ l ] );
+				}
+
+				Time[ bCold ] += Seconds() - Start;
+
+				for( int l = 0 ; l < LoadCount && bOk ; l++ )
+					bOk = SurfaceMatches( &Surfaces[ l ], pArt[ Loads[ l ] ], Sizes[ Loads[ l ] ][ 0 ], Sizes[ Loads[ l ] ][ 1 ] );
+
+				if( !bOk )
+				{
+					printf( "%s: round %d loaded the wrong pixels\n", Ways[ Way ], r );
+					Errors++;
+					break;
+				}
+			}
+		}
+
+		printf( "  %-42s cold %7.3f ms   cached %7.3f ms\n", Ways[ Way ], Time[ 1 ] / Rounds * 1000, Time[ 0 ] / Rounds * 1000 );
+	}
+
+	for( int a = 0 ; a < ArtCount ; a++ )
+		delete [] pArt[ a ];
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+// Bakes bitmaps into an asset pack for the game (graphics\assets.pak)
+int MakeAssetPack( const char* PackName, const char** Files, int Count )
+{
+	CMemorySurface32* pSurfaces = new CMemorySurface32[ Count ];
+	ISurface32** ppSurfaces = new ISurface32*[ Count ];
+	int Errors = 0;
+
+	for( int i = 0 ; i < Count ; i++ )
+	{
+		ppSurfaces[ i ] = &pSurfaces[ i ];
+		if( !LoadBmpFile( Files[ i ], &pSurfaces[ i ] ) )
+		{
+			printf( "Could not read %s\n", Files[ i ] );
+			Errors++;
+		}
+	}
+
+	if( !Errors && !WriteAssetPack( PackName, Files, ppSurfaces, Count ) )
+	{
+		printf( "Could not write %s\n", PackName );
+		Errors++;
+	}
+
+	if( !Errors )
+		printf( "Wrote %d bitmaps to %s\n", Count, PackName );
+
+	delete [] ppSurfaces;
+	delete [] pSurfaces;
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Resource Cache
+//====================================================
+
+// The cache's loader for the headless tools: a bitmap in a memory surface.  pContext counts
+// the files read.
+ISurface32* LoadMemoryResource( const char* PathName, void* pContext )
+{
+	CMemorySurface32* pSurface = new CMemorySurface32;
+	if( !LoadBmpFile( PathName, pSurface ) )
+	{
+		delete pSurface;
+		return 0;
+	}
+
+	( *(int*)pContext )++;
+	return pSurface;
+}
+
+// Loads the game's bitmaps through the resource cache, checking that the same file is only ever
+// loaded once however it is asked for, that sprites are shared, and that everything is freed by
+// the last release or at shutdown
+int BenchResources( int Rounds )
+{
+	int Errors = 0, FilesRead = 0;
+	RESOURCECACHE Cache;
+	InitResourceCache( &Cache, LoadMemoryResource, &FilesRead );
+
+	mkdir( ASSETS_FOLDER, 0777 );
+
+	DWORD* pPaddle = new DWORD[ PADDLE_WIDTH * PADDLE_HEIGHT ];
+	DWORD* pBall = new DWORD[ BALL_WIDTH * BALL_HEIGHT ];
+	DWORD* pBg = new DWORD[ RES_WIDTH * RES_HEIGHT ];
+	MakeSprite( pPaddle, PADDLE_WIDTH, PADDLE_HEIGHT, 0x00808080 );
+	MakeSprite( pBall, BALL_WIDTH, BALL_HEIGHT, 0x00C0C0C0 );
+	for( int i = 0 ; i < RES_WIDTH * RES_HEIGHT ; i++ )
+		pBg[ i ] = ( i * 2654435761u ) & 0x00FFFFFF;
+
+	const char PaddleName[] = ASSETS_FOLDER "/paddle.bmp";
+	const char BallName[] = ASSETS_FOLDER "/ball.bmp";
+	const char BgName[] = ASSETS_FOLDER "/space.bmp";
+
+	if( !WriteTestBmp( PaddleName, pPaddle, 0, PADDLE_WIDTH, PADDLE_HEIGHT, 24, FALSE ) ||
+		!WriteTestBmp( BallName, pBall, 0, BALL_WIDTH, BALL_HEIGHT, 24, FALSE ) ||
+		!WriteTestBmp( BgName, pBg, 0, RES_WIDTH, RES_HEIGHT, 24, FALSE ) )
+	{
+		printf( "Could not write the bitmaps in %s\n", ASSETS_FOLDER );
+		return 1;
+	}
+
+	// The way GameInit() asks for them, then the paddle again under another spelling
+	const RESOURCE* pBackground = AcquireResource( &Cache, BgName );
+	const RESOURCE* pPaddle1 = AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+	const RESOURCE* pPaddle2 = AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+	const RESOURCE* pBallRes = AcquireSprite( &Cache, BallName, COLOR_KEY );
+	const RESOURCE* pPaddle3 = AcquireResource( &Cache, "BENCH_GRAPHICS\\Paddle.BMP" );
+
+	printf( "%d acquires, %d files read, %d shared\n", 5, FilesRead, Cache.Shared );
+
+	if( !pBackground || !pPaddle1 || !pBallRes || FilesRead != 3 || Cache.Shared != 2 )
+		Errors++;
+	if( pPaddle1 != pPaddle2 || pPaddle1 != pPaddle3 || pPaddle1->RefCount != 3 )
+	{
+		printf( "The paddles do not share one resource\n" );
+		Errors++;
+	}
+	if( pPaddle1 && ( !pPaddle1->bSprite || pPaddle1->Sprite.Width != PADDLE_WIDTH || pPaddle1->Sprite.Height != PADDLE_HEIGHT ) )
+	{
+		printf( "The paddle sprite was not built\n" );
+		Errors++;
+	}
+	if( AcquireSprite( &Cache, BallName, 0 ) )
+	{
+		printf( "The ball was given out with a second color key\n" );
+		Errors++;
+	}
+	if( AcquireResource( &Cache, ASSETS_FOLDER "/missing.bmp" ) )
+	{
+		printf( "A missing file was loaded\n" );
+		Errors++;
+	}
+
+	// The last release frees it, and the next acquire loads it again
+	ReleaseResource( &Cache, pPaddle3 );
+	ReleaseResource( &Cache, pPaddle2 );
+	if( Cache.Count != 3 )
+		Errors++;
+	ReleaseResource( &Cache, pPaddle1 );
+	if( Cache.Count != 2 )
+	{
+		printf( "The paddle was not freed by its last release\n" );
+		Errors++;
+	}
+
+	pPaddle1 = AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+	if( !pPaddle1 || FilesRead != 4 )
+		Errors++;
+
+	// Shutdown frees what is still held
+	FreeResourceCache( &Cache );
+	if( Cache.Count || Cache.ppResources )
+	{
+		printf( "Resources were left after shutdown\n" );
+		Errors++;
+	}
+
+	// Time the game's loads with the paddle shared against loading it for each player
+	double Time[ 2 ] = { 0, 0 };
+	for( int r = 0 ; r < Rounds ; r++ )
+	{
+		for( int bShared = 0 ; bShared < 2 ; bShared++ )
+		{
+			double Start = Seconds();
+			InitResourceCache( &Cache, LoadMemoryResource, &FilesRead );
+
+			AcquireResource( &Cache, BgName );
+			if( bShared )
+			{
+				AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+				AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+			}
+			else
+			{
+				// No cache to ask, so the second paddle is loaded under its own name
+				AcquireSprite( &Cache, PaddleName, COLOR_KEY );
+				AcquireSprite( &Cache, ASSETS_FOLDER "/./paddle.bmp", COLOR_KEY );
+			}
+			AcquireSprite( &Cache, BallName, COLOR_KEY );
+
+			FreeResourceCache( &Cache );
+			Time[ bShared ] += Seconds() - Start;
+		}
+	}
+
+	printf( "Loading the game's sprites: %.1f us with both paddles loaded, %.1f us with one shared\n",
+			Time[ 0 ] / Rounds * 1e6, Time[ 1 ] / Rounds * 1e6 );
+
+	delete [] pPaddle;
+	delete [] pBall;
+	delete [] pBg;
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Background Asset Loading
+//====================================================
+
+// The resource cache's loader while an ASSETLOADER is running, the way LoadD3DResource() works
+// in the game: collected pixels are copied into a new surface, anything else is loaded there
+// and then.  pContext is the ASSETLOADER.
+ISurface32* LoadCollectedResource( const char* PathName, void* pContext )
+{
+	CMemorySurface32* pSurface = new CMemorySurface32;
+	CMemorySurface32* pDecoded = FindCollectedAsset( (ASSETLOADER*)pContext, PathName );
+
+	BOOL bOk;
+	if( pDecoded )
+	{
+		bOk = pSurface->Create( pDecoded->GetWidth(), pDecoded->GetHeight() );
+		if( bOk )
+			memcpy( pSurface->GetBits(), pDecoded->GetBits(), pDecoded->GetPitch() * pDecoded->GetHeight() );
+	}
+	else
+		bOk = LoadBmpFile( PathName, pSurface );
+
+	if( !bOk )
+	{
+		delete pSurface;
+		return 0;
+	}
+
+	return pSurface;
+}
+
+// Loads the game's bitmaps plus Extra full HD backgrounds, first one after another on this
+// thread, then on the background loader with Threads workers while this thread collects them.
+// Checks every pixel and shows when each file was ready.
+int BenchLoader( int Threads, int Extra )
+{
+	static ASSETLOADER Loader;
+	int Errors = 0;
+
+	if( Extra < 0 || Extra + 4 > ASSETLOADER_MAXASSETS )
+	{
+		printf( "Between 0 and %d extra backgrounds\n", ASSETLOADER_MAXASSETS - 4 );
+		return 1;
+	}
+
+	mkdir( ASSETS_FOLDER, 0777 );
+
+	// The font first, as in GameInit(), then the rest biggest first
+	const int Count = 4 + Extra;
+	char Paths[ ASSETLOADER_MAXASSETS ][ 64 ];
+	const char* pPaths[ ASSETLOADER_MAXASSETS ];
+	DWORD* pArt[ ASSETLOADER_MAXASSETS ];
+	int Widths[ ASSETLOADER_MAXASSETS ], Heights[ ASSETLOADER_MAXASSETS ];
+
+	for( int a = 0 ; a < Count ; a++ )
+	{
+		int e = a - 4;
+		switch( a )
+		{
+			case 0: sprintf( Paths[ a ], ASSETS_FOLDER "/font.bmp" ); Widths[ a ] = FONT_WIDTH; Heights[ a ] = FONT_HEIGHT; break;
+			case 1: sprintf( Paths[ a ], ASSETS_FOLDER "/space.bmp" ); Widths[ a ] = RES_WIDTH; Heights[ a ] = RES_HEIGHT; break;
+			case 2: sprintf( Paths[ a ], ASSETS_FOLDER "/paddle.bmp" ); Widths[ a ] = PADDLE_WIDTH; Heights[ a ] = PADDLE_HEIGHT; break;
+			case 3: sprintf( Paths[ a ], ASSETS_FOLDER "/ball.bmp" ); Widths[ a ] = BALL_WIDTH; Heights[ a ] = BALL_HEIGHT; break;
+			default: sprintf( Paths[ a ], ASSETS_FOLDER "/level%d.bmp", e ); Widths[ a ] = 1920; Heights[ a ] = 1080; break;
+		}
+
+		int Pixels = Widths[ a ] * Heights[ a ];
+		pArt[ a ] = new DWORD[ Pixels ];
+		pPaths[ a ] = Paths[ a ];
+
+		if( a == 0 )
+			MakeFont( pArt[ a ] );
+		else if( a == 2 || a == 3 )
+			MakeSprite( pArt[ a ], Widths[ a ], Heights[ a ], 0x00808080 );
+		else
+			for( int i = 0 ; i < Pixels ; i++ )
+				pArt[ a ][ i ] = ( i * 2654435761u + a ) & 0x00FFFFFF;
+
+		if( !WriteTestBmp( Paths[ a ], pArt[ a ], 0, Widths[ a ], Heights[ a ], 24, FALSE ) )
+		{
+			printf( "Could not write %s\n", Paths[ a ] );
+			return 1;
+		}
+	}
+
+	const RESOURCE* pResources[ ASSETLOADER_MAXASSETS ];
+	double Ready[ ASSETLOADER_MAXASSETS ];
+	RESOURCECACHE Cache;
+
+	printf( "%d bitmaps, %d of them full HD, %d loader threads\n", Count, Extra, Threads );
+
+	for( int bCold = 1 ; bCold >= 0 ; bCold-- )
+	{
+		for( int bAsync = 0 ; bAsync < 2 ; bAsync++ )
+		{
+			if( bCold )
+				for( int a = 0 ; a < Count ; a++ )
+					EvictFile( Paths[ a ] );
+
+			InitResourceCache( &Cache, LoadCollectedResource, &Loader );
+			memset( pResources, 0, sizeof( pResources ) );
+
+			double Start = Seconds(), FirstFrame = 0;
+
+			if( !bAsync )
+			{
+				for( int a = 0 ; a < Count ; a++ )
+				{
+					pResources[ a ] = AcquireResource( &Cache, Paths[ a ] );
+					Ready[ a ] = Seconds() - Start;
+				}
+
+				// The first frame waits for everything
+				FirstFrame = Seconds() - Start;
+			}
+			else
+			{
+				// The font, then the first frame, then the rest as they come in
+				pResources[ 0 ] = AcquireResource( &Cache, Paths[ 0 ] );
+				Ready[ 0 ] = FirstFrame = Seconds() - Start;
+
+				StartAssetLoader( &Loader, pPaths + 1, Count - 1, Threads );
+				while( !IsAssetLoaderDone( &Loader ) )
+				{
+					int Index = CollectAsset( &Loader );
+					if( Index < 0 )
+					{
+						std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+						continue;
+					}
+
+					pResources[ Index + 1 ] = AcquireResource( &Cache, Paths[ Index + 1 ] );
+					Ready[ Index + 1 ] = Seconds() - Start;
+				}
+			}
+
+			double Total = Seconds() - Start;
+
+			for( int a = 0 ; a < Count ; a++ )
+			{
+				CMemorySurface32* pSurface = pResources[ a ] ? (CMemorySurface32*)pResources[ a ]->pSurface : 0;
+				if( !pSurface || !SurfaceMatches( pSurface, pArt[ a ], Widths[ a ], Heights[ a ] ) )
+				{
+					printf( "%s loaded the wrong pixels\n", Paths[ a ] );
+					Errors++;
+				}
+			}
+
+			printf( "%-6s %-10s first frame %7.2f ms   all loaded %7.2f ms\n", bCold ? "cold" : "cached",
+					bAsync ? "background" : "in turn", FirstFrame * 1000, Total * 1000 );
+
+			// Where the time went, once
+			if( bAsync && bCold )
+			{
+				for( int i = 0 ; i < Loader.Count ; i++ )
+				{
+					const ASSETLOAD* pLoad = &Loader.Loads[ i ];
+					printf( "       %-28s loader %d   waited %6.2f ms   decoded in %6.2f ms   ready at %6.2f ms\n",
+							pLoad->PathName, pLoad->Thread, HrClockToNs( pLoad->Started - Loader.StartTime ) / 1e6,
+							HrClockToNs( pLoad->Decoded - pLoad->Started ) / 1e6, Ready[ i + 1 ] * 1000 );
+				}
+			}
+
+			if( bAsync )
+				StopAssetLoader( &Loader );
+			FreeResourceCache( &Cache );
+		}
+	}
+
+	for( int a = 0 ; a < Count ; a++ )
+		delete [] pArt[ a ];
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Input Ring Check
+//====================================================
+
+#define INPUT_TICKNS	1000000		// 1000 ticks a second, on a nanosecond clock
+
+struct INPUTTAP
+{
+	INT64 Down, Up;			// Nanoseconds from the start of the script
+	unsigned int Button;
+	int DownTick, UpTick;	// The ticks they happen in
+};
+
+int CompareInputEvents( const void* a, const void* b )
+{
+	INT64 x = ( (const INPUTEVENT*)a )->Time, y = ( (const INPUTEVENT*)b )->Time;
+	return x < y ? -1 : ( x > y ? 1 : 0 );
+}
+
+// Makes Taps random presses of the ten buttons, from 50 us to 40 ms long, a few ms apart.  The
+// same button is never pressed again before it is let go.  pEvents needs room for Taps * 2.
+// Returns how long the script runs, in ns.
+INT64 MakeInputScript( INPUTTAP* pTaps, INPUTEVENT* pEvents, int Taps, DWORD Seed )
+{
+	PONGRNG Rng;
+	PongRngSeed( &Rng, Seed );
+
+	INT64 Free[ 10 ] = { 0 };
+	INT64 Time = INPUT_TICKNS / 2, End = 0;
+
+	for( int i = 0 ; i < Taps ; i++ )
+	{
+		int b = PongRngNext( &Rng ) % 10;
+		Time += PongRngNext( &Rng ) % 8000000;
+
+		INPUTTAP* pTap = &pTaps[ i ];
+		pTap->Button = PONGINPUT_P1_UP << b;
+		pTap->Down = Time > Free[ b ] ? Time : Free[ b ];
+		pTap->Up = pTap->Down + 50000 + PongRngNext( &Rng ) % 40000000;
+
+		// A tick covers the times after the end of the tick before it, up to its own end
+		pTap->DownTick = (int)( ( pTap->Down - 1 ) / INPUT_TICKNS );
+		pTap->UpTick = (int)( ( pTap->Up - 1 ) / INPUT_TICKNS );
+		Free[ b ] = pTap->Up + 1;
+
+		pEvents[ i * 2 ].Time = pTap->Down;
+		pEvents[ i * 2 ].Buttons = pTap->Button;
+		pEvents[ i * 2 ].bDown = TRUE;
+		pEvents[ i * 2 + 1 ].Time = pTap->Up;
+		pEvents[ i * 2 + 1 ].Buttons = pTap->Button;
+		pEvents[ i * 2 + 1 ].bDown = FALSE;
+
+		if( pTap->Up > End )
+			End = pTap->Up;
+	}
+
+	qsort( pEvents, Taps * 2, sizeof( INPUTEVENT ), CompareInputEvents );
+	return End;
+}
+
+// The input every tick should get: what is held at its end, and whatever was pressed during it
+void IdealTickInputs( const INPUTEVENT* pEvents, int Count, unsigned int* pInputs, int Ticks )
+{
+	unsigned int Held = 0;
+	int e = 0;
+
+	for( int t = 0 ; t < Ticks ; t++ )
+	{
+		unsigned int Pressed = 0;
+		for( ; e < Count && pEvents[ e ].Time <= (INT64)( t + 1 ) * INPUT_TICKNS ; e++ )
+		{
+			if( pEvents[ e ].bDown )
+			{
+				Held |= pEvents[ e ].Buttons;
+				Pressed |= pEvents[ e ].Buttons;
+			}
+			else
+				Held &= ~pEvents[ e ].Buttons;
+		}
+		pInputs[ t ] = Held | Pressed;
+	}
+}
+
+// How many taps no tick ever saw, and the average number of ticks late the rest were seen
+int CountMissedTaps( const INPUTTAP* pTaps, int Taps, const unsigned int* pInputs, int Ticks, double* pTicksLate )
+{
+	int Missed = 0;
+	double Late = 0;
+
+	for( int i = 0 ; i < Taps ; i++ )
+	{
+		// Seen if any tick from the press until the game caught up with the release had it
+		int t = pTaps[ i ].DownTick;
+		int Last = pTaps[ i ].UpTick + 100;
+		while( t < Ticks && t <= Last && !( pInputs[ t ] & pTaps[ i ].Button ) )
+			t++;
+
+		if( t >= Ticks || t > Last )
+			Missed++;
+		else
+			Late += t - pTaps[ i ].DownTick;
+	}
+
+	*pTicksLate = Taps > Missed ? Late / ( Taps - Missed ) : 0;
+	return Missed;
+}
+
+// Runs a script through the ring with frames FrameNs apart (0 for anything from 1 to 60 ms), on
+// a made up clock, and also the way the game used to: the keys held at the start of each frame
+// used for every tick in it.  Fills in each tick's input both ways.
+void RunInputFrames( const INPUTEVENT* pEvents, int Count, INT64 FrameNs, int Ticks, unsigned int* pRingInputs, unsigned int* pPolledInputs )
+{
+	static INPUTRING Ring;
+	INPUTSTATE State;
+	FIXEDSTEP Step;
+	PONGRNG Rng;
+
+	const INT64 Start = 1000000000;
+	CScriptedInput Source( pEvents, Count, Start );
+
+	InitInputRing( &Ring );
+	InitInputState( &State );
+	FixedStepInit( &Step, 1000000000, 1000000000 / INPUT_TICKNS );
+	PongRngSeed( &Rng, FrameNs );
+	FixedStepAdvance( &Step, Start );
+
+	int Tick = 0, e = 0;
+	unsigned int Held = 0;
+	INT64 Now = Start;
+
+	while( Tick < Ticks )
+	{
+		Now += FrameNs ? FrameNs : 1000000 + PongRngNext( &Rng ) % 59000000;
+
+		// What GetAsyncKeyState() would have said at the start of the frame
+		for( ; e < Count && Start + pEvents[ e ].Time <= Now ; e++ )
+			Held = pEvents[ e ].bDown ? ( Held | pEvents[ e ].Buttons ) : ( Held & ~pEvents[ e ].Buttons );
+
+		Source.Poll( &Ring, Now );
+
+		int Run = FixedStepAdvance( &Step, Now );
+		for( int i = 0 ; i < Run && Tick < Ticks ; i++, Tick++ )
+		{
+			pRingInputs[ Tick ] = ReadTickInput( &Ring, &State, FixedStepTickTime( &Step, Run, i ) );
+			pPolledInputs[ Tick ] = Held;
+		}
+	}
+}
+
+struct INPUTPRODUCER
+{
+	const INPUTEVENT* pEvents;
+	int Count;
+	INT64 Start;
+	INPUTRING* pRing;
+	std::atomic<BOOL> bDone;
+};
+
+// A source on a thread of its own, pushing each event when the real clock reaches it
+void InputProducer( INPUTPRODUCER* pProducer )
+{
+	CScriptedInput Source( pProducer->pEvents, pProducer->Count, pProducer->Start );
+
+	while( !Source.IsFinished() )
+	{
+		INT64 Wait = Source.NextTime() - HrClockNow();
+		if( Wait > 0 )
+			std::this_thread::sleep_for( std::chrono::nanoseconds( Wait < 1000000 ? Wait : 1000000 ) );
+
+		Source.Poll( pProducer->pRing, HrClockNow() );
+	}
+
+	pProducer->bDone.store( TRUE, std::memory_order_release );
+}
+
+// Checks every tick gets the input it should at any frame rate, counts the taps polling the
+// keyboard once a frame missed, then feeds the ring from another thread in real time
+int BenchInput( int Taps )
+{
+	INPUTTAP* pTaps = new INPUTTAP[ Taps ];
+	INPUTEVENT* pEvents = new INPUTEVENT[ Taps * 2 ];
+	INT64 Length = MakeInputScript( pTaps, pEvents, Taps, 1 );
+
+	int Ticks = (int)( Length / INPUT_TICKNS ) + 200;
+	unsigned int* pIdeal = new unsigned int[ Ticks ];
+	unsigned int* pRingInputs = new unsigned int[ Ticks ];
+	unsigned int* pPolledInputs = new unsigned int[ Ticks ];
+	IdealTickInputs( pEvents, Taps * 2, pIdeal, Ticks );
+
+	printf( "%d taps over %.1f s, at 1000 ticks a second\n", Taps, Length / 1e9 );
+
+	const char* Names[] = { "1000 fps", " 144 fps", "  60 fps", "  20 fps", "1 - 60 ms" };
+	INT64 FrameNs[] = { 1000000, 6944444, 16666667, 50000000, 0 };
+	int Errors = 0;
+
+	for( int s = 0 ; s < 5 ; s++ )
+	{
+		RunInputFrames( pEvents, Taps * 2, FrameNs[ s ], Ticks, pRingInputs, pPolledInputs );
+
+		int Wrong = 0, PolledWrong = 0;
+		for( int t = 0 ; t < Ticks ; t++ )
+		{
+			Wrong += pRingInputs[ t ] != pIdeal[ t ];
+			PolledWrong += pPolledInputs[ t ] != pIdeal[ t ];
+		}
+
+		double Late, PolledLate;
+		int Missed = CountMissedTaps( pTaps, Taps, pRingInputs, Ticks, &Late );
+		int PolledMissed = CountMissedTaps( pTaps, Taps, pPolledInputs, Ticks, &PolledLate );
+
+		printf( "%s: ring %d ticks wrong, %d taps missed, %.1f ticks late   polled %5d ticks wrong, %3d taps missed, %.1f ticks late\n",
+				Names[ s ], Wrong, Missed, Late, PolledWrong, PolledMissed, PolledLate );
+
+		if( Wrong || Missed )
+			Errors++;
+	}
+
+	// Now a real producer thread and a game drawing at about 60 fps, on the real clock.  Events can
+	// reach the ring after their tick has been run, if the producer is not scheduled in time, so
+	// only check nothing is lost and see how late things were.
+	int RealTaps = Taps < 300 ? Taps : 300;
+	Length = MakeInputScript( pTaps, pEvents, RealTaps, 2 );
+
+	static INPUTRING Ring;
+	INPUTSTATE State;
+	FIXEDSTEP Step;
+	InitInputRing( &Ring );
+	InitInputState( &State );
+	FixedStepInit( &Step, HrClockFrequency(), 1000 );
+
+	INPUTPRODUCER Producer;
+	Producer.pEvents = pEvents;
+	Producer.Count = RealTaps * 2;
+	Producer.pRing = &Ring;
+	Producer.bDone.store( FALSE );
+
+	INT64 Start = HrClockNow();
+	Producer.Start = Start;
+	FixedStepAdvance( &Step, Start );
+	std::thread Thread( InputProducer, &Producer );
+
+	int RealTicks = (int)( Length / INPUT_TICKNS ) + 200;
+	unsigned int* pInputs = new unsigned int[ RealTicks ];
+	int Tick = 0;
+
+	while( Tick < RealTicks )
+	{
+		std::this_thread::sleep_for( std::chrono::microseconds( 16667 ) );
+
+		INT64 Now = HrClockNow();
+		int Run = FixedStepAdvance( &Step, Now );
+		for( int i = 0 ; i < Run && Tick < RealTicks ; i++, Tick++ )
+			pInputs[ Tick ] = ReadTickInput( &Ring, &State, FixedStepTickTime( &Step, Run, i ) );
+	}
+
+	Thread.join();
+
+	double Late;
+	int Missed = CountMissedTaps( pTaps, RealTaps, pInputs, RealTicks, &Late );
+	printf( "Producer thread: %d taps, %d missed, %.2f ticks late on average\n", RealTaps, Missed, Late );
+	if( Missed || !Producer.bDone.load() )
+		Errors++;
+
+	// And what the ring costs
+	const int Rounds = 1000000;
+	double Begin = Seconds();
+	for( int i = 0 ; i < Rounds ; i++ )
+	{
+		PushInputEvent( &Ring, i, 1u << ( i & 7 ), i & 1 );
+		ReadTickInput( &Ring, &State, i );
+	}
+	printf( "Push and read: %.1f ns an event\n", ( Seconds() - Begin ) / Rounds * 1e9 );
+
+	delete [] pInputs;
+	delete [] pTaps;
+	delete [] pEvents;
+	delete [] pIdeal;
+	delete [] pRingInputs;
+	delete [] pPolledInputs;
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Sim Thread Check
+//====================================================
+
+#define SIMTHREAD_FPS		144		// The display the frames are paced to
+#define SIMTHREAD_HITCH		50		// Every this many frames, Present() takes 50 ms longer
+
+// What the drawing thread saw of one run
+struct SIMTHREADRUN
+{
+	int Frames;
+	int Snapshots;			// Frames that had a new snapshot
+	DWORD* pTicks;			// For each new snapshot, its tick and the hashes of Sim and PrevSim
+	DWORD* pHashes;
+	DWORD* pPrevHashes;
+
+	double TakeTime;		// Seconds spent in TakeSnapshot()
+	double MostTake;
+	int MostTicks;			// Most ticks the sim ran in one batch
+	DWORD Wakeups;			// Times the sim thread woke up
+	DWORD Ticks;
+	int Torn;				// Snapshots that do not match the recording
+
+	HISTOGRAM Latency;		// Key press to the Present() that showed it, ns
+};
+
+// Checks every snapshot the drawing thread took against the match played back from the recording.
+// A snapshot written to while it was read would not match.
+int CheckSnapshots( const REPLAY* pReplay, const SIMTHREADRUN* pRun )
+{
+	DWORD* pTickHashes = new DWORD[ pReplay->TickCount + 1 ];
+
+	PONGSIM Sim;
+	PongSimInit( &Sim, pReplay->Seed, pReplay->TickRate );
+	pTickHashes[ 0 ] = PongSimHash( &Sim );
+
+	DWORD Pos = 0;
+	unsigned int Input = 0;
+	DWORD Length;
+
+	while( Sim.Tick < pReplay->TickCount && ReplayNextRun( pReplay->pData, pReplay->DataSize, &Pos, &Input, &Length ) )
+	{
+		for( DWORD i = 0 ; i < Length && Sim.Tick < pReplay->TickCount ; i++ )
+		{
+			PongSimStep( &Sim, Input );
+			pTickHashes[ Sim.Tick ] = PongSimHash( &Sim );
+		}
+	}
+
+	int Torn = 0;
+	for( int i = 0 ; i < pRun->Snapshots ; i++ )
+	{
+		DWORD Tick = pRun->pTicks[ i ];
+		if( Tick > Sim.Tick || pRun->pHashes[ i ] != pTickHashes[ Tick ] ||
+			pRun->pPrevHashes[ i ] != pTickHashes[ Tick ? Tick - 1 : 0 ] )
+			Torn++;
+	}
+
+	delete [] pTickHashes;
+	return Torn;
+}
+
+// Plays the script as a match and draws it at SIMTHREAD_FPS with a hitch every SIMTHREAD_HITCH
+// frames, with the sim on its own thread, or (bThreaded FALSE) run at the start of each frame
+// the way the game used to.  The wait for the next frame stands in for Present().
+void RunSimThreadFrames( BOOL bThreaded, const INPUTEVENT* pEvents, int Count, INT64 LengthNs, int MaxFrames, SIMTHREADRUN* pRun )
+{
+	static SIMTHREAD Thread;
+	static INPUTRING Ring;
+	static GAMEART Art;
+	static TEXTBATCH Text;
+	static DIRTYTRACKER Tracker;
+	CMemorySurface32 Back;
+	COMPOSEFRAME Frame;
+	REPLAY Replay;
+
+	LoadGameArt( &Art );
+	Back.Create( RES_WIDTH, RES_HEIGHT );
+	InitDirtyTracker( &Tracker, RES_WIDTH, RES_HEIGHT );
+
+	INT64 Start = HrClockNow();
+	CScriptedInput Source( pEvents, Count, Start );
+
+	InitInputRing( &Ring );
+	memset( &Replay, 0, sizeof( Replay ) );
+	BeginReplayRecord( &Replay, 1, 1000 );
+	InitSimThread( &Thread, 1, 1000, &Ring, &Source, &Replay );
+	ClearHistogram( &pRun->Latency );
+
+	if( bThreaded )
+		StartSimThread( &Thread );
+	else
+		StartSimClock( &Thread, Start );
+
+	pRun->Frames = pRun->Snapshots = 0;
+	pRun->TakeTime = pRun->MostTake = 0;
+
+	INT64 FrameCounts = HrClockFrequency() / SIMTHREAD_FPS;
+	INT64 NextFrame = Start;
+	INT64 LastPressTime = 0;
+
+	while( HrClockNow() - Start < LengthNs + 500000000 && pRun->Frames < MaxFrames )
+	{
+		INT64 Now = HrClockNow();
+		if( !bThreaded )
+			RunSimBatch( &Thread, Now );
+
+		BOOL bNew;
+		double Begin = Seconds();
+		const SIMSNAPSHOT* pSnapshot = TakeSnapshot( &Thread.Snapshots, &bNew );
+		double Took = Seconds() - Begin;
+
+		pRun->TakeTime += Took;
+		if( Took > pRun->MostTake )
+			pRun->MostTake = Took;
+
+		if( bNew )
+		{
+			pRun->pTicks[ pRun->Snapshots ] = pSnapshot->Sim.Tick;
+			pRun->pHashes[ pRun->Snapshots ] = PongSimHash( &pSnapshot->Sim );
+			pRun->pPrevHashes[ pRun->Snapshots ] = PongSimHash( &pSnapshot->PrevSim );
+			pRun->Snapshots++;
+		}
+
+		HUDINFO Hud = { pRun->Frames, Tracker.PixelsTouched, pSnapshot->bCanQuit, FALSE, 0 };
+		BuildGameFrame( &Frame, &Art, &Text, &pSnapshot->PrevSim, &pSnapshot->Sim, SnapshotAlpha( pSnapshot, Now ), &Hud );
+		ComposeFrame( &Frame, &Tracker, &Back, TRUE );
+
+		// Present() waits for the next refresh, and now and then for much longer
+		NextFrame += FrameCounts;
+		if( pRun->Frames % SIMTHREAD_HITCH == SIMTHREAD_HITCH - 1 )
+			NextFrame += HrClockFrequency() / 20;
+
+		INT64 Wait = HrClockToNs( NextFrame - HrClockNow() );
+		if( Wait > 0 )
+			std::this_thread::sleep_for( std::chrono::nanoseconds( Wait ) );
+		else
+			NextFrame = HrClockNow();
+
+		// The first frame to show a key press is on the screen
+		if( pSnapshot->PressTime != LastPressTime )
+		{
+			RecordHistogram( &pRun->Latency, HrClockToNs( HrClockNow() - pSnapshot->PressTime ) );
+			LastPressTime = pSnapshot->PressTime;
+		}
+
+		pRun->Frames++;
+	}
+
+	StopSimThread( &Thread );
+	EndReplayRecord( &Replay, &Thread.Sim );
+
+	pRun->MostTicks = Thread.MostTicks;
+	pRun->Wakeups = Thread.Wakeups;
+	pRun->Ticks = Thread.Sim.Tick;
+	pRun->Torn = CheckSnapshots( &Replay, pRun );
+
+	FreeReplay( &Replay );
+	FreeGameArt( &Art );
+}
+
+// Plays a scripted match with the sim run at the start of each frame, then on its own thread, and
+// checks every snapshot drawn was whole, how long the drawing thread waited for them, how far the
+// ticks bunched up behind slow frames, and how long key presses took to reach the screen
+int BenchSimThread( int Seconds )
+{
+	int Taps = Seconds * 250;
+	INPUTTAP* pTaps = new INPUTTAP[ Taps ];
+	INPUTEVENT* pEvents = new INPUTEVENT[ Taps * 2 ];
+	INT64 Length = MakeInputScript( pTaps, pEvents, Taps, 3 );
+
+	int MaxFrames = (int)( ( Length / 1000000 + 1000 ) * SIMTHREAD_FPS / 1000 );
+	static SIMTHREADRUN Run;
+	Run.pTicks = new DWORD[ MaxFrames ];
+	Run.pHashes = new DWORD[ MaxFrames ];
+	Run.pPrevHashes = new DWORD[ MaxFrames ];
+
+	InitBlitters( );
+	printf( "%d taps over %.1f s, 1000 ticks a second, drawn at %d fps with a 50 ms hitch every %d frames\n",
+			Taps, Length / 1e9, SIMTHREAD_FPS, SIMTHREAD_HITCH );
+
+	const char* Names[] = { "Sim each frame", "Sim thread    " };
+	int Errors = 0;
+
+	for( int m = 0 ; m < 2 ; m++ )
+	{
+		RunSimThreadFrames( m, pEvents, Taps * 2, Length, MaxFrames, &Run );
+
+		printf( "%s: %d frames, %d new snapshots, %u ticks, %d torn, most ticks in a batch %d\n", Names[ m ],
+				Run.Frames, Run.Snapshots, Run.Ticks, Run.Torn, Run.MostTicks );
+		printf( "                taking a snapshot %.0f ns on average, %.1f us at most\n",
+				Run.TakeTime / Run.Frames * 1e9, Run.MostTake * 1e6 );
+		if( m )
+			printf( "                sim thread woke %u times for %u ticks\n", Run.Wakeups, Run.Ticks );
+		printf( "                key press to present (ms) p50 %.1f  p99 %.1f  max %.1f  over %u presses\n",
+				HistogramPercentile( &Run.Latency, 0.5 ) / 1e6, HistogramPercentile( &Run.Latency, 0.99 ) / 1e6,
+				Run.Latency.Max.load() / 1e6, Run.Latency.Count.load() );
+
+		if( Run.Torn || !Run.Snapshots )
+			Errors++;
+	}
+
+	delete [] Run.pTicks;
+	delete [] Run.pHashes;
+	delete [] Run.pPrevHashes;
+	delete [] pTaps;
+	delete [] pEvents;
+
+	printf( "%s\n", Errors ? "FAILED" : "OK" );
+	return Errors ? 1 : 0;
+}
+
+
+//====================================================
+// Entry Point
+//====================================================
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 )
+	{
+		printf( "Usage: headless blit|sprite|text|dirty|compose|hud|bands|sim|batch|collide|timestep|timers|histogram|trace|tourney|replay|play|archive|capture|export|assets|pack|resources|loader|input|simthread [iterations]\n" );
+		return 1;
+	}
+
+	if( MATCH( argv[1], "blit" ) )
+		return BenchBlit( argc > 2 ? atoi( argv[2] ) : 1000 );
+
+	if( MATCH( argv[1], "sprite" ) )
+		return BenchSprite( argc > 2 ? atoi( argv[2] ) : 10000 );
+
+	if( MATCH( argv[1], "text" ) )
+		return BenchText( argc > 2 ? atoi( argv[2] ) : 100000 );
+
+	if( MATCH( argv[1], "dirty" ) )
+		return BenchDirty( argc > 2 ? atoi( argv[2] ) : 1000 );
+
+	if( MATCH( argv[1], "compose" ) )
+		return BenchCompose( argc > 2 ? atoi( argv[2] ) : 10000 );
+
+	if( MATCH( argv[1], "hud" ) )
+		return BenchHud( argc > 2 ? atoi( argv[2] ) : 10000 );
+
+	if( MATCH( argv[1], "bands" ) )
+		return BenchBands( argc > 2 ? atoi( argv[2] ) : 0, argc > 3 ? atoi( argv[3] ) : 200 );
+
+	if( MATCH( argv[1], "sim" ) )
+		return BenchSim( argc > 2 ? atoi( argv[2] ) : 100000000, argc > 3 ? atoi( argv[3] ) : PONGSIM_BASE_RATE );
+
+	if( MATCH( argv[1], "batch" ) )
+		return BenchBatch( argc > 2 ? atoi( argv[2] ) : 4096, argc > 3 ? atoi( argv[3] ) : 20000 );
+
+	if( MATCH( argv[1], "collide" ) )
+		return BenchCollide();
+
+	if( MATCH( argv[1], "timestep" ) )
+		return BenchTimestep( argc > 2 ? atoi( argv[2] ) : 1000 );
+
+	if( MATCH( argv[1], "timers" ) )
+		return BenchTimers( argc > 2 ? atoi( argv[2] ) : 1000000 );
+
+	if( MATCH( argv[1], "histogram" ) )
+		return BenchHistogram( argc > 2 ? atoi( argv[2] ) : 10000000 );
+
+	if( MATCH( argv[1], "trace" ) )
+		return BenchTrace( argc > 2 ? atoi( argv[2] ) : 10000000 );
+
+	if( MATCH( argv[1], "tourney" ) )
+		return BenchTourney( argc > 2 ? atoi( argv[2] ) : 0, argc > 3 ? atoi( argv[3] ) : 10 );
+
+	if( MATCH( argv[1], "replay" ) )
+		return BenchReplay( argc > 2 ? atoi( argv[2] ) : 600 );
+
+	if( MATCH( argv[1], "play" ) && argc > 2 )
+		return PlayReplayFile( argv[2] );
+
+	if( MATCH( argv[1], "archive" ) )
+		return BenchArchive( argc > 2 ? atoi( argv[2] ) : 100 );
+
+	if( MATCH( argv[1], "capture" ) )
+		return BenchCapture( argc > 2 ? atoi( argv[2] ) : 2000 );
+
+	if( MATCH( argv[1], "export" ) )
+		return BenchExport( argc > 2 ? atoi( argv[2] ) : 5000, argc > 3 ? atoi( argv[3] ) : 2 );
+
+	if( MATCH( argv[1], "assets" ) )
+		return BenchAssets( argc > 2 ? atoi( argv[2] ) : 20 );
+
+	if( MATCH( argv[1], "pack" ) && argc > 3 )
+		return MakeAssetPack( argv[2], (const char**)argv + 3, argc - 3 );
+
+	if( MATCH( argv[1], "resources" ) )
+		return BenchResources( argc > 2 ? atoi( argv[2] ) : 100 );
+
+	if( MATCH( argv[1], "loader" ) )
+		return BenchLoader( argc > 2 ? atoi( argv[2] ) : 4, argc > 3 ? atoi( argv[3] ) : 8 );
+
+	if( MATCH( argv[1], "input" ) )
+		return BenchInput( argc > 2 ? atoi( argv[2] ) : 2000 );
+
+	if( MATCH( argv[1], "simthread" ) )
+		return BenchSimThread( argc > 2 ? atoi( argv[2] ) : 5 );
+
+	printf( "Unknown mode '%s'\n", argv[1] );
+	return 1;
+}
@@ -0,0 +1,55 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// A high resolution clock that works the same on Windows and in the
+// headless tools.  On Windows it is QueryPerformanceCounter().
+
+#ifndef HRCLOCK_H
+#define HRCLOCK_H
+
+#include "platform.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+// Clock counts per second
+inline INT64 HrClockFrequency()
+{
+#ifdef _WIN32
+	static INT64 Frequency = 0;
+	if( Frequency == 0 )
+		QueryPerformanceFrequency( (LARGE_INTEGER*)&Frequency );
+	return Frequency;
+#else
+	return 1000000000;
+#endif
+}
+
+// The current count
+inline INT64 HrClockNow()
+{
+#ifdef _WIN32
+	INT64 Count;
+	QueryPerformanceCounter( (LARGE_INTEGER*)&Count );
+	return Count;
+#else
+	timespec Time;
+	clock_gettime( CLOCK_MONOTONIC, &Time );
+	return (INT64)Time.tv_sec * 1000000000 + Time.tv_nsec;
+#endif
+}
+
+// Converts a number of counts to nanoseconds
+inline INT64 HrClockToNs( INT64 Counts )
+{
+	INT64 Frequency = HrClockFrequency();
+
+	// Split so the multiply cannot overflow for long spans
+	return ( Counts / Frequency ) * 1000000000 + ( Counts % Frequency ) * 1000000000 / Frequency;
+}
+
+#endif	// HRCLOCK_H
@@ -0,0 +1,214 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// The HUD layer.  Text that sits in the same place every frame is drawn
+// once into an overlay the size of the screen, which is the color key
+// everywhere nothing is written, and the overlay is laid over the frame.
+// Each field remembers what it shows, so when a number changes only the
+// letters that are different are drawn again.  Labels are never redrawn.
+//
+// The overlay keeps its own copy of the font, so changing a field never
+// has to lock a Direct3D surface.
+
+#ifndef HUD_H
+#define HUD_H
+
+#include <string.h>
+#include "platform.h"
+#include "blit.h"
+#include "text.h"
+#include "surface.h"
+
+#define HUD_MAXFIELDS	16
+#define HUD_MAXCELLS	32		// Most letters in a field
+#define HUD_MAXCHANGED	32		// Changed rectangles kept per frame
+
+// A piece of text at a fixed place, Cells letters wide
+struct HUDFIELD
+{
+	int x, y;
+	int Cells;
+	char Text[ HUD_MAXCELLS ];	// What the overlay shows now, a space where it is blank
+};
+
+struct HUDLAYER
+{
+	CMemorySurface32 Overlay;	// ColorKey wherever no letter is drawn
+	CMemorySurface32 Font;		// Copy of the font the letters come from
+	FONTATLAS Atlas;
+	DWORD ColorKey;
+
+	int FieldCount;
+	HUDFIELD Fields[ HUD_MAXFIELDS ];
+
+	// Since BeginHudFrame()
+	int ChangedCount;
+	RECT Changed[ HUD_MAXCHANGED ];	// Letters redrawn in the overlay, which the frame has to redraw
+	int CellsDrawn;
+};
+
+// Makes an empty Width x Height overlay using a copy of pFont.  Returns FALSE if the font
+// cannot be locked.
+BOOL InitHudLayer( HUDLAYER* pHud, int Width, int Height, const FONTATLAS* pAtlas, ISurface32* pFont, DWORD ColorKey )
+{
+	pHud->FieldCount = 0;
+	pHud->ChangedCount = 0;
+	pHud->CellsDrawn = 0;
+	pHud->Atlas = *pAtlas;
+	pHud->ColorKey = ColorKey;
+
+	if( !pHud->Overlay.Create( Width, Height ) || !pHud->Font.Create( pFont->GetWidth(), pFont->GetHeight() ) )
+		return FALSE;
+
+	if( !SurfaceCopy( NULL, pFont, NULL, &pHud->Font, FALSE, 0 ) )
+		return FALSE;
+
+	RECT All = { 0, 0, Width, Height };
+	FillRect32( pHud->Overlay.GetBits(), pHud->Overlay.GetPitch(), All, ColorKey );
+	return TRUE;
+}
+
+void FreeHudLayer( HUDLAYER* pHud )
+{
+	pHud->Overlay.Release();
+	pHud->Font.Release();
+	pHud->FieldCount = 0;
+}
+
+// Starts a new frame's list of changes
+inline void BeginHudFrame( HUDLAYER* pHud )
+{
+	pHud->ChangedCount = 0;
+	pHud->CellsDrawn = 0;
+}
+
+// The area a field covers on the screen
+inline void GetHudFieldRect( const HUDLAYER* pHud, int Field, RECT* pRect )
+{
+	const HUDFIELD* pField = &pHud->Fields[ Field ];
+	SetRect( pRect, pField->x, pField->y, pField->x + pField->Cells * pHud->Atlas.LetterWidth, pField->y + pHud->Atlas.LetterHeight );
+}
+
+// Draws one letter of a field into the overlay and adds it to the changes
+void DrawHudCell( HUDLAYER* pHud, int Field, int Cell, unsigned char Char )
+{
+	const HUDFIELD* pField = &pHud->Fields[ Field ];
+	int LetterWidth = pHud->Atlas.LetterWidth;
+	int LetterHeight = pHud->Atlas.LetterHeight;
+
+	RECT CellRect = { pField->x + Cell * LetterWidth, pField->y, pField->x + ( Cell + 1 ) * LetterWidth, pField->y + LetterHeight };
+
+	// Clip to the overlay
+	RECT Clipped = CellRect;
+	if( Clipped.left < 0 ) Clipped.left = 0;
+	if( Clipped.top < 0 ) Clipped.top = 0;
+	if( Clipped.right > pHud->Overlay.GetWidth() ) Clipped.right = pHud->Overlay.GetWidth();
+	if( Clipped.bottom > pHud->Overlay.GetHeight() ) Clipped.bottom = pHud->Overlay.GetHeight();
+	if( Clipped.left >= Clipped.right || Clipped.top >= Clipped.bottom )
+		return;
+
+	// The whole cell is written, so nothing of the old letter is left
+	if( pHud->Atlas.bHasGlyph[ Char ] )
+	{
+		RECT GlyphRect = { pHud->Atlas.GlyphX[ Char ], pHud->Atlas.GlyphY[ Char ],
+						   pHud->Atlas.GlyphX[ Char ] + LetterWidth, pHud->Atlas.GlyphY[ Char ] + LetterHeight };
+		POINT DestPoint = { CellRect.left, CellRect.top };
+
+		Blit32( pHud->Font.GetBits(), pHud->Font.GetPitch(), GlyphRect, pHud->Overlay.GetBits(), pHud->Overlay.GetPitch(),
+				pHud->Overlay.GetWidth(), pHud->Overlay.GetHeight(), DestPoint, FALSE, 0 );
+	}
+	else
+		FillRect32( pHud->Overlay.GetBits(), pHud->Overlay.GetPitch(), Clipped, pHud->ColorKey );
+
+	pHud->CellsDrawn++;
+
+	// Letters changed next to each other in a field make one rectangle
+	if( pHud->ChangedCount > 0 )
+	{
+		RECT* pLast = &pHud->Changed[ pHud->ChangedCount - 1 ];
+		if( pLast->top == Clipped.top && pLast->bottom == Clipped.bottom && pLast->right == Clipped.left )
+		{
+			pLast->right = Clipped.right;
+			return;
+		}
+	}
+
+	// Out of room, so the last one grows to cover it
+	if( pHud->ChangedCount == HUD_MAXCHANGED )
+	{
+		RECT* pLast = &pHud->Changed[ HUD_MAXCHANGED - 1 ];
+		if( Clipped.left < pLast->left ) pLast->left = Clipped.left;
+		if( Clipped.top < pLast->top ) pLast->top = Clipped.top;
+		if( Clipped.right > pLast->right ) pLast->right = Clipped.right;
+		if( Clipped.bottom > pLast->bottom ) pLast->bottom = Clipped.bottom;
+		return;
+	}
+
+	pHud->Changed[ pHud->ChangedCount++ ] = Clipped;
+}
+
+// Changes what a field shows.  Only the letters that differ from last time are drawn.  Text
+// longer than the field is cut off, and shorter text leaves the rest of the field blank.
+void SetHudText( HUDLAYER* pHud, int Field, const char* Text )
+{
+	HUDFIELD* pField = &pHud->Fields[ Field ];
+	BOOL bEnded = FALSE;
+
+	for( int c = 0 ; c < pField->Cells ; c++ )
+	{
+		if( !bEnded && !Text[ c ] )
+			bEnded = TRUE;
+
+		char Char = bEnded ? ' ' : Text[ c ];
+		if( Char == pField->Text[ c ] )
+			continue;
+
+		pField->Text[ c ] = Char;
+		DrawHudCell( pHud, Field, c, (unsigned char)Char );
+	}
+}
+
+// Shows a number in a field, left aligned.  Most frames nothing changes and nothing is drawn.
+void SetHudNumber( HUDLAYER* pHud, int Field, int Value )
+{
+	char Digits[ 16 ];
+	char Text[ 16 ];
+	int Count = 0, Length = 0;
+
+	unsigned int Magnitude = Value < 0 ? 0u - (unsigned int)Value : (unsigned int)Value;
+	do
+	{
+		Digits[ Count++ ] = (char)( '0' + Magnitude % 10 );
+		Magnitude /= 10;
+	}
+	while( Magnitude );
+
+	if( Value < 0 )
+		Text[ Length++ ] = '-';
+	while( Count )
+		Text[ Length++ ] = Digits[ --Count ];
+	Text[ Length ] = 0;
+
+	SetHudText( pHud, Field, Text );
+}
+
+// Adds a field Cells letters wide showing Text.  Returns its index, or -1 if there is no room.
+int AddHudField( HUDLAYER* pHud, int x, int y, int Cells, const char* Text )
+{
+	if( pHud->FieldCount >= HUD_MAXFIELDS || Cells <= 0 || Cells > HUD_MAXCELLS )
+		return -1;
+
+	HUDFIELD* pField = &pHud->Fields[ pHud->FieldCount ];
+	pField->x = x;
+	pField->y = y;
+	pField->Cells = Cells;
+	memset( pField->Text, ' ', sizeof( pField->Text ) );
+
+	SetHudText( pHud, pHud->FieldCount, Text );
+	return pHud->FieldCount++;
+}
+
+#endif	// HUD_H
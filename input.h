@@ -0,0 +1,168 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Timestamped input.  Whatever makes the input (the keyboard, a script, a
+// bot) pushes every button going down or up into an INPUTRING with the
+// clock count it happened at.  The game takes them out a tick at a time
+// with ReadTickInput(), so a press counts from the tick it happened in,
+// however long the frame was, and a press shorter than a tick still shows
+// for one tick instead of being missed.
+//
+// The ring has one producer and one consumer and never locks, so a source
+// can run on a thread of its own.  Times are HrClockNow() counts, the same
+// clock FIXEDSTEP runs on.
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <string.h>
+#include <atomic>
+#include "platform.h"
+
+#define INPUTRING_SIZE		256			// Events that can wait, must be a power of two
+
+struct INPUTEVENT
+{
+	INT64 Time;					// When it happened
+	unsigned int Buttons;		// PONGINPUT_ flags
+	BOOL bDown;					// Pressed, or released
+};
+
+struct INPUTRING
+{
+	INPUTEVENT Events[ INPUTRING_SIZE ];		// Event n goes in Events[ n % INPUTRING_SIZE ]
+
+	alignas( 64 ) std::atomic<DWORD> Head;	// Events pushed (only the source writes it)
+	alignas( 64 ) std::atomic<DWORD> Tail;	// Events taken (only the game writes it)
+};
+
+// What the game has taken out of the ring so far
+struct INPUTSTATE
+{
+	unsigned int Held;			// Buttons down
+	unsigned int Pressed;		// Buttons pressed since the last tick, even if already let go
+	INT64 PressTime;			// When the first of the last tick's presses happened, 0 if none
+};
+
+inline void InitInputRing( INPUTRING* pRing )
+{
+	pRing->Head.store( 0, std::memory_order_relaxed );
+	pRing->Tail.store( 0, std::memory_order_relaxed );
+}
+
+inline void InitInputState( INPUTSTATE* pState )
+{
+	memset( pState, 0, sizeof( INPUTSTATE ) );
+}
+
+// Source side.  Returns FALSE if the ring is full and the event was not added.
+inline BOOL PushInputEvent( INPUTRING* pRing, INT64 Time, unsigned int Buttons, BOOL bDown )
+{
+	DWORD Head = pRing->Head.load( std::memory_order_relaxed );
+	if( Head - pRing->Tail.load( std::memory_order_acquire ) >= INPUTRING_SIZE )
+		return FALSE;
+
+	INPUTEVENT* pEvent = &pRing->Events[ Head & ( INPUTRING_SIZE - 1 ) ];
+	pEvent->Time = Time;
+	pEvent->Buttons = Buttons;
+	pEvent->bDown = bDown;
+
+	// Release, so the event is all there before the game sees the new head
+	pRing->Head.store( Head + 1, std::memory_order_release );
+	return TRUE;
+}
+
+// Game side.  Takes every event that happened up to TickEnd, the clock count the tick being run
+// ends at, and returns the PONGINPUT_ flags for the tick: the buttons held, and any pressed
+// during it.
+unsigned int ReadTickInput( INPUTRING* pRing, INPUTSTATE* pState, INT64 TickEnd )
+{
+	DWORD Tail = pRing->Tail.load( std::memory_order_relaxed );
+	DWORD Head = pRing->Head.load( std::memory_order_acquire );
+
+	pState->PressTime = 0;
+
+	for( ; Tail != Head ; Tail++ )
+	{
+		const INPUTEVENT* pEvent = &pRing->Events[ Tail & ( INPUTRING_SIZE - 1 ) ];
+		if( pEvent->Time > TickEnd )
+			break;
+
+		if( pEvent->bDown )
+		{
+			pState->Held |= pEvent->Buttons;
+			pState->Pressed |= pEvent->Buttons;
+			if( !pState->PressTime )
+				pState->PressTime = pEvent->Time;
+		}
+		else
+			pState->Held &= ~pEvent->Buttons;
+	}
+
+	// Release, so the source does not reuse the slots until they have been read
+	pRing->Tail.store( Tail, std::memory_order_release );
+
+	unsigned int Input = pState->Held | pState->Pressed;
+	pState->Pressed = 0;
+	return Input;
+}
+
+// Game side, for when no ticks are being run (loading, or the ball is held after a point).
+// Keeps track of what is held up to Now but throws the presses away.
+inline void SkipInput( INPUTRING* pRing, INPUTSTATE* pState, INT64 Now )
+{
+	ReadTickInput( pRing, pState, Now );
+}
+
+//====================================================
+// Sources
+//====================================================
+
+// Something that makes input.  Poll() is called by the game once a pass through the game loop,
+// before the ticks are run, and pushes everything that has happened up to Now.  Sources that
+// are told about input as it happens (the keyboard, through window messages) push it then, and
+// need do nothing here.
+class IInputSource
+{
+public:
+	virtual ~IInputSource() {}
+
+	virtual void Poll( INPUTRING* pRing, INT64 Now ) = 0;
+};
+
+// Plays back a list of events, in time order, with times counted from Start.  Used to drive the
+// game's input in the headless tools.  If the ring is full it waits for the next Poll() instead
+// of losing anything.
+class CScriptedInput : public IInputSource
+{
+public:
+	CScriptedInput( const INPUTEVENT* pEvents, int Count, INT64 Start ) : m_pEvents( pEvents ), m_Count( Count ), m_Next( 0 ), m_Start( Start ) {}
+
+	void Poll( INPUTRING* pRing, INT64 Now )
+	{
+		while( m_Next < m_Count && m_Start + m_pEvents[ m_Next ].Time <= Now )
+		{
+			const INPUTEVENT* pEvent = &m_pEvents[ m_Next ];
+			if( !PushInputEvent( pRing, m_Start + pEvent->Time, pEvent->Buttons, pEvent->bDown ) )
+				break;
+
+			m_Next++;
+		}
+	}
+
+	BOOL IsFinished() const { return m_Next == m_Count; }
+
+	// When the next event is due, for a source running on a thread of its own to wait for
+	INT64 NextTime() const { return m_Next < m_Count ? m_Start + m_pEvents[ m_Next ].Time : 0; }
+
+private:
+	const INPUTEVENT* m_pEvents;
+	int m_Count;
+	int m_Next;
+	INT64 m_Start;
+};
+
+#endif	// INPUT_H
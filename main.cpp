@@ -27,6 +27,14 @@
 #include <d3d8.h>
 #include <d3dx8.h>
 #include "engine.h"
+#include "pongsim.h"
+#include "compose.h"
+#include "compositor.h"
+#include "timestep.h"
+#include "simthread.h"
+#include "replay.h"
+#include "framedump.h"
+#include "frameexport.h"
 #include "resource.h"
 
 // Namespace Declaration
@@ -37,14 +45,7 @@ using namespace std;
 // Constants
 //====================================================
 
-// Paddle & Ball Parameters
-#define PADDLE_WIDTH		19	// Width of the paddle bitmap
-#define PADDLE_HEIGHT		79	// Height of the paddle bitmap
-#define PADDLE_INITIAL_X	15	// Distance of the paddle from the side of the screen
-#define PADDLE_SPEED		6	// Number of pixels per key press the paddle moves
-#define BALL_WIDTH		30	// Width of the ball bitmap
-#define BALL_HEIGHT		30	// Height of the ball bitmap
-#define BALL_SPEED		1	// Number of pixels per tick the ball moves
+// Paddle, ball and screen sizes are in pongsim.h
 
 // Controls
 #define START			VK_SPACE		// 'START' Button
@@ -53,9 +54,9 @@ using namespace std;
 #define P2_UP			VK_TAB			// Player Two's 'UP' Button
 #define P2_DOWN			VK_LCONTROL		// Player Two's 'DOWN' Button
 
-// Window Resolution
-#define RES_WIDTH	640		// Window Width
-#define RES_HEIGHT	480		// Window Height
+// Default timing, both can be changed on the command line (-tickrate 1000 -fps 60)
+#define TICK_RATE		1000	// Simulation ticks per second
+#define RENDER_CAP		0		// Most frames drawn per second (0 is no limit)
 
 // Font Parameters
 #define FONT_LETTERW	8						// Width of each letter
@@ -64,9 +65,6 @@ using namespace std;
 #define FONT_WIDTH		80						// Width of the font pallate
 #define FONT_HEIGHT		160						// Height of the font pallate
 
-// Miscellanious
-#define MAX_SCORE	10		// How many points it takes to win
-
 const char g_AppName[] = "Sean's UBER_PONG v1.0";	// Application Name CHAR
 
 
@@ -74,29 +72,72 @@ const char g_AppName[] = "Sean's UBER_PONG v1.0";	// Application Name CHAR
 // Global Variables
 //====================================================
 
-POINT g_Paddle1;		// Global paddle structure
-POINT g_Paddle2;		// Global paddle structure
-POINT g_Ball;		// Global ball structure
+SIMTHREAD g_SimThread;		// Plays the match (ball, paddles and scores) on a thread of its own
+INT64 g_LastPressTime = 0;	// The newest key press a presented frame has shown
+
+FIXEDSTEP g_RenderStep;		// Decides when to draw
+int g_TickRate = TICK_RATE;
+int g_RenderCap = RENDER_CAP;
+
+// The game's controls
+const KEYBINDING g_KeyBindings[] =
+{
+	{ P1_UP, PONGINPUT_P1_UP },		{ P1_DOWN, PONGINPUT_P1_DOWN },		// Player One Controls
+	{ P2_UP, PONGINPUT_P2_UP },		{ P2_DOWN, PONGINPUT_P2_DOWN },		// Player Two Controls
+	{ VK_F1, PONGINPUT_SPEED1 },	{ VK_F2, PONGINPUT_SPEED2 },		// Adjust Ball Speed through F-Keys
+	{ VK_F3, PONGINPUT_SPEED3 },	{ VK_F4, PONGINPUT_SPEED4 },
+	{ VK_F5, PONGINPUT_SPEED5 },
+	{ START, PONGINPUT_START },
+};
+
+CKeyboardInput g_Keyboard( g_KeyBindings, sizeof( g_KeyBindings ) / sizeof( g_KeyBindings[ 0 ] ) );
+IInputSource* g_pInputSource = &g_Keyboard;		// Where the input comes from
+INPUTRING g_InputRing;			// Key changes waiting for the tick they happened in
+INPUTSTATE g_InputState;		// What the loading screen has thrown away of it
 
 HWND g_hWndMain;	// Global window handle
 HDC g_hDC;			// Global device context
 
-int g_p1Score = 0;	// Player one's score
-int g_p2Score = 0;	// Player two's score
+int g_PlayWinSound = 2;		// Controls winning sound
 
-int g_BallSpeed = BALL_SPEED;	// Variable to change ball speed
+BOOL g_bDirtyRects = TRUE;	// Only redraw the parts of the screen that changed
+BOOL g_bProfileOverlay = FALSE;	// Show the frame timings (F9)
+BOOL g_bTraceOnStart = FALSE;	// Start tracing straight away (-trace)
 
-int MultiplierX;	// Controls ball's x motion
-int MultiplierY;	// Controls ball's y motion
-int g_BounceCount;	// Controls ball's speed
+BANDCOMPOSITOR g_Compositor;	// Shares the drawing between threads
+int g_ComposeThreads = 1;		// Threads drawing each frame (-threads, 0 for one per core)
+DRAWSTATS g_DrawStats;			// Commands and locks used to draw the last frame
 
-int g_PlayWinSound = 2;		// Controls winning sound
+REPLAY g_Replay;				// Every tick's input, for playing the match back
+char g_ReplayFile[ 260 ] = "";	// Where the recording is saved on exit (-record file)
+
+FRAMEDUMP g_FrameDump;				// Every frame drawn, written out by another thread
+BOOL g_bCapturing = FALSE;			// Frames are going to capture.ufd (F11)
+BOOL g_bCaptureOnStart = FALSE;		// Start capturing straight away (-capture)
+
+FRAMEEXPORT g_FrameExport;			// Every frame drawn, in shared memory for other programs
+BOOL g_bExporting = FALSE;			// (-export)
 
 // Surfaces
-LPDIRECT3DSURFACE8 g_pBgSurf = 0;
-LPDIRECT3DSURFACE8 g_pPaddle1Surf = 0;
-LPDIRECT3DSURFACE8 g_pPaddle2Surf = 0;
-LPDIRECT3DSURFACE8 g_pBallSurf = 0;
+const RESOURCE* g_pBackground = 0;
+
+// The color keyed sprites, as span lists.  Both players share the one paddle bitmap.
+const RESOURCE* g_pPaddle1 = 0;
+const RESOURCE* g_pPaddle2 = 0;
+const RESOURCE* g_pBall = 0;
+
+// The graphics loaded in the background while the loading screen is up, biggest first
+enum { GRAPHIC_BACKGROUND, GRAPHIC_PADDLE, GRAPHIC_BALL, GRAPHIC_COUNT };
+const char* g_GraphicFiles[ GRAPHIC_COUNT ] = { "graphics\\space.bmp", "graphics\\paddle.bmp", "graphics\\ball.bmp" };
+
+BOOL g_bGraphicsReady = FALSE;		// Everything is loaded and the match can start
+
+// Text drawn each frame
+TEXTBATCH g_TextBatch;
+
+// The labels and numbers, only redrawn where they change
+HUDLAYER g_Hud;
+BOOL g_bHudReady = FALSE;
 
 
 //====================================================
@@ -107,20 +148,15 @@ LPDIRECT3DSURFACE8 g_pBallSurf = 0;
 int GameInit( void );
 int GameLoop( void );
 int GameShutdown( void );
-int Render( void );
-void MoveBall( void );
-void RandomDirection( void );
+DWORD GameIdleTime( void );
+int Render( const SIMSNAPSHOT* pSnapshot, int Alpha );
+int RenderLoadingFrame( void );
+void UpdateAssetLoading( void );
+void ReadCommandLine( char* CmdLine );
 
 // Miscellanious
 void Debug( char* String );
 
-// Pauses for specified number of ms
-void Pause( int Milliseconds )
-{
-	int Time = GetTickCount( );
-	while( (UINT)GetTickCount( ) - (UINT)Time < (UINT)Milliseconds ) {}
-}
-
 
 //====================================================
 // Windows Procedure Loop & Entry Point
@@ -141,15 +177,27 @@ long CALLBACK WndProc( HWND hWnd, UINT uMessage, WPARAM wParam, LPARAM lParam )
 			ValidateRect( hWnd, NULL );
 			return 0;
 		}
+		case WM_KEYDOWN:	// Straight into the input ring, with when it happened
+		case WM_KEYUP:
+		{
+			if( g_Keyboard.OnKeyMessage( &g_InputRing, uMessage, wParam, lParam ) )
+				return 0;
+			break;
+		}
+		case WM_KILLFOCUS:	// No key ups will come while another window has the keyboard
+		{
+			g_Keyboard.ReleaseAll( &g_InputRing );
+			break;
+		}
 		case WM_DESTROY:	// The main window is about to be closed
 		{
 			PostQuitMessage( 0 );
 			return 0;
 		}
-
-		default:			// Let windows handle an unknown message
-			return (long)DefWindowProc( hWnd, uMessage, wParam, lParam );
 	}
+
+	// Let windows handle an unknown message
+	return (long)DefWindowProc( hWnd, uMessage, wParam, lParam );
 }
 
 // Windows Entry Point
@@ -196,6 +244,7 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pstrCmdLi
 	ShowWindow( hWnd, iCmdShow );
 	UpdateWindow( hWnd );
 
+	ReadCommandLine( pstrCmdLine );
 	GameInit( );
 
 	// Start the message loop
@@ -212,8 +261,15 @@ int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pstrCmdLi
 			DispatchMessage( &msg );
 		}
 		else
+		{
 			// Nothing else is happening
 			GameLoop( );
+
+			// If there is nothing to do until a timed event, sleep until then (or until a message arrives)
+			DWORD Idle = GameIdleTime( );
+			if( Idle )
+				MsgWaitForMultipleObjects( 0, NULL, FALSE, Idle, QS_ALLINPUT );
+		}
 	}
 	
 	GameShutdown();
@@ -257,149 +313,324 @@ int GameInit()
 		return E_FAIL;
 	}	
 
-	srand( GetTickCount() );
 	InitTiming( );
+	InitBlitters( );
 
-	char PaddleImage[] = "graphics\\paddle.bmp";
-	char BallImage[] = "graphics\\ball.bmp";
-	char BgImage[] = "graphics\\space.bmp";
 	char FontImage[] = "graphics\\font.bmp";
+	char AssetPack[] = "graphics\\assets.pak";
 
-	// Load graphics
-	LoadBitmapToSurface( BgImage, &g_pBgSurf, g_pDevice );			// Background
-	LoadBitmapToSurface( PaddleImage, &g_pPaddle1Surf, g_pDevice );			// Paddle 1
-	LoadBitmapToSurface( PaddleImage, &g_pPaddle2Surf, g_pDevice );			// Paddle 2
-	LoadBitmapToSurface( BallImage, &g_pBallSurf, g_pDevice );		// Ball
+	// Load graphics, from the baked pack if there is one
+	BOOL bPacked = OpenGameAssetPack( AssetPack );
+	InitResourceCache( &g_Resources, LoadD3DResource, g_pDevice );
 
-	// Load font engine
+	// The font is tiny and the loading screen needs it, so it comes first
 	LoadAlphabet( FontImage, FONT_LETTERW, FONT_LETTERH );
+	RenderLoadingFrame( );
+
+	// Draw the HUD's labels once, with its own copy of the font
+	if( g_bAlphabetLoaded )
+	{
+		CD3DSurface32 FontSurface( g_pAlphabetSurface );
+		g_bHudReady = InitGameHud( &g_Hud, &g_FontAtlas, &FontSurface, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
+	}
+	if( !g_bHudReady )
+		Debug( "Could not make the HUD" );
+
+	// Everything else is decoded on other threads while the loading screen is up
+	if( !StartAssetLoader( &g_AssetLoader, g_GraphicFiles, GRAPHIC_COUNT, 0, bPacked ? &g_AssetPack : 0 ) )
+		Debug( "Could not start loading the graphics" );
+
+	// Set up the paddles and ball for a new match.  The keyboard pushes into the ring from here, so
+	// the sim thread has no source of its own to poll.
+	DWORD Seed = GetTickCount( );
+	InitInputRing( &g_InputRing );
+	InitInputState( &g_InputState );
+	InitSimThread( &g_SimThread, Seed, g_TickRate, &g_InputRing, 0, g_ReplayFile[ 0 ] ? &g_Replay : 0 );
+
+	if( g_ReplayFile[ 0 ] )
+		BeginReplayRecord( &g_Replay, Seed, g_SimThread.Sim.TickRate );
+
+	// Sleeps on both threads wake within a millisecond, not the default 15
+	timeBeginPeriod( 1 );
+	FixedStepInit( &g_RenderStep, g_Frequency, g_TickRate, g_RenderCap );
+	InitBandCompositor( &g_Compositor, g_ComposeThreads );
 
-	// Initialize player one's paddle
-	g_Paddle1.x = PADDLE_INITIAL_X;
-	g_Paddle1.y = ( RES_HEIGHT / 2 );
+	TraceNameThread( "Game" );
+	if( g_bTraceOnStart )
+		StartTrace( );
 
-	// Initialize player two's paddle
-	g_Paddle2.x = ( RES_WIDTH - PADDLE_INITIAL_X - PADDLE_WIDTH );
-	g_Paddle2.y = ( RES_HEIGHT / 2 );
+	if( g_bCaptureOnStart )
+		g_bCapturing = StartFrameDump( &g_FrameDump, "capture.ufd", RES_WIDTH, RES_HEIGHT );
 
-	// Initialize the Ball
-	RandomDirection( );
-	g_BounceCount = 0;
+	if( g_bExporting && !StartFrameExport( &g_FrameExport, RES_WIDTH, RES_HEIGHT ) )
+	{
+		Debug( "Could not make the shared memory for -export" );
+		g_bExporting = FALSE;
+	}
 			
 	return S_OK;
 }
 
 int GameLoop( )
 {
-	// Used for object synchronization
-	static Paddle1Time = 0;
-	static Paddle2Time = 0;
-	static BallTime = 0;
+	TRACE_SCOPE( "GameLoop" );
+
+	INT64 Now = 0;
+	QueryPerformanceCounter( (LARGE_INTEGER*)&Now );
 
-	// Check if this is the first time the loop has run
-	if( Paddle1Time == 0 )
-		Paddle1Time = 1;
-	if( Paddle2Time == 0 )
-		Paddle2Time = 1;
+	// Collect the input up to now.  The keyboard's is already in the ring.
+	g_pInputSource->Poll( &g_InputRing, Now );
 
-	// Check for keyboard input, and screen input to prevent breakage or tearing
+	// Escape
+	if( GetAsyncKeyState( VK_ESCAPE ) )
+		PostQuitMessage( 0 );
 
-	// Player One Controls
-	if( GetAsyncKeyState( P1_UP ) )
+	// Nothing moves until the graphics are in
+	if( !g_bGraphicsReady )
 	{
-		if( !( g_Paddle1.y == 15 ) )
-		{
-			if( ( GetTickCount( ) - Paddle1Time ) > 1 )
-			{
-				Paddle1Time = GetTickCount( );
-				g_Paddle1.y -= PADDLE_SPEED;
-			}
-		}
-		else
-			g_Paddle1.y = 15;
+		SkipInput( &g_InputRing, &g_InputState, Now );
+		UpdateAssetLoading( );
+		return S_OK;
 	}
-	if( GetAsyncKeyState( P1_DOWN ) )
+
+	// F9 shows and hides the frame timings
+	static BOOL bProfileKeyDown = FALSE;
+	BOOL bProfileKey = GetAsyncKeyState( VK_F9 ) ? TRUE : FALSE;
+	if( bProfileKey && !bProfileKeyDown )
+		g_bProfileOverlay = !g_bProfileOverlay;
+	bProfileKeyDown = bProfileKey;
+
+	// F10 starts a trace, and pressing it again saves it to trace.json
+	static BOOL bTraceKeyDown = FALSE;
+	BOOL bTraceKey = GetAsyncKeyState( VK_F10 ) ? TRUE : FALSE;
+	if( bTraceKey && !bTraceKeyDown )
 	{
-		if( !( g_Paddle1.y == ( RES_HEIGHT - PADDLE_HEIGHT - 15 ) ) )
+		if( g_bTracing )
 		{
-			if( ( GetTickCount( ) - Paddle1Time ) > 1 )
-			{
-				Paddle1Time = GetTickCount( );
-				g_Paddle1.y += PADDLE_SPEED;
-			}
+			StopTrace( );
+			WriteTraceJSON( "trace.json" );
 		}
 		else
-			g_Paddle1.y = ( RES_HEIGHT + PADDLE_HEIGHT + 15 );
+			StartTrace( );
 	}
+	bTraceKeyDown = bTraceKey;
 
-	// Player Two Controls
-	if( GetAsyncKeyState( P2_UP ) )
+	// F11 starts capturing every frame to capture.ufd, and pressing it again finishes the file
+	static BOOL bCaptureKeyDown = FALSE;
+	BOOL bCaptureKey = GetAsyncKeyState( VK_F11 ) ? TRUE : FALSE;
+	if( bCaptureKey && !bCaptureKeyDown )
 	{
-		if( !( g_Paddle2.y == 15 ) )
+		if( g_bCapturing )
 		{
-			if( ( GetTickCount( ) - Paddle2Time ) > 1 )
-			{
-				Paddle2Time = GetTickCount( );
-				g_Paddle2.y -= PADDLE_SPEED;
-			}
+			if( !StopFrameDump( &g_FrameDump ) )
+				Debug( "Could not write all of capture.ufd" );
+			g_bCapturing = FALSE;
 		}
 		else
-			g_Paddle2.y = 15;
+			g_bCapturing = StartFrameDump( &g_FrameDump, "capture.ufd", RES_WIDTH, RES_HEIGHT );
 	}
-	if( GetAsyncKeyState( P2_DOWN ) )
+	bCaptureKeyDown = bCaptureKey;
+
+	// The newest match the sim thread has finished.  It never waits for us, or we for it.
+	BOOL bNew;
+	const SIMSNAPSHOT* pSnapshot = TakeSnapshot( &g_SimThread.Snapshots, &bNew );
+
+	// Start quits once the win screen is up
+	if( pSnapshot->bQuit )
+		PostQuitMessage( 0 );
+
+	// Everything is frozen while the ball is held, so show the new score once, then wait
+	if( pSnapshot->bServePaused && !bNew )
+		return S_OK;
+
+	// Draw a frame if one is due
+	if( pSnapshot->bServePaused || FixedStepRenderDue( &g_RenderStep, Now ) )
+	{
+		Render( pSnapshot, SnapshotAlpha( pSnapshot, Now ) );	// Render images to the back buffer
+		FrameCount( );	// Count FPS
+	}
+	
+	return S_OK;
+}
+
+// Puts the graphics the loader has finished into surfaces, and starts the match once they are all in
+void UpdateAssetLoading()
+{
+	int Collected = 0;
+	int Index;
+
+	while( ( Index = CollectAsset( &g_AssetLoader ) ) >= 0 )
 	{
-		if( !( g_Paddle2.y == ( RES_HEIGHT + PADDLE_HEIGHT + 15 ) ) )
+		// The cache's loader takes the decoded pixels from g_AssetLoader
+		const char* pFile = g_GraphicFiles[ Index ];
+		INT64 UploadStart = HrClockNow( );
+
+		switch( Index )
 		{
-			if( ( GetTickCount( ) - Paddle2Time ) > 1 )
-			{
-				Paddle2Time = GetTickCount( );
-				g_Paddle2.y += PADDLE_SPEED;
-			}
+			case GRAPHIC_BACKGROUND:
+				g_pBackground = AcquireResource( &g_Resources, pFile );
+				break;
+			case GRAPHIC_PADDLE:
+				// Both players share the one paddle
+				g_pPaddle1 = AcquireSprite( &g_Resources, pFile, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
+				g_pPaddle2 = AcquireSprite( &g_Resources, pFile, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
+				break;
+			case GRAPHIC_BALL:
+				g_pBall = AcquireSprite( &g_Resources, pFile, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
+				break;
 		}
-		else
-			g_Paddle2.y = ( RES_HEIGHT + PADDLE_HEIGHT + 15 );
-	}
 
-	// Adjust Ball Speed through F-Keys
-	if( GetAsyncKeyState( VK_F1 ) )
-		g_BallSpeed = 1;
-	if( GetAsyncKeyState( VK_F2 ) )
-		g_BallSpeed = 2;
-	if( GetAsyncKeyState( VK_F3 ) )
-		g_BallSpeed = 3;
-	if( GetAsyncKeyState( VK_F4 ) )
-		g_BallSpeed = 4;
-	if( GetAsyncKeyState( VK_F5 ) )
-		g_BallSpeed = 5;
+		const ASSETLOAD* pLoad = &g_AssetLoader.Loads[ Index ];
+		INT64 Now = HrClockNow( );
 
-	// Escape
-	if( GetAsyncKeyState( VK_ESCAPE ) )
-		PostQuitMessage( 0 );
+		char Timing[ 256 ];
+		sprintf( Timing, "%s: waited %.2f ms, decoded in %.2f ms on loader %d, uploaded in %.2f ms, ready %.2f ms after start\n", pFile,
+				 HrClockToNs( pLoad->Started - g_AssetLoader.StartTime ) / 1000000.0, HrClockToNs( pLoad->Decoded - pLoad->Started ) / 1000000.0,
+				 pLoad->Thread, HrClockToNs( Now - UploadStart ) / 1000000.0, HrClockToNs( Now - g_AssetLoader.StartTime ) / 1000000.0 );
+		OutputDebugString( Timing );
 
-	// Update the ball every 10 ms
-	if( ( GetTickCount( ) - BallTime ) > 10 )
+		Collected++;
+	}
+
+	if( !IsAssetLoaderDone( &g_AssetLoader ) )
 	{
-		BallTime = GetTickCount( );
-		//MoveBall( );
+		// Show how far along it is
+		if( Collected )
+			RenderLoadingFrame( );
+		return;
 	}
 
-	Render( );		// Render images to the back buffer
-	MoveBall( );	// Move the ball
-	FrameCount( );	// Count FPS
-	
-	return S_OK;
+	char LoadTime[ 64 ];
+	sprintf( LoadTime, "Graphics loaded in %.2f ms\n", HrClockToNs( HrClockNow( ) - g_AssetLoader.StartTime ) / 1000000.0 );
+	OutputDebugString( LoadTime );
+
+	// Every surface has its own copy now
+	StopAssetLoader( &g_AssetLoader );
+	CloseGameAssetPack( );
+
+	if( !g_pBackground || !g_pPaddle1 || !g_pPaddle2 || !g_pBall )
+		Debug( "Could not load the graphics" );
+
+	// Start the match now, so the loading time is not played catching up.  The ring is the sim thread's from here.
+	FixedStepInit( &g_RenderStep, g_Frequency, g_TickRate, g_RenderCap );
+	StartSimThread( &g_SimThread );
+	InvalidateDirtyTracker( &g_DirtyTracker );
+	g_bGraphicsReady = TRUE;
+}
+
+// Returns how long the game loop can sleep for, 0 if it has work to do now
+DWORD GameIdleTime( )
+{
+	// Leave the loader threads the CPU while they work
+	if( !g_bGraphicsReady )
+		return 1;
+
+	// Nothing to draw while the ball is held until the sim thread has something new, which is
+	// when the next delayed event fires.  Sleep until then (or until a message arrives).
+	const SIMSNAPSHOT* pSnapshot = &g_SimThread.Snapshots.Slots[ g_SimThread.Snapshots.Front ];
+	if( !pSnapshot->bServePaused || IsSnapshotFresh( &g_SimThread.Snapshots ) )
+		return 0;
+
+	if( !pSnapshot->WakeTime )
+		return INFINITE;
+
+	// Rounded up.  If it is already due the sim thread is about to publish, so look again shortly.
+	INT64 Wait = HrClockToNs( pSnapshot->WakeTime - HrClockNow( ) );
+	return Wait > 0 ? (DWORD)( ( Wait + 999999 ) / 1000000 ) : 1;
+}
+
+// Picks up the command line options, e.g. "-tickrate 1000 -fps 60 -threads 4 -trace -capture -export -record match.rep"
+void ReadCommandLine( char* CmdLine )
+{
+	if( !CmdLine )
+		return;
+
+	char* pOption = strstr( CmdLine, "-tickrate" );
+	if( pOption && atoi( pOption + 9 ) > 0 )
+		g_TickRate = atoi( pOption + 9 );
+
+	if( strstr( CmdLine, "-trace" ) )
+		g_bTraceOnStart = TRUE;
+
+	if( strstr( CmdLine, "-capture" ) )
+		g_bCaptureOnStart = TRUE;
+
+	if( strstr( CmdLine, "-export" ) )
+		g_bExporting = TRUE;
+
+	pOption = strstr( CmdLine, "-threads" );
+	if( pOption && atoi( pOption + 8 ) >= 0 )
+		g_ComposeThreads = atoi( pOption + 8 );
+
+	pOption = strstr( CmdLine, "-fps" );
+	if( pOption && atoi( pOption + 4 ) >= 0 )
+		g_RenderCap = atoi( pOption + 4 );
+
+	// The file name runs to the next space
+	pOption = strstr( CmdLine, "-record" );
+	if( pOption )
+	{
+		pOption += 7;
+		while( *pOption == ' ' )
+			pOption++;
+
+		int Length = 0;
+		while( pOption[ Length ] && pOption[ Length ] != ' ' && Length < (int)sizeof( g_ReplayFile ) - 1 )
+		{
+			g_ReplayFile[ Length ] = pOption[ Length ];
+			Length++;
+		}
+		g_ReplayFile[ Length ] = 0;
+	}
 }
 
 int GameShutdown()
 {
-	// Release graphics pointers
-	g_pBgSurf->Release( );
-	g_pPaddle1Surf->Release( );
-	g_pPaddle2Surf->Release( );
-	g_pBallSurf->Release( );
+	// Save the frame timings, and the trace if one is running
+	WriteProfileCSV( "profile.csv" );
+	if( g_bTracing )
+	{
+		StopTrace( );
+		WriteTraceJSON( "trace.json" );
+	}
+
+	// Finish the capture file
+	if( g_bCapturing )
+	{
+		StopFrameDump( &g_FrameDump );
+		g_bCapturing = FALSE;
+	}
+
+	if( g_bExporting )
+		StopFrameExport( &g_FrameExport );
+
+	// Stop the match where it is
+	StopSimThread( &g_SimThread );
+	timeEndPeriod( 1 );
+
+	// Save the recording, with the state it has to play back to
+	if( g_ReplayFile[ 0 ] )
+	{
+		EndReplayRecord( &g_Replay, &g_SimThread.Sim );
+		if( !SaveReplay( &g_Replay, g_ReplayFile ) )
+			Debug( "Could not save the recording" );
+		FreeReplay( &g_Replay );
+	}
+
+	ShutdownBandCompositor( &g_Compositor );
+
+	// In case we quit before the graphics were all in
+	StopAssetLoader( &g_AssetLoader );
+	CloseGameAssetPack( );
 
 	// Release font pointer
 	UnloadAlphabet( );
+	FreeHudLayer( &g_Hud );
+	g_bHudReady = FALSE;
+
+	// Free every bitmap and sprite
+	FreeResourceCache( &g_Resources );
+	g_pBackground = g_pPaddle1 = g_pPaddle2 = g_pBall = 0;
 
 	// Release the pointer to the back surface
 	if( g_pBackSurface )
@@ -421,186 +652,120 @@ int GameShutdown()
 // Rendering Function
 //====================================================
 
-int Render( )
+// The first frames, while the graphics load: a clear screen and how far along it is
+int RenderLoadingFrame()
 {
-	HRESULT r = 0;
-
-	// Clear the back buffer
-	g_pDevice->Clear( 0, 0, D3DCLEAR_TARGET, D3DCOLOR_XRGB( 0, 0, 25 ), 1.0f, 0 );
-	
-	// Make sure the device is valid
-	if( !g_pDevice )
-	{
-		Debug( "Cannot render because there is no device" );
+	if( !g_pDevice || FAILED( ValidateDevice( ) ) )
 		return E_FAIL;
-	}
-
-	// Return if the device is not ready;
-	r = ValidateDevice();
-	if( FAILED( r ) )
-		return E_FAIL;
-
-	D3DLOCKED_RECT Locked;
-
-	// Draw the Background
-	CopySurfaceToSurface( NULL, g_pBgSurf, 0, g_pBackSurface, FALSE, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
 
-	// Draw the Paddles
-	CopySurfaceToSurface( NULL, g_pPaddle1Surf, &g_Paddle1, g_pBackSurface, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
-	CopySurfaceToSurface( NULL, g_pPaddle2Surf, &g_Paddle2, g_pBackSurface, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
-
-	// Draw the Ball
-	CopySurfaceToSurface( NULL, g_pBallSurf, &g_Ball, g_pBackSurface, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
-
-	// Lock the primary surface
-	g_pBackSurface->LockRect( &Locked, 0, 0 );
-
-	// Convert Player One's score from an int to a string
-	char p1_TextScore[5], p1_Output[30] = "Player 1: ";
-	itoa( g_p1Score, p1_TextScore, 10 );
-	strcat( p1_Output, p1_TextScore );
+	g_pDevice->Clear( 0, 0, D3DCLEAR_TARGET, D3DCOLOR_XRGB( 0, 0, 25 ), 1.0f, 0 );
 
-	// Convert Player Two's score from an int to a string
-	char p2_TextScore[5], p2_Output[30] = "Player 2: ";
-	itoa( g_p2Score, p2_TextScore, 10 );
-	strcat( p2_Output, p2_TextScore );
+	if( g_bAlphabetLoaded )
+	{
+		char Message[ 32 ];
+		sprintf( Message, "Loading %d of %d", g_AssetLoader.Collected, GRAPHIC_COUNT );
 
-	// Print the scores
-	PrintString( 10, 10, p1_Output, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-	PrintString( ( RES_WIDTH - 106 ), 10, p2_Output, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
+		BeginTextBatch( &g_TextBatch );
+		AddText( &g_TextBatch, RES_WIDTH / 2 - 60, RES_HEIGHT / 2 - 8, Message );
 
-	// Program Heading
-	PrintString( ( ( RES_WIDTH / 2 ) - 104 ), 10, "UBER-PONG by Sean Gilleran", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
+		CD3DSurface32 BackSurface( g_pBackSurface );
+		CD3DSurface32 FontSurface( g_pAlphabetSurface );
+		SurfaceDrawTextBatch( &g_TextBatch, &g_FontAtlas, &FontSurface, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), &BackSurface );
+	}
 
-	// DEBUG INFORMATION
-	// Print FPS to Screen
-	PrintString( ( RES_WIDTH - 92 ), ( RES_HEIGHT - 26 ), "FPS: ", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-	PrintFrameRate( ( RES_WIDTH - 42 ), ( RES_HEIGHT - 26 ), (DWORD*)Locked.pBits, Locked.Pitch );
+	return SUCCEEDED( g_pDevice->Present( NULL, NULL, NULL, NULL ) ) ? S_OK : E_FAIL;
+}
 
-	// Print Ball Speed to the screen
-	char BallSpeed[5];
-	itoa( g_BallSpeed, BallSpeed, 10 );
-	PrintString( 10, ( RES_HEIGHT - 26 ), "Ball Speed: ", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-	PrintString( 106, ( RES_HEIGHT - 26 ), BallSpeed, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
+// Draws a snapshot of the match.  Alpha is how far we are between its last tick and the next one (0 - 65535).
+int Render( const SIMSNAPSHOT* pSnapshot, int Alpha )
+{
+	TRACE_SCOPE( "Render" );
 
-	// Prints bounce count to the screen
-	char BounceCount[5];
-	itoa( g_BounceCount, BounceCount, 10 );
-	PrintString( ( ( RES_WIDTH / 2 ) - 64 ), ( RES_HEIGHT - 26 ), "Bounce Count: ", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-	PrintString( ( ( RES_WIDTH / 2 ) + 48 ), ( RES_HEIGHT - 26 ), BounceCount, TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
+	HRESULT r = 0;
 
-	// Player One Wins
-	if( g_p1Score >= MAX_SCORE )
+	// Make sure the device is valid
+	if( !g_pDevice )
 	{
-		PrintString( ( ( RES_WIDTH / 2 ) - 72 ), ( ( RES_HEIGHT / 2 ) - 18 ), "PLAYER ONE WINS!!!", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-		PrintString( ( ( RES_WIDTH / 2 ) - 88 ), ( ( RES_HEIGHT / 2 ) + 18 ), "Press Start to Quit...", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-
-		if( GetAsyncKeyState( START ) )
-			PostQuitMessage( 0 );
-
-		g_PlayWinSound--;
+		Debug( "Cannot render because there is no device" );
+		return E_FAIL;
 	}
 
-	// Player Two Wins
-	else if( g_p2Score >= MAX_SCORE )
-	{
-		PrintString( ( ( RES_WIDTH / 2 ) - 72 ), ( ( RES_HEIGHT / 2 ) - 18 ), "PLAYER TWO WINS!!!", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-		PrintString( ( ( RES_WIDTH / 2 ) - 88 ), ( ( RES_HEIGHT / 2 ) + 18 ), "Press Start to Quit...", TRUE, D3DCOLOR_ARGB( 0, 255, 0, 255 ), (DWORD*)Locked.pBits, Locked.Pitch );
-
-		if( GetAsyncKeyState( START ) )
-			PostQuitMessage( 0 );
+	// Nothing to draw if the graphics did not load
+	if( !g_pBackground || !g_pPaddle1 || !g_pPaddle2 || !g_pBall )
+		return E_FAIL;
 
-		g_PlayWinSound--;
+	// Return if the device is not ready;
+	{
+		PROFILESCOPE Scope( PROFILE_VALIDATE );
+		r = ValidateDevice();
 	}
+	if( FAILED( r ) )
+		return E_FAIL;
 
-	// Unlock the surface
-	g_pBackSurface->UnlockRect();
-	
-	// Transfer back buffer to primary display memory
-	r = g_pDevice->Present( NULL, NULL, NULL, NULL );
+	// Where everything is on the screen, part way between the last two ticks
+	POINT Paddle1, Paddle2, Ball;
+	const PONGSIM* pSim = &pSnapshot->Sim;
+	GetSpritePositions( &pSnapshot->PrevSim, pSim, Alpha, &Paddle1, &Paddle2, &Ball );
 
-	if( g_PlayWinSound == 1 && ( g_p1Score >= MAX_SCORE || g_p2Score >= MAX_SCORE ) )
-			// PlaySound( "sound\\win.wav", NULL, SND_FILENAME | SND_SYNC );
+	// Bring the HUD's numbers up to date and queue up the rest of the text for this frame
+	HUDINFO Hud = { g_FrameRate, g_DirtyTracker.PixelsTouched, pSnapshot->bCanQuit, g_bProfileOverlay, &g_DrawStats };
+	if( g_bHudReady )
+		UpdateGameHud( &g_Hud, pSim, &Hud );
+	QueueHudText( &g_TextBatch, pSim, &Hud, !g_bHudReady );
 
-	return S_OK;
-}
+	if( pSim->p1Score >= MAX_SCORE || pSim->p2Score >= MAX_SCORE )
+		g_PlayWinSound--;
 
-// Finds a completely random direction for the ball to move
-void RandomDirection( )
-{
-	if( ( rand( ) % 2 ) == 1)
-		MultiplierX = 1;
+	// The same drawing code the headless tools use, on the D3D surfaces
+	CD3DSurface32 BackSurface( g_pBackSurface, g_pDevice );
+	CD3DSurface32 FontSurface( g_pAlphabetSurface );
+
+	COMPOSEFRAME Frame;
+	BeginComposeFrame( &Frame, g_pBackground->pSurface, D3DCOLOR_XRGB( 0, 0, 25 ) );
+	AddComposeSprite( &Frame, &g_pPaddle1->Sprite, Paddle1 );
+	AddComposeSprite( &Frame, &g_pPaddle2->Sprite, Paddle2 );
+	AddComposeSprite( &Frame, &g_pBall->Sprite, Ball );
+	if( g_bHudReady )
+		SetComposeHud( &Frame, &g_Hud );
+	if( g_bAlphabetLoaded )
+		SetComposeText( &Frame, &g_TextBatch, &g_FontAtlas, &FontSurface, D3DCOLOR_ARGB( 0, 255, 0, 255 ) );
+
+	// One thread keeps the per stage timings, more share the work out in bands
+	if( g_Compositor.Threads > 1 )
+		ComposeFrameBands( &g_Compositor, &Frame, &g_DirtyTracker, &BackSurface, g_bDirtyRects, &g_DrawStats );
 	else
-		MultiplierX = -1;
+		ComposeFrame( &Frame, &g_DirtyTracker, &BackSurface, g_bDirtyRects, &g_DrawStats );
 
-	if( ( rand( ) % 2 ) == 1 )
-		MultiplierY = 1;
-	else
-		MultiplierY = -1;
-}
+	// Hand a copy of the frame to the capture thread
+	if( g_bCapturing )
+		SubmitFrameDump( &g_FrameDump, &BackSurface );
 
-// Moves the ball and checks for a score or paddle
-void MoveBall( )
-{
-	if( g_Ball.x <= 0 )
-	{
-		g_p2Score++;
-		// PlaySound( "sound\\score.wav", NULL, SND_FILENAME | SND_ASYNC );
-		Pause( 250 );
-		g_Ball.x += 5;
-		MultiplierX = 1;
-	}
-	else if( g_Ball.x >= ( RES_WIDTH - BALL_WIDTH ) )
-	{
-		g_p1Score++;
-		// PlaySound( "sound\\score.wav", NULL, SND_FILENAME | SND_ASYNC );
-		Pause( 250 );
-		g_Ball.x -= 5;
-		MultiplierX = -1;
-	}
-	if( g_Ball.y <= 0 )
-	{
-		// PlaySound( "sound\\wall.wav", NULL, SND_FILENAME | SND_ASYNC );
-		MultiplierY = 1;
-	}
-	else if( g_Ball.y >= ( RES_HEIGHT - BALL_HEIGHT ) )
+	// And to anyone reading the shared memory
+	if( g_bExporting )
 	{
-		// PlaySound( "sound\\wall.wav", NULL, SND_FILENAME | SND_ASYNC );
-		MultiplierY = -1;
+		LOCKEDSURFACE32 Locked;
+		if( BackSurface.Lock( &Locked, TRUE ) )
+		{
+			PublishExportFrame( &g_FrameExport, Locked.pBits, Locked.Pitch, RES_WIDTH, RES_HEIGHT, HrClockToNs( HrClockNow( ) ) / 1000 );
+			BackSurface.Unlock( );
+		}
 	}
 
-	// Paddle RECT structs
-	RECT Paddle1Rect = { g_Paddle1.x, g_Paddle1.y, ( g_Paddle1.x + PADDLE_WIDTH ), ( g_Paddle1.y + PADDLE_HEIGHT ) };
-	RECT Paddle2Rect = { g_Paddle2.x, g_Paddle2.y, ( g_Paddle2.x + PADDLE_WIDTH ), ( g_Paddle2.y + PADDLE_HEIGHT ) };
-
-	if( PtInRect( &Paddle1Rect, g_Ball ) )
+	// Transfer back buffer to primary display memory
 	{
-		// PlaySound( "sound\\wall.wav", NULL, SND_FILENAME | SND_ASYNC );
-		MultiplierX *= -1;
-		g_Ball.x += 10;
-		g_BounceCount++;
+		PROFILESCOPE Scope( PROFILE_PRESENT );
+		r = g_pDevice->Present( NULL, NULL, NULL, NULL );
 	}
 
-	// New ball point for the second paddle
-	POINT Paddle2Ball = { g_Ball.x + BALL_WIDTH, g_Ball.y + BALL_HEIGHT };
-
-	if( PtInRect( &Paddle2Rect, Paddle2Ball ) )
+	// The first frame to show a key press is on its way to the screen
+	if( pSnapshot->PressTime != g_LastPressTime )
 	{
-		// PlaySound( "sound\\wall.wav", NULL, SND_FILENAME | SND_ASYNC );
-		MultiplierX *= -1;
-		g_Ball.x -= 10;
-		g_BounceCount++;
+		RecordHistogram( &g_ProfileHistograms[ PROFILE_LATENCY ], HrClockToNs( HrClockNow( ) - pSnapshot->PressTime ) );
+		g_LastPressTime = pSnapshot->PressTime;
 	}
 
-	/*
-	// Increase ball speed after 10 reflects
-	if( g_BounceCount == 10 )
-	{
-		g_BallSpeed++;
-		g_BounceCount = 0;
-	}
-	*/
+	if( g_PlayWinSound == 1 && ( pSim->p1Score >= MAX_SCORE || pSim->p2Score >= MAX_SCORE ) )
+			// PlaySound( "sound\\win.wav", NULL, SND_FILENAME | SND_SYNC );
 
-	g_Ball.x += ( MultiplierX * g_BallSpeed );
-	g_Ball.y += ( MultiplierY * g_BallSpeed );
-}
\ No newline at end of file
+	return S_OK;
+}
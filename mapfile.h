@@ -0,0 +1,109 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Read only memory mapped files.  The whole file shows up as one block of
+// memory and the OS pages it in as it is touched, so big files open at
+// once and only the parts that are read cost anything.
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include "platform.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct MAPPEDFILE
+{
+	const BYTE* pData;		// Page aligned
+	INT64 Size;
+
+#ifdef _WIN32
+	HANDLE hFile;
+	HANDLE hMapping;
+#endif
+};
+
+void CloseMappedFile( MAPPEDFILE* pFile )
+{
+#ifdef _WIN32
+	if( pFile->pData )
+		UnmapViewOfFile( pFile->pData );
+	if( pFile->hMapping )
+		CloseHandle( pFile->hMapping );
+	if( pFile->hFile && pFile->hFile != INVALID_HANDLE_VALUE )
+		CloseHandle( pFile->hFile );
+	pFile->hFile = pFile->hMapping = 0;
+#else
+	if( pFile->pData )
+		munmap( (void*)pFile->pData, (size_t)pFile->Size );
+#endif
+
+	pFile->pData = 0;
+	pFile->Size = 0;
+}
+
+// Maps a whole file for reading.  Returns FALSE if it cannot be opened or is empty.
+BOOL OpenMappedFile( MAPPEDFILE* pFile, const char* FileName )
+{
+	pFile->pData = 0;
+	pFile->Size = 0;
+
+#ifdef _WIN32
+	pFile->hMapping = 0;
+	pFile->hFile = CreateFileA( FileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( pFile->hFile == INVALID_HANDLE_VALUE )
+		return FALSE;
+
+	LARGE_INTEGER Size;
+	if( !GetFileSizeEx( pFile->hFile, &Size ) || Size.QuadPart == 0 )
+	{
+		CloseMappedFile( pFile );
+		return FALSE;
+	}
+
+	pFile->hMapping = CreateFileMappingA( pFile->hFile, NULL, PAGE_READONLY, 0, 0, NULL );
+	if( pFile->hMapping )
+		pFile->pData = (const BYTE*)MapViewOfFile( pFile->hMapping, FILE_MAP_READ, 0, 0, 0 );
+
+	if( !pFile->pData )
+	{
+		CloseMappedFile( pFile );
+		return FALSE;
+	}
+
+	pFile->Size = Size.QuadPart;
+#else
+	int File = open( FileName, O_RDONLY );
+	if( File < 0 )
+		return FALSE;
+
+	struct stat Info;
+	if( fstat( File, &Info ) != 0 || Info.st_size == 0 )
+	{
+		close( File );
+		return FALSE;
+	}
+
+	// The mapping stays valid after the file is closed
+	void* pData = mmap( 0, (size_t)Info.st_size, PROT_READ, MAP_SHARED, File, 0 );
+	close( File );
+
+	if( pData == MAP_FAILED )
+		return FALSE;
+
+	pFile->pData = (const BYTE*)pData;
+	pFile->Size = Info.st_size;
+#endif
+
+	return TRUE;
+}
+
+#endif	// MAPFILE_H
@@ -0,0 +1,74 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Basic Win32 types for the code that has to build without windows.h
+// (the 2D kernels, the simulation and the headless tools)
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#else
+
+typedef unsigned int DWORD;		// 32 bits, same as on Win32
+typedef unsigned short WORD;
+typedef unsigned char BYTE;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef long long INT64;
+
+#ifndef TRUE
+#define TRUE	1
+#endif
+#ifndef FALSE
+#define FALSE	0
+#endif
+
+typedef struct tagPOINT
+{
+	long x;
+	long y;
+} POINT;
+
+typedef struct tagRECT
+{
+	long left;
+	long top;
+	long right;
+	long bottom;
+} RECT;
+
+inline BOOL SetRect( RECT* pRect, int Left, int Top, int Right, int Bottom )
+{
+	pRect->left = Left;
+	pRect->top = Top;
+	pRect->right = Right;
+	pRect->bottom = Bottom;
+	return TRUE;
+}
+
+#endif	// _WIN32
+
+// The threads, atomics and thread_local storage need C++11: Visual C++ 2015 (the project's
+// v140 toolset) or later, or g++ / clang with -std=c++11 or later
+#if defined( _MSC_VER ) && _MSC_VER < 1900
+#error Uber-Pong needs Visual C++ 2015 or later
+#elif !defined( _MSC_VER ) && __cplusplus < 201103L
+#error Uber-Pong needs a C++11 compiler
+#endif
+
+// x86 targets get the SSE2/AVX2 code paths
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#define PLATFORM_X86
+#endif
+
+#endif	// PLATFORM_H
@@ -0,0 +1,405 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Runs many independent matches at once.  The matches are stored as a
+// structure of arrays (one array per PONGSIM field) so the AVX2 kernel can
+// step 8 of them per instruction.  Every branch in PongSimStep() becomes a
+// lane mask, and the results are bit-for-bit the same as PongSimStep().
+
+#ifndef PONGBATCH_H
+#define PONGBATCH_H
+
+#include <string.h>
+#include "platform.h"
+#include "cpu.h"
+#include "pongsim.h"
+
+#define PONGBATCH_LANES		8	// Matches per AVX2 step
+
+struct PONGBATCH
+{
+	int Count;			// Number of matches
+	int Padded;			// Count rounded up to a whole number of lanes
+	int TickRate;		// Ticks per second, the same for every match
+	int BallStep;		// Ball movement per tick per unit of speed (fixed point)
+	int PaddleStep;		// Paddle movement per tick (fixed point)
+
+	// One entry per match
+	int* pTick;
+	int* pBallX;
+	int* pBallY;
+	int* pMultiplierX;
+	int* pMultiplierY;
+	int* pBallSpeed;
+	int* pPaddle1Y;
+	int* pPaddle2Y;
+	int* p1Score;
+	int* p2Score;
+	int* pBounceCount;
+	int* pGameOver;		// 0 or -1 (all bits set), so it can be used as a mask
+	DWORD* pRandom;
+
+	BYTE* pMemory;		// The block all of the arrays live in
+};
+
+#define PONGBATCH_ARRAYS	13
+
+// Copies one match out of the batch
+void PongBatchGet( const PONGBATCH* pBatch, int Match, PONGSIM* pSim )
+{
+	// Start from a fresh match so the constant fields are right
+	PongSimInit( pSim, 1, pBatch->TickRate );
+
+	pSim->Tick = pBatch->pTick[ Match ];
+	pSim->BallX = pBatch->pBallX[ Match ];
+	pSim->BallY = pBatch->pBallY[ Match ];
+	pSim->MultiplierX = pBatch->pMultiplierX[ Match ];
+	pSim->MultiplierY = pBatch->pMultiplierY[ Match ];
+	pSim->BallSpeed = pBatch->pBallSpeed[ Match ];
+	pSim->Paddle1Y = pBatch->pPaddle1Y[ Match ];
+	pSim->Paddle2Y = pBatch->pPaddle2Y[ Match ];
+	pSim->p1Score = pBatch->p1Score[ Match ];
+	pSim->p2Score = pBatch->p2Score[ Match ];
+	pSim->BounceCount = pBatch->pBounceCount[ Match ];
+	pSim->bGameOver = pBatch->pGameOver[ Match ] ? TRUE : FALSE;
+	pSim->Random = pBatch->pRandom[ Match ];
+}
+
+// Copies one match into the batch
+void PongBatchSet( PONGBATCH* pBatch, int Match, const PONGSIM* pSim )
+{
+	pBatch->pTick[ Match ] = (int)pSim->Tick;
+	pBatch->pBallX[ Match ] = pSim->BallX;
+	pBatch->pBallY[ Match ] = pSim->BallY;
+	pBatch->pMultiplierX[ Match ] = pSim->MultiplierX;
+	pBatch->pMultiplierY[ Match ] = pSim->MultiplierY;
+	pBatch->pBallSpeed[ Match ] = pSim->BallSpeed;
+	pBatch->pPaddle1Y[ Match ] = pSim->Paddle1Y;
+	pBatch->pPaddle2Y[ Match ] = pSim->Paddle2Y;
+	pBatch->p1Score[ Match ] = pSim->p1Score;
+	pBatch->p2Score[ Match ] = pSim->p2Score;
+	pBatch->pBounceCount[ Match ] = pSim->BounceCount;
+	pBatch->pGameOver[ Match ] = pSim->bGameOver ? -1 : 0;
+	pBatch->pRandom[ Match ] = pSim->Random;
+}
+
+// Starts a new match in one slot of the batch
+void PongBatchResetMatch( PONGBATCH* pBatch, int Match, DWORD Seed )
+{
+	PONGSIM Sim;
+	PongSimInit( &Sim, Seed, pBatch->TickRate );
+	PongBatchSet( pBatch, Match, &Sim );
+}
+
+// Frees the memory held by a batch
+void PongBatchFree( PONGBATCH* pBatch )
+{
+	delete [] pBatch->pMemory;
+	memset( pBatch, 0, sizeof( PONGBATCH ) );
+}
+
+// Sets up Count matches.  Match i is seeded with Seed + i.
+BOOL PongBatchInit( PONGBATCH* pBatch, int Count, DWORD Seed, int TickRate = PONGSIM_BASE_RATE )
+{
+	memset( pBatch, 0, sizeof( PONGBATCH ) );
+
+	if( Count <= 0 )
+		return FALSE;
+
+	pBatch->Count = Count;
+	pBatch->Padded = ( Count + PONGBATCH_LANES - 1 ) & ~( PONGBATCH_LANES - 1 );
+
+	// One block for every array, 32 byte aligned so lanes line up with AVX2 registers
+	int ArrayBytes = pBatch->Padded * 4;
+	pBatch->pMemory = new BYTE[ ArrayBytes * PONGBATCH_ARRAYS + 32 ];
+
+	BYTE* pAligned = pBatch->pMemory + ( ( 32 - ( (size_t)pBatch->pMemory & 31 ) ) & 31 );
+	int** ppArrays[] = { &pBatch->pTick, &pBatch->pBallX, &pBatch->pBallY, &pBatch->pMultiplierX, &pBatch->pMultiplierY,
+						 &pBatch->pBallSpeed, &pBatch->pPaddle1Y, &pBatch->pPaddle2Y, &pBatch->p1Score, &pBatch->p2Score,
+						 &pBatch->pBounceCount, &pBatch->pGameOver, (int**)&pBatch->pRandom };
+
+	for( int a = 0 ; a < PONGBATCH_ARRAYS ; a++ )
+		*ppArrays[ a ] = (int*)( pAligned + a * ArrayBytes );
+
+	// Take the per-tick steps from a real match so they always agree with PongSimStep()
+	PONGSIM Sim;
+	PongSimInit( &Sim, Seed, TickRate );
+	pBatch->TickRate = Sim.TickRate;
+	pBatch->BallStep = Sim.BallStep;
+	pBatch->PaddleStep = Sim.PaddleStep;
+
+	// The padding lanes are real matches too; their results are just never read
+	for( int i = 0 ; i < pBatch->Padded ; i++ )
+		PongBatchResetMatch( pBatch, i, Seed + i );
+
+	return TRUE;
+}
+
+//====================================================
+// Scalar Step
+//====================================================
+
+// Steps every match with PongSimStep().  Used when AVX2 is missing, and to check the AVX2 kernel.
+void PongBatchStep_Scalar( PONGBATCH* pBatch, const unsigned int* pInputs, int* pEvents )
+{
+	PONGSIM Sim;
+
+	for( int i = 0 ; i < pBatch->Padded ; i++ )
+	{
+		PongBatchGet( pBatch, i, &Sim );
+		int Events = PongSimStep( &Sim, pInputs[ i ] );
+		PongBatchSet( pBatch, i, &Sim );
+
+		if( pEvents )
+			pEvents[ i ] = Events;
+	}
+}
+
+//====================================================
+// AVX2 Step (8 matches at a time)
+//====================================================
+
+#ifndef CPU_NO_AVX2
+
+// Loads and stores for one lane group
+#define PB_LOAD( p )		_mm256_load_si256( (const __m256i*)( p ) )
+#define PB_STORE( p, v )	_mm256_store_si256( (__m256i*)( p ), v )
+
+// x >= y for signed lanes
+CPU_TARGET_AVX2 inline __m256i PongBatchGreaterEqual( __m256i x, __m256i y )
+{
+	return _mm256_or_si256( _mm256_cmpgt_epi32( x, y ), _mm256_cmpeq_epi32( x, y ) );
+}
+
+// All bits set in the lanes where (Input & Bit) != 0
+CPU_TARGET_AVX2 inline __m256i PongBatchButton( __m256i Input, int Bit )
+{
+	__m256i BitV = _mm256_set1_epi32( Bit );
+	return _mm256_cmpeq_epi32( _mm256_and_si256( Input, BitV ), BitV );
+}
+
+// Same as PongSimSweepPaddle(): how far each ball travels before it touches the paddle, or
+// PONGSIM_NOHIT.  *pFaceX is set in the lanes that hit the front or back of the paddle.
+CPU_TARGET_AVX2 inline __m256i PongBatchSweepPaddle( __m256i x, __m256i y, __m256i MulX, __m256i NegX, __m256i NegY,
+													  __m256i PaddleX, __m256i PaddleY, int GoalX, __m256i* pFaceX )
+{
+	const __m256i Zero = _mm256_setzero_si256();
+	const __m256i NoHit = _mm256_set1_epi32( PONGSIM_NOHIT );
+
+	__m256i Left = _mm256_sub_epi32( PaddleX, _mm256_set1_epi32( BALL_WIDTH << PONGSIM_SHIFT ) );
+	__m256i Right = _mm256_add_epi32( PaddleX, _mm256_set1_epi32( PADDLE_WIDTH << PONGSIM_SHIFT ) );
+	__m256i Top = _mm256_sub_epi32( PaddleY, _mm256_set1_epi32( BALL_HEIGHT << PONGSIM_SHIFT ) );
+	__m256i Bottom = _mm256_add_epi32( PaddleY, _mm256_set1_epi32( PADDLE_HEIGHT << PONGSIM_SHIFT ) );
+
+	__m256i EnterX = _mm256_blendv_epi8( _mm256_sub_epi32( Left, x ), _mm256_sub_epi32( x, Right ), NegX );
+	__m256i ExitX = _mm256_blendv_epi8( _mm256_sub_epi32( Right, x ), _mm256_sub_epi32( x, Left ), NegX );
+	__m256i EnterY = _mm256_blendv_epi8( _mm256_sub_epi32( Top, y ), _mm256_sub_epi32( y, Bottom ), NegY );
+	__m256i ExitY = _mm256_blendv_epi8( _mm256_sub_epi32( Bottom, y ), _mm256_sub_epi32( y, Top ), NegY );
+
+	__m256i Enter = _mm256_max_epi32( EnterX, EnterY );
+	__m256i Exit = _mm256_min_epi32( ExitX, ExitY );
+
+	__m256i Valid = _mm256_and_si256( PongBatchGreaterEqual( Enter, Zero ), _mm256_cmpgt_epi32( Exit, Enter ) );
+	__m256i Hit = _mm256_blendv_epi8( NoHit, Enter, Valid );
+	__m256i FaceX = PongBatchGreaterEqual( EnterX, EnterY );
+
+	// Already overlapping: turn round at once if heading for the goal, otherwise no hit
+	__m256i Overlap = _mm256_and_si256( _mm256_cmpgt_epi32( Zero, EnterX ), _mm256_cmpgt_epi32( Zero, EnterY ) );
+	Overlap = _mm256_and_si256( Overlap, _mm256_and_si256( _mm256_cmpgt_epi32( ExitX, Zero ), _mm256_cmpgt_epi32( ExitY, Zero ) ) );
+	__m256i Toward = _mm256_cmpeq_epi32( MulX, _mm256_set1_epi32( GoalX ) );
+
+	Hit = _mm256_blendv_epi8( Hit, _mm256_andnot_si256( Toward, NoHit ), Overlap );
+	*pFaceX = _mm256_or_si256( FaceX, Overlap );
+
+	return Hit;
+}
+
+CPU_TARGET_AVX2 void PongBatchStep_AVX2( PONGBATCH* pBatch, const unsigned int* pInputs, int* pEvents )
+{
+	const __m256i Zero = _mm256_setzero_si256();
+	const __m256i One = _mm256_set1_epi32( 1 );
+	const __m256i MinusOne = _mm256_set1_epi32( -1 );
+
+	const __m256i PaddleStep = _mm256_set1_epi32( pBatch->PaddleStep );
+	const __m256i BallStep = _mm256_set1_epi32( pBatch->BallStep );
+	const __m256i PaddleTop = _mm256_set1_epi32( PADDLE_MARGIN << PONGSIM_SHIFT );
+	const __m256i PaddleBottom = _mm256_set1_epi32( ( RES_HEIGHT - PADDLE_HEIGHT - PADDLE_MARGIN ) << PONGSIM_SHIFT );
+	const __m256i Paddle1X = _mm256_set1_epi32( PADDLE_INITIAL_X << PONGSIM_SHIFT );
+	const __m256i Paddle2X = _mm256_set1_epi32( ( RES_WIDTH - PADDLE_INITIAL_X - PADDLE_WIDTH ) << PONGSIM_SHIFT );
+	const __m256i RightEdge = _mm256_set1_epi32( ( RES_WIDTH - BALL_WIDTH ) << PONGSIM_SHIFT );
+	const __m256i BottomEdge = _mm256_set1_epi32( ( RES_HEIGHT - BALL_HEIGHT ) << PONGSIM_SHIFT );
+	const __m256i MaxScore = _mm256_set1_epi32( MAX_SCORE );
+
+	for( int i = 0 ; i < pBatch->Padded ; i += PONGBATCH_LANES )
+	{
+		__m256i Input = _mm256_loadu_si256( (const __m256i*)( pInputs + i ) );
+
+		__m256i Tick = _mm256_add_epi32( PB_LOAD( pBatch->pTick + i ), One );
+		__m256i BallX = PB_LOAD( pBatch->pBallX + i );
+		__m256i BallY = PB_LOAD( pBatch->pBallY + i );
+		__m256i MulX = PB_LOAD( pBatch->pMultiplierX + i );
+		__m256i MulY = PB_LOAD( pBatch->pMultiplierY + i );
+		__m256i Speed = PB_LOAD( pBatch->pBallSpeed + i );
+		__m256i Paddle1Y = PB_LOAD( pBatch->pPaddle1Y + i );
+		__m256i Paddle2Y = PB_LOAD( pBatch->pPaddle2Y + i );
+		__m256i Score1 = PB_LOAD( pBatch->p1Score + i );
+		__m256i Score2 = PB_LOAD( pBatch->p2Score + i );
+		__m256i Bounces = PB_LOAD( pBatch->pBounceCount + i );
+		__m256i GameOver = PB_LOAD( pBatch->pGameOver + i );
+
+		// Adjust Ball Speed (the highest key held wins)
+		for( int s = 1 ; s <= BALL_MAXSPEED ; s++ )
+			Speed = _mm256_blendv_epi8( Speed, _mm256_set1_epi32( s ), PongBatchButton( Input, PONGINPUT_SPEED1 << ( s - 1 ) ) );
+
+		// Player controls: the masks are -1 where a button is held, so and-ing them with the step gives step or 0
+		Paddle1Y = _mm256_sub_epi32( Paddle1Y, _mm256_and_si256( PongBatchButton( Input, PONGINPUT_P1_UP ), PaddleStep ) );
+		Paddle1Y = _mm256_add_epi32( Paddle1Y, _mm256_and_si256( PongBatchButton( Input, PONGINPUT_P1_DOWN ), PaddleStep ) );
+		Paddle1Y = _mm256_min_epi32( _mm256_max_epi32( Paddle1Y, PaddleTop ), PaddleBottom );
+
+		Paddle2Y = _mm256_sub_epi32( Paddle2Y, _mm256_and_si256( PongBatchButton( Input, PONGINPUT_P2_UP ), PaddleStep ) );
+		Paddle2Y = _mm256_add_epi32( Paddle2Y, _mm256_and_si256( PongBatchButton( Input, PONGINPUT_P2_DOWN ), PaddleStep ) );
+		Paddle2Y = _mm256_min_epi32( _mm256_max_epi32( Paddle2Y, PaddleTop ), PaddleBottom );
+
+		// Everything below only happens in matches that are still being played
+		__m256i Live = _mm256_xor_si256( GameOver, MinusOne );
+
+		// Move the ball, one contact at a time, until every lane has gone its full distance
+		__m256i Distance = _mm256_and_si256( Live, _mm256_mullo_epi32( Speed, BallStep ) );
+		__m256i Scored1 = Zero, Scored2 = Zero, Walls = Zero, Paddles = Zero;
+
+		for( int c = 0 ; c < PONGSIM_MAXCONTACTS ; c++ )
+		{
+			__m256i Active = _mm256_cmpgt_epi32( Distance, Zero );
+			if( _mm256_testz_si256( Active, Active ) )
+				break;
+
+			__m256i NegX = _mm256_cmpgt_epi32( Zero, MulX );
+			__m256i NegY = _mm256_cmpgt_epi32( Zero, MulY );
+
+			// The goal lines behind the paddles
+			__m256i Nearest = _mm256_blendv_epi8( _mm256_sub_epi32( RightEdge, BallX ), BallX, NegX );
+			Nearest = _mm256_max_epi32( Nearest, Zero );
+			__m256i Contact = _mm256_set1_epi32( PONGSIM_CONTACT_GOAL );
+
+			// The top and bottom of the screen
+			__m256i Wall = _mm256_blendv_epi8( _mm256_sub_epi32( BottomEdge, BallY ), BallY, NegY );
+			Wall = _mm256_max_epi32( Wall, Zero );
+			__m256i Closer = _mm256_cmpgt_epi32( Nearest, Wall );
+			Nearest = _mm256_blendv_epi8( Nearest, Wall, Closer );
+			Contact = _mm256_blendv_epi8( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_WALL ), Closer );
+
+			// The paddles
+			__m256i FaceX1, FaceX2;
+			__m256i Hit1 = PongBatchSweepPaddle( BallX, BallY, MulX, NegX, NegY, Paddle1X, Paddle1Y, -1, &FaceX1 );
+			__m256i Hit2 = PongBatchSweepPaddle( BallX, BallY, MulX, NegX, NegY, Paddle2X, Paddle2Y, 1, &FaceX2 );
+
+			Closer = _mm256_cmpgt_epi32( Nearest, Hit1 );
+			Nearest = _mm256_blendv_epi8( Nearest, Hit1, Closer );
+			Contact = _mm256_blendv_epi8( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_PADDLE1 ), Closer );
+
+			Closer = _mm256_cmpgt_epi32( Nearest, Hit2 );
+			Nearest = _mm256_blendv_epi8( Nearest, Hit2, Closer );
+			Contact = _mm256_blendv_epi8( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_PADDLE2 ), Closer );
+
+			// Lanes that hit something move up to it, the rest move all the way and are done
+			__m256i Hit = _mm256_and_si256( Active, _mm256_cmpgt_epi32( Distance, Nearest ) );
+			__m256i Move = _mm256_blendv_epi8( Distance, Nearest, Hit );
+
+			BallX = _mm256_add_epi32( BallX, _mm256_mullo_epi32( MulX, Move ) );
+			BallY = _mm256_add_epi32( BallY, _mm256_mullo_epi32( MulY, Move ) );
+			Distance = _mm256_and_si256( Hit, _mm256_sub_epi32( Distance, Nearest ) );
+
+			// Score, and bounce back into play
+			__m256i Goal = _mm256_and_si256( Hit, _mm256_cmpeq_epi32( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_GOAL ) ) );
+			__m256i Left = _mm256_and_si256( Goal, NegX );
+			__m256i Right = _mm256_andnot_si256( NegX, Goal );
+			Score2 = _mm256_sub_epi32( Score2, Left );
+			Score1 = _mm256_sub_epi32( Score1, Right );
+			Scored2 = _mm256_or_si256( Scored2, Left );
+			Scored1 = _mm256_or_si256( Scored1, Right );
+
+			// Bounce off the top and bottom
+			__m256i WallHit = _mm256_and_si256( Hit, _mm256_cmpeq_epi32( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_WALL ) ) );
+			Walls = _mm256_or_si256( Walls, WallHit );
+
+			// Bounce off a paddle
+			__m256i Paddle1 = _mm256_cmpeq_epi32( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_PADDLE1 ) );
+			__m256i Paddle2 = _mm256_cmpeq_epi32( Contact, _mm256_set1_epi32( PONGSIM_CONTACT_PADDLE2 ) );
+			__m256i PaddleHit = _mm256_and_si256( Hit, _mm256_or_si256( Paddle1, Paddle2 ) );
+			__m256i FaceX = _mm256_blendv_epi8( FaceX2, FaceX1, Paddle1 );
+			Bounces = _mm256_sub_epi32( Bounces, PaddleHit );
+			Paddles = _mm256_or_si256( Paddles, PaddleHit );
+
+			__m256i FlipX = _mm256_or_si256( Goal, _mm256_and_si256( PaddleHit, FaceX ) );
+			__m256i FlipY = _mm256_or_si256( WallHit, _mm256_andnot_si256( FaceX, PaddleHit ) );
+			MulX = _mm256_blendv_epi8( MulX, _mm256_sub_epi32( Zero, MulX ), FlipX );
+			MulY = _mm256_blendv_epi8( MulY, _mm256_sub_epi32( Zero, MulY ), FlipY );
+		}
+
+		// Check for a winner
+		__m256i Won = _mm256_or_si256( PongBatchGreaterEqual( Score1, MaxScore ), PongBatchGreaterEqual( Score2, MaxScore ) );
+		Won = _mm256_and_si256( Live, Won );
+		GameOver = _mm256_or_si256( GameOver, Won );
+
+		PB_STORE( pBatch->pTick + i, Tick );
+		PB_STORE( pBatch->pBallX + i, BallX );
+		PB_STORE( pBatch->pBallY + i, BallY );
+		PB_STORE( pBatch->pMultiplierX + i, MulX );
+		PB_STORE( pBatch->pMultiplierY + i, MulY );
+		PB_STORE( pBatch->pBallSpeed + i, Speed );
+		PB_STORE( pBatch->pPaddle1Y + i, Paddle1Y );
+		PB_STORE( pBatch->pPaddle2Y + i, Paddle2Y );
+		PB_STORE( pBatch->p1Score + i, Score1 );
+		PB_STORE( pBatch->p2Score + i, Score2 );
+		PB_STORE( pBatch->pBounceCount + i, Bounces );
+		PB_STORE( pBatch->pGameOver + i, GameOver );
+
+		// Build the same event flags PongSimStep() returns
+		if( pEvents )
+		{
+			__m256i Events = _mm256_and_si256( Scored1, _mm256_set1_epi32( PONGEVENT_P1_SCORED ) );
+			Events = _mm256_or_si256( Events, _mm256_and_si256( Scored2, _mm256_set1_epi32( PONGEVENT_P2_SCORED ) ) );
+			Events = _mm256_or_si256( Events, _mm256_and_si256( Walls, _mm256_set1_epi32( PONGEVENT_WALL ) ) );
+			Events = _mm256_or_si256( Events, _mm256_and_si256( Paddles, _mm256_set1_epi32( PONGEVENT_PADDLE ) ) );
+			Events = _mm256_or_si256( Events, _mm256_and_si256( Won, _mm256_set1_epi32( PONGEVENT_GAMEOVER ) ) );
+			_mm256_storeu_si256( (__m256i*)( pEvents + i ), Events );
+		}
+	}
+}
+
+#undef PB_LOAD
+#undef PB_STORE
+
+#endif	// CPU_NO_AVX2
+
+//====================================================
+// Dispatch
+//====================================================
+
+typedef void (*PONGBATCHSTEP)( PONGBATCH* pBatch, const unsigned int* pInputs, int* pEvents );
+
+// The batch stepper in use.  Works before InitPongBatch() is called.
+PONGBATCHSTEP g_pfnPongBatchStep = PongBatchStep_Scalar;
+
+// Picks the AVX2 kernel if the CPU has it.  Pass FALSE to force the scalar one.
+void InitPongBatch( BOOL bAllowSIMD = TRUE )
+{
+	g_pfnPongBatchStep = PongBatchStep_Scalar;
+
+#ifndef CPU_NO_AVX2
+	if( bAllowSIMD && CpuHasAVX2() )
+		g_pfnPongBatchStep = PongBatchStep_AVX2;
+#endif
+}
+
+// Advances every match one tick.  pInputs holds one PONGINPUT_ mask per match and must
+// have Padded entries; pEvents receives the PONGEVENT_ flags for each match and may be NULL.
+void PongBatchStep( PONGBATCH* pBatch, const unsigned int* pInputs, int* pEvents = 0 )
+{
+	g_pfnPongBatchStep( pBatch, pInputs, pEvents );
+}
+
+#endif	// PONGBATCH_H
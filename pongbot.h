@@ -0,0 +1,151 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Computer players.  A policy looks at a match and returns the buttons one
+// player holds this tick.  Policies that need random numbers draw them from
+// the PONGRNG they are given, never from rand(), so every thread (and every
+// match) can have its own stream.
+
+#ifndef PONGBOT_H
+#define PONGBOT_H
+
+#include "platform.h"
+#include "pongsim.h"
+
+//====================================================
+// Random Number Streams
+//====================================================
+
+// A splitmix64 generator.  Cheap to seed, and nearby seeds give unrelated streams.
+struct PONGRNG
+{
+	unsigned long long State;
+};
+
+void PongRngSeed( PONGRNG* pRng, unsigned long long Seed )
+{
+	pRng->State = Seed;
+}
+
+unsigned long long PongRngNext64( PONGRNG* pRng )
+{
+	unsigned long long z = ( pRng->State += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+DWORD PongRngNext( PONGRNG* pRng )
+{
+	return (DWORD)( PongRngNext64( pRng ) >> 32 );
+}
+
+// Mixes a base seed with an index into an independent seed, e.g. one per match
+DWORD PongRngDerive( unsigned long long Seed, unsigned long long Index )
+{
+	PONGRNG Rng;
+	PongRngSeed( &Rng, Seed ^ ( Index * 0xD1B54A32D192ED03ULL ) );
+	return PongRngNext( &Rng );
+}
+
+//====================================================
+// Policies
+//====================================================
+
+// Returns the buttons for Player (1 or 2) this tick
+typedef unsigned int (*PONGPOLICY)( const PONGSIM* pSim, int Player, PONGRNG* pRng );
+
+// Turns up/down into the right player's buttons
+inline unsigned int PongBotButtons( int Player, BOOL bUp, BOOL bDown )
+{
+	if( Player == 1 )
+		return ( bUp ? PONGINPUT_P1_UP : 0 ) | ( bDown ? PONGINPUT_P1_DOWN : 0 );
+
+	return ( bUp ? PONGINPUT_P2_UP : 0 ) | ( bDown ? PONGINPUT_P2_DOWN : 0 );
+}
+
+// Moves the paddle so that Target (fixed point) is level with the middle of the paddle
+inline unsigned int PongBotAim( const PONGSIM* pSim, int Player, int Target )
+{
+	int PaddleY = ( Player == 1 ) ? pSim->Paddle1Y : pSim->Paddle2Y;
+	int Middle = PaddleY + ( ( PADDLE_HEIGHT / 2 ) << PONGSIM_SHIFT );
+
+	return PongBotButtons( Player, Target < Middle - pSim->PaddleStep, Target > Middle + pSim->PaddleStep );
+}
+
+// Never moves
+unsigned int PongBotStill( const PONGSIM* /*pSim*/, int /*Player*/, PONGRNG* /*pRng*/ )
+{
+	return 0;
+}
+
+// Mashes buttons
+unsigned int PongBotRandom( const PONGSIM* /*pSim*/, int Player, PONGRNG* pRng )
+{
+	DWORD r = PongRngNext( pRng );
+	return PongBotButtons( Player, ( r & 3 ) == 0, ( r & 3 ) == 1 );
+}
+
+// Keeps the middle of the paddle level with the middle of the ball
+unsigned int PongBotTracker( const PONGSIM* pSim, int Player, PONGRNG* /*pRng*/ )
+{
+	return PongBotAim( pSim, Player, pSim->BallY + ( ( BALL_HEIGHT / 2 ) << PONGSIM_SHIFT ) );
+}
+
+// A tracker that only reacts on about two ticks in three
+unsigned int PongBotLazy( const PONGSIM* pSim, int Player, PONGRNG* pRng )
+{
+	if( PongRngNext( pRng ) % 3 == 0 )
+		return 0;
+
+	return PongBotTracker( pSim, Player, pRng );
+}
+
+// Works out where the ball will cross the paddle, bounces included, and waits there
+unsigned int PongBotPredictor( const PONGSIM* pSim, int Player, PONGRNG* /*pRng*/ )
+{
+	BOOL bIncoming = ( Player == 1 ) ? ( pSim->MultiplierX < 0 ) : ( pSim->MultiplierX > 0 );
+
+	// Drift back to the middle while the ball is going the other way
+	if( !bIncoming )
+		return PongBotAim( pSim, Player, ( RES_HEIGHT / 2 ) << PONGSIM_SHIFT );
+
+	// The ball moves as far vertically as horizontally, so the distance to the paddle is the vertical travel too
+	int Distance = ( Player == 1 ) ? pSim->BallX - pSim->Paddle1X : pSim->Paddle2X - ( pSim->BallX + ( BALL_WIDTH << PONGSIM_SHIFT ) );
+	if( Distance < 0 )
+		Distance = 0;
+
+	// Fold the straight-line position back into the court to account for wall bounces
+	int Range = ( RES_HEIGHT - BALL_HEIGHT ) << PONGSIM_SHIFT;
+	int y = (int)( ( (INT64)pSim->BallY + (INT64)pSim->MultiplierY * Distance ) % ( 2 * (INT64)Range ) );
+	if( y < 0 )
+		y += 2 * Range;
+	if( y > Range )
+		y = 2 * Range - y;
+
+	// Line the middle of the paddle up with the middle of the ball
+	return PongBotAim( pSim, Player, y + ( ( BALL_HEIGHT / 2 ) << PONGSIM_SHIFT ) );
+}
+
+// Every built in policy, by name
+struct PONGBOTINFO
+{
+	const char* Name;
+	PONGPOLICY pfnPolicy;
+};
+
+const PONGBOTINFO g_PongBots[] =
+{
+	{ "still",		PongBotStill },
+	{ "random",		PongBotRandom },
+	{ "tracker",	PongBotTracker },
+	{ "lazy",		PongBotLazy },
+	{ "predictor",	PongBotPredictor },
+};
+
+const int g_PongBotCount = sizeof( g_PongBots ) / sizeof( g_PongBots[0] );
+
+#endif	// PONGBOT_H
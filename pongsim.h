@@ -0,0 +1,373 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// The game rules, with no Windows calls and no globals.  All of a match
+// lives in a PONGSIM and PongSimStep() advances it by exactly one tick of
+// 1/TickRate seconds, given the buttons held during that tick.  The same
+// seed, tick rate and inputs always give the same match.
+
+#ifndef PONGSIM_H
+#define PONGSIM_H
+
+#include <string.h>
+#include "platform.h"
+
+//====================================================
+// Constants
+//====================================================
+
+// Paddle & Ball Parameters
+#define PADDLE_WIDTH		19	// Width of the paddle bitmap
+#define PADDLE_HEIGHT		79	// Height of the paddle bitmap
+#define PADDLE_INITIAL_X	15	// Distance of the paddle from the side of the screen
+#define PADDLE_MARGIN		15	// Closest the paddle gets to the top or bottom of the screen
+#define PADDLE_SPEED		6	// Number of pixels per tick the paddle moves
+#define BALL_WIDTH		30	// Width of the ball bitmap
+#define BALL_HEIGHT		30	// Height of the ball bitmap
+#define BALL_SPEED		1	// Number of pixels per tick the ball moves
+#define BALL_MAXSPEED	5	// Fastest ball speed (F5)
+
+// Window Resolution
+#define RES_WIDTH	640		// Window Width
+#define RES_HEIGHT	480		// Window Height
+
+// Miscellanious
+#define MAX_SCORE	10		// How many points it takes to win
+
+// The speeds above are per tick at this rate; other rates are scaled to match
+#define PONGSIM_BASE_RATE	100
+
+// Positions are fixed point with this many fraction bits, so any tick rate moves at the same speed
+#define PONGSIM_SHIFT	16
+#define PONGSIM_ONE		( 1 << PONGSIM_SHIFT )
+
+// Buttons held during a tick
+#define PONGINPUT_P1_UP		0x0001
+#define PONGINPUT_P1_DOWN	0x0002
+#define PONGINPUT_P2_UP		0x0004
+#define PONGINPUT_P2_DOWN	0x0008
+#define PONGINPUT_SPEED1	0x0010	// F1 - F5
+#define PONGINPUT_SPEED2	0x0020
+#define PONGINPUT_SPEED3	0x0040
+#define PONGINPUT_SPEED4	0x0080
+#define PONGINPUT_SPEED5	0x0100
+#define PONGINPUT_START		0x0200
+
+// What happened during a tick
+#define PONGEVENT_P1_SCORED	0x0001
+#define PONGEVENT_P2_SCORED	0x0002
+#define PONGEVENT_WALL		0x0004
+#define PONGEVENT_PADDLE	0x0008
+#define PONGEVENT_GAMEOVER	0x0010
+
+#define PONGEVENT_SCORED	( PONGEVENT_P1_SCORED | PONGEVENT_P2_SCORED )
+
+//====================================================
+// Simulation State
+//====================================================
+
+struct PONGSIM
+{
+	int TickRate;		// Ticks per second
+	DWORD Tick;			// Ticks run so far
+
+	int BallX;			// Top left of the ball (fixed point)
+	int BallY;
+	int MultiplierX;	// Controls ball's x motion (1 or -1)
+	int MultiplierY;	// Controls ball's y motion (1 or -1)
+	int BallSpeed;		// Ball speed setting (1 - 5)
+
+	int Paddle1X;		// Top left of player one's paddle (fixed point)
+	int Paddle1Y;
+	int Paddle2X;		// Top left of player two's paddle (fixed point)
+	int Paddle2Y;
+
+	int p1Score;		// Player one's score
+	int p2Score;		// Player two's score
+	int BounceCount;	// Paddle hits
+
+	BOOL bGameOver;		// Someone reached MAX_SCORE
+
+	DWORD Random;		// Random number generator state
+
+	int BallStep;		// Ball movement per tick per unit of speed (fixed point)
+	int PaddleStep;		// Paddle movement per tick (fixed point)
+};
+
+// Converts a fixed point position to whole pixels
+inline int PongSimPixels( int Fixed )
+{
+	return Fixed >> PONGSIM_SHIFT;
+}
+
+// Blends two fixed point positions, Alpha goes from 0 (all From) to 65536 (all To)
+inline int PongSimLerp( int From, int To, int Alpha )
+{
+	return From + (int)( ( (INT64)( To - From ) * Alpha ) >> 16 );
+}
+
+// Returns a random number from the simulation's own generator (xorshift)
+DWORD PongSimRandom( PONGSIM* pSim )
+{
+	DWORD x = pSim->Random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pSim->Random = x;
+
+	return x;
+}
+
+// Finds a completely random direction for the ball to move
+void PongSimRandomDirection( PONGSIM* pSim )
+{
+	pSim->MultiplierX = ( PongSimRandom( pSim ) & 1 ) ? 1 : -1;
+	pSim->MultiplierY = ( PongSimRandom( pSim ) & 1 ) ? 1 : -1;
+}
+
+// Sets up a new match
+void PongSimInit( PONGSIM* pSim, DWORD Seed, int TickRate = PONGSIM_BASE_RATE )
+{
+	memset( pSim, 0, sizeof( PONGSIM ) );
+
+	if( TickRate <= 0 )
+		TickRate = PONGSIM_BASE_RATE;
+
+	pSim->TickRate = TickRate;
+
+	// xorshift gets stuck on zero
+	pSim->Random = Seed ? Seed : 0x2545F491;
+
+	// Work out the per-tick steps once
+	pSim->BallStep = (int)( ( (INT64)BALL_SPEED * PONGSIM_ONE * PONGSIM_BASE_RATE ) / TickRate );
+	pSim->PaddleStep = (int)( ( (INT64)PADDLE_SPEED * PONGSIM_ONE * PONGSIM_BASE_RATE ) / TickRate );
+
+	// Initialize the paddles
+	pSim->Paddle1X = PADDLE_INITIAL_X << PONGSIM_SHIFT;
+	pSim->Paddle1Y = ( RES_HEIGHT / 2 ) << PONGSIM_SHIFT;
+	pSim->Paddle2X = ( RES_WIDTH - PADDLE_INITIAL_X - PADDLE_WIDTH ) << PONGSIM_SHIFT;
+	pSim->Paddle2Y = ( RES_HEIGHT / 2 ) << PONGSIM_SHIFT;
+
+	// Initialize the Ball in the middle of the screen
+	pSim->BallX = ( ( RES_WIDTH - BALL_WIDTH ) / 2 ) << PONGSIM_SHIFT;
+	pSim->BallY = ( ( RES_HEIGHT - BALL_HEIGHT ) / 2 ) << PONGSIM_SHIFT;
+	pSim->BallSpeed = BALL_SPEED;
+	PongSimRandomDirection( pSim );
+}
+
+// Moves a paddle and keeps it on the screen
+void PongSimMovePaddle( PONGSIM* pSim, int* pPaddleY, BOOL bUp, BOOL bDown )
+{
+	if( bUp )
+		*pPaddleY -= pSim->PaddleStep;
+	if( bDown )
+		*pPaddleY += pSim->PaddleStep;
+
+	if( *pPaddleY < ( PADDLE_MARGIN << PONGSIM_SHIFT ) )
+		*pPaddleY = PADDLE_MARGIN << PONGSIM_SHIFT;
+	if( *pPaddleY > ( ( RES_HEIGHT - PADDLE_HEIGHT - PADDLE_MARGIN ) << PONGSIM_SHIFT ) )
+		*pPaddleY = ( RES_HEIGHT - PADDLE_HEIGHT - PADDLE_MARGIN ) << PONGSIM_SHIFT;
+}
+
+// The most things the ball can hit in one tick before the rest of its movement is dropped
+#define PONGSIM_MAXCONTACTS	8
+
+// Returned by the sweep functions when nothing is hit
+#define PONGSIM_NOHIT		0x7FFFFFFF
+
+// What the ball hit first
+#define PONGSIM_CONTACT_GOAL		0
+#define PONGSIM_CONTACT_WALL		1
+#define PONGSIM_CONTACT_PADDLE1		2
+#define PONGSIM_CONTACT_PADDLE2		3
+
+// Sweeps the ball box against a paddle box.  The ball moves the same distance along x and y,
+// so the time of impact is just a distance and everything stays in integers.  Returns how far
+// the ball travels before it touches the paddle, or PONGSIM_NOHIT.  *pbFaceX is TRUE if it hits
+// the front or back of the paddle (reverse x) and FALSE for the top or bottom (reverse y).
+// GoalX is -1 for the paddle guarding the left side and 1 for the right.
+inline int PongSimSweepPaddle( int x, int y, int MultiplierX, int MultiplierY, int PaddleX, int PaddleY, int GoalX, BOOL* pbFaceX )
+{
+	// The ball's top left corner touches the paddle anywhere inside this box
+	int Left = PaddleX - ( BALL_WIDTH << PONGSIM_SHIFT );
+	int Right = PaddleX + ( PADDLE_WIDTH << PONGSIM_SHIFT );
+	int Top = PaddleY - ( BALL_HEIGHT << PONGSIM_SHIFT );
+	int Bottom = PaddleY + ( PADDLE_HEIGHT << PONGSIM_SHIFT );
+
+	// Distance along each axis to entering and leaving the box
+	int EnterX = ( MultiplierX > 0 ) ? Left - x : x - Right;
+	int ExitX = ( MultiplierX > 0 ) ? Right - x : x - Left;
+	int EnterY = ( MultiplierY > 0 ) ? Top - y : y - Bottom;
+	int ExitY = ( MultiplierY > 0 ) ? Bottom - y : y - Top;
+
+	// Already overlapping, e.g. the paddle moved onto the ball.  Turn it round if it is heading
+	// for the goal, and otherwise let it carry on out of the paddle.
+	if( EnterX < 0 && EnterY < 0 && ExitX > 0 && ExitY > 0 )
+	{
+		*pbFaceX = TRUE;
+		return ( MultiplierX == GoalX ) ? 0 : PONGSIM_NOHIT;
+	}
+
+	int Enter = EnterX > EnterY ? EnterX : EnterY;
+	int Exit = ExitX < ExitY ? ExitX : ExitY;
+
+	if( Enter < 0 || Enter >= Exit )
+		return PONGSIM_NOHIT;
+
+	// The axis that entered last is the face that was hit (a corner counts as the front)
+	*pbFaceX = EnterX >= EnterY;
+	return Enter;
+}
+
+// Moves the ball Distance along its path, bouncing off everything it meets on the way
+int PongSimMoveBall( PONGSIM* pSim, int Distance )
+{
+	int Events = 0;
+
+	for( int Contacts = 0 ; Distance > 0 && Contacts < PONGSIM_MAXCONTACTS ; Contacts++ )
+	{
+		int x = pSim->BallX;
+		int y = pSim->BallY;
+
+		// The goal lines behind the paddles
+		int Nearest = ( pSim->MultiplierX < 0 ) ? x : ( ( RES_WIDTH - BALL_WIDTH ) << PONGSIM_SHIFT ) - x;
+		int Contact = PONGSIM_CONTACT_GOAL;
+		if( Nearest < 0 )
+			Nearest = 0;
+
+		// The top and bottom of the screen
+		int Wall = ( pSim->MultiplierY < 0 ) ? y : ( ( RES_HEIGHT - BALL_HEIGHT ) << PONGSIM_SHIFT ) - y;
+		if( Wall < 0 )
+			Wall = 0;
+		if( Wall < Nearest )
+		{
+			Nearest = Wall;
+			Contact = PONGSIM_CONTACT_WALL;
+		}
+
+		// The paddles
+		BOOL bFaceX1 = FALSE, bFaceX2 = FALSE;
+		int Hit1 = PongSimSweepPaddle( x, y, pSim->MultiplierX, pSim->MultiplierY, pSim->Paddle1X, pSim->Paddle1Y, -1, &bFaceX1 );
+		int Hit2 = PongSimSweepPaddle( x, y, pSim->MultiplierX, pSim->MultiplierY, pSim->Paddle2X, pSim->Paddle2Y, 1, &bFaceX2 );
+
+		if( Hit1 < Nearest )
+		{
+			Nearest = Hit1;
+			Contact = PONGSIM_CONTACT_PADDLE1;
+		}
+		if( Hit2 < Nearest )
+		{
+			Nearest = Hit2;
+			Contact = PONGSIM_CONTACT_PADDLE2;
+		}
+
+		// Nothing in the way this tick
+		if( Nearest >= Distance )
+		{
+			pSim->BallX += pSim->MultiplierX * Distance;
+			pSim->BallY += pSim->MultiplierY * Distance;
+			break;
+		}
+
+		// Move up to the point of contact
+		pSim->BallX += pSim->MultiplierX * Nearest;
+		pSim->BallY += pSim->MultiplierY * Nearest;
+		Distance -= Nearest;
+
+		// Score, and bounce back into play
+		if( Contact == PONGSIM_CONTACT_GOAL )
+		{
+			if( pSim->MultiplierX < 0 )
+			{
+				pSim->p2Score++;
+				Events |= PONGEVENT_P2_SCORED;
+			}
+			else
+			{
+				pSim->p1Score++;
+				Events |= PONGEVENT_P1_SCORED;
+			}
+
+			pSim->MultiplierX = -pSim->MultiplierX;
+		}
+
+		// Bounce off the top and bottom
+		if( Contact == PONGSIM_CONTACT_WALL )
+		{
+			pSim->MultiplierY = -pSim->MultiplierY;
+			Events |= PONGEVENT_WALL;
+		}
+
+		// Bounce off a paddle
+		if( Contact == PONGSIM_CONTACT_PADDLE1 || Contact == PONGSIM_CONTACT_PADDLE2 )
+		{
+			BOOL bFaceX = ( Contact == PONGSIM_CONTACT_PADDLE1 ) ? bFaceX1 : bFaceX2;
+
+			if( bFaceX )
+				pSim->MultiplierX = -pSim->MultiplierX;
+			else
+				pSim->MultiplierY = -pSim->MultiplierY;
+
+			pSim->BounceCount++;
+			Events |= PONGEVENT_PADDLE;
+		}
+	}
+
+	return Events;
+}
+
+// Advances the match by one tick.  Returns the PONGEVENT_ flags for what happened.
+int PongSimStep( PONGSIM* pSim, unsigned int Input )
+{
+	pSim->Tick++;
+
+	// Adjust Ball Speed (the highest key held wins)
+	for( int Speed = 1 ; Speed <= BALL_MAXSPEED ; Speed++ )
+	{
+		if( Input & ( PONGINPUT_SPEED1 << ( Speed - 1 ) ) )
+			pSim->BallSpeed = Speed;
+	}
+
+	// Player controls
+	PongSimMovePaddle( pSim, &pSim->Paddle1Y, Input & PONGINPUT_P1_UP, Input & PONGINPUT_P1_DOWN );
+	PongSimMovePaddle( pSim, &pSim->Paddle2Y, Input & PONGINPUT_P2_UP, Input & PONGINPUT_P2_DOWN );
+
+	// The ball stops once the match is won
+	if( pSim->bGameOver )
+		return 0;
+
+	// Move the ball, with the paddles where they ended up this tick
+	int Events = PongSimMoveBall( pSim, pSim->BallSpeed * pSim->BallStep );
+
+	// Check for a winner
+	if( pSim->p1Score >= MAX_SCORE || pSim->p2Score >= MAX_SCORE )
+	{
+		pSim->bGameOver = TRUE;
+		Events |= PONGEVENT_GAMEOVER;
+	}
+
+	return Events;
+}
+
+// Hashes the match state (FNV-1a), for checking two runs ended up in the same place
+DWORD PongSimHash( const PONGSIM* pSim )
+{
+	int Fields[] = { (int)pSim->Tick, pSim->BallX, pSim->BallY, pSim->MultiplierX, pSim->MultiplierY, pSim->BallSpeed,
+					 pSim->Paddle1Y, pSim->Paddle2Y, pSim->p1Score, pSim->p2Score, pSim->BounceCount, pSim->bGameOver, (int)pSim->Random };
+
+	DWORD Hash = 2166136261u;
+	const BYTE* pBytes = (const BYTE*)Fields;
+
+	for( unsigned int i = 0 ; i < sizeof( Fields ) ; i++ )
+	{
+		Hash ^= pBytes[ i ];
+		Hash *= 16777619u;
+	}
+
+	return Hash;
+}
+
+#endif	// PONGSIM_H
@@ -0,0 +1,223 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Frame timing.  Each stage of a frame is timed with a PROFILESCOPE and the
+// time goes into a log-linear histogram: every power of two is split into
+// 16 equal buckets, so any percentile is within 1/16 of the real value and
+// recording is just a shift and an add.  Each histogram has one writer;
+// the counters are atomics so another thread can read them while it runs.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "platform.h"
+#include "hrclock.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define HISTOGRAM_SUBBITS		4							// 16 buckets per power of two
+#define HISTOGRAM_SUBBUCKETS	( 1 << HISTOGRAM_SUBBITS )
+#define HISTOGRAM_BUCKETS		( ( 32 - HISTOGRAM_SUBBITS + 1 ) * HISTOGRAM_SUBBUCKETS )	// Covers every DWORD
+
+// Times are recorded in nanoseconds
+struct HISTOGRAM
+{
+	std::atomic<DWORD> Counts[ HISTOGRAM_BUCKETS ];
+	std::atomic<DWORD> Count;
+	std::atomic<DWORD> Max;
+	std::atomic<INT64> Total;
+};
+
+// Which bucket a value goes in
+inline int HistogramBucket( DWORD Value )
+{
+	if( Value < HISTOGRAM_SUBBUCKETS )
+		return (int)Value;
+
+	// Position of the top bit
+#ifdef _MSC_VER
+	unsigned long Top;
+	_BitScanReverse( &Top, Value );
+#else
+	int Top = 31 - __builtin_clz( Value );
+#endif
+
+	// The top bit picks the power of two, the next HISTOGRAM_SUBBITS bits pick the bucket in it
+	int Shift = (int)Top - HISTOGRAM_SUBBITS;
+	return ( Shift + 1 ) * HISTOGRAM_SUBBUCKETS + (int)( ( Value >> Shift ) & ( HISTOGRAM_SUBBUCKETS - 1 ) );
+}
+
+// The largest value that goes in a bucket
+inline DWORD HistogramBucketTop( int Bucket )
+{
+	if( Bucket < HISTOGRAM_SUBBUCKETS )
+		return (DWORD)Bucket;
+
+	int Shift = Bucket / HISTOGRAM_SUBBUCKETS - 1;
+	DWORD Sub = (DWORD)( Bucket % HISTOGRAM_SUBBUCKETS );
+	INT64 Bottom = (INT64)( HISTOGRAM_SUBBUCKETS + Sub ) << Shift;
+
+	return (DWORD)( Bottom + ( (INT64)1 << Shift ) - 1 );
+}
+
+void ClearHistogram( HISTOGRAM* pHistogram )
+{
+	for( int i = 0 ; i < HISTOGRAM_BUCKETS ; i++ )
+		pHistogram->Counts[ i ].store( 0, std::memory_order_relaxed );
+
+	pHistogram->Count.store( 0, std::memory_order_relaxed );
+	pHistogram->Max.store( 0, std::memory_order_relaxed );
+	pHistogram->Total.store( 0, std::memory_order_relaxed );
+}
+
+// Adds one value.  Only one thread may record into a histogram, so plain loads and stores
+// are enough and no locked instructions are needed.
+inline void RecordHistogram( HISTOGRAM* pHistogram, INT64 Nanoseconds )
+{
+	DWORD Value = Nanoseconds < 0 ? 0 : ( Nanoseconds > 0xFFFFFFFF ? 0xFFFFFFFF : (DWORD)Nanoseconds );
+	std::atomic<DWORD>* pCount = &pHistogram->Counts[ HistogramBucket( Value ) ];
+
+	pCount->store( pCount->load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+	pHistogram->Total.store( pHistogram->Total.load( std::memory_order_relaxed ) + Value, std::memory_order_relaxed );
+	if( Value > pHistogram->Max.load( std::memory_order_relaxed ) )
+		pHistogram->Max.store( Value, std::memory_order_relaxed );
+
+	// Published last, so a reader never sees more values than bucket counts
+	pHistogram->Count.store( pHistogram->Count.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+// Returns the value (in ns) that Fraction of the recorded values are at or below, e.g. 0.99
+DWORD HistogramPercentile( const HISTOGRAM* pHistogram, double Fraction )
+{
+	DWORD Count = pHistogram->Count.load( std::memory_order_acquire );
+	if( Count == 0 )
+		return 0;
+
+	// The rank of the value we want, counting from 1
+	DWORD Rank = (DWORD)( Fraction * Count + 0.999999 );
+	if( Rank < 1 )
+		Rank = 1;
+	if( Rank > Count )
+		Rank = Count;
+
+	DWORD Max = pHistogram->Max.load( std::memory_order_relaxed );
+	DWORD Seen = 0;
+
+	for( int i = 0 ; i < HISTOGRAM_BUCKETS ; i++ )
+	{
+		Seen += pHistogram->Counts[ i ].load( std::memory_order_relaxed );
+		if( Seen >= Rank )
+		{
+			// Nothing was bigger than the max, so the bucket top can be trimmed to it
+			DWORD Top = HistogramBucketTop( i );
+			return Top < Max ? Top : Max;
+		}
+	}
+
+	return Max;
+}
+
+// Average in ns
+double HistogramMean( const HISTOGRAM* pHistogram )
+{
+	DWORD Count = pHistogram->Count.load( std::memory_order_acquire );
+	return Count ? (double)pHistogram->Total.load( std::memory_order_relaxed ) / Count : 0.0;
+}
+
+//====================================================
+// Frame Stages
+//====================================================
+
+enum PROFILESTAGE
+{
+	PROFILE_FRAME,			// Start of one frame to the start of the next
+	PROFILE_SIM,			// One batch of simulation ticks, on the sim thread
+	PROFILE_VALIDATE,		// Checking the device
+	PROFILE_BACKGROUND,		// Clearing and restoring the background
+	PROFILE_SPRITES,		// Paddles and ball
+	PROFILE_TEXT,			// Drawing the text
+	PROFILE_PRESENT,		// Present()
+	PROFILE_LATENCY,		// A key going down to the first frame showing it being presented
+
+	PROFILE_STAGES
+};
+
+const char* g_ProfileStageNames[ PROFILE_STAGES ] =
+{
+	"Frame", "Sim", "Validate", "Background", "Sprites", "Text", "Present", "Latency"
+};
+
+HISTOGRAM g_ProfileHistograms[ PROFILE_STAGES ];
+
+// Times the rest of the enclosing block into one stage
+struct PROFILESCOPE
+{
+	int Stage;
+	INT64 Start;
+
+	PROFILESCOPE( int StageToTime ) : Stage( StageToTime ), Start( HrClockNow() ) {}
+	~PROFILESCOPE() { RecordHistogram( &g_ProfileHistograms[ Stage ], HrClockToNs( HrClockNow() - Start ) ); }
+};
+
+void ClearProfile()
+{
+	for( int i = 0 ; i < PROFILE_STAGES ; i++ )
+		ClearHistogram( &g_ProfileHistograms[ i ] );
+}
+
+// Records the time since the last call as one frame
+void ProfileFrame()
+{
+	static INT64 LastFrame = 0;
+	INT64 Now = HrClockNow();
+
+	if( LastFrame )
+		RecordHistogram( &g_ProfileHistograms[ PROFILE_FRAME ], HrClockToNs( Now - LastFrame ) );
+
+	LastFrame = Now;
+}
+
+// Formats one stage as "Name  p50  p99  p99.9  max" in microseconds, for the overlay
+void FormatProfileStage( int Stage, char* pString, int Size )
+{
+	const HISTOGRAM* pHistogram = &g_ProfileHistograms[ Stage ];
+
+	snprintf( pString, Size, "%-10s %7.1f %7.1f %7.1f %7.1f", g_ProfileStageNames[ Stage ],
+			  HistogramPercentile( pHistogram, 0.5 ) / 1000.0, HistogramPercentile( pHistogram, 0.99 ) / 1000.0,
+			  HistogramPercentile( pHistogram, 0.999 ) / 1000.0, pHistogram->Max.load( std::memory_order_relaxed ) / 1000.0 );
+	pString[ Size - 1 ] = 0;
+}
+
+// Writes a summary of every stage to a CSV file, times in microseconds
+BOOL WriteProfileCSV( const char* FileName )
+{
+	FILE* pFile = fopen( FileName, "w" );
+	if( !pFile )
+		return FALSE;
+
+	fprintf( pFile, "stage,count,mean_us,p50_us,p90_us,p99_us,p99.9_us,max_us\n" );
+
+	for( int i = 0 ; i < PROFILE_STAGES ; i++ )
+	{
+		const HISTOGRAM* pHistogram = &g_ProfileHistograms[ i ];
+
+		fprintf( pFile, "%s,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", g_ProfileStageNames[ i ],
+				 pHistogram->Count.load( std::memory_order_relaxed ), HistogramMean( pHistogram ) / 1000.0,
+				 HistogramPercentile( pHistogram, 0.5 ) / 1000.0, HistogramPercentile( pHistogram, 0.9 ) / 1000.0,
+				 HistogramPercentile( pHistogram, 0.99 ) / 1000.0, HistogramPercentile( pHistogram, 0.999 ) / 1000.0,
+				 pHistogram->Max.load( std::memory_order_relaxed ) / 1000.0 );
+	}
+
+	fclose( pFile );
+	return TRUE;
+}
+
+#endif	// PROFILE_H
@@ -0,0 +1,289 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Match recordings.  The simulation only depends on its seed, its tick rate
+// and the buttons held on each tick, so that is all a recording keeps, and
+// playing one back gives exactly the same match.  No rendering and no
+// clock are involved, so a match plays back as fast as the CPU can tick it.
+//
+// File layout (all numbers little endian):
+//		'UPRP', version, tick rate, seed, ticks, final state hash, data bytes
+//		then one number per run of ticks with the same buttons held:
+//		( ticks - 1 ) << 5 | the button that changed since the last run,
+//		or REPLAY_MANY followed by the changed buttons, or REPLAY_NONE.
+// Numbers are stored 7 bits a byte with the top bit meaning "more".  Most
+// runs change one button and are under four ticks long, which is one byte,
+// and a person holds buttons down far longer than that.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+#include "pongsim.h"
+
+#define REPLAY_MAGIC		0x50525055	// 'UPRP'
+#define REPLAY_VERSION		1
+#define REPLAY_HEADERSIZE	28
+
+#define REPLAY_MANY			16			// More than one button changed, the XOR follows
+#define REPLAY_NONE			17			// Nothing changed (the first run, or a very long run split up)
+#define REPLAY_MAXRUN		( 1 << 26 )	// So the run fits in a DWORD with the change
+
+struct REPLAY
+{
+	int TickRate;
+	DWORD Seed;
+	DWORD TickCount;
+	DWORD FinalHash;		// PongSimHash() after the last tick
+
+	BYTE* pData;			// The runs
+	DWORD DataSize;
+	DWORD Capacity;
+
+	// While recording, the run that has not been written yet
+	unsigned int RunInput;
+	DWORD RunLength;
+	unsigned int LastInput;	// Buttons of the last run written
+};
+
+// Adds one number, 7 bits at a time
+void ReplayPutVarint( REPLAY* pReplay, DWORD Value )
+{
+	// 5 bytes is the most a DWORD takes
+	if( pReplay->DataSize + 5 > pReplay->Capacity )
+	{
+		DWORD Capacity = pReplay->Capacity ? pReplay->Capacity * 2 : 4096;
+		BYTE* pData = new BYTE[ Capacity ];
+		if( pReplay->pData )
+		{
+			memcpy( pData, pReplay->pData, pReplay->DataSize );
+			delete [] pReplay->pData;
+		}
+		pReplay->pData = pData;
+		pReplay->Capacity = Capacity;
+	}
+
+	while( Value >= 0x80 )
+	{
+		pReplay->pData[ pReplay->DataSize++ ] = (BYTE)( Value | 0x80 );
+		Value >>= 7;
+	}
+	pReplay->pData[ pReplay->DataSize++ ] = (BYTE)Value;
+}
+
+// Reads one number.  Returns FALSE if the data runs out first.
+inline BOOL ReplayGetVarint( const BYTE* pData, DWORD Size, DWORD* pPos, DWORD* pValue )
+{
+	DWORD Value = 0;
+
+	for( int Shift = 0 ; Shift < 35 ; Shift += 7 )
+	{
+		if( *pPos >= Size )
+			return FALSE;
+
+		BYTE b = pData[ ( *pPos )++ ];
+		Value |= (DWORD)( b & 0x7F ) << Shift;
+		if( !( b & 0x80 ) )
+		{
+			*pValue = Value;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void FreeReplay( REPLAY* pReplay )
+{
+	delete [] pReplay->pData;
+	memset( pReplay, 0, sizeof( REPLAY ) );
+}
+
+//====================================================
+// Recording
+//====================================================
+
+// Starts an empty recording of a match set up with PongSimInit( Seed, TickRate )
+void BeginReplayRecord( REPLAY* pReplay, DWORD Seed, int TickRate )
+{
+	FreeReplay( pReplay );
+
+	pReplay->Seed = Seed;
+	pReplay->TickRate = TickRate;
+}
+
+// Writes out the run being held
+void ReplayFlushRun( REPLAY* pReplay )
+{
+	if( pReplay->RunLength == 0 )
+		return;
+
+	DWORD Change = pReplay->RunInput ^ pReplay->LastInput;
+	DWORD Code = REPLAY_MANY;
+
+	if( Change == 0 )
+		Code = REPLAY_NONE;
+	else if( ( Change & ( Change - 1 ) ) == 0 )
+	{
+		// Just one button, so store which
+		Code = 0;
+		while( !( Change & ( 1 << Code ) ) )
+			Code++;
+	}
+
+	ReplayPutVarint( pReplay, ( pReplay->RunLength - 1 ) << 5 | Code );
+	if( Code == REPLAY_MANY )
+		ReplayPutVarint( pReplay, Change );
+
+	pReplay->LastInput = pReplay->RunInput;
+	pReplay->RunLength = 0;
+}
+
+// Records the input given to one PongSimStep() call
+inline void RecordReplayTick( REPLAY* pReplay, unsigned int Input )
+{
+	if( Input != pReplay->RunInput || pReplay->RunLength == REPLAY_MAXRUN )
+	{
+		ReplayFlushRun( pReplay );
+		pReplay->RunInput = Input;
+	}
+
+	pReplay->RunLength++;
+	pReplay->TickCount++;
+}
+
+// Finishes the recording.  pSim is the match after the last recorded tick.
+void EndReplayRecord( REPLAY* pReplay, const PONGSIM* pSim )
+{
+	ReplayFlushRun( pReplay );
+	pReplay->FinalHash = PongSimHash( pSim );
+}
+
+//====================================================
+// Saving and Loading
+//====================================================
+
+BOOL SaveReplay( const REPLAY* pReplay, const char* FileName )
+{
+	FILE* pFile = fopen( FileName, "wb" );
+	if( !pFile )
+		return FALSE;
+
+	DWORD Fields[] = { REPLAY_MAGIC, REPLAY_VERSION, (DWORD)pReplay->TickRate, pReplay->Seed,
+					   pReplay->TickCount, pReplay->FinalHash, pReplay->DataSize };
+
+	// A byte at a time so the file is the same on any machine
+	BYTE Header[ REPLAY_HEADERSIZE ];
+	for( int i = 0 ; i < REPLAY_HEADERSIZE ; i++ )
+		Header[ i ] = (BYTE)( Fields[ i / 4 ] >> ( ( i % 4 ) * 8 ) );
+
+	BOOL bOk = fwrite( Header, sizeof( Header ), 1, pFile ) == 1;
+	if( bOk && pReplay->DataSize )
+		bOk = fwrite( pReplay->pData, pReplay->DataSize, 1, pFile ) == 1;
+
+	fclose( pFile );
+	return bOk;
+}
+
+BOOL LoadReplay( REPLAY* pReplay, const char* FileName )
+{
+	FreeReplay( pReplay );
+
+	FILE* pFile = fopen( FileName, "rb" );
+	if( !pFile )
+		return FALSE;
+
+	BYTE Header[ REPLAY_HEADERSIZE ];
+	DWORD Fields[ REPLAY_HEADERSIZE / 4 ];
+
+	BOOL bOk = fread( Header, sizeof( Header ), 1, pFile ) == 1;
+	if( bOk )
+	{
+		for( int i = 0 ; i < REPLAY_HEADERSIZE / 4 ; i++ )
+			Fields[ i ] = Header[ i * 4 ] | ( Header[ i * 4 + 1 ] << 8 ) | ( Header[ i * 4 + 2 ] << 16 ) | ( (DWORD)Header[ i * 4 + 3 ] << 24 );
+
+		bOk = Fields[ 0 ] == REPLAY_MAGIC && Fields[ 1 ] == REPLAY_VERSION;
+	}
+
+	if( bOk )
+	{
+		pReplay->TickRate = (int)Fields[ 2 ];
+		pReplay->Seed = Fields[ 3 ];
+		pReplay->TickCount = Fields[ 4 ];
+		pReplay->FinalHash = Fields[ 5 ];
+		pReplay->DataSize = pReplay->Capacity = Fields[ 6 ];
+
+		pReplay->pData = new BYTE[ pReplay->DataSize ? pReplay->DataSize : 1 ];
+		if( pReplay->DataSize )
+			bOk = fread( pReplay->pData, pReplay->DataSize, 1, pFile ) == 1;
+	}
+
+	fclose( pFile );
+
+	if( !bOk )
+		FreeReplay( pReplay );
+
+	return bOk;
+}
+
+//====================================================
+// Playback
+//====================================================
+
+// Reads the next run.  Input holds the buttons of the previous run going in, and this run's
+// coming out.  Returns FALSE if the data is damaged.
+inline BOOL ReplayNextRun( const BYTE* pData, DWORD Size, DWORD* pPos, unsigned int* pInput, DWORD* pLength )
+{
+	DWORD Run, Change;
+	if( !ReplayGetVarint( pData, Size, pPos, &Run ) )
+		return FALSE;
+
+	DWORD Code = Run & 31;
+	*pLength = ( Run >> 5 ) + 1;
+
+	if( Code < REPLAY_MANY )
+		*pInput ^= 1 << Code;
+	else if( Code == REPLAY_MANY )
+	{
+		if( !ReplayGetVarint( pData, Size, pPos, &Change ) )
+			return FALSE;
+		*pInput ^= Change;
+	}
+	else if( Code != REPLAY_NONE )
+		return FALSE;
+
+	return TRUE;
+}
+
+// Plays the whole recording into pSim, as fast as it will go.  Returns TRUE if the match
+// ended up where it did when it was recorded.
+BOOL PlayReplay( const REPLAY* pReplay, PONGSIM* pSim )
+{
+	PongSimInit( pSim, pReplay->Seed, pReplay->TickRate );
+
+	DWORD Pos = 0;
+	DWORD Ticks = 0;
+	unsigned int Input = 0;
+	DWORD Length;
+
+	while( Pos < pReplay->DataSize )
+	{
+		if( !ReplayNextRun( pReplay->pData, pReplay->DataSize, &Pos, &Input, &Length ) )
+			return FALSE;
+
+		Ticks += Length;
+
+		// The same buttons are held for the whole run
+		for( DWORD i = 0 ; i < Length ; i++ )
+			PongSimStep( pSim, Input );
+	}
+
+	return Ticks == pReplay->TickCount && PongSimHash( pSim ) == pReplay->FinalHash;
+}
+
+#endif	// REPLAY_H
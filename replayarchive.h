@@ -0,0 +1,414 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Replay archives: any number of match recordings in one file, laid out so
+// the file can be memory mapped and read where it lies.  Every
+// REPLAYARCHIVE_INTERVAL ticks a match stores a keyframe, the whole
+// PONGSIM at that tick plus where its input runs carry on from, so getting
+// to any tick is a binary search for the keyframe before it and at most one
+// interval of simulation.  The reader never allocates or copies the file,
+// so any number of threads can read the same mapping at once.
+//
+// File layout (little endian, as the structures are in memory on x86):
+//		REPLAYARCHIVEHEADER
+//		for each match: its REPLAYKEYFRAMEs, then its input runs (replay.h format)
+//		REPLAYMATCH table
+// Everything starts on an 8 byte boundary.
+
+#ifndef REPLAYARCHIVE_H
+#define REPLAYARCHIVE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+#include "pongsim.h"
+#include "replay.h"
+
+#define REPLAYARCHIVE_MAGIC		0x41525055	// 'UPRA'
+#define REPLAYARCHIVE_VERSION	1
+#define REPLAYARCHIVE_INTERVAL	1024		// Ticks between keyframes
+
+struct REPLAYARCHIVEHEADER
+{
+	DWORD Magic;
+	DWORD Version;
+	DWORD MatchCount;
+	DWORD KeyframeInterval;
+	INT64 MatchTable;			// File offset of the REPLAYMATCH table
+	INT64 Reserved;
+};
+
+struct REPLAYMATCH
+{
+	DWORD Seed;
+	int TickRate;
+	DWORD TickCount;
+	DWORD FinalHash;
+	DWORD KeyframeCount;		// The first is always tick 0
+	DWORD RunBytes;
+	INT64 Keyframes;			// File offsets
+	INT64 Runs;
+};
+
+struct REPLAYKEYFRAME
+{
+	DWORD Tick;
+	DWORD Offset;				// Where in the runs the run starting at this tick is
+	DWORD Input;				// Buttons of the run before it
+	DWORD Reserved;
+	PONGSIM Sim;				// The match before this tick is run
+};
+
+// The layout is the file format, so it must not change with the compiler
+static_assert( sizeof( REPLAYARCHIVEHEADER ) == 32, "REPLAYARCHIVEHEADER is part of the file format" );
+static_assert( sizeof( REPLAYMATCH ) == 40, "REPLAYMATCH is part of the file format" );
+static_assert( sizeof( REPLAYKEYFRAME ) == 16 + 18 * 4, "REPLAYKEYFRAME is part of the file format" );
+
+// Keyframes in a match of TickCount ticks
+inline DWORD ReplayArchiveKeyframes( DWORD TickCount, DWORD Interval )
+{
+	return TickCount ? ( TickCount - 1 ) / Interval + 1 : 1;
+}
+
+//====================================================
+// Writing
+//====================================================
+
+struct REPLAYARCHIVEWRITER
+{
+	FILE* pFile;
+	INT64 Pos;					// Bytes written so far
+	DWORD Interval;
+
+	REPLAYMATCH* pMatches;
+	int MatchCount;
+	int Capacity;
+};
+
+BOOL ReplayArchiveWrite( REPLAYARCHIVEWRITER* pWriter, const void* pData, DWORD Bytes )
+{
+	if( Bytes && fwrite( pData, Bytes, 1, pWriter->pFile ) != 1 )
+		return FALSE;
+
+	pWriter->Pos += Bytes;
+	return TRUE;
+}
+
+// Pads the file out to the next 8 byte boundary
+BOOL ReplayArchiveAlign( REPLAYARCHIVEWRITER* pWriter )
+{
+	static const BYTE Zero[ 8 ] = { 0 };
+	return ReplayArchiveWrite( pWriter, Zero, (DWORD)( -pWriter->Pos & 7 ) );
+}
+
+// Starts a new archive.  Keyframes go in every Interval ticks.
+BOOL BeginReplayArchive( REPLAYARCHIVEWRITER* pWriter, const char* FileName, DWORD Interval = REPLAYARCHIVE_INTERVAL )
+{
+	memset( pWriter, 0, sizeof( REPLAYARCHIVEWRITER ) );
+
+	pWriter->pFile = fopen( FileName, "wb" );
+	if( !pWriter->pFile )
+		return FALSE;
+
+	pWriter->Interval = Interval ? Interval : REPLAYARCHIVE_INTERVAL;
+
+	// The real header goes in at the end, once the table is written
+	REPLAYARCHIVEHEADER Header;
+	memset( &Header, 0, sizeof( Header ) );
+	return ReplayArchiveWrite( pWriter, &Header, sizeof( Header ) );
+}
+
+// Adds a recording to the archive.  The match is played through once to take the keyframes.
+// Returns FALSE if the recording does not play back to its final hash or the file cannot be written.
+BOOL AddReplayArchiveMatch( REPLAYARCHIVEWRITER* pWriter, const REPLAY* pReplay )
+{
+	if( pWriter->MatchCount == pWriter->Capacity )
+	{
+		int Capacity = pWriter->Capacity ? pWriter->Capacity * 2 : 64;
+		REPLAYMATCH* pMatches = new REPLAYMATCH[ Capacity ];
+		if( pWriter->pMatches )
+		{
+			memcpy( pMatches, pWriter->pMatches, pWriter->MatchCount * sizeof( REPLAYMATCH ) );
+			delete [] pWriter->pMatches;
+		}
+		pWriter->pMatches = pMatches;
+		pWriter->Capacity = Capacity;
+	}
+
+	DWORD KeyframeCount = ReplayArchiveKeyframes( pReplay->TickCount, pWriter->Interval );
+	REPLAYKEYFRAME* pKeyframes = new REPLAYKEYFRAME[ KeyframeCount ];
+	memset( pKeyframes, 0, KeyframeCount * sizeof( REPLAYKEYFRAME ) );
+
+	// The runs are written again, split at every keyframe so play can start there
+	REPLAY Runs;
+	memset( &Runs, 0, sizeof( Runs ) );
+	BeginReplayRecord( &Runs, pReplay->Seed, pReplay->TickRate );
+
+	PONGSIM Sim;
+	PongSimInit( &Sim, pReplay->Seed, pReplay->TickRate );
+
+	DWORD Pos = 0;
+	DWORD Keyframe = 0;
+	unsigned int Input = 0;
+	DWORD Length;
+	BOOL bOk = TRUE;
+
+	while( bOk && Pos < pReplay->DataSize )
+	{
+		bOk = ReplayNextRun( pReplay->pData, pReplay->DataSize, &Pos, &Input, &Length );
+
+		for( DWORD i = 0 ; bOk && i < Length ; i++ )
+		{
+			if( Sim.Tick % pWriter->Interval == 0 )
+			{
+				// More ticks than the header says
+				if( Keyframe == KeyframeCount )
+				{
+					bOk = FALSE;
+					break;
+				}
+
+				ReplayFlushRun( &Runs );
+
+				REPLAYKEYFRAME* pKeyframe = &pKeyframes[ Keyframe++ ];
+				pKeyframe->Tick = Sim.Tick;
+				pKeyframe->Offset = Runs.DataSize;
+				pKeyframe->Input = Runs.LastInput;
+				pKeyframe->Sim = Sim;
+			}
+
+			RecordReplayTick( &Runs, Input );
+			PongSimStep( &Sim, Input );
+		}
+	}
+
+	// A recording with no ticks still starts with a keyframe
+	if( Keyframe == 0 )
+	{
+		pKeyframes[ 0 ].Sim = Sim;
+		Keyframe = 1;
+	}
+
+	EndReplayRecord( &Runs, &Sim );
+	bOk = bOk && Keyframe == KeyframeCount && Runs.TickCount == pReplay->TickCount && Runs.FinalHash == pReplay->FinalHash;
+
+	REPLAYMATCH* pMatch = &pWriter->pMatches[ pWriter->MatchCount ];
+	pMatch->Seed = pReplay->Seed;
+	pMatch->TickRate = pReplay->TickRate;
+	pMatch->TickCount = pReplay->TickCount;
+	pMatch->FinalHash = pReplay->FinalHash;
+	pMatch->KeyframeCount = KeyframeCount;
+	pMatch->RunBytes = Runs.DataSize;
+
+	if( bOk )
+	{
+		pMatch->Keyframes = pWriter->Pos;
+		bOk = ReplayArchiveWrite( pWriter, pKeyframes, KeyframeCount * sizeof( REPLAYKEYFRAME ) ) && ReplayArchiveAlign( pWriter );
+
+		pMatch->Runs = pWriter->Pos;
+		bOk = bOk && ReplayArchiveWrite( pWriter, Runs.pData, Runs.DataSize ) && ReplayArchiveAlign( pWriter );
+	}
+
+	if( bOk )
+		pWriter->MatchCount++;
+
+	delete [] pKeyframes;
+	FreeReplay( &Runs );
+	return bOk;
+}
+
+// Writes the match table and the header, and closes the file
+BOOL EndReplayArchive( REPLAYARCHIVEWRITER* pWriter )
+{
+	REPLAYARCHIVEHEADER Header;
+	memset( &Header, 0, sizeof( Header ) );
+	Header.Magic = REPLAYARCHIVE_MAGIC;
+	Header.Version = REPLAYARCHIVE_VERSION;
+	Header.MatchCount = pWriter->MatchCount;
+	Header.KeyframeInterval = pWriter->Interval;
+	Header.MatchTable = pWriter->Pos;
+
+	BOOL bOk = ReplayArchiveWrite( pWriter, pWriter->pMatches, pWriter->MatchCount * sizeof( REPLAYMATCH ) );
+
+	bOk = bOk && fseek( pWriter->pFile, 0, SEEK_SET ) == 0;
+	bOk = bOk && fwrite( &Header, sizeof( Header ), 1, pWriter->pFile ) == 1;
+	bOk = ( fclose( pWriter->pFile ) == 0 ) && bOk;
+
+	delete [] pWriter->pMatches;
+	memset( pWriter, 0, sizeof( REPLAYARCHIVEWRITER ) );
+	return bOk;
+}
+
+//====================================================
+// Reading
+//====================================================
+
+// An archive in memory.  Only points into the data it was opened on.
+struct REPLAYARCHIVE
+{
+	const BYTE* pBase;
+	INT64 Size;
+	const REPLAYARCHIVEHEADER* pHeader;
+	const REPLAYMATCH* pMatches;
+	int MatchCount;
+};
+
+// Where a match is being played from
+struct REPLAYCURSOR
+{
+	const BYTE* pRuns;
+	DWORD RunBytes;
+	DWORD Pos;
+	unsigned int Input;
+	DWORD RunLeft;				// Ticks left in the current run
+};
+
+// TRUE if Count items of Size bytes at Offset lie inside the archive, suitably aligned
+inline BOOL ReplayArchiveInside( const REPLAYARCHIVE* pArchive, INT64 Offset, INT64 Count, INT64 Size, INT64 Align )
+{
+	// Compare against the room left after Offset, so a huge offset or count cannot overflow
+	return Offset >= 0 && Offset <= pArchive->Size && ( Offset & ( Align - 1 ) ) == 0 &&
+		   Count >= 0 && Count <= ( pArchive->Size - Offset ) / Size;
+}
+
+// Checks the header and the match table of an archive at pData (normally a mapped file, which is
+// page aligned).  Nothing is copied; pData has to stay around while the archive is used.
+BOOL OpenReplayArchive( REPLAYARCHIVE* pArchive, const BYTE* pData, INT64 Size )
+{
+	memset( pArchive, 0, sizeof( REPLAYARCHIVE ) );
+	pArchive->pBase = pData;
+	pArchive->Size = Size;
+
+	if( !pData || ( (size_t)pData & 7 ) || Size < (INT64)sizeof( REPLAYARCHIVEHEADER ) )
+		return FALSE;
+
+	const REPLAYARCHIVEHEADER* pHeader = (const REPLAYARCHIVEHEADER*)pData;
+	if( pHeader->Magic != REPLAYARCHIVE_MAGIC || pHeader->Version != REPLAYARCHIVE_VERSION || pHeader->KeyframeInterval == 0 )
+		return FALSE;
+
+	if( !ReplayArchiveInside( pArchive, pHeader->MatchTable, pHeader->MatchCount, sizeof( REPLAYMATCH ), 8 ) )
+		return FALSE;
+
+	const REPLAYMATCH* pMatches = (const REPLAYMATCH*)( pData + pHeader->MatchTable );
+
+	// Check every match once here so seeking does not have to
+	for( DWORD i = 0 ; i < pHeader->MatchCount ; i++ )
+	{
+		const REPLAYMATCH* pMatch = &pMatches[ i ];
+		if( pMatch->KeyframeCount != ReplayArchiveKeyframes( pMatch->TickCount, pHeader->KeyframeInterval ) ||
+			!ReplayArchiveInside( pArchive, pMatch->Keyframes, pMatch->KeyframeCount, sizeof( REPLAYKEYFRAME ), 8 ) ||
+			!ReplayArchiveInside( pArchive, pMatch->Runs, pMatch->RunBytes, 1, 8 ) )
+			return FALSE;
+	}
+
+	pArchive->pHeader = pHeader;
+	pArchive->pMatches = pMatches;
+	pArchive->MatchCount = (int)pHeader->MatchCount;
+	return TRUE;
+}
+
+inline const REPLAYKEYFRAME* GetReplayKeyframes( const REPLAYARCHIVE* pArchive, const REPLAYMATCH* pMatch )
+{
+	return (const REPLAYKEYFRAME*)( pArchive->pBase + pMatch->Keyframes );
+}
+
+// Gets the input for the next tick.  Returns FALSE at the end of the match, or if the runs are damaged.
+inline BOOL ReplayCursorNext( REPLAYCURSOR* pCursor, unsigned int* pInput )
+{
+	if( pCursor->RunLeft == 0 )
+	{
+		if( pCursor->Pos >= pCursor->RunBytes )
+			return FALSE;
+		if( !ReplayNextRun( pCursor->pRuns, pCursor->RunBytes, &pCursor->Pos, &pCursor->Input, &pCursor->RunLeft ) )
+			return FALSE;
+	}
+
+	pCursor->RunLeft--;
+	*pInput = pCursor->Input;
+	return TRUE;
+}
+
+// Sets pSim to the match as it was before Tick was run, and pCursor to carry on from there.
+// Returns FALSE if the match is not that long or its data is damaged.
+BOOL SeekReplayArchive( const REPLAYARCHIVE* pArchive, int Match, DWORD Tick, PONGSIM* pSim, REPLAYCURSOR* pCursor )
+{
+	if( Match < 0 || Match >= pArchive->MatchCount )
+		return FALSE;
+
+	const REPLAYMATCH* pMatch = &pArchive->pMatches[ Match ];
+	if( Tick > pMatch->TickCount )
+		return FALSE;
+
+	// Find the last keyframe at or before the tick
+	const REPLAYKEYFRAME* pKeyframes = GetReplayKeyframes( pArchive, pMatch );
+	DWORD Low = 0;
+	DWORD High = pMatch->KeyframeCount;
+
+	while( High - Low > 1 )
+	{
+		DWORD Middle = ( Low + High ) / 2;
+		if( pKeyframes[ Middle ].Tick <= Tick )
+			Low = Middle;
+		else
+			High = Middle;
+	}
+
+	const REPLAYKEYFRAME* pKeyframe = &pKeyframes[ Low ];
+	if( pKeyframe->Offset > pMatch->RunBytes )
+		return FALSE;
+
+	*pSim = pKeyframe->Sim;
+
+	pCursor->pRuns = pArchive->pBase + pMatch->Runs;
+	pCursor->RunBytes = pMatch->RunBytes;
+	pCursor->Pos = pKeyframe->Offset;
+	pCursor->Input = pKeyframe->Input;
+	pCursor->RunLeft = 0;
+
+	// Play the rest of the way
+	unsigned int Input;
+	while( pSim->Tick < Tick )
+	{
+		if( !ReplayCursorNext( pCursor, &Input ) )
+			return FALSE;
+		PongSimStep( pSim, Input );
+	}
+
+	return TRUE;
+}
+
+// Plays a whole match from the start, checking it passes through every keyframe and ends
+// on the recorded hash
+BOOL CheckReplayArchiveMatch( const REPLAYARCHIVE* pArchive, int Match, PONGSIM* pSim )
+{
+	if( Match < 0 || Match >= pArchive->MatchCount )
+		return FALSE;
+
+	const REPLAYMATCH* pMatch = &pArchive->pMatches[ Match ];
+	const REPLAYKEYFRAME* pKeyframes = GetReplayKeyframes( pArchive, pMatch );
+
+	REPLAYCURSOR Cursor;
+	if( !SeekReplayArchive( pArchive, Match, 0, pSim, &Cursor ) )
+		return FALSE;
+
+	DWORD Interval = pArchive->pHeader->KeyframeInterval;
+	unsigned int Input;
+
+	while( ReplayCursorNext( &Cursor, &Input ) )
+	{
+		PongSimStep( pSim, Input );
+
+		if( pSim->Tick % Interval == 0 && pSim->Tick < pMatch->TickCount )
+		{
+			if( PongSimHash( pSim ) != PongSimHash( &pKeyframes[ pSim->Tick / Interval ].Sim ) )
+				return FALSE;
+		}
+	}
+
+	return pSim->Tick == pMatch->TickCount && Cursor.Pos == Cursor.RunBytes && PongSimHash( pSim ) == pMatch->FinalHash;
+}
+
+#endif	// REPLAYARCHIVE_H
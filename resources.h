@@ -0,0 +1,183 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// The resource cache.  Everything loaded from a file is looked up by its
+// path, so asking for the same bitmap twice (both paddles, say) gives back
+// the same surface instead of decoding it again into a second one.  Every
+// Acquire is matched by a Release; the last Release frees it, and
+// FreeResourceCache() frees whatever is left at shutdown.
+//
+// Resources never change once loaded, which is what makes sharing them
+// safe.  How a file becomes a surface is up to the loader the cache is
+// given, so the game makes Direct3D surfaces and the headless tools make
+// memory ones.
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <string.h>
+#include "platform.h"
+#include "sprite.h"
+#include "surface.h"
+
+#define RESOURCE_MAXPATH	260
+
+struct RESOURCE
+{
+	char PathName[ RESOURCE_MAXPATH ];
+	int RefCount;
+
+	ISurface32* pSurface;		// Owned by the cache.  Never drawn into.
+
+	// The surface as a span sprite, built the first time it is acquired as one
+	BOOL bSprite;
+	DWORD ColorKey;
+	SPANSPRITE Sprite;
+};
+
+// Makes a surface from a file.  The cache deletes what it returns.  Returns 0 if it cannot.
+typedef ISurface32* (*PFNLOADRESOURCE)( const char* PathName, void* pContext );
+
+struct RESOURCECACHE
+{
+	PFNLOADRESOURCE pfnLoad;
+	void* pContext;
+
+	RESOURCE** ppResources;
+	int Count;
+	int Capacity;
+
+	// Since the cache was started
+	int Loads;					// Files actually loaded
+	int Shared;					// Acquires that were given something already loaded
+};
+
+void InitResourceCache( RESOURCECACHE* pCache, PFNLOADRESOURCE pfnLoad, void* pContext )
+{
+	memset( pCache, 0, sizeof( RESOURCECACHE ) );
+	pCache->pfnLoad = pfnLoad;
+	pCache->pContext = pContext;
+}
+
+// TRUE if two paths name the same file.  Windows paths, so case and slashes do not matter.
+inline BOOL ResourcePathsMatch( const char* a, const char* b )
+{
+	for( ; *a && *b ; a++, b++ )
+	{
+		char ca = ( *a == '/' ) ? '\\' : ( *a >= 'A' && *a <= 'Z' ) ? *a - 'A' + 'a' : *a;
+		char cb = ( *b == '/' ) ? '\\' : ( *b >= 'A' && *b <= 'Z' ) ? *b - 'A' + 'a' : *b;
+		if( ca != cb )
+			return FALSE;
+	}
+
+	return *a == *b;
+}
+
+void FreeResource( RESOURCE* pResource )
+{
+	if( pResource->bSprite )
+		FreeSpanSprite( &pResource->Sprite );
+
+	delete pResource->pSurface;
+	delete pResource;
+}
+
+// Gives the resource for a file, loading it if nobody has it yet.  Returns 0 if it cannot be
+// loaded.  Hand it back with ReleaseResource() when done.
+const RESOURCE* AcquireResource( RESOURCECACHE* pCache, const char* PathName )
+{
+	for( int i = 0 ; i < pCache->Count ; i++ )
+	{
+		RESOURCE* pResource = pCache->ppResources[ i ];
+		if( ResourcePathsMatch( pResource->PathName, PathName ) )
+		{
+			pResource->RefCount++;
+			pCache->Shared++;
+			return pResource;
+		}
+	}
+
+	if( strlen( PathName ) >= RESOURCE_MAXPATH )
+		return 0;
+
+	ISurface32* pSurface = pCache->pfnLoad( PathName, pCache->pContext );
+	if( !pSurface )
+		return 0;
+
+	if( pCache->Count == pCache->Capacity )
+	{
+		int Capacity = pCache->Capacity ? pCache->Capacity * 2 : 16;
+		RESOURCE** ppResources = new RESOURCE*[ Capacity ];
+		if( pCache->ppResources )
+		{
+			memcpy( ppResources, pCache->ppResources, pCache->Count * sizeof( RESOURCE* ) );
+			delete [] pCache->ppResources;
+		}
+		pCache->ppResources = ppResources;
+		pCache->Capacity = Capacity;
+	}
+
+	RESOURCE* pResource = new RESOURCE;
+	memset( pResource, 0, sizeof( RESOURCE ) );
+	strcpy( pResource->PathName, PathName );
+	pResource->RefCount = 1;
+	pResource->pSurface = pSurface;
+
+	pCache->ppResources[ pCache->Count++ ] = pResource;
+	pCache->Loads++;
+	return pResource;
+}
+
+// Hands back a resource from an Acquire.  The last one frees it.
+void ReleaseResource( RESOURCECACHE* pCache, const RESOURCE* pResource )
+{
+	for( int i = 0 ; i < pCache->Count ; i++ )
+	{
+		if( pCache->ppResources[ i ] != pResource )
+			continue;
+
+		if( --pCache->ppResources[ i ]->RefCount == 0 )
+		{
+			FreeResource( pCache->ppResources[ i ] );
+			pCache->ppResources[ i ] = pCache->ppResources[ --pCache->Count ];
+		}
+		return;
+	}
+}
+
+// Gives the resource for a color keyed bitmap, with its span sprite built.  A bitmap is only
+// ever keyed one way, so asking for it with a different key fails.
+const RESOURCE* AcquireSprite( RESOURCECACHE* pCache, const char* PathName, DWORD ColorKey )
+{
+	RESOURCE* pResource = (RESOURCE*)AcquireResource( pCache, PathName );
+	if( !pResource || ( pResource->bSprite && pResource->ColorKey == ColorKey ) )
+		return pResource;
+
+	if( pResource->bSprite || !SurfaceBuildSpanSprite( pResource->pSurface, ColorKey, &pResource->Sprite ) )
+	{
+		ReleaseResource( pCache, pResource );
+		return 0;
+	}
+
+	pResource->bSprite = TRUE;
+	pResource->ColorKey = ColorKey;
+	return pResource;
+}
+
+// Frees everything, whether it was released or not
+void FreeResourceCache( RESOURCECACHE* pCache )
+{
+	for( int i = 0 ; i < pCache->Count ; i++ )
+		FreeResource( pCache->ppResources[ i ] );
+
+	delete [] pCache->ppResources;
+
+	PFNLOADRESOURCE pfnLoad = pCache->pfnLoad;
+	void* pContext = pCache->pContext;
+	InitResourceCache( pCache, pfnLoad, pContext );
+}
+
+#endif	// RESOURCES_H
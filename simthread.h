@@ -0,0 +1,360 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// The simulation on a thread of its own.  The sim thread takes the input
+// from the ring, runs the ticks on its own clock and, after each batch,
+// publishes a snapshot of the match through a triple buffer.  The thread
+// that draws takes whichever snapshot is newest whenever it wants one.
+//
+// There are three snapshots: the one the sim thread is writing, the one
+// the drawing thread is reading, and a finished one in the middle.
+// Publishing and taking each swap with the middle in one atomic exchange,
+// so neither side ever waits for the other.  A slow Present() no longer
+// holds the ticks up, and a burst of ticks no longer holds a frame up.
+//
+// The delayed events (holding the ball after a point, the win prompt) run
+// on the sim thread's timer wheel too.  Nothing here needs Windows.
+
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "platform.h"
+#include "hrclock.h"
+#include "pongsim.h"
+#include "timestep.h"
+#include "timerwheel.h"
+#include "input.h"
+#include "replay.h"
+#include "profile.h"
+#include "trace.h"
+
+// Delayed Events
+#define EVENT_SERVE			1		// Put the ball back in play after a point
+#define EVENT_WINPROMPT		2		// Let the winner quit
+#define SERVE_DELAY			250		// How long the ball is held after a point (ms)
+#define WINPROMPT_DELAY		1000	// How long the win screen shows before Start quits (ms)
+
+#define SNAPSHOT_FRESH		4		// Set in SNAPSHOTBUFFER::Middle until the drawing thread takes it
+
+// The match as it was after a batch of ticks.  Never changed once published.
+struct SIMSNAPSHOT
+{
+	PONGSIM PrevSim;		// The match one tick before Sim, for drawing in between
+	PONGSIM Sim;
+	INT64 TickTime;			// HrClockNow() count Sim's tick ended at
+
+	BOOL bServePaused;		// The ball is being held after a point
+	BOOL bCanQuit;			// The win screen is up and Start quits
+	BOOL bQuit;				// Start was pressed on the win screen
+
+	INT64 PressTime;		// When the newest key press that has reached Sim happened, 0 for none yet
+	INT64 WakeTime;			// HrClockNow() count the next delayed event is due at, 0 for none
+};
+
+struct SNAPSHOTBUFFER
+{
+	SIMSNAPSHOT Slots[ 3 ];
+
+	alignas( 64 ) std::atomic<DWORD> Middle;	// The slot between the threads, with SNAPSHOT_FRESH
+	alignas( 64 ) DWORD Back;					// Being written (only the sim thread uses it)
+	alignas( 64 ) DWORD Front;					// Being read (only the drawing thread uses it)
+};
+
+// Starts the buffer off with every slot holding pFirst, which counts as already taken
+void InitSnapshotBuffer( SNAPSHOTBUFFER* pBuffer, const SIMSNAPSHOT* pFirst )
+{
+	for( int i = 0 ; i < 3 ; i++ )
+		pBuffer->Slots[ i ] = *pFirst;
+
+	pBuffer->Back = 0;
+	pBuffer->Middle.store( 1, std::memory_order_relaxed );
+	pBuffer->Front = 2;
+}
+
+// Sim thread.  Copies pSnapshot in and makes it the newest.
+inline void PublishSnapshot( SNAPSHOTBUFFER* pBuffer, const SIMSNAPSHOT* pSnapshot )
+{
+	pBuffer->Slots[ pBuffer->Back ] = *pSnapshot;
+
+	// Release, so the copy is all there before the drawing thread can take it.  Acquire, so
+	// the drawing thread has finished with the slot we get back.
+	pBuffer->Back = pBuffer->Middle.exchange( pBuffer->Back | SNAPSHOT_FRESH, std::memory_order_acq_rel ) & 3;
+}
+
+// Drawing thread.  TRUE if a snapshot has been published since the last TakeSnapshot().
+inline BOOL IsSnapshotFresh( const SNAPSHOTBUFFER* pBuffer )
+{
+	return ( pBuffer->Middle.load( std::memory_order_relaxed ) & SNAPSHOT_FRESH ) != 0;
+}
+
+// Drawing thread.  Returns the newest snapshot, which stays put until the next call.
+// *pbNew (if given) says whether it is a different one from last time.
+const SIMSNAPSHOT* TakeSnapshot( SNAPSHOTBUFFER* pBuffer, BOOL* pbNew = 0 )
+{
+	BOOL bNew = IsSnapshotFresh( pBuffer );
+	if( bNew )
+		pBuffer->Front = pBuffer->Middle.exchange( pBuffer->Front, std::memory_order_acq_rel ) & 3;
+
+	if( pbNew )
+		*pbNew = bNew;
+
+	return &pBuffer->Slots[ pBuffer->Front ];
+}
+
+// How far to draw the sprites between PrevSim and Sim at clock count Now, from 0 to 65536
+int SnapshotAlpha( const SIMSNAPSHOT* pSnapshot, INT64 Now )
+{
+	if( pSnapshot->bServePaused )
+		return 65536;
+
+	INT64 TickCounts = HrClockFrequency() / pSnapshot->Sim.TickRate;
+	INT64 Since = Now - pSnapshot->TickTime;
+
+	if( Since <= 0 )
+		return 0;
+	if( Since >= TickCounts )
+		return 65535;
+
+	return (int)( ( Since << 16 ) / TickCounts );
+}
+
+//====================================================
+// The Sim Thread
+//====================================================
+
+struct SIMTHREAD
+{
+	// Only the sim thread uses these while it runs
+	PONGSIM Sim;
+	PONGSIM PrevSim;
+	FIXEDSTEP Step;
+	TIMERWHEEL Timers;
+	INPUTSTATE InputState;
+	BOOL bServePaused;
+	BOOL bCanQuit;
+	BOOL bQuit;
+	INT64 PressTime;
+	INT64 WakeTime;				// When the next timer event is due, 0 for none
+
+	INPUTRING* pRing;			// Taken from here
+	IInputSource* pSource;		// Polled before each batch of ticks.  0 if another thread pushes the input.
+	REPLAY* pReplay;			// Every tick is recorded here, may be 0
+
+	SNAPSHOTBUFFER Snapshots;
+	DWORD Published;			// Snapshots published so far
+	int MostTicks;				// Most ticks run in one batch
+	DWORD Wakeups;				// Times the sim thread has woken up
+
+	std::thread Thread;
+	std::atomic<BOOL> bStop;
+	BOOL bRunning;
+};
+
+// Fills in a snapshot of the match as the sim thread has it
+void MakeSimSnapshot( const SIMTHREAD* pThread, INT64 TickTime, SIMSNAPSHOT* pSnapshot )
+{
+	pSnapshot->WakeTime = pThread->WakeTime;
+	pSnapshot->PrevSim = pThread->PrevSim;
+	pSnapshot->Sim = pThread->Sim;
+	pSnapshot->TickTime = TickTime;
+	pSnapshot->bServePaused = pThread->bServePaused;
+	pSnapshot->bCanQuit = pThread->bCanQuit;
+	pSnapshot->bQuit = pThread->bQuit;
+	pSnapshot->PressTime = pThread->PressTime;
+}
+
+// Sets up a new match.  Nothing runs until StartSimThread().
+void InitSimThread( SIMTHREAD* pThread, DWORD Seed, int TickRate, INPUTRING* pRing, IInputSource* pSource, REPLAY* pReplay )
+{
+	PongSimInit( &pThread->Sim, Seed, TickRate );
+	pThread->PrevSim = pThread->Sim;
+	InitInputState( &pThread->InputState );
+	pThread->bServePaused = pThread->bCanQuit = pThread->bQuit = FALSE;
+	pThread->PressTime = 0;
+	pThread->WakeTime = 0;
+
+	pThread->pRing = pRing;
+	pThread->pSource = pSource;
+	pThread->pReplay = pReplay;
+	pThread->bRunning = FALSE;
+	pThread->Published = 0;
+	pThread->MostTicks = 0;
+	pThread->Wakeups = 0;
+
+	SIMSNAPSHOT First;
+	MakeSimSnapshot( pThread, 0, &First );
+	InitSnapshotBuffer( &pThread->Snapshots, &First );
+}
+
+inline DWORD SimThreadMs( INT64 Now )
+{
+	return (DWORD)( HrClockToNs( Now ) / 1000000 );
+}
+
+// Publishes what the sim thread has at clock count Now, with when the next delayed event is due
+void PublishSimThread( SIMTHREAD* pThread, INT64 Now, INT64 TickTime )
+{
+	DWORD Wait = TimerWheelWaitTime( &pThread->Timers, SimThreadMs( Now ) );
+	pThread->WakeTime = Wait == TIMERWHEEL_NONE ? 0 : Now + (INT64)Wait * HrClockFrequency() / 1000;
+
+	SIMSNAPSHOT Snapshot;
+	MakeSimSnapshot( pThread, TickTime, &Snapshot );
+	PublishSnapshot( &pThread->Snapshots, &Snapshot );
+	pThread->Published++;
+}
+
+// Sets up the clocks.  Now is the HrClockNow() count the match starts at.
+void StartSimClock( SIMTHREAD* pThread, INT64 Now )
+{
+	FixedStepInit( &pThread->Step, HrClockFrequency(), pThread->Sim.TickRate );
+	FixedStepReset( &pThread->Step, Now );
+	InitTimerWheel( &pThread->Timers, SimThreadMs( Now ) );
+}
+
+// One pass of the sim thread: takes the input up to Now, fires the delayed events, runs the ticks
+// that are due and publishes the result if anything changed.  The headless tools also call it
+// from the drawing thread, to compare with running it on its own.
+void RunSimBatch( SIMTHREAD* pThread, INT64 Now )
+{
+	if( pThread->pSource )
+		pThread->pSource->Poll( pThread->pRing, Now );
+
+	BOOL bChanged = FALSE;
+
+	// Fire any delayed events that have come due
+	TIMEREVENT Fired[ TIMERWHEEL_MAXEVENTS ];
+	int FiredCount = PollTimerWheel( &pThread->Timers, SimThreadMs( Now ), Fired );
+	for( int i = 0 ; i < FiredCount ; i++ )
+	{
+		if( Fired[ i ].Type == EVENT_SERVE )
+		{
+			// Back into play, without trying to catch up on the time the ball was held
+			pThread->bServePaused = FALSE;
+			FixedStepReset( &pThread->Step, Now );
+		}
+		else if( Fired[ i ].Type == EVENT_WINPROMPT )
+			pThread->bCanQuit = TRUE;
+
+		bChanged = TRUE;
+	}
+
+	// Everything is frozen while the ball is held
+	if( pThread->bServePaused )
+	{
+		SkipInput( pThread->pRing, &pThread->InputState, Now );
+		if( bChanged )
+			PublishSimThread( pThread, Now, Now );
+		return;
+	}
+
+	// Run however many ticks of game time have passed since last time
+	int Ticks = FixedStepAdvance( &pThread->Step, Now );
+	INT64 TickTime = Now;
+
+	if( Ticks > 0 )
+	{
+		PROFILESCOPE Scope( PROFILE_SIM );
+
+		if( Ticks > pThread->MostTicks )
+			pThread->MostTicks = Ticks;
+
+		for( int i = 0 ; i < Ticks ; i++ )
+		{
+			pThread->PrevSim = pThread->Sim;
+
+			// The keys as they were when this tick ended
+			TickTime = FixedStepTickTime( &pThread->Step, Ticks, i );
+			unsigned int Input = ReadTickInput( pThread->pRing, &pThread->InputState, TickTime );
+			if( pThread->InputState.PressTime )
+				pThread->PressTime = pThread->InputState.PressTime;
+
+			// Start quits once the win screen is up
+			if( pThread->bCanQuit && ( Input & PONGINPUT_START ) )
+				pThread->bQuit = TRUE;
+
+			// Move the paddles and ball
+			int Events;
+			{
+				TRACE_SCOPE( "PongSimStep" );
+				Events = PongSimStep( &pThread->Sim, Input );
+			}
+
+			if( pThread->pReplay )
+				RecordReplayTick( pThread->pReplay, Input );
+
+			if( Events & PONGEVENT_GAMEOVER )
+				PostTimerEvent( &pThread->Timers, WINPROMPT_DELAY, EVENT_WINPROMPT );
+
+			// Give the players a moment after a point
+			else if( Events & PONGEVENT_SCORED )
+			{
+				// PlaySound( "sound\\score.wav", NULL, SND_FILENAME | SND_ASYNC );
+				pThread->bServePaused = TRUE;
+				PostTimerEvent( &pThread->Timers, SERVE_DELAY, EVENT_SERVE );
+				break;
+			}
+		}
+	}
+
+	if( Ticks > 0 || bChanged )
+		PublishSimThread( pThread, Now, TickTime );
+}
+
+// How long the sim thread can sleep after RunSimBatch(), in ns.  While the ball is held that is
+// until the serve, not a tick.
+INT64 SimBatchWait( const SIMTHREAD* pThread, INT64 Now )
+{
+	// Held after a point, so nothing changes until the next delayed event
+	if( pThread->bServePaused )
+		return pThread->WakeTime ? HrClockToNs( pThread->WakeTime - Now ) : 1000000;
+
+	const FIXEDSTEP* pStep = &pThread->Step;
+	INT64 NextTick = pStep->LastTime + ( pStep->Frequency - pStep->Accumulator + pStep->TickRate - 1 ) / pStep->TickRate;
+	return HrClockToNs( NextTick - Now );
+}
+
+void RunSimThread( SIMTHREAD* pThread )
+{
+	TraceNameThread( "Simulation" );
+
+	while( !pThread->bStop.load( std::memory_order_relaxed ) )
+	{
+		RunSimBatch( pThread, HrClockNow() );
+		pThread->Wakeups++;
+
+		// Sleep until the next tick is due
+		INT64 Wait = SimBatchWait( pThread, HrClockNow() );
+		if( Wait > 0 )
+			std::this_thread::sleep_for( std::chrono::nanoseconds( Wait ) );
+	}
+}
+
+// Starts the clock and the thread
+void StartSimThread( SIMTHREAD* pThread )
+{
+	StartSimClock( pThread, HrClockNow() );
+
+	pThread->bStop.store( FALSE, std::memory_order_relaxed );
+	pThread->Thread = std::thread( RunSimThread, pThread );
+	pThread->bRunning = TRUE;
+}
+
+// Stops the thread.  The match it was playing is left in pThread->Sim.
+void StopSimThread( SIMTHREAD* pThread )
+{
+	if( !pThread->bRunning )
+		return;
+
+	pThread->bStop.store( TRUE, std::memory_order_relaxed );
+	pThread->Thread.join();
+	pThread->bRunning = FALSE;
+}
+
+#endif	// SIMTHREAD_H
@@ -0,0 +1,178 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Run-length "span" sprites.  A color keyed image is converted once at load
+// time into a list of opaque runs per row, so drawing it is just a memcpy
+// per run with no per-pixel color key test.
+
+#ifndef SPRITE_H
+#define SPRITE_H
+
+#include <string.h>
+#include "platform.h"
+
+// A run of opaque pixels in one row of the sprite
+struct SPRITESPAN
+{
+	int x;			// Column the run starts at
+	int Length;		// Number of pixels in the run
+	int Offset;		// Index of the first pixel in SPANSPRITE::pPixels
+};
+
+struct SPANSPRITE
+{
+	int Width;				// Width of the original image
+	int Height;				// Height of the original image
+
+	int SpanCount;			// Total number of spans
+	int PixelCount;			// Total number of opaque pixels
+
+	int* pRowStart;			// Index of the first span of each row (Height + 1 entries)
+	SPRITESPAN* pSpans;		// The spans, row by row
+	DWORD* pPixels;			// The opaque pixels, packed
+};
+
+// Frees the memory held by a sprite
+void FreeSpanSprite( SPANSPRITE* pSprite )
+{
+	delete [] pSprite->pRowStart;
+	delete [] pSprite->pSpans;
+	delete [] pSprite->pPixels;
+
+	memset( pSprite, 0, sizeof( SPANSPRITE ) );
+}
+
+// Builds a span sprite from a color keyed image.  Pitch is in bytes.
+BOOL BuildSpanSprite( SPANSPRITE* pSprite, const DWORD* pData, int Pitch, int Width, int Height, DWORD ColorKey )
+{
+	memset( pSprite, 0, sizeof( SPANSPRITE ) );
+
+	if( !pData || Width <= 0 || Height <= 0 )
+		return FALSE;
+
+	int Pitch32 = Pitch / 4;
+
+	// First pass: count the spans and opaque pixels so everything can be allocated at once
+	int SpanCount = 0, PixelCount = 0;
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		const DWORD* pRow = pData + y * Pitch32;
+		BOOL bInRun = FALSE;
+
+		for( int x = 0 ; x < Width ; x++ )
+		{
+			BOOL bOpaque = ( pRow[ x ] != ColorKey );
+
+			if( bOpaque )
+			{
+				PixelCount++;
+				if( !bInRun )
+					SpanCount++;
+			}
+			bInRun = bOpaque;
+		}
+	}
+
+	pSprite->Width = Width;
+	pSprite->Height = Height;
+	pSprite->SpanCount = SpanCount;
+	pSprite->PixelCount = PixelCount;
+	pSprite->pRowStart = new int[ Height + 1 ];
+	pSprite->pSpans = new SPRITESPAN[ SpanCount > 0 ? SpanCount : 1 ];
+	pSprite->pPixels = new DWORD[ PixelCount > 0 ? PixelCount : 1 ];
+
+	// Second pass: record the runs and pack their pixels
+	int Span = 0, Pixel = 0;
+	for( int y = 0 ; y < Height ; y++ )
+	{
+		const DWORD* pRow = pData + y * Pitch32;
+		pSprite->pRowStart[ y ] = Span;
+
+		int x = 0;
+		while( x < Width )
+		{
+			// Skip the transparent pixels
+			while( x < Width && pRow[ x ] == ColorKey )
+				x++;
+
+			if( x == Width )
+				break;
+
+			// Find the end of the opaque run
+			int Start = x;
+			while( x < Width && pRow[ x ] != ColorKey )
+				x++;
+
+			SPRITESPAN* pSpan = &pSprite->pSpans[ Span++ ];
+			pSpan->x = Start;
+			pSpan->Length = x - Start;
+			pSpan->Offset = Pixel;
+
+			memcpy( &pSprite->pPixels[ Pixel ], &pRow[ Start ], pSpan->Length * 4 );
+			Pixel += pSpan->Length;
+		}
+	}
+	pSprite->pRowStart[ Height ] = Span;
+
+	return TRUE;
+}
+
+// Draws a span sprite to a DWORD buffer, clipped to DestWidth x DestHeight.  DestPitch is in bytes.
+void DrawSpanSprite( const SPANSPRITE* pSprite, int x, int y, DWORD* pDestData, int DestPitch, int DestWidth, int DestHeight )
+{
+	if( !pSprite->pRowStart )
+		return;
+
+	int DestPitch32 = DestPitch / 4;
+
+	// Only walk the rows that land on the target
+	int FirstRow = y < 0 ? -y : 0;
+	int LastRow = ( y + pSprite->Height > DestHeight ) ? DestHeight - y : pSprite->Height;
+
+	// Spans only need clipping when the sprite hangs off the left or right
+	BOOL bClipX = ( x < 0 ) || ( x + pSprite->Width > DestWidth );
+
+	for( int Row = FirstRow ; Row < LastRow ; Row++ )
+	{
+		DWORD* pDestRow = pDestData + ( y + Row ) * DestPitch32 + x;
+
+		const SPRITESPAN* pSpan = &pSprite->pSpans[ pSprite->pRowStart[ Row ] ];
+		const SPRITESPAN* pEnd = &pSprite->pSpans[ pSprite->pRowStart[ Row + 1 ] ];
+
+		for( ; pSpan < pEnd ; pSpan++ )
+		{
+			int Start = pSpan->x;
+			int Length = pSpan->Length;
+			const DWORD* pSrc = &pSprite->pPixels[ pSpan->Offset ];
+
+			if( bClipX )
+			{
+				// Trim the part of the run left of the target
+				if( x + Start < 0 )
+				{
+					int Cut = -( x + Start );
+					if( Cut >= Length )
+						continue;
+
+					Start += Cut;
+					Length -= Cut;
+					pSrc += Cut;
+				}
+
+				// Trim the part of the run right of the target
+				if( x + Start + Length > DestWidth )
+					Length = DestWidth - ( x + Start );
+
+				if( Length <= 0 )
+					continue;
+			}
+
+			memcpy( pDestRow + Start, pSrc, Length * 4 );
+		}
+	}
+}
+
+#endif	// SPRITE_H
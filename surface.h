@@ -0,0 +1,338 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// 32 bit surfaces.  Everything the 2D code draws with only needs a pointer
+// to the pixels, a pitch and a size, so that is all ISurface32 gives it.
+// CMemorySurface32 keeps its pixels in ordinary memory, which lets a whole
+// frame be drawn without Direct3D (engine.h has the D3D surface version).
+
+#ifndef SURFACE_H
+#define SURFACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include "platform.h"
+#include "blit.h"
+#include "sprite.h"
+#include "text.h"
+#include "dirty.h"
+
+// What Lock() hands back.  Pitch is in bytes.
+struct LOCKEDSURFACE32
+{
+	DWORD* pBits;
+	int Pitch;
+};
+
+class ISurface32
+{
+public:
+	virtual ~ISurface32() {}
+
+	virtual int GetWidth() = 0;
+	virtual int GetHeight() = 0;
+
+	// Returns FALSE if the pixels cannot be reached right now (e.g. the device was lost)
+	virtual BOOL Lock( LOCKEDSURFACE32* pLocked, BOOL bReadOnly ) = 0;
+	virtual void Unlock() = 0;
+
+	// Fills the whole surface with one color.  Surfaces with a faster way override this.
+	virtual BOOL Clear( DWORD Color )
+	{
+		LOCKEDSURFACE32 Locked;
+		if( !Lock( &Locked, FALSE ) )
+			return FALSE;
+
+		RECT Rect = { 0, 0, GetWidth(), GetHeight() };
+		FillRect32( Locked.pBits, Locked.Pitch, Rect, Color );
+
+		Unlock();
+		return TRUE;
+	}
+};
+
+// A surface in system memory.  Either owns its pixels or wraps a buffer someone else owns.
+class CMemorySurface32 : public ISurface32
+{
+public:
+	CMemorySurface32() : m_pBits( 0 ), m_Width( 0 ), m_Height( 0 ), m_Pitch( 0 ), m_bOwned( FALSE ) {}
+	~CMemorySurface32() { Release(); }
+
+	// Allocates a Width x Height surface, cleared to black
+	BOOL Create( int Width, int Height )
+	{
+		Release();
+
+		if( Width <= 0 || Height <= 0 )
+			return FALSE;
+
+		m_pBits = new DWORD[ Width * Height ];
+		memset( m_pBits, 0, Width * Height * 4 );
+
+		m_Width = Width;
+		m_Height = Height;
+		m_Pitch = Width * 4;
+		m_bOwned = TRUE;
+		return TRUE;
+	}
+
+	// Uses pixels that belong to someone else.  Pitch is in bytes.
+	void Attach( DWORD* pBits, int Width, int Height, int Pitch )
+	{
+		Release();
+
+		m_pBits = pBits;
+		m_Width = Width;
+		m_Height = Height;
+		m_Pitch = Pitch;
+	}
+
+	void Release()
+	{
+		if( m_bOwned )
+			delete [] m_pBits;
+
+		m_pBits = 0;
+		m_Width = m_Height = m_Pitch = 0;
+		m_bOwned = FALSE;
+	}
+
+	DWORD* GetBits() { return m_pBits; }
+	int GetPitch() { return m_Pitch; }
+
+	int GetWidth() { return m_Width; }
+	int GetHeight() { return m_Height; }
+
+	BOOL Lock( LOCKEDSURFACE32* pLocked, BOOL /*bReadOnly*/ )
+	{
+		if( !m_pBits )
+			return FALSE;
+
+		pLocked->pBits = m_pBits;
+		pLocked->Pitch = m_Pitch;
+		return TRUE;
+	}
+
+	void Unlock() {}
+
+private:
+	DWORD* m_pBits;
+	int m_Width;
+	int m_Height;
+	int m_Pitch;
+	BOOL m_bOwned;
+
+	// Copying would free the pixels twice
+	CMemorySurface32( const CMemorySurface32& );
+	CMemorySurface32& operator=( const CMemorySurface32& );
+};
+
+//====================================================
+// Drawing To Surfaces
+//====================================================
+
+// Copies part of one surface to another, clipped to the destination.  A NULL rectangle
+// copies the whole source and a NULL point copies to (0,0).
+BOOL SurfaceCopy( const RECT* pSourceRect, ISurface32* pSource, const POINT* pDestPoint, ISurface32* pDest, BOOL bTransparent, DWORD ColorKey )
+{
+	if( !pSource || !pDest )
+		return FALSE;
+
+	RECT SourceRect;
+	if( pSourceRect )
+		SourceRect = *pSourceRect;
+	else
+		SetRect( &SourceRect, 0, 0, pSource->GetWidth(), pSource->GetHeight() );
+
+	POINT DestPoint = { 0, 0 };
+	if( pDestPoint )
+		DestPoint = *pDestPoint;
+
+	LOCKEDSURFACE32 LockedSource;
+	LOCKEDSURFACE32 LockedDest;
+
+	if( !pSource->Lock( &LockedSource, TRUE ) )
+		return FALSE;
+
+	if( !pDest->Lock( &LockedDest, FALSE ) )
+	{
+		pSource->Unlock();
+		return FALSE;
+	}
+
+	Blit32( LockedSource.pBits, LockedSource.Pitch, SourceRect, LockedDest.pBits, LockedDest.Pitch,
+			pDest->GetWidth(), pDest->GetHeight(), DestPoint, bTransparent, ColorKey );
+
+	pSource->Unlock();
+	pDest->Unlock();
+	return TRUE;
+}
+
+// Copies the dirty rectangles from the background to the destination, locking each surface once.
+// Wherever the background does not reach is filled with ClearColor.
+BOOL SurfaceRestoreDirtyRects( const DIRTYTRACKER* pTracker, ISurface32* pBackground, ISurface32* pDest, DWORD ClearColor )
+{
+	if( !pBackground || !pDest )
+		return FALSE;
+
+	if( pTracker->DirtyCount == 0 )
+		return TRUE;
+
+	LOCKEDSURFACE32 LockedBg;
+	LOCKEDSURFACE32 LockedDest;
+
+	if( !pBackground->Lock( &LockedBg, TRUE ) )
+		return FALSE;
+
+	if( !pDest->Lock( &LockedDest, FALSE ) )
+	{
+		pBackground->Unlock();
+		return FALSE;
+	}
+
+	// The background may be smaller than the screen
+	int BgWidth = pBackground->GetWidth();
+	int BgHeight = pBackground->GetHeight();
+
+	for( int i = 0 ; i < pTracker->DirtyCount ; i++ )
+	{
+		RECT Rect = pTracker->Dirty[ i ];
+
+		RECT Outside[ 2 ];
+		int OutsideCount = DirtyRectOutside( Rect, BgWidth, BgHeight, Outside );
+		for( int o = 0 ; o < OutsideCount ; o++ )
+			FillRect32( LockedDest.pBits, LockedDest.Pitch, Outside[ o ], ClearColor );
+
+		if( Rect.right > BgWidth )
+			Rect.right = BgWidth;
+		if( Rect.bottom > BgHeight )
+			Rect.bottom = BgHeight;
+		if( Rect.left >= Rect.right || Rect.top >= Rect.bottom )
+			continue;
+
+		POINT DestPoint = { Rect.left, Rect.top };
+		Blit32( LockedBg.pBits, LockedBg.Pitch, Rect, LockedDest.pBits, LockedDest.Pitch,
+				pTracker->Width, pTracker->Height, DestPoint, FALSE, 0 );
+	}
+
+	pBackground->Unlock();
+	pDest->Unlock();
+	return TRUE;
+}
+
+// Builds a span sprite from a color keyed surface
+BOOL SurfaceBuildSpanSprite( ISurface32* pSource, DWORD ColorKey, SPANSPRITE* pSprite )
+{
+	if( !pSource )
+		return FALSE;
+
+	LOCKEDSURFACE32 Locked;
+	if( !pSource->Lock( &Locked, TRUE ) )
+		return FALSE;
+
+	BOOL bBuilt = BuildSpanSprite( pSprite, Locked.pBits, Locked.Pitch, pSource->GetWidth(), pSource->GetHeight(), ColorKey );
+
+	pSource->Unlock();
+	return bBuilt;
+}
+
+// Draws a span sprite to a surface
+BOOL SurfaceDrawSpanSprite( const SPANSPRITE* pSprite, POINT DestPoint, ISurface32* pDest )
+{
+	if( !pDest )
+		return FALSE;
+
+	LOCKEDSURFACE32 Locked;
+	if( !pDest->Lock( &Locked, FALSE ) )
+		return FALSE;
+
+	DrawSpanSprite( pSprite, DestPoint.x, DestPoint.y, Locked.pBits, Locked.Pitch, pDest->GetWidth(), pDest->GetHeight() );
+
+	pDest->Unlock();
+	return TRUE;
+}
+
+// Draws a text batch to a surface, with the font and the target each locked once
+BOOL SurfaceDrawTextBatch( const TEXTBATCH* pBatch, const FONTATLAS* pAtlas, ISurface32* pFont, BOOL bTransparent, DWORD ColorKey, ISurface32* pDest )
+{
+	if( !pFont || !pDest )
+		return FALSE;
+
+	if( pBatch->Count == 0 )
+		return TRUE;
+
+	LOCKEDSURFACE32 LockedFont;
+	LOCKEDSURFACE32 LockedDest;
+
+	if( !pFont->Lock( &LockedFont, TRUE ) )
+		return FALSE;
+
+	if( !pDest->Lock( &LockedDest, FALSE ) )
+	{
+		pFont->Unlock();
+		return FALSE;
+	}
+
+	DrawTextBatchToBuffer( pBatch, pAtlas, LockedFont.pBits, LockedFont.Pitch, bTransparent, ColorKey,
+						   LockedDest.pBits, LockedDest.Pitch, pDest->GetWidth(), pDest->GetHeight() );
+
+	pFont->Unlock();
+	pDest->Unlock();
+	return TRUE;
+}
+
+// Saves a surface as a 32 bit .bmp file, e.g. for thumbnails
+BOOL SaveSurfaceBMP( ISurface32* pSurface, const char* FileName )
+{
+	LOCKEDSURFACE32 Locked;
+	if( !pSurface->Lock( &Locked, TRUE ) )
+		return FALSE;
+
+	FILE* pFile = fopen( FileName, "wb" );
+	if( !pFile )
+	{
+		pSurface->Unlock();
+		return FALSE;
+	}
+
+	int Width = pSurface->GetWidth();
+	int Height = pSurface->GetHeight();
+	DWORD ImageSize = Width * Height * 4;
+
+	// BITMAPFILEHEADER and BITMAPINFOHEADER, written out a byte at a time so it works anywhere
+	BYTE Header[ 54 ];
+	memset( Header, 0, sizeof( Header ) );
+
+	DWORD Fields[][2] =
+	{
+		{ 2, 54 + ImageSize },	// File size
+		{ 10, 54 },				// Offset to the pixels
+		{ 14, 40 },				// Size of the info header
+		{ 18, (DWORD)Width },
+		{ 22, (DWORD)-Height },	// Negative for a top down image
+		{ 34, ImageSize },
+	};
+
+	Header[ 0 ] = 'B';
+	Header[ 1 ] = 'M';
+	for( int i = 0 ; i < (int)( sizeof( Fields ) / sizeof( Fields[0] ) ) ; i++ )
+	{
+		for( int b = 0 ; b < 4 ; b++ )
+			Header[ Fields[ i ][ 0 ] + b ] = (BYTE)( Fields[ i ][ 1 ] >> ( b * 8 ) );
+	}
+	Header[ 26 ] = 1;		// Planes
+	Header[ 28 ] = 32;		// Bits per pixel
+
+	BOOL bOk = fwrite( Header, sizeof( Header ), 1, pFile ) == 1;
+	for( int y = 0 ; y < Height && bOk ; y++ )
+		bOk = fwrite( Locked.pBits + y * ( Locked.Pitch / 4 ), Width * 4, 1, pFile ) == 1;
+
+	fclose( pFile );
+	pSurface->Unlock();
+	return bOk;
+}
+
+#endif	// SURFACE_H
@@ -0,0 +1,143 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Batched text rendering.  Strings are queued during the frame and drawn in
+// one pass, with the font atlas locked once.  Glyph positions in the atlas
+// are worked out once when the font is loaded.
+
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <string.h>
+#include "platform.h"
+#include "blit.h"
+
+#define TEXTBATCH_MAXSTRINGS	64		// Most strings per batch
+#define TEXTBATCH_MAXCHARS		2048	// Most characters per batch
+
+// Where every character lives in the font atlas
+struct FONTATLAS
+{
+	int LetterWidth;		// The width of a letter
+	int LetterHeight;		// The height of a letter
+
+	BOOL bHasGlyph[ 256 ];	// FALSE for spaces and characters not in the atlas
+	int GlyphX[ 256 ];		// Left edge of each glyph in the atlas
+	int GlyphY[ 256 ];		// Top edge of each glyph in the atlas
+};
+
+// A queued string
+struct TEXTITEM
+{
+	int x, y;		// Where to draw it
+	int Start;		// Index of the first character in TEXTBATCH::Chars
+	int Length;		// Number of characters
+};
+
+// The strings to be drawn this frame
+struct TEXTBATCH
+{
+	int Count;									// Number of strings queued
+	int CharCount;								// Number of characters queued
+	TEXTITEM Items[ TEXTBATCH_MAXSTRINGS ];
+	char Chars[ TEXTBATCH_MAXCHARS ];
+};
+
+// Builds the glyph table for an atlas of AtlasWidth x AtlasHeight pixels.
+// The atlas starts at ASCII 32 (space) and runs left to right, top to bottom.
+void InitFontAtlas( FONTATLAS* pAtlas, int AtlasWidth, int AtlasHeight, int LetterWidth, int LetterHeight )
+{
+	memset( pAtlas, 0, sizeof( FONTATLAS ) );
+
+	pAtlas->LetterWidth = LetterWidth;
+	pAtlas->LetterHeight = LetterHeight;
+
+	if( LetterWidth <= 0 || LetterHeight <= 0 )
+		return;
+
+	int LettersPerRow = AtlasWidth / LetterWidth;
+	int Rows = AtlasHeight / LetterHeight;
+
+	// Space (32) is never drawn, so start at the first real character
+	for( int c = 33 ; c < 256 ; c++ )
+	{
+		int Index = c - 32;
+		int Row = Index / LettersPerRow;
+
+		if( Row >= Rows )
+			break;
+
+		pAtlas->bHasGlyph[ c ] = TRUE;
+		pAtlas->GlyphX[ c ] = ( Index % LettersPerRow ) * LetterWidth;
+		pAtlas->GlyphY[ c ] = Row * LetterHeight;
+	}
+}
+
+// Empties a batch
+void BeginTextBatch( TEXTBATCH* pBatch )
+{
+	pBatch->Count = 0;
+	pBatch->CharCount = 0;
+}
+
+// Queues a string.  Returns FALSE if the batch is full.
+BOOL AddText( TEXTBATCH* pBatch, int x, int y, const char* String )
+{
+	int Length = (int)strlen( String );
+
+	if( pBatch->Count >= TEXTBATCH_MAXSTRINGS || pBatch->CharCount + Length > TEXTBATCH_MAXCHARS )
+		return FALSE;
+
+	TEXTITEM* pItem = &pBatch->Items[ pBatch->Count++ ];
+	pItem->x = x;
+	pItem->y = y;
+	pItem->Start = pBatch->CharCount;
+	pItem->Length = Length;
+
+	memcpy( &pBatch->Chars[ pBatch->CharCount ], String, Length );
+	pBatch->CharCount += Length;
+
+	return TRUE;
+}
+
+// Draws every queued string into a DWORD buffer.  This is the whole text pass;
+// the caller only has to provide the atlas pixels and the target.  Pitches are in bytes.
+// The target can be part of a bigger one: pDestData is where (OriginX, OriginY) would be.
+void DrawTextBatchToBuffer( const TEXTBATCH* pBatch, const FONTATLAS* pAtlas, const DWORD* pAtlasData, int AtlasPitch,
+							BOOL bTransparent, DWORD ColorKey, DWORD* pDestData, int DestPitch, int DestWidth, int DestHeight,
+							int OriginX = 0, int OriginY = 0 )
+{
+	int LetterWidth = pAtlas->LetterWidth;
+	int LetterHeight = pAtlas->LetterHeight;
+
+	for( int i = 0 ; i < pBatch->Count ; i++ )
+	{
+		const TEXTITEM* pItem = &pBatch->Items[ i ];
+		const unsigned char* pChar = (const unsigned char*)&pBatch->Chars[ pItem->Start ];
+
+		POINT DestPoint = { pItem->x - OriginX, pItem->y - OriginY };
+
+		// Skip strings above or below the target without looking at every letter
+		if( DestPoint.y + LetterHeight <= 0 || DestPoint.y >= DestHeight )
+			continue;
+
+		for( int c = 0 ; c < pItem->Length ; c++, DestPoint.x += LetterWidth )
+		{
+			if( !pAtlas->bHasGlyph[ pChar[ c ] ] )
+				continue;
+
+			RECT GlyphRect;
+			GlyphRect.left = pAtlas->GlyphX[ pChar[ c ] ];
+			GlyphRect.top = pAtlas->GlyphY[ pChar[ c ] ];
+			GlyphRect.right = GlyphRect.left + LetterWidth;
+			GlyphRect.bottom = GlyphRect.top + LetterHeight;
+
+			Blit32( pAtlasData, AtlasPitch, GlyphRect, pDestData, DestPitch, DestWidth, DestHeight, DestPoint, bTransparent, ColorKey );
+		}
+	}
+}
+
+#endif	// TEXT_H
@@ -0,0 +1,203 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Delayed events for the game loop.  Events are hashed by the millisecond
+// they are due into a wheel of slots, so posting, cancelling and firing
+// do not depend on how many events are waiting.  Events more than one turn
+// of the wheel away just sit in their slot until their time comes round.
+// Nothing in here reads the clock; the caller passes the time in.
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <string.h>
+#include "platform.h"
+
+#define TIMERWHEEL_SLOTS		256		// Milliseconds per turn of the wheel (a power of 2)
+#define TIMERWHEEL_MAXEVENTS	64		// Most events that can be waiting at once
+#define TIMERWHEEL_NONE			0xFFFFFFFF	// TimerWheelNextDue() when nothing is waiting
+
+struct TIMEREVENT
+{
+	int Type;		// What to do, up to the caller
+	int Param;
+	DWORD Due;		// Time it fires, in ms
+	int Next;		// Next event in the same slot (or free list), -1 for none
+	BOOL bActive;
+};
+
+struct TIMERWHEEL
+{
+	DWORD Time;							// Last time the wheel was polled, in ms
+	int Count;							// Events waiting
+	int FreeList;
+	int Slots[ TIMERWHEEL_SLOTS ];		// First event in each slot, -1 for none
+	TIMEREVENT Events[ TIMERWHEEL_MAXEVENTS ];
+};
+
+// Empties the wheel and sets the current time
+void InitTimerWheel( TIMERWHEEL* pWheel, DWORD Now )
+{
+	memset( pWheel, 0, sizeof( TIMERWHEEL ) );
+	pWheel->Time = Now;
+
+	for( int i = 0 ; i < TIMERWHEEL_SLOTS ; i++ )
+		pWheel->Slots[ i ] = -1;
+
+	// Chain every event onto the free list
+	for( int i = 0 ; i < TIMERWHEEL_MAXEVENTS ; i++ )
+		pWheel->Events[ i ].Next = i + 1 < TIMERWHEEL_MAXEVENTS ? i + 1 : -1;
+	pWheel->FreeList = 0;
+}
+
+// Posts an event to fire DelayMs from the last poll.  Returns FALSE if the wheel is full.
+BOOL PostTimerEvent( TIMERWHEEL* pWheel, DWORD DelayMs, int Type, int Param = 0 )
+{
+	if( pWheel->FreeList < 0 )
+		return FALSE;
+
+	// Anything due now fires on the next poll
+	if( DelayMs == 0 )
+		DelayMs = 1;
+
+	int Index = pWheel->FreeList;
+	TIMEREVENT* pEvent = &pWheel->Events[ Index ];
+	pWheel->FreeList = pEvent->Next;
+
+	pEvent->Type = Type;
+	pEvent->Param = Param;
+	pEvent->Due = pWheel->Time + DelayMs;
+	pEvent->bActive = TRUE;
+
+	// Link it into the slot for its due time
+	int Slot = pEvent->Due & ( TIMERWHEEL_SLOTS - 1 );
+	pEvent->Next = pWheel->Slots[ Slot ];
+	pWheel->Slots[ Slot ] = Index;
+	pWheel->Count++;
+
+	return TRUE;
+}
+
+// Removes the event at *pLink from its slot and puts it back on the free list
+void TimerWheelUnlink( TIMERWHEEL* pWheel, int* pLink )
+{
+	int Index = *pLink;
+	TIMEREVENT* pEvent = &pWheel->Events[ Index ];
+
+	*pLink = pEvent->Next;
+	pEvent->bActive = FALSE;
+	pEvent->Next = pWheel->FreeList;
+	pWheel->FreeList = Index;
+	pWheel->Count--;
+}
+
+// Cancels every waiting event of a type.  Returns how many were cancelled.
+int CancelTimerEvents( TIMERWHEEL* pWheel, int Type )
+{
+	int Cancelled = 0;
+
+	for( int i = 0 ; i < TIMERWHEEL_MAXEVENTS ; i++ )
+	{
+		if( !pWheel->Events[ i ].bActive || pWheel->Events[ i ].Type != Type )
+			continue;
+
+		// Find what points at it
+		int* pLink = &pWheel->Slots[ pWheel->Events[ i ].Due & ( TIMERWHEEL_SLOTS - 1 ) ];
+		while( *pLink != i )
+			pLink = &pWheel->Events[ *pLink ].Next;
+
+		TimerWheelUnlink( pWheel, pLink );
+		Cancelled++;
+	}
+
+	return Cancelled;
+}
+
+// Moves the wheel on to Now and copies out every event that has come due, oldest first.
+// pFired needs room for TIMERWHEEL_MAXEVENTS.  Returns how many fired.
+int PollTimerWheel( TIMERWHEEL* pWheel, DWORD Now, TIMEREVENT* pFired )
+{
+	DWORD Steps = Now - pWheel->Time;
+	int Fired = 0;
+
+	// Signed compare so GetTickCount() wrapping round is fine
+	if( (int)Steps <= 0 || pWheel->Count == 0 )
+	{
+		if( (int)Steps > 0 )
+			pWheel->Time = Now;
+		return 0;
+	}
+
+	// After a long gap every slot has to be looked at, but only once
+	if( Steps > TIMERWHEEL_SLOTS )
+		Steps = TIMERWHEEL_SLOTS;
+
+	for( DWORD s = 1 ; s <= Steps ; s++ )
+	{
+		int* pLink = &pWheel->Slots[ ( pWheel->Time + s ) & ( TIMERWHEEL_SLOTS - 1 ) ];
+
+		while( *pLink >= 0 )
+		{
+			TIMEREVENT* pEvent = &pWheel->Events[ *pLink ];
+
+			// Still a turn or more away
+			if( (int)( Now - pEvent->Due ) < 0 )
+			{
+				pLink = &pEvent->Next;
+				continue;
+			}
+
+			// Keep the fired list in order of due time
+			int i = Fired++;
+			while( i > 0 && (int)( pFired[ i - 1 ].Due - pEvent->Due ) > 0 )
+			{
+				pFired[ i ] = pFired[ i - 1 ];
+				i--;
+			}
+			pFired[ i ] = *pEvent;
+
+			TimerWheelUnlink( pWheel, pLink );
+		}
+	}
+
+	pWheel->Time = Now;
+	return Fired;
+}
+
+// Milliseconds from the last poll until the next event is due, or TIMERWHEEL_NONE
+DWORD TimerWheelNextDue( const TIMERWHEEL* pWheel )
+{
+	DWORD Next = TIMERWHEEL_NONE;
+
+	if( pWheel->Count == 0 )
+		return Next;
+
+	for( int i = 0 ; i < TIMERWHEEL_MAXEVENTS ; i++ )
+	{
+		if( !pWheel->Events[ i ].bActive )
+			continue;
+
+		DWORD Delay = pWheel->Events[ i ].Due - pWheel->Time;
+		if( Delay < Next )
+			Next = Delay;
+	}
+
+	return Next;
+}
+
+// Milliseconds from Now until the next event is due, 0 if one already is, or TIMERWHEEL_NONE.
+// Allows for the time since the wheel was last polled, for sleeping until the next event.
+DWORD TimerWheelWaitTime( const TIMERWHEEL* pWheel, DWORD Now )
+{
+	DWORD Next = TimerWheelNextDue( pWheel );
+	if( Next == TIMERWHEEL_NONE )
+		return Next;
+
+	DWORD Waited = Now - pWheel->Time;
+	return Next > Waited ? Next - Waited : 0;
+}
+
+#endif	// TIMERWHEEL_H
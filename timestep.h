@@ -0,0 +1,135 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Fixed timestep scheduling.  Real time is added to an accumulator each
+// pass through the game loop and the simulation is stepped once for every
+// whole tick in it, so the game runs at the same speed at any frame rate.
+// Rendering is scheduled separately and can be capped.  Times are counts
+// of a clock running at Frequency (QueryPerformanceCounter on Windows).
+
+#ifndef TIMESTEP_H
+#define TIMESTEP_H
+
+#include <string.h>
+#include "platform.h"
+
+struct FIXEDSTEP
+{
+	INT64 Frequency;		// Clock counts per second
+	int TickRate;			// Simulation ticks per second
+	int RenderCap;			// Most frames drawn per second, 0 for no limit
+
+	INT64 LastTime;			// Clock count at the last update
+	INT64 Accumulator;		// Time not yet simulated, in clock counts * TickRate
+	INT64 MaxAccumulator;	// Most time we will try to catch up on at once
+	INT64 NextRender;		// Clock count when the next frame is due
+
+	DWORD Ticks;			// Ticks run so far
+	DWORD DroppedTicks;		// Ticks skipped because we fell too far behind
+	DWORD Frames;			// Frames drawn so far
+	BOOL bStarted;
+};
+
+// Sets up the scheduler.  MaxCatchUpMs is how far behind the simulation may fall before
+// time is thrown away rather than simulated (otherwise a slow tick makes the next frame
+// run even more ticks, which makes it slower still).
+void FixedStepInit( FIXEDSTEP* pStep, INT64 Frequency, int TickRate, int RenderCap = 0, int MaxCatchUpMs = 250 )
+{
+	memset( pStep, 0, sizeof( FIXEDSTEP ) );
+
+	if( TickRate <= 0 )
+		TickRate = 100;
+	if( Frequency <= 0 )
+		Frequency = 1000;
+
+	pStep->Frequency = Frequency;
+	pStep->TickRate = TickRate;
+	pStep->RenderCap = RenderCap > 0 ? RenderCap : 0;
+
+	// Keeping the accumulator in counts * TickRate means a tick is exactly Frequency of it, with no rounding
+	pStep->MaxAccumulator = Frequency * MaxCatchUpMs / 1000 * TickRate;
+	if( pStep->MaxAccumulator < Frequency )
+		pStep->MaxAccumulator = Frequency;
+}
+
+// Forgets any time that has built up, e.g. after a pause or a lost device
+void FixedStepReset( FIXEDSTEP* pStep, INT64 Now )
+{
+	pStep->LastTime = Now;
+	pStep->Accumulator = 0;
+	pStep->NextRender = Now;
+	pStep->bStarted = TRUE;
+}
+
+// Adds the time since the last call and returns how many ticks should be run now
+int FixedStepAdvance( FIXEDSTEP* pStep, INT64 Now )
+{
+	if( !pStep->bStarted )
+		FixedStepReset( pStep, Now );
+
+	INT64 Elapsed = Now - pStep->LastTime;
+	pStep->LastTime = Now;
+
+	// The clock should never go backwards, but do not let it confuse us if it does
+	if( Elapsed < 0 )
+		Elapsed = 0;
+
+	pStep->Accumulator += Elapsed * pStep->TickRate;
+
+	// Spiral of death clamp
+	if( pStep->Accumulator > pStep->MaxAccumulator )
+	{
+		pStep->DroppedTicks += (DWORD)( ( pStep->Accumulator - pStep->MaxAccumulator ) / pStep->Frequency );
+		pStep->Accumulator = pStep->MaxAccumulator;
+	}
+
+	int Ticks = (int)( pStep->Accumulator / pStep->Frequency );
+	pStep->Accumulator -= (INT64)Ticks * pStep->Frequency;
+	pStep->Ticks += Ticks;
+
+	return Ticks;
+}
+
+// The clock count at which tick Tick (0 to Ticks - 1) of the Ticks FixedStepAdvance() just
+// returned ends.  The last one ends where the accumulator starts, the others a tick apart
+// before it.
+INT64 FixedStepTickTime( const FIXEDSTEP* pStep, int Ticks, int Tick )
+{
+	INT64 Behind = pStep->Accumulator + (INT64)( Ticks - 1 - Tick ) * pStep->Frequency;
+	return pStep->LastTime - Behind / pStep->TickRate;
+}
+
+// How far we are into the next tick, from 0 to 65535.  Used to draw moving things
+// between their last two positions.
+int FixedStepAlpha( const FIXEDSTEP* pStep )
+{
+	return (int)( ( pStep->Accumulator << 16 ) / pStep->Frequency );
+}
+
+// Returns TRUE if a frame should be drawn now.  With no cap there is always one due.
+BOOL FixedStepRenderDue( FIXEDSTEP* pStep, INT64 Now )
+{
+	if( pStep->RenderCap == 0 )
+	{
+		pStep->Frames++;
+		return TRUE;
+	}
+
+	if( Now < pStep->NextRender )
+		return FALSE;
+
+	INT64 Interval = pStep->Frequency / pStep->RenderCap;
+	pStep->NextRender += Interval;
+
+	// Fell more than a frame behind, so start counting again from now instead of drawing a burst
+	if( pStep->NextRender < Now )
+		pStep->NextRender = Now + Interval;
+
+	pStep->Frames++;
+	return TRUE;
+}
+
+#endif	// TIMESTEP_H
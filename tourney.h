@@ -0,0 +1,375 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Round robin tournaments between computer players, spread over every core.
+// Each match is one task.  Tasks are dealt out to per-thread work-stealing
+// deques; a thread that runs out steals from the others.  Every match writes
+// its result to its own slot, so no locks are needed, and the standings are
+// added up once all threads are done.
+
+#ifndef TOURNEY_H
+#define TOURNEY_H
+
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "platform.h"
+#include "pongsim.h"
+#include "pongbot.h"
+
+#define TOURNEY_MAXTHREADS	256
+
+// One match to be played
+struct TOURNEYMATCH
+{
+	int Player1;		// Index into the player list
+	int Player2;
+	DWORD Seed;			// Seeds both the match and the players' random numbers
+};
+
+// How a match ended
+struct TOURNEYRESULT
+{
+	int p1Score;
+	int p2Score;
+	DWORD Ticks;		// Length of the match
+	DWORD Hash;			// PongSimHash() of the final state
+	int Thread;			// Which thread played it
+};
+
+// A player's totals
+struct TOURNEYSTANDING
+{
+	int Wins;
+	int Losses;
+	int Draws;			// Matches that hit the tick limit
+	int PointsFor;
+	int PointsAgainst;
+};
+
+struct TOURNEYSETTINGS
+{
+	int GamesPerPairing;	// Games for each ordered pair of players (so each side is played)
+	DWORD Seed;				// Base seed; match i is seeded from (Seed, i)
+	int Threads;			// 0 for one per core
+	int TickRate;			// Ticks per second of game time
+	int BallSpeed;			// 1 - 5, as if F1 - F5 were held
+	DWORD MaxTicks;			// A match that runs longer is a draw
+};
+
+struct TOURNEYSTATS
+{
+	int Matches;
+	int Threads;
+	double TotalTicks;
+	DWORD Hash;								// Combined hash of every match, in match order
+	int Played[ TOURNEY_MAXTHREADS ];		// Matches played by each thread
+	int Stolen[ TOURNEY_MAXTHREADS ];		// Matches each thread stole from another
+};
+
+//====================================================
+// Work-Stealing Deque
+//====================================================
+
+// A Chase-Lev deque of task indices.  The owner pops from the bottom and thieves take from the
+// top.  All tasks are pushed before the threads start, so the array never has to grow.
+struct alignas( 64 ) WORKDEQUE
+{
+	std::atomic<long long> Top;
+	char Pad[ 64 - sizeof( std::atomic<long long> ) ];	// Keep the thieves' and owner's counters on separate cache lines
+	std::atomic<long long> Bottom;
+	int* pTasks;
+};
+
+#define WORKDEQUE_EMPTY		-1
+#define WORKDEQUE_ABORT		-2		// Lost a race with another thief, try again
+
+void WorkDequeInit( WORKDEQUE* pDeque, int* pTasks )
+{
+	pDeque->Top.store( 0 );
+	pDeque->Bottom.store( 0 );
+	pDeque->pTasks = pTasks;
+}
+
+// Only called before the threads start
+void WorkDequePush( WORKDEQUE* pDeque, int Task )
+{
+	long long b = pDeque->Bottom.load( std::memory_order_relaxed );
+	pDeque->pTasks[ b ] = Task;
+	pDeque->Bottom.store( b + 1, std::memory_order_release );
+}
+
+// Takes a task from the owner's end
+int WorkDequePop( WORKDEQUE* pDeque )
+{
+	long long b = pDeque->Bottom.load( std::memory_order_relaxed ) - 1;
+	pDeque->Bottom.store( b, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	long long t = pDeque->Top.load( std::memory_order_relaxed );
+
+	if( t > b )
+	{
+		// Already empty
+		pDeque->Bottom.store( b + 1, std::memory_order_relaxed );
+		return WORKDEQUE_EMPTY;
+	}
+
+	int Task = pDeque->pTasks[ b ];
+
+	if( t == b )
+	{
+		// The last task, so race the thieves for it
+		if( !pDeque->Top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+			Task = WORKDEQUE_EMPTY;
+
+		pDeque->Bottom.store( b + 1, std::memory_order_relaxed );
+	}
+
+	return Task;
+}
+
+// Takes a task from the other end, called by other threads
+int WorkDequeSteal( WORKDEQUE* pDeque )
+{
+	long long t = pDeque->Top.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	long long b = pDeque->Bottom.load( std::memory_order_acquire );
+
+	if( t >= b )
+		return WORKDEQUE_EMPTY;
+
+	int Task = pDeque->pTasks[ t ];
+
+	if( !pDeque->Top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+		return WORKDEQUE_ABORT;
+
+	return Task;
+}
+
+//====================================================
+// Matches
+//====================================================
+
+// Plays one match to the end (or MaxTicks)
+void PlayTourneyMatch( const PONGBOTINFO* pPlayers, const TOURNEYMATCH* pMatch, const TOURNEYSETTINGS* pSettings,
+					   PONGRNG* pRng, TOURNEYRESULT* pResult )
+{
+	PONGSIM Sim;
+	PongSimInit( &Sim, pMatch->Seed, pSettings->TickRate );
+
+	// The thread's random number stream restarts for every match, so results do not depend on which thread played it
+	PongRngSeed( pRng, ( (unsigned long long)pMatch->Seed << 32 ) | pMatch->Seed );
+
+	PONGPOLICY pfnPlayer1 = pPlayers[ pMatch->Player1 ].pfnPolicy;
+	PONGPOLICY pfnPlayer2 = pPlayers[ pMatch->Player2 ].pfnPolicy;
+	unsigned int Speed = PONGINPUT_SPEED1 << ( pSettings->BallSpeed - 1 );
+
+	while( !Sim.bGameOver && Sim.Tick < pSettings->MaxTicks )
+	{
+		unsigned int Input = pfnPlayer1( &Sim, 1, pRng ) | pfnPlayer2( &Sim, 2, pRng ) | Speed;
+		PongSimStep( &Sim, Input );
+	}
+
+	pResult->p1Score = Sim.p1Score;
+	pResult->p2Score = Sim.p2Score;
+	pResult->Ticks = Sim.Tick;
+	pResult->Hash = PongSimHash( &Sim );
+}
+
+// Everything the worker threads share.  Only the deques are written by more than one thread.
+struct TOURNEYWORK
+{
+	const PONGBOTINFO* pPlayers;
+	const TOURNEYSETTINGS* pSettings;
+	const TOURNEYMATCH* pMatches;
+	TOURNEYRESULT* pResults;
+	WORKDEQUE* pDeques;
+	int Threads;
+	TOURNEYSTATS* pStats;
+};
+
+// The body of each worker thread
+void TourneyWorker( TOURNEYWORK* pWork, int Thread )
+{
+	PONGRNG Rng;
+	PONGRNG Victims;
+	PongRngSeed( &Victims, Thread + 1 );
+
+	int Played = 0, Stolen = 0;
+
+	for( ;; )
+	{
+		// Our own work first
+		int Task = WorkDequePop( &pWork->pDeques[ Thread ] );
+
+		// Then try everyone else, starting somewhere random so thieves spread out
+		if( Task == WORKDEQUE_EMPTY && pWork->Threads > 1 )
+		{
+			BOOL bRetry = TRUE;
+			while( Task < 0 && bRetry )
+			{
+				bRetry = FALSE;
+				int Start = (int)( PongRngNext( &Victims ) % pWork->Threads );
+
+				for( int v = 0 ; v < pWork->Threads && Task < 0 ; v++ )
+				{
+					int Victim = ( Start + v ) % pWork->Threads;
+					if( Victim == Thread )
+						continue;
+
+					Task = WorkDequeSteal( &pWork->pDeques[ Victim ] );
+					if( Task == WORKDEQUE_ABORT )
+						bRetry = TRUE;
+				}
+			}
+
+			if( Task >= 0 )
+				Stolen++;
+		}
+
+		// Nothing was pushed after the start, so once every deque is empty we are done
+		if( Task < 0 )
+			break;
+
+		PlayTourneyMatch( pWork->pPlayers, &pWork->pMatches[ Task ], pWork->pSettings, &Rng, &pWork->pResults[ Task ] );
+		pWork->pResults[ Task ].Thread = Thread;
+		Played++;
+	}
+
+	// Each thread owns its own slot
+	pWork->pStats->Played[ Thread ] = Played;
+	pWork->pStats->Stolen[ Thread ] = Stolen;
+}
+
+//====================================================
+// Tournament
+//====================================================
+
+void DefaultTourneySettings( TOURNEYSETTINGS* pSettings )
+{
+	pSettings->GamesPerPairing = 10;
+	pSettings->Seed = 1;
+	pSettings->Threads = 0;
+	pSettings->TickRate = PONGSIM_BASE_RATE;
+	pSettings->BallSpeed = BALL_MAXSPEED;			// Good bots never miss a slow ball
+	pSettings->MaxTicks = 60 * 60 * PONGSIM_BASE_RATE;	// An hour of game time
+}
+
+// Plays every player against every other player, GamesPerPairing times on each side.
+// pStandings needs PlayerCount entries.  Returns the number of matches played.
+int RunTournament( const PONGBOTINFO* pPlayers, int PlayerCount, const TOURNEYSETTINGS* pSettings,
+				   TOURNEYSTANDING* pStandings, TOURNEYSTATS* pStats )
+{
+	int Threads = pSettings->Threads;
+	if( Threads <= 0 )
+		Threads = (int)std::thread::hardware_concurrency();
+	if( Threads <= 0 )
+		Threads = 1;
+	if( Threads > TOURNEY_MAXTHREADS )
+		Threads = TOURNEY_MAXTHREADS;
+
+	memset( pStats, 0, sizeof( TOURNEYSTATS ) );
+	memset( pStandings, 0, PlayerCount * sizeof( TOURNEYSTANDING ) );
+
+	// Build the list of matches
+	std::vector<TOURNEYMATCH> Matches;
+	for( int p1 = 0 ; p1 < PlayerCount ; p1++ )
+	{
+		for( int p2 = 0 ; p2 < PlayerCount ; p2++ )
+		{
+			if( p1 == p2 )
+				continue;
+
+			for( int g = 0 ; g < pSettings->GamesPerPairing ; g++ )
+			{
+				TOURNEYMATCH Match;
+				Match.Player1 = p1;
+				Match.Player2 = p2;
+				Match.Seed = PongRngDerive( pSettings->Seed, Matches.size() );
+				Matches.push_back( Match );
+			}
+		}
+	}
+
+	int Count = (int)Matches.size();
+	if( Count == 0 )
+		return 0;
+
+	std::vector<TOURNEYRESULT> Results( Count );
+	std::vector<int> TaskMemory( Count );
+	WORKDEQUE* pDeques = new WORKDEQUE[ Threads ];
+
+	// Deal the matches out round robin.  Each deque gets a slice of the task memory big
+	// enough for its share, since nothing is pushed once the threads are running.
+	int Offset = 0;
+	for( int t = 0 ; t < Threads ; t++ )
+	{
+		WorkDequeInit( &pDeques[ t ], &TaskMemory[ 0 ] + Offset );
+		Offset += ( Count - t + Threads - 1 ) / Threads;
+	}
+	for( int i = 0 ; i < Count ; i++ )
+		WorkDequePush( &pDeques[ i % Threads ], i );
+
+	TOURNEYWORK Work;
+	Work.pPlayers = pPlayers;
+	Work.pSettings = pSettings;
+	Work.pMatches = &Matches[ 0 ];
+	Work.pResults = &Results[ 0 ];
+	Work.pDeques = pDeques;
+	Work.Threads = Threads;
+	Work.pStats = pStats;
+
+	// This thread is worker 0
+	std::vector<std::thread> Workers;
+	for( int t = 1 ; t < Threads ; t++ )
+		Workers.push_back( std::thread( TourneyWorker, &Work, t ) );
+	TourneyWorker( &Work, 0 );
+	for( size_t t = 0 ; t < Workers.size() ; t++ )
+		Workers[ t ].join();
+
+	delete [] pDeques;
+
+	// Add everything up now that the threads are finished
+	pStats->Matches = Count;
+	pStats->Threads = Threads;
+	pStats->Hash = 2166136261u;
+
+	for( int i = 0 ; i < Count ; i++ )
+	{
+		TOURNEYSTANDING* p1 = &pStandings[ Matches[ i ].Player1 ];
+		TOURNEYSTANDING* p2 = &pStandings[ Matches[ i ].Player2 ];
+		const TOURNEYRESULT* pResult = &Results[ i ];
+
+		p1->PointsFor += pResult->p1Score;
+		p1->PointsAgainst += pResult->p2Score;
+		p2->PointsFor += pResult->p2Score;
+		p2->PointsAgainst += pResult->p1Score;
+
+		if( pResult->p1Score >= MAX_SCORE )
+		{
+			p1->Wins++;
+			p2->Losses++;
+		}
+		else if( pResult->p2Score >= MAX_SCORE )
+		{
+			p2->Wins++;
+			p1->Losses++;
+		}
+		else
+		{
+			p1->Draws++;
+			p2->Draws++;
+		}
+
+		pStats->TotalTicks += pResult->Ticks;
+		pStats->Hash = ( pStats->Hash ^ pResult->Hash ) * 16777619u;
+	}
+
+	return Count;
+}
+
+#endif	// TOURNEY_H
@@ -0,0 +1,261 @@
+//*********************************
+// Uber-Pong by Sean Gilleran
+// (C)2003 Anti-Mass Studios
+// All rights reserved
+//*********************************
+
+// Span tracing.  TRACE_SCOPE( "Name" ) records when the enclosing block
+// began and ended into a ring buffer owned by the calling thread, so no
+// locks are taken and the newest events are always kept.  While tracing is
+// off a scope costs one load and one branch; define NO_TRACE to remove them
+// altogether.  WriteTraceJSON() saves the rings in the Chrome trace event
+// format, which chrome://tracing and ui.perfetto.dev both open.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "platform.h"
+#include "hrclock.h"
+
+#define TRACE_RINGSIZE		65536	// Events kept per thread (a power of 2)
+#define TRACE_MAXTHREADS	32
+
+// One span.  Name must be a string that lives forever (normally a literal).
+struct TRACEEVENT
+{
+	const char* Name;
+	INT64 Start;		// HrClockNow() counts
+	INT64 End;
+};
+
+struct TRACERING
+{
+	std::atomic<DWORD> Head;			// Events written so far; the slot is Head % TRACE_RINGSIZE
+	std::atomic<BOOL> bInUse;			// A live thread owns the ring
+	std::atomic<DWORD> FreeEpoch;		// Trace the owner exited in; the ring is not handed on during it
+	char ThreadName[32];
+	TRACEEVENT Events[ TRACE_RINGSIZE ];
+};
+
+// Every ring made so far.  A slot is claimed by bumping the count, then filled in.
+std::atomic<TRACERING*> g_pTraceRings[ TRACE_MAXTHREADS ];
+std::atomic<int> g_TraceRingCount( 0 );
+
+// TRUE while events are being recorded
+std::atomic<BOOL> g_bTracing( FALSE );
+
+// Counts the traces started so far
+std::atomic<DWORD> g_TraceEpoch( 0 );
+
+// Clock count when tracing was last started; times in the file are relative to this, and
+// anything older is left out
+INT64 g_TraceStart = 0;
+
+// The calling thread's tracing state.  The ring is given back when the thread exits.
+struct TRACETHREAD
+{
+	TRACERING* pRing;
+	DWORD FullEpoch;					// Trace in which no ring was left for this thread
+	char Name[32];
+
+	~TRACETHREAD()
+	{
+		if( !pRing )
+			return;
+
+		pRing->FreeEpoch.store( g_TraceEpoch.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+		pRing->bInUse.store( FALSE, std::memory_order_release );
+	}
+};
+
+thread_local TRACETHREAD t_TraceThread;
+
+// Hands the ring to the calling thread under its name
+TRACERING* TraceClaimRing( TRACETHREAD* pThread, TRACERING* pRing, int Index )
+{
+	if( pThread->Name[ 0 ] )
+		strcpy( pRing->ThreadName, pThread->Name );
+	else
+		snprintf( pRing->ThreadName, sizeof( pRing->ThreadName ), "Thread %d", Index );
+
+	pThread->pRing = pRing;
+	return pRing;
+}
+
+// Returns the calling thread's ring.  Rings are only handed out while tracing, either one
+// left by a thread that has exited or a new one.  NULL if tracing is off or every slot is
+// taken; a thread that found none does not look again until the next trace.
+TRACERING* TraceThreadRing()
+{
+	TRACETHREAD* pThread = &t_TraceThread;
+	if( pThread->pRing )
+		return pThread->pRing;
+
+	DWORD Epoch = g_TraceEpoch.load( std::memory_order_relaxed );
+	if( !g_bTracing.load( std::memory_order_relaxed ) || pThread->FullEpoch == Epoch )
+		return 0;
+
+	// Reuse a ring from an exited thread, unless it exited during this trace and its events are still wanted
+	int Count = g_TraceRingCount.load();
+	for( int i = 0 ; i < Count && i < TRACE_MAXTHREADS ; i++ )
+	{
+		TRACERING* pRing = g_pTraceRings[ i ].load( std::memory_order_acquire );
+		if( !pRing || pRing->bInUse.load( std::memory_order_relaxed ) )
+			continue;
+
+		BOOL bInUse = FALSE;
+		if( !pRing->bInUse.compare_exchange_strong( bInUse, TRUE, std::memory_order_acquire ) )
+			continue;
+
+		if( pRing->FreeEpoch.load( std::memory_order_relaxed ) == Epoch )
+		{
+			pRing->bInUse.store( FALSE, std::memory_order_release );
+			continue;
+		}
+
+		pRing->Head.store( 0, std::memory_order_relaxed );
+		return TraceClaimRing( pThread, pRing, i );
+	}
+
+	int Index = Count < TRACE_MAXTHREADS ? g_TraceRingCount.fetch_add( 1 ) : TRACE_MAXTHREADS;
+	if( Index >= TRACE_MAXTHREADS )
+	{
+		pThread->FullEpoch = Epoch;
+		return 0;
+	}
+
+	TRACERING* pRing = new TRACERING;
+	pRing->Head.store( 0 );
+	pRing->bInUse.store( TRUE );
+	pRing->FreeEpoch.store( 0 );
+	TraceClaimRing( pThread, pRing, Index );
+
+	g_pTraceRings[ Index ].store( pRing, std::memory_order_release );
+	return pRing;
+}
+
+// Gives the calling thread a name in the trace
+void TraceNameThread( const char* Name )
+{
+	TRACETHREAD* pThread = &t_TraceThread;
+	strncpy( pThread->Name, Name, sizeof( pThread->Name ) - 1 );
+	pThread->Name[ sizeof( pThread->Name ) - 1 ] = 0;
+
+	if( pThread->pRing )
+		strcpy( pThread->pRing->ThreadName, pThread->Name );
+}
+
+// Adds a finished span to the calling thread's ring
+inline void TraceRecord( const char* Name, INT64 Start, INT64 End )
+{
+	TRACERING* pRing = TraceThreadRing();
+	if( !pRing )
+		return;
+
+	// Only this thread writes the ring, so a plain load and store is enough
+	DWORD Head = pRing->Head.load( std::memory_order_relaxed );
+	TRACEEVENT* pEvent = &pRing->Events[ Head & ( TRACE_RINGSIZE - 1 ) ];
+	pEvent->Name = Name;
+	pEvent->Start = Start;
+	pEvent->End = End;
+	pRing->Head.store( Head + 1, std::memory_order_release );
+}
+
+// Records the enclosing block as a span, if tracing was on when it started
+struct TRACESCOPE
+{
+	const char* Name;
+	INT64 Start;
+
+	TRACESCOPE( const char* ScopeName )
+	{
+		Name = g_bTracing.load( std::memory_order_relaxed ) ? ScopeName : 0;
+		if( Name )
+			Start = HrClockNow();
+	}
+
+	~TRACESCOPE()
+	{
+		if( Name )
+			TraceRecord( Name, Start, HrClockNow() );
+	}
+};
+
+#ifdef NO_TRACE
+#define TRACE_SCOPE( Name )
+#else
+#define TRACE_JOIN2( a, b )		a##b
+#define TRACE_JOIN( a, b )		TRACE_JOIN2( a, b )
+#define TRACE_SCOPE( Name )		TRACESCOPE TRACE_JOIN( TraceScope, __LINE__ )( Name )
+#endif
+
+// Starts recording.  The rings belong to their threads, so they are not emptied here;
+// events from earlier traces are older than g_TraceStart and are skipped when written.
+void StartTrace()
+{
+	g_TraceStart = HrClockNow();
+	g_TraceEpoch.fetch_add( 1 );
+	g_bTracing.store( TRUE );
+}
+
+void StopTrace()
+{
+	g_bTracing.store( FALSE );
+}
+
+// Microseconds since the trace started, which is what the trace format wants
+inline double TraceMicroseconds( INT64 Counts )
+{
+	return HrClockToNs( Counts - g_TraceStart ) / 1000.0;
+}
+
+// Writes every ring to a Chrome trace event JSON file.  Call with tracing stopped, or the
+// events being written while the file is saved may come out garbled.
+BOOL WriteTraceJSON( const char* FileName )
+{
+	FILE* pFile = fopen( FileName, "w" );
+	if( !pFile )
+		return FALSE;
+
+	fprintf( pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+	BOOL bFirst = TRUE;
+	int Count = g_TraceRingCount.load();
+
+	for( int t = 0 ; t < Count && t < TRACE_MAXTHREADS ; t++ )
+	{
+		TRACERING* pRing = g_pTraceRings[ t ].load( std::memory_order_acquire );
+		if( !pRing )
+			continue;
+
+		// Name the thread
+		fprintf( pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				 bFirst ? "" : ",\n", t, pRing->ThreadName );
+		bFirst = FALSE;
+
+		// The oldest events have been overwritten if the ring went all the way round
+		DWORD Head = pRing->Head.load( std::memory_order_acquire );
+		DWORD First = Head > TRACE_RINGSIZE ? Head - TRACE_RINGSIZE : 0;
+
+		for( DWORD i = First ; i < Head ; i++ )
+		{
+			const TRACEEVENT* pEvent = &pRing->Events[ i & ( TRACE_RINGSIZE - 1 ) ];
+			if( pEvent->Start < g_TraceStart )
+				continue;
+
+			// Complete events carry both the begin and end time
+			fprintf( pFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					 pEvent->Name, t, TraceMicroseconds( pEvent->Start ),
+					 HrClockToNs( pEvent->End - pEvent->Start ) / 1000.0 );
+		}
+	}
+
+	fprintf( pFile, "\n]}\n" );
+	fclose( pFile );
+	return TRUE;
+}
+
+#endif	// TRACE_H